@@ -8,7 +8,14 @@
  */  
 #include "MRAGBlockLab.h"
 #include "MRAGCompressionPlan.h"
+#include "MRAGEnvironment.h"
 #pragma once
+
+#ifdef _MRAG_TBB
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#endif
+
 namespace MRAG
 {
 	template <typename WaveletsType, typename BlockCollectionType>
@@ -84,6 +91,76 @@ namespace MRAG
 			}
 		}
 		
+		template <typename BlockLabType>
+		void _prepareLab(BlockLabType& lab, BlockCollection<BlockType>& collection, BoundaryInfo& boundaryInfo) const
+		{
+			const int stencilStart[3] = {
+				!BlockType::shouldProcessDirectionX?0: 1 - WaveletsType::HaSupport[1],
+				!BlockType::shouldProcessDirectionY?0: 1 - WaveletsType::HaSupport[1],
+				!BlockType::shouldProcessDirectionZ?0: 1 - WaveletsType::HaSupport[1]
+			};
+			
+			const int stencilEnd[3] = {
+				!BlockType::shouldProcessDirectionX?1: - WaveletsType::HaSupport[0],
+				!BlockType::shouldProcessDirectionY?1: - WaveletsType::HaSupport[0],
+				!BlockType::shouldProcessDirectionZ?1: - WaveletsType::HaSupport[0]
+			};	
+			
+			lab.prepare(collection, boundaryInfo, stencilStart, stencilEnd);
+		}
+		
+		/**
+		 * Fills the parents of the collapses [r.begin(), r.end()) of the plan.
+		 * The collapses write disjoint parents and only read their sources,
+		 * every range works with its own lab.
+		 */
+		template <typename BlockLabType>
+		struct CollapseBody
+		{
+			BlockCollapser& collapser;
+			BlockCollection<BlockType>& collection;
+			BoundaryInfo& boundaryInfo;
+			const CompressionPlan& compressionPlan;
+			const vector<int>& vIDs;
+			
+			CollapseBody(BlockCollapser& collapser, BlockCollection<BlockType>& collection, BoundaryInfo& boundaryInfo, 
+						 const CompressionPlan& compressionPlan, const vector<int>& vIDs):
+			collapser(collapser), collection(collection), boundaryInfo(boundaryInfo), 
+			compressionPlan(compressionPlan), vIDs(vIDs) {}
+			
+			CollapseBody(const CollapseBody& c):
+			collapser(c.collapser), collection(c.collection), boundaryInfo(c.boundaryInfo), 
+			compressionPlan(c.compressionPlan), vIDs(c.vIDs) {}
+			
+			void fill(BlockLabType& lab, const int cStart, const int cEnd) const
+			{
+				for(int c=cStart; c<cEnd; c++)
+				{
+					CompressionPlan::Collapse& collapseInfo = compressionPlan.vCollapseArray[c];
+					
+					vector<BlockType *>source;
+					for(int s=0; s<collapseInfo.nSources; s++)
+						source.push_back(&collection.lock(collapseInfo.source_blockIDs[s]));
+					
+					collapser._collapseBlocks(lab, collapseInfo, source, collection.lock(vIDs[c]));
+					collection.release(vIDs[c]);
+					
+					for(int s=0; s<collapseInfo.nSources; s++)
+						collection.release(collapseInfo.source_blockIDs[s]);
+				}
+			}
+			
+			template<typename BlockedRange>
+			void operator()(const BlockedRange& r) const
+			{
+				BlockLabType lab;
+				
+				collapser._prepareLab(lab, collection, boundaryInfo);
+				
+				fill(lab, r.begin(), r.end());
+			}
+		};
+		
 	public:
 		BlockCollapser(): m_blockLab() {}
 	
@@ -102,46 +179,28 @@ namespace MRAG
 			//4. output the result
 			
 			//0.
-			{
-				const int stencilStart[3] = {
-					!BlockType::shouldProcessDirectionX?0: 1 - WaveletsType::HaSupport[1],
-					!BlockType::shouldProcessDirectionY?0: 1 - WaveletsType::HaSupport[1],
-					!BlockType::shouldProcessDirectionZ?0: 1 - WaveletsType::HaSupport[1]
-				};
-				
-				const int stencilEnd[3] = {
-					!BlockType::shouldProcessDirectionX?1: - WaveletsType::HaSupport[0],
-					!BlockType::shouldProcessDirectionY?1: - WaveletsType::HaSupport[0],
-					!BlockType::shouldProcessDirectionZ?1: - WaveletsType::HaSupport[0]
-				};	
-				
-				lab.prepare(collection, boundaryInfo, stencilStart, stencilEnd);
-			}
+			const int nCollapses = compressionPlan.nCollapses;
+			
+			int nCollapsed = 0;
+			for(int c=0; c<nCollapses; c++)
+				nCollapsed += compressionPlan.vCollapseArray[c].nSources;
 			
 			//1.
-			vector<int> vIDs = collection.create(compressionPlan.nCollapses);
+			vector<int> vIDs = collection.create(nCollapses);
 			
 			//2.
-			int nCollapsed = 0;
-			for(int c=0; c<compressionPlan.nCollapses; c++)
-			{
-				CompressionPlan::Collapse& collapseInfo = compressionPlan.vCollapseArray[c];
-				
-				vector<BlockType *>source;
-				for(int s=0; s<collapseInfo.nSources; s++)
-					source.push_back(&collection.lock(collapseInfo.source_blockIDs[s]));
-				
-				_collapseBlocks(lab, collapseInfo, source, collection.lock(vIDs[c]));
-				collection.release(vIDs[c]);
-
-				for(int s=0; s<collapseInfo.nSources; s++)
-					collection.release(collapseInfo.source_blockIDs[s]);
-
-				nCollapsed += source.size();
-			}
+			CollapseBody<BlockLabType> body(*this, collection, boundaryInfo, compressionPlan, vIDs);
+			
+#ifdef _MRAG_TBB
+			const int nThreads = _MRAG_TBB_NTHREADS_HINT;
+			tbb::parallel_for(tbb::blocked_range<int>(0, nCollapses, std::max(1, nCollapses/(4*nThreads))), body, tbb::simple_partitioner());
+#else
+			_prepareLab(lab, collection, boundaryInfo);
+			body.fill(lab, 0, nCollapses);
+#endif
 			
 			//3.
-			for(int c=0; c<compressionPlan.nCollapses; c++)
+			for(int c=0; c<nCollapses; c++)
 			{
 				CompressionPlan::Collapse& collapseInfo = compressionPlan.vCollapseArray[c];
 				
@@ -150,7 +209,7 @@ namespace MRAG
 			}
 			
 			//4.
-			for(int c=0; c<compressionPlan.nCollapses; c++)
+			for(int c=0; c<nCollapses; c++)
 			{
 				BlockCollapseInfo blockinfo = {c, vIDs[c]};
 				vNewIDs.push_back(blockinfo);
@@ -17,7 +17,12 @@ using namespace std;
 #include _MRAG_BLOCKCOLLECTION_ALLOCATOR_HEADER
 #endif
 
+#include "tbb/atomic.h"
+#include "tbb/spin_mutex.h"
+
 #include "MRAGMatrix3D.h"
+#include "MRAGCommon.h"
+#include "MRAGmultithreading/MRAGBlockCostModel.h"
 
 #ifndef _MRAG_BLOCKCOLLECTION_ALLOCATOR
 #define _MRAG_BLOCKCOLLECTION_ALLOCATOR std::allocator	
@@ -78,6 +83,59 @@ public:
 		for(vector<int>::const_iterator it = blockIDs.begin(); it!= blockIDs.end(); it++)
 			release(*it);
 	}
+
+	/**
+	 * Register the arrays of block infos whose ptrBlock point to the blocks of this collection
+	 * (Grid::getBlocksInfoRef() and Grid::getBlocksInfoAtLevelRef()): the block processing uses such arrays in place.
+	 * The registered arrays are forgotten as soon as a block is erased or moved, by bumping the version of the collection.
+	 */
+	void setResolvedInfos(const BlockInfo * infos, const int n) { m_resolvedInfos = ResolvedInfos(infos, n, m_nResolvedVersion); }
+	void setResolvedInfosAtLevel(const int level, const BlockInfo * infos, const int n)
+	{
+		if (level >= m_vResolvedInfosAtLevel.size())
+			m_vResolvedInfosAtLevel.resize(level+1);
+
+		m_vResolvedInfosAtLevel[level] = ResolvedInfos(infos, n, m_nResolvedVersion);
+	}
+	void clearResolvedInfos() { m_nResolvedVersion++; }
+
+	/** Constant time: an array is either the one of all the blocks or the one of the level of its first block. */
+	bool isResolved(const BlockInfo * infos, const int n) const
+	{
+		if (n <= 0) return false;
+
+		if (m_resolvedInfos.matches(infos, n, m_nResolvedVersion)) return true;
+
+		const int level = infos->level;
+
+		return level >= 0 && level < m_vResolvedInfosAtLevel.size() && m_vResolvedInfosAtLevel[level].matches(infos, n, m_nResolvedVersion);
+	}
+
+	/**
+	 * NUMA placement (see NUMATopology): copies the blocks into memory first touched on
+	 * their home node, nodes[i] for blockIDs[i]. The blocks already there are not moved.
+	 * The block pointers change and the resolved infos are forgotten.
+	 * @return Number of blocks moved.
+	 */
+	int place(const vector<int>& blockIDs, const vector<int>& nodes);
+	/** Node the memory of the block was placed on, -1 if never placed. */
+	int getNode(const int blockID) const;
+	
+	/**
+	 * Measured costs of processing the blocks of this collection with the kernel
+	 * (see BlockProcessing_TBB::process()), created at the first use and kept until the collection dies.
+	 */
+	Multithreading::BlockCostModel& getCostModel(const int kernel) const;
+	
+	/** What the block processing keeps for a collection (e.g. the labs of the threads, see LabPool). */
+	struct ProcessingCache
+	{
+		virtual ~ProcessingCache() {}
+	};
+	
+	/** The cache of type CacheType of this collection, created at the first use and kept until the collection dies. */
+	template<typename CacheType>
+	CacheType& getProcessingCache() const;
 	
 	virtual float getMemorySize(bool bCountTrashAlso=false) const;
 	
@@ -89,17 +147,19 @@ protected:
 		BlockType * p;
 		int startID;
 		int nActives;
+		int node;
 		
-		Chunk(BlockType*p_, const int n_, const int startID_): p(p_), startID(startID_), nActives(n_){}
+		Chunk(BlockType*p_, const int n_, const int startID_, const int node_ = -1): p(p_), startID(startID_), nActives(n_), node(node_){}
 		~Chunk() {}
 
-		Chunk(const Chunk& a): p(a.p), startID(a.startID), nActives(a.nActives) {}
+		Chunk(const Chunk& a): p(a.p), startID(a.startID), nActives(a.nActives), node(a.node) {}
 		
 		Chunk& operator =(const Chunk& a)
 		{
 			p = (a.p);
 			startID = (a.startID);
 			nActives = (a.nActives);
+			node = (a.node);
 			
 			return *this;
 		}
@@ -124,6 +184,9 @@ protected:
 	}
 	
 	static int _createIDs(int n=1);
+	static int _createCacheID();
+	
+	struct PlaceChunks;
 	
 	vector<int> _allocateBlockInChunk(int & inoutRequestedBlocks, Chunk * chunk, int& inoutAvailableBlocksInCurrentChunk) const;
 	vector<int> _allocateChunks(int & inoutRequestedBlocks, 
@@ -137,6 +200,23 @@ protected:
 	map<int, Chunk *> m_blockIDToChunck;
 	set<Chunk*> m_setChunks;
 	vector<Chunk*> m_trash;
+	struct ResolvedInfos
+	{
+		const BlockInfo * infos;
+		int n, version;
+
+		ResolvedInfos(const BlockInfo * infos = NULL, int n = 0, int version = -1): infos(infos), n(n), version(version) {}
+
+		bool matches(const BlockInfo * i, const int c, const int currentVersion) const { return infos == i && n == c && version == currentVersion; }
+	};
+
+	ResolvedInfos m_resolvedInfos;
+	vector<ResolvedInfos> m_vResolvedInfosAtLevel;
+	int m_nResolvedVersion;
+	
+	mutable vector<Multithreading::BlockCostModel *> m_vCostModels;
+	mutable vector<ProcessingCache *> m_vProcessingCaches;
+	mutable tbb::spin_mutex m_cachesMutex;
 	
 	Chunk * m_currentChunk;
 	int m_nAvailableBlocksInCurrentChunk;
@@ -147,7 +227,8 @@ private:
 	//forbidden
 	BlockCollection(const BlockCollection&):
 	m_blockIDToBlockPointers(), m_blockIDToChunck(),
-	m_setChunks(), m_trash(),
+	m_setChunks(), m_trash(), m_resolvedInfos(), m_vResolvedInfosAtLevel(), m_nResolvedVersion(0),
+	m_vCostModels(), m_vProcessingCaches(), m_cachesMutex(),
 	m_currentChunk(NULL),
 	m_nAvailableBlocksInCurrentChunk(0){abort();}
 	
@@ -12,11 +12,19 @@
 #include <assert.h>
 #include <math.h>
 
+#include "MRAGNUMA.h"
+
+#ifdef _MRAG_TBB
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#endif
+
 namespace MRAG
 {
 	template<typename BlockType_> BlockCollection<BlockType_>::BlockCollection():
 		m_blockIDToBlockPointers(), m_blockIDToChunck(),
-		m_setChunks(), m_trash(),
+		m_setChunks(), m_trash(), m_resolvedInfos(), m_vResolvedInfosAtLevel(), m_nResolvedVersion(0),
+		m_vCostModels(), m_vProcessingCaches(), m_cachesMutex(),
 		m_currentChunk(NULL),
 		m_nAvailableBlocksInCurrentChunk(0), allocator()
 	{
@@ -25,6 +33,54 @@ namespace MRAG
 	template<typename BlockType_> BlockCollection<BlockType_>::~BlockCollection()
 	{
 		clear();
+		
+		for(int i=0; i<m_vCostModels.size(); i++)
+			delete m_vCostModels[i];
+		
+		for(int i=0; i<m_vProcessingCaches.size(); i++)
+			delete m_vProcessingCaches[i];
+	}
+	
+	template<typename BlockType_>
+	Multithreading::BlockCostModel& BlockCollection<BlockType_>::getCostModel(const int kernel) const
+	{
+		assert(kernel >= 0);
+		
+		tbb::spin_mutex::scoped_lock lock(m_cachesMutex);
+		
+		if (kernel >= m_vCostModels.size())
+			m_vCostModels.resize(kernel + 1, NULL);
+		
+		if (m_vCostModels[kernel] == NULL)
+			m_vCostModels[kernel] = new Multithreading::BlockCostModel;
+		
+		return *m_vCostModels[kernel];
+	}
+	
+	template<typename BlockType_>
+	inline int BlockCollection<BlockType_>::_createCacheID()
+	{
+		static tbb::atomic<int> scounterCaches;
+		
+		return scounterCaches.fetch_and_increment();
+	}
+	
+	template<typename BlockType_>
+	template<typename CacheType>
+	CacheType& BlockCollection<BlockType_>::getProcessingCache() const
+	{
+		//one index per cache type, resolved at compile time
+		static const int cacheID = _createCacheID();
+		
+		tbb::spin_mutex::scoped_lock lock(m_cachesMutex);
+		
+		if (cacheID >= m_vProcessingCaches.size())
+			m_vProcessingCaches.resize(cacheID + 1, NULL);
+		
+		if (m_vProcessingCaches[cacheID] == NULL)
+			m_vProcessingCaches[cacheID] = new CacheType;
+		
+		return *static_cast<CacheType *>(m_vProcessingCaches[cacheID]);
 	}
 	
 	template<typename BlockType_>
@@ -130,6 +186,7 @@ namespace MRAG
 		assert(chunk.nActives >= 0);
 		
 		//3.
+		clearResolvedInfos();
 		m_blockIDToChunck.erase(ID);
 		m_blockIDToBlockPointers.erase(ID);
 		if (chunk.nActives == 0)
@@ -147,6 +204,7 @@ namespace MRAG
 			m_trash.push_back(*it);
 		
 		m_setChunks.clear();
+		clearResolvedInfos();
 		m_blockIDToBlockPointers.clear();
 		m_blockIDToChunck.clear();
 		
@@ -216,7 +274,7 @@ namespace MRAG
 				chunk = inoutRecycledChunks.back();
 				inoutRecycledChunks.pop_back();
 				blocks = chunk->p;
-				*chunk = Chunk(blocks, nChunkSize, startID + iChunk*nChunkSize);
+				*chunk = Chunk(blocks, nChunkSize, startID + iChunk*nChunkSize, chunk->node);
 				
 				assert(m_setChunks.find(chunk) == m_setChunks.end());
 			}
@@ -282,10 +340,135 @@ namespace MRAG
 		return vIDs;
 	}
 	
+	/**
+	 * Copies the chunks of a node into new memory, allocated and touched by a thread bound to the node.
+	 */
+	template<typename BlockType_>
+	struct BlockCollection<BlockType_>::PlaceChunks
+	{
+		const BlockCollection& collection;
+		const vector< vector<Chunk *> >& chunksOfNode;
+		vector< vector<BlockType *> >& newBlocksOfNode;
+		
+		PlaceChunks(const BlockCollection& collection_, const vector< vector<Chunk *> >& chunksOfNode_, vector< vector<BlockType *> >& newBlocksOfNode_):
+		collection(collection_), chunksOfNode(chunksOfNode_), newBlocksOfNode(newBlocksOfNode_) {}
+		
+		PlaceChunks(const PlaceChunks& c): collection(c.collection), chunksOfNode(c.chunksOfNode), newBlocksOfNode(c.newBlocksOfNode) {}
+		
+		void placeNode(const int node) const
+		{
+			const vector<Chunk *>& chunks = chunksOfNode[node];
+			
+			if (chunks.empty()) return;
+			
+			NUMATopology::Binding binding(node);
+			
+			for(int i=0; i<chunks.size(); i++)
+			{
+				BlockType * blocks = collection._allocate(nChunkSize);
+				
+				for(int b=0; b<nChunkSize; b++)
+					blocks[b] = chunks[i]->p[b];
+				
+				newBlocksOfNode[node][i] = blocks;
+			}
+		}
+		
+#ifdef _MRAG_TBB
+		void operator()(const tbb::blocked_range<int>& r) const
+		{
+			for(int node=r.begin(); node<r.end(); node++)
+				placeNode(node);
+		}
+#endif
+	};
+	
+	template<typename BlockType_>
+	int BlockCollection<BlockType_>::place(const vector<int>& blockIDs, const vector<int>& nodes)
+	{
+		//1. collect the chunks not on their node
+		//2. copy them, one task per node
+		//3. switch the pointers, free the old memory
+		
+		assert(blockIDs.size() == nodes.size());
+		
+		const int nNodes = NUMATopology::getNodes();
+		
+		//1.
+		vector< vector<Chunk *> > chunksOfNode(nNodes);
+		set<Chunk *> chunksToPlace;
+		
+		for(int i=0; i<blockIDs.size(); i++)
+		{
+			assert(nodes[i] >= 0 && nodes[i] < nNodes);
+			
+			typename map<int, Chunk *>::const_iterator it = m_blockIDToChunck.find(blockIDs[i]);
+			assert(it != m_blockIDToChunck.end());
+			
+			Chunk * chunk = it->second;
+			
+			if (chunk->node == nodes[i] || !chunksToPlace.insert(chunk).second) continue;
+			
+			chunksOfNode[nodes[i]].push_back(chunk);
+		}
+		
+		if (chunksToPlace.empty()) return 0;
+		
+		//2.
+		vector< vector<BlockType *> > newBlocksOfNode(nNodes);
+		
+		for(int node=0; node<nNodes; node++)
+			newBlocksOfNode[node].resize(chunksOfNode[node].size());
+		
+		PlaceChunks body(*this, chunksOfNode, newBlocksOfNode);
+		
+#ifdef _MRAG_TBB
+		tbb::parallel_for(tbb::blocked_range<int>(0, nNodes, 1), body);
+#else
+		for(int node=0; node<nNodes; node++)
+			body.placeNode(node);
+#endif
+		
+		//3.
+		for(int node=0; node<nNodes; node++)
+			for(int i=0; i<chunksOfNode[node].size(); i++)
+			{
+				Chunk * chunk = chunksOfNode[node][i];
+				BlockType * blocks = newBlocksOfNode[node][i];
+				
+				for(int b=0; b<nChunkSize; b++)
+				{
+					typename map<int, BlockType*>::iterator it = m_blockIDToBlockPointers.find(chunk->startID + b);
+					
+					if (it != m_blockIDToBlockPointers.end())
+						it->second = blocks + b;
+				}
+				
+				_deallocate(chunk->p, nChunkSize);
+				
+				chunk->p = blocks;
+				chunk->node = node;
+			}
+		
+		clearResolvedInfos();
+		
+		return chunksToPlace.size()*nChunkSize;
+	}
+	
+	template<typename BlockType_>
+	int BlockCollection<BlockType_>::getNode(const int blockID) const
+	{
+		typename map<int, Chunk *>::const_iterator it = m_blockIDToChunck.find(blockID);
+		
+		assert(it != m_blockIDToChunck.end());
+		
+		return it->second->node;
+	}
+	
 	template<typename BlockType_>
 	float BlockCollection<BlockType_>::getMemorySize(bool bCountTrashAlso) const
 	{
-		int memsize = 0;
+		double memsize = 0;
 				
 		memsize += m_setChunks.size()*(sizeof(Chunk));
 		memsize += m_blockIDToBlockPointers.size()*(sizeof(BlockType*) + sizeof(int));
@@ -16,6 +16,7 @@
 #include "MRAGMatrix3D.h"
 #include "MRAGBlockLab.h"
 #include "MRAGEnvironment.h"
+#include "MRAGFWTLifting.h"
 #undef max
 #undef min
 
@@ -99,6 +100,17 @@ private:
 		maxVal = std::max(val, maxVal);
 	}
 	
+	//only the max is updated
+	template <int iChannel>
+	void sendMax(int code, double val)
+	{
+		assert(m_status == FWTReport_Open);
+		
+		double& maxVal = m_matMaxValues[iChannel]->Access(code&1, (code>>1)&1, (code>>2)&1);
+		
+		maxVal = std::max(val, maxVal);
+	}
+	
 	void conclude()
 	{
 		assert(m_status == FWTReport_Open);
@@ -195,6 +207,10 @@ public:
  * Used for automatic refinement/compression.
  * Projector needs to provide a static function Real Project(const T&) which should work for T = Block::ElementType.
  * Easiest way to do this is by using macro #make_projector.
+ * The 2D blocks are transformed with the lifting form of the wavelets that have one (see MRAGFWTLifting.h),
+ * all the channels being projected in one sweep over the lab; the others with the convolution.
+ * If bWriteDetails is false, Block::wtdata is not called and the report holds only the max magnitude
+ * of the details (not the min).
  * @see Science::AutomaticRefinement, Science::AutomaticCompression, MRAGHelperMacros.h, #make_projector
  */
 template <typename Wavelets, typename Block , typename Projector = dummy_projector ,bool bWriteDetails=true, int nChannels=1, typename BlockLabType = BlockLab<Block> >
@@ -216,6 +232,126 @@ private:
 	const BlockCollection<Block> * m_refCollection;
 	Real * m_weightsHa, * m_weightsGa;
 	
+	typedef FWTLifting<Wavelets> Lifting;
+	typedef LiftingAnalysis<Lifting> Analysis;
+	static const bool bLifting = Lifting::bAvailable && Block::shouldProcessDirectionX && Block::shouldProcessDirectionY && !Block::shouldProcessDirectionZ;
+	
+	//lifting: projected channels on the samples [sampleStart, sampleEnd) in x and y, then the lines of the passes
+	vector<Real> m_projected, m_lines, m_work;
+	int m_iFirstProjected;
+	
+	template <int iChannel, int iSize>
+	struct ProjectChannels
+	{
+		inline static void project(const Element& e, Real * dest, const int channelStride)
+		{
+			*dest = Projector::template Project<Element, iChannel>(e);
+			ProjectChannels<iChannel+1, iSize-1>::project(e, dest + channelStride, channelStride);
+		}
+	};
+	
+	template <int iChannel>
+	struct ProjectChannels<iChannel, 0>
+	{
+		inline static void project(const Element& e, Real * dest, const int channelStride) {}
+	};
+	
+	template<int iFirstChannel, int iLastChannel>
+	void _project()
+	{
+		const int nX = Block::sizeX/2;
+		const int nY = Block::sizeY/2;
+		const int sX[2] = {Analysis::sampleStart(), Analysis::sampleEnd(nX)};
+		const int sY[2] = {Analysis::sampleStart(), Analysis::sampleEnd(nY)};
+		const int nSamplesX = sX[1] - sX[0];
+		const int channelStride = nSamplesX*(sY[1] - sY[0]);
+		
+		m_projected.resize((iLastChannel - iFirstChannel + 1)*channelStride);
+		
+		Real * const projected = &m_projected.front();
+		
+		for(int iy=sY[0]; iy<sY[1]; iy++)
+		{
+			Real * const row = projected + (iy - sY[0])*nSamplesX - sX[0];
+			
+			for(int ix=sX[0]; ix<sX[1]; ix++)
+				ProjectChannels<iFirstChannel, iLastChannel - iFirstChannel + 1>::project(m_blockLab.read(ix, iy), row + ix, channelStride);
+		}
+		
+		m_iFirstProjected = iFirstChannel;
+	}
+	
+	template<int iChannel>
+	void _fwt_lifting(Block& block)
+	{
+		//1. lifting along y of the rows of samples
+		//2. transpose the coarse rows and the detail rows
+		//3. lifting along x of the columns, now rows
+		//4. write/report the details
+		
+		const int nX = Block::sizeX/2;
+		const int nY = Block::sizeY/2;
+		const int sX[2] = {Analysis::sampleStart(), Analysis::sampleEnd(nX)};
+		const int sY[2] = {Analysis::sampleStart(), Analysis::sampleEnd(nY)};
+		const int nSamplesX = sX[1] - sX[0];
+		const int nSamplesY = sY[1] - sY[0];
+		const int nCoarse = Analysis::coarseEnd(max(nX, nY)) - Analysis::coarseStart();
+		
+		m_lines.resize(4*nSamplesX*nY + 4*nX*nY);
+		m_work.resize(nCoarse*max(nSamplesX, nY));
+		
+		const Real * const projected = &m_projected[(iChannel - m_iFirstProjected)*nSamplesX*nSamplesY];
+		Real * const Ay = &m_lines.front();
+		Real * const Dy = Ay + nSamplesX*nY;
+		Real * const AyT = Dy + nSamplesX*nY;
+		Real * const DyT = AyT + nSamplesX*nY;
+		//the 4 codes, [ix][iy]
+		Real * const coeffs = DyT + nSamplesX*nY;
+		Real * const work = &m_work.front();
+		
+		//1.
+		Analysis::run(projected - sY[0]*nSamplesX, nSamplesX, nSamplesX, nY, Ay, Dy, work);
+		
+		//2.
+		for(int iy=0; iy<nY; iy++)
+			for(int ix=0; ix<nSamplesX; ix++)
+			{
+				AyT[ix*nY + iy] = Ay[iy*nSamplesX + ix];
+				DyT[ix*nY + iy] = Dy[iy*nSamplesX + ix];
+			}
+		
+		//3.
+		Analysis::run(AyT - sX[0]*nY, nY, nY, nX, coeffs, coeffs + nX*nY, work);
+		Analysis::run(DyT - sX[0]*nY, nY, nY, nX, coeffs + 2*nX*nY, coeffs + 3*nX*nY, work);
+		
+		//4.
+		for(int code=0; code<4; code++)
+		{
+			Real * const c = coeffs + code*nX*nY;
+			
+			if (bWriteDetails)
+			{
+				for(int ix=0; ix<nX; ix++)
+					for(int iy=0; iy<nY; iy++)
+					{
+						Real& value = c[ix*nY + iy];
+						
+						block.wtdata(value, code, ix, iy, 0);
+						m_report.template send<iChannel>(code, fabs(value));
+					}
+			}
+			else
+			{
+				Real maxMag = 0;
+				
+				for(int i=0; i<nX*nY; i++)
+					maxMag = max(maxMag, (Real)fabs(c[i]));
+				
+				m_report.template sendMax<iChannel>(code, maxMag);
+			}
+		}
+	}
+	
 	template<bool bWaveletX, bool bWaveletY, bool bWaveletZ, int iChannel>
 	Real _filter(const int dx, const int dy, const int dz) const
 	{
@@ -259,6 +395,12 @@ private:
 	template<int iChannel>
 	void _fwt(const BlockInfo& info, Block& block)
 	{
+		if (bLifting)
+		{
+			_fwt_lifting<iChannel>(block);
+			return;
+		}
+		
 		/*int a,b;
 		compute_pos__DEBUG(info.level, info.index[0], info.index[1], a, b, true);*/
 		const int nX = max(1,Block::sizeX/2);
@@ -271,24 +413,29 @@ private:
 				{
 					Real values[8];
 					
-					block.wtdata(values[0] = _filter<0,0,0, iChannel>( ix,iy,iz), 0, ix,iy,iz);
-					block.wtdata(values[1] = _filter<1,0,0, iChannel>( ix,iy,iz), 1,  ix,iy,iz);
+					values[0] = _filter<0,0,0, iChannel>( ix,iy,iz);
+					values[1] = _filter<1,0,0, iChannel>( ix,iy,iz);
 					
 					if (Block::shouldProcessDirectionY)
 					{
-						block.wtdata(values[2] = _filter<0,1,0, iChannel>( ix,iy,iz), 2,  ix,iy,iz);
-						block.wtdata(values[3] = _filter<1,1,0, iChannel>( ix,iy,iz), 3,  ix,iy,iz);
+						values[2] = _filter<0,1,0, iChannel>( ix,iy,iz);
+						values[3] = _filter<1,1,0, iChannel>( ix,iy,iz);
 						
 						if (Block::shouldProcessDirectionZ)
 						{
-							block.wtdata(values[4] = _filter<0,0,1, iChannel>(ix,iy,iz), 4, ix,iy,iz);
-							block.wtdata(values[5] = _filter<1,0,1, iChannel>(ix,iy,iz), 5, ix,iy,iz);
-							block.wtdata(values[6] = _filter<0,1,1, iChannel>(ix,iy,iz), 6, ix,iy,iz);
-							block.wtdata(values[7] = _filter<1,1,1, iChannel>(ix,iy,iz), 7, ix,iy,iz);
+							values[4] = _filter<0,0,1, iChannel>(ix,iy,iz);
+							values[5] = _filter<1,0,1, iChannel>(ix,iy,iz);
+							values[6] = _filter<0,1,1, iChannel>(ix,iy,iz);
+							values[7] = _filter<1,1,1, iChannel>(ix,iy,iz);
 						}
 					}
 					
 					const int n = !Block::shouldProcessDirectionY?2: !Block::shouldProcessDirectionZ? 4 : 8;
+					
+					if (bWriteDetails)
+						for(int i=0; i<n; i++)
+							block.wtdata(values[i], i, ix,iy,iz);
+					
 					for(int i=0; i<n; i+=2)
 					{
 						m_report.template send<iChannel>(i, fabs(values[i]));
@@ -322,7 +469,8 @@ public:
 	m_refCollection(NULL),
 	m_report(nReportSizeX, nReportSizeY, nReportSizeZ),
 	m_weightsHa(NULL), 
-	m_weightsGa(NULL)
+	m_weightsGa(NULL),
+	m_projected(), m_lines(), m_work(), m_iFirstProjected(0)
 	{
 		m_weightsGa = new Real[W::GaSupport[1] - W::GaSupport[0]];
 		m_weightsHa = new Real[W::HaSupport[1] - W::HaSupport[0]];
@@ -362,6 +510,10 @@ public:
 			!Block::shouldProcessDirectionZ?1 : max(-Wavelets::GaSupport[0], -Wavelets::HaSupport[0])
 		};	
 		
+		//the lifting reads the same samples as the convolution
+		assert(!bLifting || (Analysis::sampleStart() >= stencilStart[0] && Analysis::sampleEnd(Block::sizeX/2) <= Block::sizeX + stencilEnd[0] - 1));
+		assert(!bLifting || (Analysis::sampleStart() >= stencilStart[1] && Analysis::sampleEnd(Block::sizeY/2) <= Block::sizeY + stencilEnd[1] - 1));
+		
 		m_refCollection = &collection;
 		
 		m_blockLab.prepare(collection, boundaryInfo, stencilStart, stencilEnd);
@@ -386,6 +538,9 @@ public:
 		m_report.open();
 		m_blockLab.load(info);
 		
+		if (bLifting)
+			_project<iChannel, iChannel>();
+		
 		_fwt<iChannel>(info, block);
 		
 		m_state = eBlockFWT_Transformed;
@@ -403,6 +558,9 @@ public:
 		m_report.open();
 		m_blockLab.load(info);
 		
+		if (bLifting)
+			_project<iFirstChannel, iLastChannel>();
+		
 		MultiChannel_FWT<iFirstChannel, iLastChannel, iLastChannel-iFirstChannel+1>::multichannel_fwt(info, block, *this);
 		
 		m_state = eBlockFWT_Transformed;
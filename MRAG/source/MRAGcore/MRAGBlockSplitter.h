@@ -9,6 +9,12 @@
 
 #pragma once
 #include "MRAGRefinementPlan.h"
+#include "MRAGEnvironment.h"
+
+#ifdef _MRAG_TBB
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#endif
 
 namespace MRAG
 {	
@@ -98,6 +104,83 @@ namespace MRAG
 						}
 			}
 			
+			template<typename BlockLabType>
+			void _prepareLab(BlockLabType& lab, BlockCollectionType& collection, BoundaryInfo& boundaryInfo) const
+			{
+				const int stencilStart[3] = {
+					(int)ceil(WaveletsType::HsSupport[0]*0.5), 
+					BlockType::shouldProcessDirectionY? (int)ceil(WaveletsType::HsSupport[0]*0.5) : 0,
+					BlockType::shouldProcessDirectionZ? (int)ceil(WaveletsType::HsSupport[0]*0.5) : 0
+				};
+				
+				const int stencilEnd[3] = {
+					(2 + (int)floor((WaveletsType::HsSupport[1]-1)*0.5 )),
+					BlockType::shouldProcessDirectionY? (2 + (int)floor((WaveletsType::HsSupport[1]-1)*0.5 )) : 1,
+					BlockType::shouldProcessDirectionZ? (2 + (int)floor((WaveletsType::HsSupport[1]-1)*0.5 )) : 1					
+				};
+				
+				lab.prepare(collection, boundaryInfo, stencilStart, stencilEnd);
+			}
+			
+			/**
+			 * Fills the children of the refinements [r.begin(), r.end()) of the plan.
+			 * The refinements touch disjoint children and only read the parents,
+			 * every range works with its own lab.
+			 */
+			template<typename BlockLabType>
+			struct SplitBody
+			{
+				BlockSplitter& splitter;
+				BlockCollectionType& collection;
+				BoundaryInfo& boundaryInfo;
+				const RefinementPlan& refinementPlan;
+				const vector<int>& vIDs;
+				const vector<int>& vFirstChild;
+				
+				SplitBody(BlockSplitter& splitter, BlockCollectionType& collection, BoundaryInfo& boundaryInfo, 
+						  const RefinementPlan& refinementPlan, const vector<int>& vIDs, const vector<int>& vFirstChild):
+				splitter(splitter), collection(collection), boundaryInfo(boundaryInfo), 
+				refinementPlan(refinementPlan), vIDs(vIDs), vFirstChild(vFirstChild) {}
+				
+				SplitBody(const SplitBody& c):
+				splitter(c.splitter), collection(c.collection), boundaryInfo(c.boundaryInfo), 
+				refinementPlan(c.refinementPlan), vIDs(c.vIDs), vFirstChild(c.vFirstChild) {}
+				
+				void fill(BlockLabType& lab, const int rStart, const int rEnd) const
+				{
+					for(int r=rStart; r<rEnd; r++)
+					{
+						SingleRefinement& refinement =  *refinementPlan.refinements[r];
+						
+						const BlockType& source = collection.lock(refinement.block_info_source.blockID);
+						
+						vector<BlockType *> destinations;
+						destinations.reserve(refinement.children.size());
+						
+						for(int d=0; d<refinement.children.size(); d++)
+							destinations.push_back(&collection.lock(vIDs[vFirstChild[r] + d]));
+						
+						const BoundaryInfoBlock & bbinfo = *boundaryInfo.boundaryInfoOfBlock.find(refinement.block_info_source.blockID)->second;
+						
+						splitter._splitBlocks(lab, refinement.block_info_source, bbinfo, source, destinations, refinement.children);
+						
+						collection.release(refinement.block_info_source.blockID);
+						for(int d=0; d<refinement.children.size(); d++)
+							collection.release(vIDs[vFirstChild[r] + d]);
+					}
+				}
+				
+				template<typename BlockedRange>
+				void operator()(const BlockedRange& r) const
+				{
+					BlockLabType lab;
+					
+					splitter._prepareLab(lab, collection, boundaryInfo);
+					
+					fill(lab, r.begin(), r.end());
+				}
+			};
+			
 		public:
 			
 			BlockSplitter(): m_blockLab() {} 
@@ -117,65 +200,28 @@ namespace MRAG
 				//4. output the result
 				
 				//0.
+				const int nRefinements = refinementPlan.refinements.size();
+				
+				vector<int> vFirstChild(nRefinements);
+				for(int r=0, iCurrentBlock=0; r<nRefinements; r++)
 				{
-					const int stencilStart[3] = {
-						(int)ceil(WaveletsType::HsSupport[0]*0.5), 
-						BlockType::shouldProcessDirectionY? (int)ceil(WaveletsType::HsSupport[0]*0.5) : 0,
-						BlockType::shouldProcessDirectionZ? (int)ceil(WaveletsType::HsSupport[0]*0.5) : 0
-					};
-					
-					const int stencilEnd[3] = {
-						(2 + (int)floor((WaveletsType::HsSupport[1]-1)*0.5 )),
-						BlockType::shouldProcessDirectionY? (2 + (int)floor((WaveletsType::HsSupport[1]-1)*0.5 )) : 1,
-						BlockType::shouldProcessDirectionZ? (2 + (int)floor((WaveletsType::HsSupport[1]-1)*0.5 )) : 1					
-					};
-					
-					lab.prepare(collection, boundaryInfo, stencilStart, stencilEnd);
+					vFirstChild[r] = iCurrentBlock;
+					iCurrentBlock += refinementPlan.refinements[r]->children.size();
 				}
 				
 				//1.
-				//vector<int> vIDs;  
-				//vIDs.reserve(refinementPlan.nNewBlocks);
 				vector<int> vIDs = collection.create(refinementPlan.nNewBlocks);
 				
 				//2.
-				int iCurrentBlock = 0;
-				const int nRefinements = refinementPlan.refinements.size();
-				for(int r=0; r<nRefinements; r++)
-				{
-					SingleRefinement& refinement =  *refinementPlan.refinements[r];
-					
-					const BlockType& source = collection.lock(refinement.block_info_source.blockID);//collection[refinement.blockID];
-					
-					//{
-					//	vector<int> vLocalIDs = collection.create(refinement.children.size());
-					//	for(int i=0; i<vLocalIDs.size(); i++)
-					//		vIDs.push_back(vLocalIDs[i]);
-					//}
-					
-					vector<BlockType *> destinations;
-					vector<int> lockedChildren;
-					lockedChildren.reserve(refinement.children.size());
-					
-					for(int d=0; d<refinement.children.size(); d++,iCurrentBlock++)  
-					{
-						//printf("******ID : %d\n", vIDs[iCurrentBlock]);
-						collection.lock(vIDs[iCurrentBlock]);
-						lockedChildren.push_back(vIDs[iCurrentBlock]);
-						destinations.push_back(&collection[vIDs[iCurrentBlock]]);
-					}
-					
-					const BoundaryInfoBlock & bbinfo = *boundaryInfo.boundaryInfoOfBlock[refinement.block_info_source.blockID];
-					
-					const int idx_fake[3] = {0,0,0};
-					BlockInfo info(refinement.block_info_source.blockID, idx_fake, refinement.children[0]->level-1);
-					
-					_splitBlocks(lab, refinement.block_info_source, bbinfo, source, destinations, refinement.children);
-					 
-					collection.release(refinement.block_info_source.blockID);
-					for(vector<int>::const_iterator it = lockedChildren.begin(); it!=lockedChildren.end(); it++)
-						collection.release(*it);
-				}
+				SplitBody<BlockLabType> body(*this, collection, boundaryInfo, refinementPlan, vIDs, vFirstChild);
+				
+#ifdef _MRAG_TBB
+				const int nThreads = _MRAG_TBB_NTHREADS_HINT;
+				tbb::parallel_for(tbb::blocked_range<int>(0, nRefinements, std::max(1, nRefinements/(4*nThreads))), body, tbb::simple_partitioner());
+#else
+				_prepareLab(lab, collection, boundaryInfo);
+				body.fill(lab, 0, nRefinements);
+#endif
 				
 				//3.
 				for(int r=0; r<nRefinements; r++)
@@ -185,7 +231,7 @@ namespace MRAG
 				}
 				
 				//4.
-				iCurrentBlock = 0;
+				int iCurrentBlock = 0;
 				for(int r=0; r<nRefinements; r++)
 				{
 					RefinementReport refinementInfo;
@@ -8,9 +8,149 @@
  */
 
 #include "MRAGBoundaryBlockInfo.h"
+#include "MRAGCache.h"
+
+#ifdef _MRAG_TBB
+#include "tbb/mutex.h"
+#endif
 
 namespace MRAG
 {
+	/**
+	 * Shared LRU of the decoded tables: a slot holds the block whose tables are decoded.
+	 * It is only touched by the locks/releases of compressed blocks, under the mutex.
+	 */
+	struct DecodedTables
+	{
+		Cache<BoundaryInfoBlock *, BoundaryInfoBlock *> lru;
+#ifdef _MRAG_TBB
+		tbb::mutex mutex;
+#endif
+		
+		DecodedTables() { lru.setup(_MRAG_BBINFO_DECODED_TABLES); }
+	};
+	
+	static DecodedTables& _decodedTables()
+	{
+		//never destroyed: blocks can outlive the static objects
+		static DecodedTables * tables = new DecodedTables;
+		
+		return *tables;
+	}
+	
+	BoundaryInfoBlock::~BoundaryInfoBlock()
+	{
+		if (bCached)
+		{
+			DecodedTables& tables = _decodedTables();
+#ifdef _MRAG_TBB
+			tbb::mutex::scoped_lock lock(tables.mutex);
+#endif
+			tables.lru.erase(this);
+		}
+	}
+	
+	void BoundaryInfoBlock::setDecodedTablesCapacity(const int n)
+	{
+		assert(n > 0);
+		
+		DecodedTables& tables = _decodedTables();
+#ifdef _MRAG_TBB
+		tbb::mutex::scoped_lock lock(tables.mutex);
+#endif
+		
+		const vector<BoundaryInfoBlock *>& slots = tables.lru.getSlots();
+		
+		for(vector<BoundaryInfoBlock *>::const_iterator it = slots.begin(); it != slots.end(); it++)
+		{
+			BoundaryInfoBlock * block = *it;
+			
+			if (block == NULL) continue;
+			
+			block->bCached = false;
+			
+			if (block->nLocks == 0 && block->bDecoded)
+			{
+				block->_discard_decompression();
+				block->bDecoded = false;
+			}
+		}
+		
+		tables.lru.setup(n);
+	}
+	
+	int BoundaryInfoBlock::getDecodedTablesCapacity()
+	{
+		DecodedTables& tables = _decodedTables();
+#ifdef _MRAG_TBB
+		tbb::mutex::scoped_lock lock(tables.mutex);
+#endif
+		
+		return (int)tables.lru.getSlots().size();
+	}
+	
+	void BoundaryInfoBlock::_lockCompressed()
+	{
+		//1. touch the block in the LRU
+		//2. on a miss, discard the tables of the evicted block unless it is locked
+		//3. decode the tables if not there yet
+		
+		DecodedTables& tables = _decodedTables();
+#ifdef _MRAG_TBB
+		tbb::mutex::scoped_lock lock(tables.mutex);
+#endif
+		
+		//1.
+		bool bCacheHit = false;
+		BoundaryInfoBlock *& slot = tables.lru.get(this, bCacheHit);
+		
+		//2.
+		if (!bCacheHit)
+		{
+			BoundaryInfoBlock * victim = slot;
+			
+			if (victim != NULL)
+			{
+				victim->bCached = false;
+				
+				if (victim->nLocks == 0 && victim->bDecoded)
+				{
+					victim->_discard_decompression();
+					victim->bDecoded = false;
+				}
+			}
+			
+			slot = this;
+			bCached = true;
+		}
+		
+		//3.
+		if (!bDecoded)
+		{
+			_decompress();
+			bDecoded = true;
+		}
+		
+		++nLocks;
+	}
+	
+	void BoundaryInfoBlock::_releaseCompressed()
+	{
+		DecodedTables& tables = _decodedTables();
+#ifdef _MRAG_TBB
+		tbb::mutex::scoped_lock lock(tables.mutex);
+#endif
+		
+		--nLocks;
+		
+		//evicted while locked
+		if (nLocks == 0 && !bCached && bDecoded)
+		{
+			_discard_decompression();
+			bDecoded = false;
+		}
+	}
+	
 	void BoundaryInfoBlock::_compress()
 	{
 		//1. encode number of instruction per ghosts
@@ -284,15 +424,13 @@ namespace MRAG
 		//1. discard indexPool content
 		//2. discard ghost instruction content
 		
+		//the memory is given back (clear() would keep the capacity)
+		
 		//1.
-		indexPool.clear();
+		vector<PointIndex>().swap(indexPool);
 		
 		//2.
-		const vector<ReconstructionInfo>::iterator itGEnd = ghosts.end();
-		for(vector<ReconstructionInfo>::iterator itG = ghosts.begin(); itG!=itGEnd; itG++)
-			itG->clear();
-		
-		ghosts.clear();
+		vector<ReconstructionInfo>().swap(ghosts);
 	}
 	
 	void* BoundaryInfoBlock::createBBPack()
@@ -22,9 +22,14 @@
 using namespace std;
 
 #include "MRAGCommon.h"
+#include "MRAGEnvironment.h"
 #include "MRAGHuffmanEncoder.h"
 #include "MRAGGridNode.h"
 
+#ifdef _MRAG_TBB
+#include "tbb/atomic.h"
+#endif
+
 namespace MRAG
 {
 	struct PointIndex
@@ -88,13 +93,24 @@ namespace MRAG
 	};
 	
 
+	/**
+	 * Ghost reconstruction tables of a block.
+	 * lock()/release() can be called concurrently: the count of locks is atomic and,
+	 * for the uncompressed tables, it is all they do. The compressed tables are decoded
+	 * once, by the first lock, and kept in a shared LRU of _MRAG_BBINFO_DECODED_TABLES
+	 * decoded tables: they are discarded only when evicted and not locked.
+	 */
 	struct BoundaryInfoBlock
 	{	
 		enum BBIState {BBIState_Initialized, BBIState_Locked, BBIState_Unlocked};
 	private:
 		
 		BBIState state;
+#ifdef _MRAG_TBB
+		tbb::atomic<int> nLocks;
+#else
 		int nLocks;
+#endif
 		int block_size[3];
 		vector<PointIndex> indexPool;
 		
@@ -112,11 +128,16 @@ namespace MRAG
 		Encoder<unsigned char> vBlockID_encodedPointIndices3D;
 		vector< pair<int, int> > vBlockID_Points;
 		bool bCompressed;
+		//compressed only: ghosts and indexPool hold the decoded tables, which are in the shared LRU
+		bool bDecoded, bCached;
 		
 		void _compress();
 		void _decompress();
 		void _discard_decompression();
 		
+		void _lockCompressed();
+		void _releaseCompressed();
+		
 		int _get_diff_res()
 		{
 			//assert(node != NULL);
@@ -163,66 +184,80 @@ namespace MRAG
 		
 		void lock()
 		{
-			if (state == BBIState_Unlocked)
-				
 			if(bCompressed)
-				_decompress();
-			
-			nLocks++;
-			
-			state = BBIState_Locked;
+				_lockCompressed();
+			else
+				++nLocks;
 		}
 		
 		inline const vector<PointIndex>& getIndexPool() const
 		{
-			assert(state == BBIState_Initialized || state == BBIState_Locked);
+			assert(state == BBIState_Initialized || nLocks > 0);
 			return indexPool;
 		}
 		
 		const vector< ReconstructionInfo >& getGhosts() const
 		{
-			assert(state == BBIState_Initialized || state == BBIState_Locked);
+			assert(state == BBIState_Initialized || nLocks > 0);
 			return ghosts;
 		}
 		
 		void release()
 		{
 			assert(nLocks>0);
-			assert(state == BBIState_Initialized || state == BBIState_Locked);
-			
-			nLocks--;
 			
-			if(nLocks==0)
+			//the creator releases the block before it is shared: this is when it gets compressed
+			if (state == BBIState_Initialized)
 			{
-				const double oldMB = getMemorySize();
-				if (state == BBIState_Initialized  && oldMB>128. && !bCompressed)
+				--nLocks;
+				
+				if (nLocks == 0)
 				{
-					_compress();
-					_discard_decompression();
+					state = BBIState_Unlocked;
 					
-					bCompressed = true;
-					
-			//		const double newMB = getMemorySize();
-			//		const int this_diff_res = _get_diff_res();
-			//		assert(diff_res ==this_diff_res);
-			//		printf("Compression factor %f, (%f MB -> %f MB) diff_res=%d\n", oldMB/newMB, oldMB, newMB, diff_res);
-				}
-				else if (bCompressed)
-					_discard_decompression();
-				else 
-				{
-			//		const double newMB = getMemorySize();
-			//		const int this_diff_res = _get_diff_res();
-			//		assert(diff_res ==this_diff_res);
-			//		printf("Compression factor %f, (%f MB -> %f MB) diff_res=%d\n", oldMB/newMB, oldMB, newMB, diff_res);
+					const double oldMB = getMemorySize();
+					if (oldMB>_MRAG_BBINFO_COMPRESSION_MB)
+					{
+						compress();
+						
+				//		const double newMB = getMemorySize();
+				//		const int this_diff_res = _get_diff_res();
+				//		assert(diff_res ==this_diff_res);
+				//		printf("Compression factor %f, (%f MB -> %f MB) diff_res=%d\n", oldMB/newMB, oldMB, newMB, diff_res);
+					}
 				}
-
-				
 			}
+			else if (bCompressed)
+				_releaseCompressed();
+			else
+				--nLocks;
+		}
+		
+		bool isCompressed() const { return bCompressed; }
+		
+		/**
+		 * Compresses the tables for good (e.g. to stay within a memory budget).
+		 * The block must be released by its creator and not locked by anyone.
+		 */
+		void compress()
+		{
+			assert(state == BBIState_Unlocked && nLocks == 0);
 			
-			state = BBIState_Unlocked;
+			if (bCompressed) return;
+			
+			_compress();
+			_discard_decompression();
+			
+			bCompressed = true;
 		}
 		
+		/**
+		 * Capacity of the shared LRU of decoded tables (_MRAG_BBINFO_DECODED_TABLES by default).
+		 * The decoded tables not locked are discarded. Not to be called while the grid is processed.
+		 */
+		static void setDecodedTablesCapacity(const int n);
+		static int getDecodedTablesCapacity();
+		
 		void * createBBPack();
 		
 		float getMemorySize() const;
@@ -230,10 +265,11 @@ namespace MRAG
 		BoundaryInfoBlock(const int block_size_[3], const GridNode& b, const vector<GridNode*>& neighbors): 
 			node(b), neighbors(neighbors),
 			indexPool(), weightsPool(), ghosts(), 
-			dependentBlockIDs(), state(BBIState_Initialized), nLocks(1),
+			dependentBlockIDs(), state(BBIState_Initialized),
 			encodedInstructionSizes(), encodedInstructionItemsWs(), encodedInstructionItemsPts(),
-			vBlockID_encodedPointIndices3D(), vBlockID_Points(), bCompressed(false)
+			vBlockID_encodedPointIndices3D(), vBlockID_Points(), bCompressed(false), bDecoded(false), bCached(false)
 		{
+			nLocks = 1;
 			nof_neighbors = neighbors.size();
 			
 			
@@ -272,16 +308,7 @@ namespace MRAG
 			return true;
 		}
 		
-	/*	~BoundaryInfoBlock()
-		{
-            indexPool.clear();
-			weightsPool.clear();
-			dependentBlockIDs.clear();
-			for(int i=0; i<ghosts.size(); i++) 
-				ghosts[i].clear();
-			
-			ghosts.clear();
-		}*/
+		~BoundaryInfoBlock();
 		
 		void check() 
 		{
@@ -23,11 +23,17 @@ using namespace std;
 namespace MRAG
 {
 
+/**
+ * Least recently used cache of n slots.
+ * On a miss, get() returns the slot of the least recently used key, still holding
+ * the value of that key (or CachedType() if the slot was free): the caller can
+ * dispose of it before overwriting. Not thread-safe.
+ */
 template<typename KeyType, typename CachedType>
 class Cache
 {
 public:
-	Cache(void): pcache(NULL), ticket(0), in_cache(),victims(),
+	Cache(void): pcache(NULL), ticket(0), in_cache(),victims(), slot_ticket(),
 		owner(false), valid(false){}
 
 	void setup(vector<CachedType>& cache);
@@ -41,7 +47,18 @@ public:
 		return get(key, bCacheHit);
 	}
 
-	~Cache(void){}
+	/** Frees the slot of key, if any. */
+	void erase(const KeyType key);
+
+	int size() const { return (int)in_cache.size(); }
+	
+	/** The n slots, a free slot holds CachedType(). */
+	const vector<CachedType>& getSlots() const { return *pcache; }
+
+	~Cache(void)
+	{
+		if (owner) delete pcache;
+	}
 
 private:
 
@@ -72,18 +89,24 @@ private:
 	
 	void _setup();
 
-	void _rebuildVictims(priority_queue<SlotInfo>& victims) const;
+	bool _isStale(const SlotInfo& s) const { return s.ticket != slot_ticket[s.slot]; }
+	void _push(const int slot, const KeyType * key, const bool is_valid);
+	void _rebuildVictims(priority_queue<SlotInfo>& victims);
 
 	vector<CachedType> * pcache;
 	unsigned int ticket;
 	map<KeyType, const int> in_cache;
+	//every use of a slot pushes a new entry, the older ones of the slot are stale
 	priority_queue<SlotInfo> victims;
+	vector<unsigned int> slot_ticket;
 	bool owner, valid;
 };
 
 template< typename KeyType, typename CachedType>
 void Cache<KeyType, CachedType>::setup(const int n)
 {	
+	if (owner) delete pcache;
+	
 	owner = true;
 	
 	this->pcache = new vector<CachedType>(n);
@@ -111,12 +134,41 @@ void Cache<KeyType, CachedType>::_setup()
 	victims = priority_queue<SlotInfo>();
 	
 	const int n = (int)pcache->size();
+	slot_ticket.resize(n);
+	
 	for(int i=0; i<n; i++)
-		victims.push(SlotInfo(ticket++, i));
+		_push(i, NULL, false);
 	
 	valid = true;
 }
 
+template< typename KeyType, typename CachedType>
+void Cache<KeyType, CachedType>::_push(const int slot, const KeyType * key, const bool is_valid)
+{
+	slot_ticket[slot] = ticket;
+	victims.push(SlotInfo(ticket++, slot, key, is_valid));
+	
+	if (ticket == 0 || victims.size() > 2*slot_ticket.size() + 16)
+		_rebuildVictims(victims);
+}
+
+template< typename KeyType, typename CachedType>
+void Cache<KeyType, CachedType>::erase(const KeyType key)
+{
+	assert(valid);
+	
+	typename map<KeyType, const int>::iterator itInCache = in_cache.find(key);
+	
+	if (itInCache == in_cache.end()) return;
+	
+	const int slot = itInCache->second;
+	
+	in_cache.erase(itInCache);
+	(*pcache)[slot] = CachedType();
+	
+	_push(slot, NULL, false);
+}
+
 template< typename KeyType, typename CachedType>
 CachedType& Cache<KeyType, CachedType>::get(const KeyType key, bool& bCacheHit)
 {
@@ -134,11 +186,17 @@ CachedType& Cache<KeyType, CachedType>::get(const KeyType key, bool& bCacheHit)
 		//printf("Cache Hit\n");
 		assert(itInCache->first == key);
 		value = &cache[itInCache->second];
+		
+		_push(itInCache->second, &itInCache->first, true);
 	}
 	else
 	{
 		//printf("Cache Miss\n");
-		const SlotInfo& slot_info = victims.top();
+		while(_isStale(victims.top()))
+			victims.pop();
+		
+		const SlotInfo slot_info = victims.top();
+		victims.pop();
 		
 		value = &cache[slot_info.slot];
 		
@@ -149,35 +207,34 @@ CachedType& Cache<KeyType, CachedType>::get(const KeyType key, bool& bCacheHit)
 		
 		in_cache.insert(std::pair<KeyType, const int>(key,slot_info.slot));
 		
-		victims.push(SlotInfo(ticket++, slot_info.slot, & in_cache.find(key)->first, true));
-		victims.pop();
-		
-		if (ticket == 0)
-		{
-			_rebuildVictims(victims);
-			ticket = (int)victims.size();
-		}
+		_push(slot_info.slot, & in_cache.find(key)->first, true);
 	}
 	
 	return *value;
 }
 
 template< typename KeyType, typename CachedType>
-void Cache<KeyType, CachedType>::_rebuildVictims(priority_queue<SlotInfo>& v) const
+void Cache<KeyType, CachedType>::_rebuildVictims(priority_queue<SlotInfo>& v)
 {
 	priority_queue<SlotInfo> new_v;
 	
-	const int n = (int)v.size();
-	for(int t=0; t<n; t++)
+	//renumber the live entries from the least recently used, drop the stale ones
+	vector<unsigned int> new_slot_ticket(slot_ticket.size());
+	
+	unsigned int t = 0;
+	for(; !v.empty(); v.pop())
 	{
 		SlotInfo slot_info = v.top();
 		
-		slot_info.ticket = t;
-		new_v.push(slot_info);
+		if (_isStale(slot_info)) continue;
 		
-		v.pop();
+		slot_info.ticket = t++;
+		new_slot_ticket[slot_info.slot] = slot_info.ticket;
+		new_v.push(slot_info);
 	}
 	
 	v = new_v;
+	slot_ticket = new_slot_ticket;
+	ticket = t;
 }
 }
\ No newline at end of file
@@ -27,19 +27,37 @@ namespace MRAG
 #define _MRAG_TBB
 
 #ifdef _MRAG_TBB
-		#define _MRAG_BLOCKLAB_ALLOCATOR tbb::cache_aligned_allocator
-		#define _MRAG_BLOCKLAB_ALLOCATOR_HEADER "tbb/cache_aligned_allocator.h"
+		//see MRAGMemoryPool.h
+		#define _MRAG_BLOCKLAB_ALLOCATOR MRAG::PoolAllocator
+		#define _MRAG_BLOCKLAB_ALLOCATOR_HEADER "MRAGMemoryPool.h"
 		
-		#define _MRAG_GHOSTSCREATION_ALLOCATOR tbb::scalable_allocator
-		#define _MRAG_GHOSTSCREATION_ALLOCATOR_HEADER "tbb/scalable_allocator.h"
+		#define _MRAG_GHOSTSCREATION_ALLOCATOR MRAG::PoolAllocator
+		#define _MRAG_GHOSTSCREATION_ALLOCATOR_HEADER "MRAGMemoryPool.h"
 	
-		#define _MRAG_BLOCKCOLLECTION_ALLOCATOR tbb::cache_aligned_allocator
-		#define _MRAG_BLOCKCOLLECTION_ALLOCATOR_HEADER "tbb/cache_aligned_allocator.h"
+		#define _MRAG_BLOCKCOLLECTION_ALLOCATOR MRAG::PoolAllocator
+		#define _MRAG_BLOCKCOLLECTION_ALLOCATOR_HEADER "MRAGMemoryPool.h"
 	
 		#ifndef _MRAG_TBB_NTHREADS_HINT
 			#define _MRAG_TBB_NTHREADS_HINT 2
 		#endif
 #endif
+
+//GHOSTS STUFF
+//boundary infos of blocks above this size (MB) are kept compressed
+#ifndef _MRAG_BBINFO_COMPRESSION_MB
+	#define _MRAG_BBINFO_COMPRESSION_MB 128.
+#endif
+
+//decoded ghost tables of the compressed boundary infos kept at the same time
+#ifndef _MRAG_BBINFO_DECODED_TABLES
+	#define _MRAG_BBINFO_DECODED_TABLES 1024
+#endif
+
+//MEMORY STUFF
+//memory released to the pool kept for the next requests (MB), see MemoryPool::setCacheLimitMB
+#ifndef _MRAG_MEMORYPOOL_CACHE_MB
+	#define _MRAG_MEMORYPOOL_CACHE_MB 512
+#endif
 }
 
 
@@ -0,0 +1,184 @@
+/*
+ *  MRAGFWTLifting.h
+ *  MRAG
+ *
+ *	Lifting form of the analysis step of the interpolating and average-interpolating
+ *	wavelets, used by BlockFWT in place of the convolution with Ha/Ga.
+ *	The coarse samples a[k] are the even samples (interpolating) or the averages of the
+ *	sample pairs (average-interpolating), the details are the odd samples (half differences)
+ *	corrected by a symmetric combination of the neighboring coarse samples:
+ *
+ *	interpolating:           d[i] = s[2i+1] - sum_k tap(k)*(a[i+k] + a[i+1-k])
+ *	average-interpolating:   d[i] = (s[2i+1]-s[2i])/2 + sum_k tap(k)*(a[i+k] - a[i-k])
+ *
+ *	with k = 1..nTaps. The coarse samples are computed once and shared by the
+ *	neighboring details instead of being recomputed by every tap of Ga.
+ *
+ */
+#pragma once
+
+#include "MRAGCommon.h"
+#include "MRAGWavelets_Haar.h"
+#include "MRAGWavelets_Interp2ndOrder.h"
+#include "MRAGWavelets_Interp4thOrder.h"
+#include "MRAGWavelets_AverageInterp3rdOrder.h"
+#include "MRAGWavelets_AverageInterp5thOrder.h"
+
+namespace MRAG
+{
+	/** Wavelets without a lifting form use the convolution. */
+	template<typename Wavelets>
+	struct FWTLifting
+	{
+		static const bool bAvailable = false;
+		static const bool bAverage = false;
+		static const int nTaps = 0;
+
+		static Real tap(const int k) { return 0; }
+	};
+
+	template<>
+	struct FWTLifting<Wavelets_Haar>
+	{
+		static const bool bAvailable = true;
+		static const bool bAverage = true;
+		static const int nTaps = 0;
+
+		static Real tap(const int k) { return 0; }
+	};
+
+	template<>
+	struct FWTLifting<Wavelets_Interp2ndOrder>
+	{
+		static const bool bAvailable = true;
+		static const bool bAverage = false;
+		static const int nTaps = 1;
+
+		static Real tap(const int k) { return 1/2.; }
+	};
+
+	template<>
+	struct FWTLifting<Wavelets_Interp4thOrder>
+	{
+		static const bool bAvailable = true;
+		static const bool bAverage = false;
+		static const int nTaps = 2;
+
+		static Real tap(const int k) { return k==1 ? 9/16. : -1/16.; }
+	};
+
+	template<>
+	struct FWTLifting<Wavelets_AverageInterp3rdOrder>
+	{
+		static const bool bAvailable = true;
+		static const bool bAverage = true;
+		static const int nTaps = 1;
+
+		static Real tap(const int k) { return -1/8.; }
+	};
+
+	template<>
+	struct FWTLifting<Wavelets_AverageInterp5thOrder>
+	{
+		static const bool bAvailable = true;
+		static const bool bAverage = true;
+		static const int nTaps = 2;
+
+		static Real tap(const int k) { return k==1 ? -11/64. : 3/128.; }
+	};
+
+	/**
+	 * One analysis step along a line of samples, each sample being a row of w values:
+	 * sample k starts at src + k*stride. The n coarse samples and details are written
+	 * to a and d, w values apart. The inner loops run over the w values.
+	 */
+	template<typename Lifting>
+	struct LiftingAnalysis
+	{
+		//range [k0, k1) of the coarse samples used by the details
+		static int coarseStart() { return Lifting::bAverage ? -Lifting::nTaps : 1 - Lifting::nTaps; }
+		static int coarseEnd(const int n) { return n + Lifting::nTaps; }
+
+		//range of the samples read
+		static int sampleStart() { return 2*coarseStart(); }
+		static int sampleEnd(const int n)
+		{
+			const int e = Lifting::bAverage ? 2*coarseEnd(n) : 2*coarseEnd(n) - 1;
+
+			return e > 2*n ? e : 2*n;
+		}
+
+		//work: room for (coarseEnd(n) - coarseStart())*w values
+		static void run(const Real * src, const int stride, const int w, const int n, Real * a, Real * d, Real * work)
+		{
+			//1. coarse samples
+			//2. details
+			//3. copy the coarse samples of the line
+
+			const int k0 = coarseStart();
+			const int k1 = coarseEnd(n);
+
+			//1.
+			for(int k=k0; k<k1; k++)
+			{
+				const Real * const e = src + 2*k*stride;
+				const Real * const o = e + stride;
+				Real * const dest = work + (k-k0)*w;
+
+				if (Lifting::bAverage)
+					for(int l=0; l<w; l++)
+						dest[l] = (Real)0.5*(e[l] + o[l]);
+				else
+					for(int l=0; l<w; l++)
+						dest[l] = e[l];
+			}
+
+			//2.
+			for(int i=0; i<n; i++)
+			{
+				const Real * const e = src + 2*i*stride;
+				const Real * const o = e + stride;
+				const Real * const ai = work + (i-k0)*w;
+				Real * const di = d + i*w;
+
+				if (Lifting::bAverage)
+					for(int l=0; l<w; l++)
+						di[l] = (Real)0.5*(o[l] - e[l]);
+				else
+					for(int l=0; l<w; l++)
+						di[l] = o[l];
+
+				for(int k=1; k<=Lifting::nTaps; k++)
+				{
+					const Real c = Lifting::tap(k);
+					const Real * const ap = ai + k*w;
+
+					if (Lifting::bAverage)
+					{
+						const Real * const am = ai - k*w;
+
+						for(int l=0; l<w; l++)
+							di[l] += c*(ap[l] - am[l]);
+					}
+					else
+					{
+						const Real * const am = ai + (1-k)*w;
+
+						for(int l=0; l<w; l++)
+							di[l] -= c*(ap[l] + am[l]);
+					}
+				}
+			}
+
+			//3.
+			for(int i=0; i<n; i++)
+			{
+				const Real * const ai = work + (i-k0)*w;
+				Real * const dest = a + i*w;
+
+				for(int l=0; l<w; l++)
+					dest[l] = ai[l];
+			}
+		}
+	};
+}
@@ -0,0 +1,252 @@
+/*
+ *  MRAGLinearQuadtree.h
+ *  MRAG
+ *
+ *	Linear quadtree (octree in 3D) of the nodes of the grid hierarchy.
+ *	Every node is identified by the key (level, Morton code of its index): the nodes
+ *	are stored in contiguous arrays sorted by key and found by hashing the key,
+ *	the leaves also by hashing their blockID. Parents and children are not stored,
+ *	their keys are computed from the index. The tree is a read-only view of the
+ *	hierarchy, rebuilt by the grid whenever the hierarchy changes.
+ *
+ */
+#pragma once
+
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+
+#include "MRAGGridNode.h"
+
+using namespace std;
+
+namespace MRAG
+{
+	class LinearQuadtree
+	{
+	public:
+		typedef unsigned long long Key;
+
+		//the Morton code of a level takes 3*level bits, the level the bits above
+		static const int nMaxLevel = 19;
+
+		LinearQuadtree(): m_keys(), m_nodes(), m_slotsOfKey(), m_slotsOfBlock(), m_nShift(0), m_nMaxLevel(0) {}
+
+		static Key key(const int level, const int index[3])
+		{
+			assert(level >= 0 && level <= nMaxLevel);
+			assert(index[0] >= 0 && index[1] >= 0 && index[2] >= 0);
+
+			return ((Key)level << (3*nMaxLevel)) | _spread(index[0]) | (_spread(index[1]) << 1) | (_spread(index[2]) << 2);
+		}
+
+		/** Rebuilds the tree from the nodes of the hierarchy (its keys, NULL being the root). */
+		template<typename HierarchyType>
+		void build(const HierarchyType& hierarchy)
+		{
+			//1. sort the nodes by key
+			//2. hash the keys and the blockIDs of the leaves
+
+			//1.
+			vector< pair<Key, GridNode *> > entries;
+			entries.reserve(hierarchy.size());
+
+			m_nMaxLevel = 0;
+
+			for(typename HierarchyType::const_iterator it = hierarchy.begin(); it != hierarchy.end(); it++)
+			{
+				GridNode * node = it->first;
+
+				if (node == NULL) continue;
+
+				entries.push_back(pair<Key, GridNode *>(key(node->level, node->index), node));
+				m_nMaxLevel = std::max(m_nMaxLevel, node->level);
+			}
+
+			sort(entries.begin(), entries.end());
+
+			const int n = (int)entries.size();
+
+			m_keys.resize(n);
+			m_nodes.resize(n);
+
+			for(int i=0; i<n; i++)
+			{
+				assert(i == 0 || entries[i-1].first != entries[i].first);
+
+				m_keys[i] = entries[i].first;
+				m_nodes[i] = entries[i].second;
+			}
+
+			//2.
+			int nSlots = 16;
+			m_nShift = 64 - 4;
+
+			while(nSlots < 2*n) { nSlots *= 2; m_nShift--; }
+
+			m_slotsOfKey.assign(nSlots, -1);
+			m_slotsOfBlock.assign(nSlots, -1);
+
+			for(int i=0; i<n; i++)
+			{
+				m_slotsOfKey[_probeKey(m_keys[i])] = i;
+
+				if (!m_nodes[i]->isEmpty)
+				{
+					assert(m_slotsOfBlock[_probeBlock(m_nodes[i]->blockID)] == -1);
+
+					m_slotsOfBlock[_probeBlock(m_nodes[i]->blockID)] = i;
+				}
+			}
+		}
+
+		void clear()
+		{
+			m_keys.clear();
+			m_nodes.clear();
+			m_slotsOfKey.clear();
+			m_slotsOfBlock.clear();
+			m_nMaxLevel = 0;
+		}
+
+		int size() const { return (int)m_nodes.size(); }
+		int getMaxLevel() const { return m_nMaxLevel; }
+
+		/** i-th node in key order: the nodes of a level are contiguous, in Morton order. */
+		GridNode * operator[](const int i) const { return m_nodes[i]; }
+		Key getKey(const int i) const { return m_keys[i]; }
+
+		/** The node at (level, index), NULL if there is none. */
+		GridNode * find(const int level, const int index[3]) const
+		{
+			if (m_nodes.empty() || level < 0 || level > m_nMaxLevel) return NULL;
+			if (index[0] < 0 || index[1] < 0 || index[2] < 0) return NULL;
+			if (index[0] >> level || index[1] >> level || index[2] >> level) return NULL;
+
+			const int i = m_slotsOfKey[_probeKey(key(level, index))];
+
+			return i < 0 ? NULL : m_nodes[i];
+		}
+
+		/** The leaf holding the block, NULL if there is none. */
+		GridNode * findLeaf(const int blockID) const
+		{
+			if (m_nodes.empty()) return NULL;
+
+			const int i = m_slotsOfBlock[_probeBlock(blockID)];
+
+			return i < 0 ? NULL : m_nodes[i];
+		}
+
+		/** Whether node is a leaf of the tree (and not a copy of it, e.g. a periodic image). */
+		bool isLeaf(const GridNode * node) const
+		{
+			return node != NULL && !node->isEmpty && findLeaf(node->blockID) == node;
+		}
+
+		/**
+		 * Appends to leaves the leaves of the cell (level, index) lying on its side
+		 * (per direction: -1 lower, +1 upper, 0 both): the leaf covering the cell if the
+		 * cell is not refined, the leaves of its side otherwise. Nothing for a cell outside the tree.
+		 */
+		void collectLeaves(const int level, const int index[3], const int side[3], vector<GridNode *>& leaves) const
+		{
+			GridNode * node = find(level, index);
+
+			if (node == NULL)
+			{
+				//an unrefined coarser cell covers it, or it is outside
+				int l = level;
+				int idx[3] = {index[0], index[1], index[2]};
+
+				while(node == NULL && l > 0)
+				{
+					l--;
+					idx[0] >>= 1; idx[1] >>= 1; idx[2] >>= 1;
+					node = find(l, idx);
+				}
+
+				if (node != NULL && !node->isEmpty)
+					leaves.push_back(node);
+
+				return;
+			}
+
+			_collectSide(node, side, leaves);
+		}
+
+		float getMemorySize() const
+		{
+			return (m_keys.capacity()*sizeof(Key) + m_nodes.capacity()*sizeof(GridNode *) +
+					(m_slotsOfKey.capacity() + m_slotsOfBlock.capacity())*sizeof(int))/(float)(1<<20);
+		}
+
+	private:
+
+		vector<Key> m_keys;
+		vector<GridNode *> m_nodes;
+		vector<int> m_slotsOfKey, m_slotsOfBlock;
+		int m_nShift, m_nMaxLevel;
+
+		static Key _spread(const int i)
+		{
+			Key x = (Key)i & 0x1fffffULL;
+
+			x = (x | (x << 32)) & 0x1f00000000ffffULL;
+			x = (x | (x << 16)) & 0x1f0000ff0000ffULL;
+			x = (x | (x << 8)) & 0x100f00f00f00f00fULL;
+			x = (x | (x << 4)) & 0x10c30c30c30c30c3ULL;
+			x = (x | (x << 2)) & 0x1249249249249249ULL;
+
+			return x;
+		}
+
+		int _hash(const Key k) const { return (int)((k*0x9e3779b97f4a7c15ULL) >> m_nShift); }
+
+		//slot of the key, or the free slot where it goes
+		int _probeKey(const Key k) const
+		{
+			const int mask = (int)m_slotsOfKey.size() - 1;
+
+			int s = _hash(k);
+			while(m_slotsOfKey[s] >= 0 && m_keys[m_slotsOfKey[s]] != k) s = (s+1) & mask;
+
+			return s;
+		}
+
+		int _probeBlock(const int blockID) const
+		{
+			const int mask = (int)m_slotsOfBlock.size() - 1;
+
+			int s = _hash((Key)(unsigned int)blockID);
+			while(m_slotsOfBlock[s] >= 0 && m_nodes[m_slotsOfBlock[s]]->blockID != blockID) s = (s+1) & mask;
+
+			return s;
+		}
+
+		void _collectSide(GridNode * node, const int side[3], vector<GridNode *>& leaves) const
+		{
+			if (!node->isEmpty)
+			{
+				leaves.push_back(node);
+				return;
+			}
+
+			for(int c=0; c<8; c++)
+			{
+				const int b[3] = {c&1, (c>>1)&1, (c>>2)&1};
+
+				if ((side[0] < 0 && b[0]) || (side[0] > 0 && !b[0]) ||
+					(side[1] < 0 && b[1]) || (side[1] > 0 && !b[1]) ||
+					(side[2] < 0 && b[2]) || (side[2] > 0 && !b[2])) continue;
+
+				const int idx[3] = {2*node->index[0] + b[0], 2*node->index[1] + b[1], 2*node->index[2] + b[2]};
+
+				GridNode * child = find(node->level + 1, idx);
+
+				if (child != NULL)
+					_collectSide(child, side, leaves);
+			}
+		}
+	};
+}
@@ -0,0 +1,656 @@
+/*
+ *  MRAGMemoryPool.h
+ *  MRAG
+ *
+ *	Memory of MRAG: blocks, labs, ghost creation and the transient buffers of the solvers.
+ *	MemoryPool hands out 64-byte aligned memory and keeps what is released, per size class and
+ *	NUMA node (the one of the thread that allocated it), for the next requests of the same class:
+ *	- up to nMaxSmallBytes, 8 classes per power of two (multiples of 64 bytes up to 1KB),
+ *	  the memory is carved from slabs of nSlabBytes, aligned to their size and starting with their node,
+ *	  and cached per thread (then in the shared lists, beyond nThreadCacheBytes per thread or when
+ *	  released from another node), it never goes back to the system,
+ *	- above, one class per multiple of 64 bytes, the memory comes from the system with its node
+ *	  in front and goes back to it beyond the cache limit (or at trim()).
+ *	If enabled, the slabs and the large requests are aligned and advised as transparent huge pages.
+ *
+ *	MemoryArena serves the large buffers living for one step (FMM source particles and
+ *	interaction buffers), allocated by one thread at a time: it moves a pointer forward in its
+ *	pages and is rewound by reset() at the end of the step, once everything was released.
+ *	The pages are kept for the next step.
+ *
+ *	PoolAllocator and TransientAllocator wrap them as std allocators
+ *	(see the allocators of MRAGEnvironment.h).
+ *
+ */
+#pragma once
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <new>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "MRAGNUMA.h"
+
+#include "tbb/atomic.h"
+#include "tbb/spin_mutex.h"
+#include "tbb/enumerable_thread_specific.h"
+
+using namespace std;
+
+namespace MRAG
+{
+	class MemoryPool
+	{
+	public:
+		static const size_t nAlignment = 64;
+		static const size_t nHugePageBytes = 2 << 20;
+		static const size_t nSlabBytes = 2 << 20;
+		static const size_t nMaxSmallBytes = 256 << 10;
+		static const size_t nThreadCacheBytes = 8 << 20;
+
+		struct Statistics
+		{
+			double dUsedMB;			//handed out, arena pages included
+			double dPeakMB;			//peak of dUsedMB since the last resetPeak()
+			double dCachedMB;		//released, kept for the next requests
+			double dSystemMB;		//obtained from the system
+			double dArenaMB;		//pages of the arenas
+			double dArenaUsedMB;	//live in the arenas
+			int nSystemAllocations;
+
+			/** Part of the memory obtained from the system not holding live data. */
+			double getFragmentation() const
+			{
+				return dSystemMB > 0 ? 1 - (dUsedMB - dArenaMB + dArenaUsedMB)/dSystemMB : 0;
+			}
+		};
+
+	private:
+		friend class MemoryArena;
+
+		//node, bytes
+		typedef pair<int, size_t> Key;
+		typedef map<Key, vector<void *> > Lists;
+
+		struct ThreadCache
+		{
+			Lists lists;
+			size_t nBytes;
+
+			//current slab of every node: [first, second)
+			map<int, pair<char *, char *> > slabs;
+
+			ThreadCache(): lists(), nBytes(0), slabs() {}
+		};
+
+		tbb::spin_mutex m_mutex;
+		Lists m_lists;
+		tbb::enumerable_thread_specific<ThreadCache> m_threadCaches;
+
+		bool m_bHugePages;
+		long long m_nCacheLimitBytes;
+
+		tbb::atomic<long long> m_nUsed, m_nPeak, m_nCached, m_nSystem, m_nArenaPages, m_nArenaUsed;
+		tbb::atomic<int> m_nSystemAllocations;
+
+		MemoryPool(): m_mutex(), m_lists(), m_threadCaches(), m_bHugePages(false),
+		m_nCacheLimitBytes((long long)_MRAG_MEMORYPOOL_CACHE_MB << 20)
+		{
+			m_nUsed = 0;
+			m_nPeak = 0;
+			m_nCached = 0;
+			m_nSystem = 0;
+			m_nArenaPages = 0;
+			m_nArenaUsed = 0;
+			m_nSystemAllocations = 0;
+		}
+
+		//never destroyed: blocks and labs may be released by the destructors of other statics
+		static MemoryPool& _instance()
+		{
+			static MemoryPool * pool = new MemoryPool;
+
+			return *pool;
+		}
+
+		static size_t _round(const size_t bytes)
+		{
+			return bytes == 0 ? nAlignment : ((bytes + nAlignment - 1)/nAlignment)*nAlignment;
+		}
+
+		//bytes handed out for a request: multiples of 64 up to 1KB, then 8 classes per power of two
+		static size_t _sizeClass(const size_t bytes)
+		{
+			if (bytes <= 1024 || bytes > nMaxSmallBytes) return _round(bytes);
+
+			size_t p = 1024;
+			while(2*p < bytes) p *= 2;
+
+			const size_t step = p/8;
+
+			return ((bytes + step - 1)/step)*step;
+		}
+
+		void _use(const long long bytes)
+		{
+			const long long used = m_nUsed.fetch_and_add(bytes) + bytes;
+
+			long long peak = m_nPeak;
+
+			while(used > peak && m_nPeak.compare_and_swap(used, peak) != peak)
+				peak = m_nPeak;
+		}
+
+		void * _systemAllocate(const size_t bytes, const size_t minAlignment = nAlignment)
+		{
+			const bool bHuge = m_bHugePages && bytes >= nHugePageBytes;
+			const size_t alignment = bHuge && nHugePageBytes > minAlignment ? nHugePageBytes : minAlignment;
+
+			void * ptr = NULL;
+
+#ifdef _WIN32
+			ptr = _aligned_malloc(bytes, alignment);
+#else
+			if (posix_memalign(&ptr, alignment, bytes) != 0) ptr = NULL;
+#endif
+
+			if (ptr == NULL)
+			{
+				printf("MemoryPool: cannot allocate %f MB. aborting.\n", bytes/(double)(1<<20));
+				abort();
+			}
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+			if (bHuge) madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+
+			m_nSystem.fetch_and_add(bytes);
+			m_nSystemAllocations.fetch_and_increment();
+
+			return ptr;
+		}
+
+		void _systemDeallocate(void * ptr, const size_t bytes)
+		{
+#ifdef _WIN32
+			_aligned_free(ptr);
+#else
+			free(ptr);
+#endif
+
+			m_nSystem.fetch_and_add(-(long long)bytes);
+		}
+
+		void * _allocateSmall(const size_t bytes, const int node)
+		{
+			//1. the cache of the thread
+			//2. the shared lists
+			//3. the slab of the thread
+
+			ThreadCache& cache = m_threadCaches.local();
+
+			//1.
+			{
+				vector<void *>& list = cache.lists[Key(node, bytes)];
+
+				if (!list.empty())
+				{
+					void * ptr = list.back();
+					list.pop_back();
+
+					cache.nBytes -= bytes;
+					m_nCached.fetch_and_add(-(long long)bytes);
+
+					return ptr;
+				}
+			}
+
+			//2.
+			{
+				tbb::spin_mutex::scoped_lock lock(m_mutex);
+
+				Lists::iterator it = m_lists.find(Key(node, bytes));
+
+				if (it != m_lists.end() && !it->second.empty())
+				{
+					void * ptr = it->second.back();
+					it->second.pop_back();
+
+					m_nCached.fetch_and_add(-(long long)bytes);
+
+					return ptr;
+				}
+			}
+
+			//3.
+			pair<char *, char *>& slab = cache.slabs[node];
+
+			if (slab.first == NULL || (size_t)(slab.second - slab.first) < bytes)
+			{
+				char * start = (char *)_systemAllocate(nSlabBytes, nSlabBytes);
+
+				*(int *)start = node;
+
+				slab = pair<char *, char *>(start + nAlignment, start + nSlabBytes);
+			}
+
+			void * ptr = slab.first;
+			slab.first += bytes;
+
+			return ptr;
+		}
+
+		//node written at the start of the slab
+		static int _nodeOfSmall(const void * ptr)
+		{
+			return *(const int *)((size_t)ptr & ~(nSlabBytes - 1));
+		}
+
+		void _deallocateSmall(void * ptr, const size_t bytes, const int node)
+		{
+			if (node != NUMATopology::getCurrentNode())
+			{
+				tbb::spin_mutex::scoped_lock lock(m_mutex);
+
+				m_lists[Key(node, bytes)].push_back(ptr);
+				m_nCached.fetch_and_add(bytes);
+
+				return;
+			}
+
+			ThreadCache& cache = m_threadCaches.local();
+
+			cache.lists[Key(node, bytes)].push_back(ptr);
+			cache.nBytes += bytes;
+			m_nCached.fetch_and_add(bytes);
+
+			if (cache.nBytes <= nThreadCacheBytes) return;
+
+			//the thread keeps releasing what others allocate: share it
+			tbb::spin_mutex::scoped_lock lock(m_mutex);
+
+			for(Lists::iterator it = cache.lists.begin(); it != cache.lists.end(); it++)
+			{
+				vector<void *>& shared = m_lists[it->first];
+
+				shared.insert(shared.end(), it->second.begin(), it->second.end());
+				it->second.clear();
+			}
+
+			cache.nBytes = 0;
+		}
+
+		void * _allocateLarge(const size_t bytes, const int node)
+		{
+			{
+				tbb::spin_mutex::scoped_lock lock(m_mutex);
+
+				Lists::iterator it = m_lists.find(Key(node, bytes));
+
+				if (it != m_lists.end() && !it->second.empty())
+				{
+					void * ptr = it->second.back();
+					it->second.pop_back();
+
+					m_nCached.fetch_and_add(-(long long)bytes);
+
+					return ptr;
+				}
+			}
+
+			char * start = (char *)_systemAllocate(bytes + nAlignment);
+
+			*(int *)start = node;
+
+			return start + nAlignment;
+		}
+
+		//node written in front of the memory
+		static int _nodeOfLarge(const void * ptr)
+		{
+			return *(const int *)((const char *)ptr - nAlignment);
+		}
+
+		void _systemDeallocateLarge(void * ptr, const size_t bytes)
+		{
+			_systemDeallocate((char *)ptr - nAlignment, bytes + nAlignment);
+		}
+
+		void _deallocateLarge(void * ptr, const size_t bytes, const int node)
+		{
+			if (m_nCached + (long long)bytes > m_nCacheLimitBytes)
+			{
+				_systemDeallocateLarge(ptr, bytes);
+
+				return;
+			}
+
+			tbb::spin_mutex::scoped_lock lock(m_mutex);
+
+			m_lists[Key(node, bytes)].push_back(ptr);
+			m_nCached.fetch_and_add(bytes);
+		}
+
+	public:
+
+		/** 64-byte aligned memory, to be released with deallocate() and the same number of bytes. */
+		static void * allocate(const size_t bytes)
+		{
+			MemoryPool& pool = _instance();
+
+			const size_t n = _sizeClass(bytes);
+			const int node = NUMATopology::getCurrentNode();
+
+			void * ptr = n <= nMaxSmallBytes ? pool._allocateSmall(n, node) : pool._allocateLarge(n, node);
+
+			pool._use(n);
+
+			return ptr;
+		}
+
+		static void deallocate(void * ptr, const size_t bytes)
+		{
+			if (ptr == NULL) return;
+
+			MemoryPool& pool = _instance();
+
+			const size_t n = _sizeClass(bytes);
+
+			//back to the lists of the node it was allocated on, whichever thread releases it
+			if (n <= nMaxSmallBytes)
+				pool._deallocateSmall(ptr, n, _nodeOfSmall(ptr));
+			else
+				pool._deallocateLarge(ptr, n, _nodeOfLarge(ptr));
+
+			pool._use(-(long long)n);
+		}
+
+		/** As allocate(), the size being kept in front of the memory: to be released with deallocateTagged(). */
+		static void * allocateTagged(const size_t bytes)
+		{
+			char * ptr = (char *)allocate(bytes + nAlignment);
+
+			*(size_t *)ptr = bytes;
+
+			return ptr + nAlignment;
+		}
+
+		static void deallocateTagged(void * ptr)
+		{
+			if (ptr == NULL) return;
+
+			char * start = (char *)ptr - nAlignment;
+
+			deallocate(start, *(size_t *)start + nAlignment);
+		}
+
+		/** Transparent huge pages for the slabs and the large requests (Linux), from the next system allocations. */
+		static void setHugePages(const bool bHugePages)
+		{
+			_instance().m_bHugePages = bHugePages;
+		}
+
+		/** Memory kept once released, beyond which the large requests go back to the system. */
+		static void setCacheLimitMB(const double dCacheLimitMB)
+		{
+			assert(dCacheLimitMB >= 0);
+
+			_instance().m_nCacheLimitBytes = (long long)(dCacheLimitMB*(1<<20));
+		}
+
+		/** Gives the cached large requests back to the system. Not thread-safe with respect to the thread caches. */
+		static void trim()
+		{
+			MemoryPool& pool = _instance();
+
+			tbb::spin_mutex::scoped_lock lock(pool.m_mutex);
+
+			for(Lists::iterator it = pool.m_lists.begin(); it != pool.m_lists.end(); it++)
+			{
+				const size_t bytes = it->first.second;
+
+				if (bytes <= nMaxSmallBytes) continue;
+
+				for(vector<void *>::const_iterator itPtr = it->second.begin(); itPtr != it->second.end(); itPtr++)
+					pool._systemDeallocateLarge(*itPtr, bytes);
+
+				pool.m_nCached.fetch_and_add(-(long long)(bytes*it->second.size()));
+				it->second.clear();
+			}
+		}
+
+		static Statistics getStatistics()
+		{
+			const MemoryPool& pool = _instance();
+			const double MB = 1./(1<<20);
+
+			Statistics s;
+			s.dUsedMB = pool.m_nUsed*MB;
+			s.dPeakMB = pool.m_nPeak*MB;
+			s.dCachedMB = pool.m_nCached*MB;
+			s.dSystemMB = pool.m_nSystem*MB;
+			s.dArenaMB = pool.m_nArenaPages*MB;
+			s.dArenaUsedMB = pool.m_nArenaUsed*MB;
+			s.nSystemAllocations = pool.m_nSystemAllocations;
+
+			return s;
+		}
+
+		/** The peak restarts from the current usage (e.g. at every step). */
+		static void resetPeak()
+		{
+			MemoryPool& pool = _instance();
+
+			pool.m_nPeak = (long long)pool.m_nUsed;
+		}
+
+		static void printStatistics()
+		{
+			const Statistics s = getStatistics();
+
+			printf("MemoryPool: used %.2f MB (peak %.2f MB), cached %.2f MB, system %.2f MB in %d allocations, arenas %.2f/%.2f MB, fragmentation %.1f%%\n",
+				   s.dUsedMB, s.dPeakMB, s.dCachedMB, s.dSystemMB, s.nSystemAllocations, s.dArenaUsedMB, s.dArenaMB, 100*s.getFragmentation());
+		}
+	};
+
+	class MemoryArena
+	{
+		static const size_t nPageBytes = MemoryPool::nHugePageBytes;
+
+		tbb::spin_mutex m_mutex;
+		vector< pair<char *, size_t> > m_pages;
+		int m_iPage;
+		size_t m_nOffset;
+		int m_nLive;
+
+		//forbidden
+		MemoryArena(const MemoryArena&);
+		MemoryArena& operator=(const MemoryArena&);
+
+	public:
+
+		MemoryArena(): m_mutex(), m_pages(), m_iPage(0), m_nOffset(0), m_nLive(0) {}
+
+		~MemoryArena()
+		{
+			assert(m_nLive == 0);
+
+			release();
+		}
+
+		/** The arena of the buffers living for one step of the solvers, never destroyed. */
+		static MemoryArena& transient()
+		{
+			static MemoryArena * arena = new MemoryArena;
+
+			return *arena;
+		}
+
+		void * allocate(const size_t bytes)
+		{
+			const size_t n = MemoryPool::_round(bytes);
+
+			tbb::spin_mutex::scoped_lock lock(m_mutex);
+
+			while(m_iPage < (int)m_pages.size() && m_nOffset + n > m_pages[m_iPage].second)
+			{
+				m_iPage++;
+				m_nOffset = 0;
+			}
+
+			if (m_iPage == (int)m_pages.size())
+			{
+				const size_t pageBytes = ((n + nPageBytes - 1)/nPageBytes)*nPageBytes;
+
+				m_pages.push_back(pair<char *, size_t>((char *)MemoryPool::allocate(pageBytes), pageBytes));
+				MemoryPool::_instance().m_nArenaPages.fetch_and_add(pageBytes);
+
+				m_nOffset = 0;
+			}
+
+			void * ptr = m_pages[m_iPage].first + m_nOffset;
+
+			m_nOffset += n;
+			m_nLive++;
+			MemoryPool::_instance().m_nArenaUsed.fetch_and_add(n);
+
+			return ptr;
+		}
+
+		/** The memory is reused only after reset(). */
+		void deallocate(void * ptr, const size_t bytes)
+		{
+			if (ptr == NULL) return;
+
+			tbb::spin_mutex::scoped_lock lock(m_mutex);
+
+			assert(m_nLive > 0);
+
+			m_nLive--;
+			MemoryPool::_instance().m_nArenaUsed.fetch_and_add(-(long long)MemoryPool::_round(bytes));
+		}
+
+		/** Rewinds the arena at the end of a step: all its allocations must have been released. */
+		void reset()
+		{
+			tbb::spin_mutex::scoped_lock lock(m_mutex);
+
+			if (m_nLive != 0)
+			{
+				printf("MemoryArena::reset: %d allocations still live. aborting.\n", m_nLive);
+				abort();
+			}
+
+			m_iPage = 0;
+			m_nOffset = 0;
+		}
+
+		/** Gives the pages back to the pool. The arena must be empty. */
+		void release()
+		{
+			tbb::spin_mutex::scoped_lock lock(m_mutex);
+
+			assert(m_nLive == 0);
+
+			for(vector< pair<char *, size_t> >::const_iterator it = m_pages.begin(); it != m_pages.end(); it++)
+			{
+				MemoryPool::deallocate(it->first, it->second);
+				MemoryPool::_instance().m_nArenaPages.fetch_and_add(-(long long)it->second);
+			}
+
+			m_pages.clear();
+			m_iPage = 0;
+			m_nOffset = 0;
+		}
+	};
+
+	/**
+	 * std allocator of MemoryPool.
+	 */
+	template<typename T>
+	class PoolAllocator
+	{
+	public:
+		typedef T value_type;
+		typedef T * pointer;
+		typedef const T * const_pointer;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+
+		template<typename U> struct rebind { typedef PoolAllocator<U> other; };
+
+		PoolAllocator() {}
+		PoolAllocator(const PoolAllocator&) {}
+		template<typename U> PoolAllocator(const PoolAllocator<U>&) {}
+
+		pointer address(reference x) const { return &x; }
+		const_pointer address(const_reference x) const { return &x; }
+
+		pointer allocate(size_type n, const void * = 0) { return (pointer)MemoryPool::allocate(n*sizeof(T)); }
+		void deallocate(pointer p, size_type n) { MemoryPool::deallocate(p, n*sizeof(T)); }
+
+		size_type max_size() const { return ((size_t)-1)/sizeof(T); }
+
+		void construct(pointer p, const T& value) { new ((void *)p) T(value); }
+		void destroy(pointer p) { p->~T(); }
+	};
+
+	template<typename T, typename U>
+	inline bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) { return true; }
+
+	template<typename T, typename U>
+	inline bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) { return false; }
+
+	/**
+	 * std allocator of MemoryArena::transient(), for the buffers released before its reset() at the end of the step.
+	 */
+	template<typename T>
+	class TransientAllocator
+	{
+	public:
+		typedef T value_type;
+		typedef T * pointer;
+		typedef const T * const_pointer;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+
+		template<typename U> struct rebind { typedef TransientAllocator<U> other; };
+
+		TransientAllocator() {}
+		TransientAllocator(const TransientAllocator&) {}
+		template<typename U> TransientAllocator(const TransientAllocator<U>&) {}
+
+		pointer address(reference x) const { return &x; }
+		const_pointer address(const_reference x) const { return &x; }
+
+		pointer allocate(size_type n, const void * = 0) { return (pointer)MemoryArena::transient().allocate(n*sizeof(T)); }
+		void deallocate(pointer p, size_type n) { MemoryArena::transient().deallocate(p, n*sizeof(T)); }
+
+		size_type max_size() const { return ((size_t)-1)/sizeof(T); }
+
+		void construct(pointer p, const T& value) { new ((void *)p) T(value); }
+		void destroy(pointer p) { p->~T(); }
+	};
+
+	template<typename T, typename U>
+	inline bool operator==(const TransientAllocator<T>&, const TransientAllocator<U>&) { return true; }
+
+	template<typename T, typename U>
+	inline bool operator!=(const TransientAllocator<T>&, const TransientAllocator<U>&) { return false; }
+}
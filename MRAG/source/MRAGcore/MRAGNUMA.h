@@ -0,0 +1,268 @@
+/*
+ *  MRAGNUMA.h
+ *  MRAG
+ *
+ *	NUMA topology of the process: the nodes and their CPUs, read from
+ *	/sys/devices/system/node or simulated by splitting the CPUs of the process
+ *	in equal groups (to exercise the placement on a single-socket machine).
+ *	Once set up, the TBB worker threads are pinned to the CPUs of a node, round robin,
+ *	and remember their node. The application thread keeps its affinity and counts as
+ *	node 0. Without setup there is one node and nothing is pinned.
+ *
+ *	The grid gives every block a home node (see Grid::_placeBlocks), the block
+ *	collection copies the blocks into memory first touched on their node
+ *	(BlockCollection::place) and the block processing lets the threads of a node
+ *	pick the chunks of blocks homed there first, with or without a lab and with
+ *	automatic or explicit granularity.
+ *
+ */
+#pragma once
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "MRAGEnvironment.h"
+
+#ifdef _MRAG_TBB
+#include "tbb/atomic.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/task_scheduler_observer.h"
+#endif
+
+using namespace std;
+
+namespace MRAG
+{
+	class NUMATopology
+	{
+		vector< vector<int> > m_cpusOfNode;
+		bool m_bSimulated;
+
+#ifdef _MRAG_TBB
+		class Pinning: public tbb::task_scheduler_observer
+		{
+			tbb::atomic<int> m_nThreads;
+
+		public:
+			Pinning() { m_nThreads = 0; }
+
+			void on_scheduler_entry(bool is_worker)
+			{
+				//the application thread is not ours to bind
+				if (!is_worker) return;
+
+				NUMATopology& topology = NUMATopology::_instance();
+
+				int& node = _threadNode().local();
+
+				if (node >= 0) return;
+
+				node = m_nThreads.fetch_and_increment() % topology.getNodes();
+				_bind(topology.m_cpusOfNode[node]);
+			}
+		};
+
+		static tbb::enumerable_thread_specific<int>& _threadNode()
+		{
+			static tbb::enumerable_thread_specific<int> threadNode(-1);
+
+			return threadNode;
+		}
+#endif
+
+		NUMATopology(): m_cpusOfNode(1), m_bSimulated(false) {}
+
+		static NUMATopology& _instance()
+		{
+			static NUMATopology topology;
+
+			return topology;
+		}
+
+		static vector<int> _processCPUs()
+		{
+			vector<int> cpus;
+#ifdef __linux__
+			cpu_set_t mask;
+			CPU_ZERO(&mask);
+
+			if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+				for(int c=0; c<CPU_SETSIZE; c++)
+					if (CPU_ISSET(c, &mask)) cpus.push_back(c);
+#endif
+			return cpus;
+		}
+
+		//cpulist format: "0-11,24-35"
+		static bool _readNodeCPUs(const int node, vector<int>& cpus)
+		{
+			char path[256];
+			sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+
+			FILE * f = fopen(path, "r");
+			if (f == NULL) return false;
+
+			int a = 0, b = 0;
+			char sep = 0;
+
+			while(fscanf(f, "%d", &a) == 1)
+			{
+				b = a;
+
+				if (fscanf(f, "%c", &sep) == 1 && sep == '-')
+				{
+					if (fscanf(f, "%d", &b) != 1) break;
+					if (fscanf(f, "%c", &sep) != 1) sep = 0;
+				}
+
+				for(int c=a; c<=b; c++) cpus.push_back(c);
+
+				if (sep != ',') break;
+			}
+
+			fclose(f);
+
+			return true;
+		}
+
+		static void _bind(const vector<int>& cpus)
+		{
+#ifdef __linux__
+			if (cpus.empty()) return;
+
+			cpu_set_t mask;
+			CPU_ZERO(&mask);
+
+			for(vector<int>::const_iterator it = cpus.begin(); it != cpus.end(); it++)
+				CPU_SET(*it, &mask);
+
+			sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+		}
+
+	public:
+
+		/**
+		 * nNodes: 0 for one node (the default), -1 for the nodes of the machine,
+		 * n>0 for n nodes simulated over the CPUs of the process.
+		 * To be called once, after the TBB scheduler is initialized (see Environment::setup).
+		 */
+		static void setup(const int nNodes)
+		{
+			NUMATopology& topology = _instance();
+
+			assert(topology.m_cpusOfNode.size() == 1);
+
+			if (nNodes == 0) return;
+
+			const vector<int> processCPUs = _processCPUs();
+
+			if (nNodes > 0)
+			{
+				topology.m_bSimulated = true;
+				topology.m_cpusOfNode.assign(nNodes, vector<int>());
+
+				const int nCPUs = processCPUs.size();
+
+				for(int n=0; n<nNodes && nCPUs > 0; n++)
+				{
+					const int s = (n*nCPUs)/nNodes;
+					const int e = max(s+1, ((n+1)*nCPUs)/nNodes);
+
+					for(int c=s; c<e; c++)
+						topology.m_cpusOfNode[n].push_back(processCPUs[c % nCPUs]);
+				}
+			}
+			else
+			{
+				vector< vector<int> > nodes;
+				vector<int> cpus;
+
+				for(int n=0; _readNodeCPUs(n, cpus); n++, cpus.clear())
+				{
+					//only the CPUs the process may run on
+					vector<int> allowed;
+
+					for(vector<int>::const_iterator it = cpus.begin(); it != cpus.end(); it++)
+						if (std::find(processCPUs.begin(), processCPUs.end(), *it) != processCPUs.end())
+							allowed.push_back(*it);
+
+					if (!allowed.empty()) nodes.push_back(allowed);
+				}
+
+				if (nodes.size() > 1)
+					topology.m_cpusOfNode = nodes;
+			}
+
+			printf("NUMATopology: %d %s node(s)\n", topology.getNodes(), topology.m_bSimulated ? "simulated" : "detected");
+
+#ifdef _MRAG_TBB
+			if (topology.getNodes() > 1)
+			{
+				static Pinning pinning;
+				pinning.observe(true);
+			}
+#endif
+		}
+
+		static int getNodes() { return _instance().m_cpusOfNode.size(); }
+
+		static bool isEnabled() { return getNodes() > 1; }
+
+		/** Node of the calling thread, 0 for the threads not pinned (the application thread). */
+		static int getCurrentNode()
+		{
+#ifdef _MRAG_TBB
+			if (!isEnabled()) return 0;
+
+			return max(0, _threadNode().local());
+#else
+			return 0;
+#endif
+		}
+
+		/**
+		 * Runs the calling thread on the CPUs of a node for the lifetime of the binding,
+		 * so that the memory it touches first lands there (and the pools serve the node, see MemoryPool).
+		 */
+		class Binding
+		{
+			const vector<int> m_previousCPUs;
+			int m_previousNode;
+
+		public:
+			Binding(const int node): m_previousCPUs(isEnabled() ? _processCPUs() : vector<int>()), m_previousNode(-1)
+			{
+				if (!isEnabled()) return;
+
+				_bind(_instance().m_cpusOfNode[node]);
+#ifdef _MRAG_TBB
+				m_previousNode = _threadNode().local();
+				_threadNode().local() = node;
+#endif
+			}
+
+			~Binding()
+			{
+				if (!isEnabled()) return;
+
+				_bind(m_previousCPUs);
+#ifdef _MRAG_TBB
+				_threadNode().local() = m_previousNode;
+#endif
+			}
+
+		private:
+			//forbidden
+			Binding(const Binding&): m_previousCPUs(), m_previousNode(-1) { abort(); }
+			Binding& operator=(const Binding&) { abort(); return *this; }
+		};
+	};
+}
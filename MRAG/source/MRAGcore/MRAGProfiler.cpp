@@ -21,7 +21,7 @@ void MRAG::ProfileAgent::_getTime(tick_count& time)
 	time = tick_count::now();
 }
 
-float MRAG::ProfileAgent::_getElapsedTime(const tick_count& tS, const tick_count& tE)
+double MRAG::ProfileAgent::_getElapsedTime(const tick_count& tS, const tick_count& tE)
 {
 	return (tE - tS).seconds();
 }
@@ -33,7 +33,7 @@ void MRAG::ProfileAgent::_getTime(clock_t& time)
 	time = clock();
 }
 
-float MRAG::ProfileAgent::_getElapsedTime(const clock_t& tS, const clock_t& tE)
+double MRAG::ProfileAgent::_getElapsedTime(const clock_t& tS, const clock_t& tE)
 {
 	return (tE - tS)/(double)CLOCKS_PER_SEC;
 }
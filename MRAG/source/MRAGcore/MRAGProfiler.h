@@ -18,12 +18,15 @@
 #include <string>
 #include <stack>
 #include <cstdlib>
+#include <stdio.h>
 
 using namespace std;
 
 #include "MRAGEnvironment.h"
 #ifdef _MRAG_TBB
 #include "tbb/tick_count.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "MRAGMemoryPool.h"
 namespace tbb { class tick_count; }
 #else
 #include <time.h>
@@ -61,7 +64,7 @@ namespace MRAG
 		int m_nMoney;
 		
 		static void _getTime(ClockTime& time);
-		static float _getElapsedTime(const ClockTime& tS, const ClockTime& tE);
+		static double _getElapsedTime(const ClockTime& tS, const ClockTime& tE);
 		
 		void _reset()
 		{
@@ -137,16 +140,162 @@ namespace MRAG
 	/**
 	 * Profile different parts of your code (identified by a user-specified string-ID).
 	 * For each string-ID we get a MRAG::ProfileAgent, where we can store timings.
+	 *
+	 * push_start()/pop_stop() also form a hierarchy of scopes: every scope is timed
+	 * inclusively under its path ("STEP/ADVECT/FMM"), see printTree().
+	 * Work done inside TBB tasks is timed with Profiler::Task and counted with count(),
+	 * both are recorded per thread and merged by endStep(). Once setOutput() is called,
+	 * endStep() appends the scopes, tasks, counters and gauges (set()) of the step to
+	 * a CSV file and, optionally, the timeline of the step to a Chrome trace
+	 * (chrome://tracing, tid 0 is the scope stack, tid 1+ the threads running tasks).
 	 * @see Profiler::getAgent(), Profiler::printSummary()
 	 */
 	class Profiler
 	{
 	protected:
 		
+		struct TraceEvent
+		{
+			string sName;
+			double dStart, dDuration;
+			
+			TraceEvent(string sName_, double dStart_, double dDuration_): sName(sName_), dStart(dStart_), dDuration(dDuration_) {}
+		};
+		
+		struct ScopeTotal
+		{
+			double dTime;
+			int nSamples;
+			
+			ScopeTotal(): dTime(0), nSamples(0) {}
+		};
+		
+		/** Per-thread record of one step, only touched by its thread until endStep(). */
+		struct ThreadRecord
+		{
+			map<string, double> timers;
+			map<string, double> counters;
+			vector<TraceEvent> events;
+		};
+		
 		map<string, ProfileAgent*> m_mapAgents;
 		stack<string> m_mapStoppedAgents;
 		
+		ProfileAgent::ClockTime m_tOrigin;
+		stack<string> m_scopePaths;
+		stack<double> m_scopeStarts;
+		map<string, ScopeTotal> m_mapScopeTotals;
+		map<string, double> m_mapStepScopes;
+		map<string, double> m_mapStepGauges;
+		vector<TraceEvent> m_scopeEvents;
+		double m_dStepStart;
+		
+		FILE * m_fCSV;
+		FILE * m_fTrace;
+		int m_nTraceEvents;
+		
+#ifdef _MRAG_TBB
+		tbb::enumerable_thread_specific<ThreadRecord> m_threadRecords;
+		
+		ThreadRecord& _local() { return m_threadRecords.local(); }
+		
+		void _records(vector<ThreadRecord*>& records)
+		{
+			for(tbb::enumerable_thread_specific<ThreadRecord>::iterator it = m_threadRecords.begin(); it != m_threadRecords.end(); it++)
+				records.push_back(&*it);
+		}
+#else
+		ThreadRecord m_threadRecord;
+		
+		ThreadRecord& _local() { return m_threadRecord; }
+		
+		void _records(vector<ThreadRecord*>& records)
+		{
+			records.push_back(&m_threadRecord);
+		}
+#endif
+		
+		static Profiler*& _stepProfiler()
+		{
+			static Profiler * profiler = NULL;
+			
+			return profiler;
+		}
+		
+		double _now() const
+		{
+			ProfileAgent::ClockTime t;
+			ProfileAgent::_getTime(t);
+			
+			return ProfileAgent::_getElapsedTime(m_tOrigin, t);
+		}
+		
+		void _endTask(const char * sName, const double dStart)
+		{
+			const double dEnd = _now();
+			ThreadRecord& record = _local();
+			
+			record.timers[sName] += dEnd - dStart;
+			
+			if (m_fTrace != NULL)
+				record.events.push_back(TraceEvent(sName, dStart, dEnd - dStart));
+		}
+		
+		void _writeEvents(const vector<TraceEvent>& events, const int tid, const int step)
+		{
+			for(vector<TraceEvent>::const_iterator it = events.begin(); it != events.end(); it++)
+				fprintf(m_fTrace, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"step\":%d}}\n",
+						m_nTraceEvents++ > 0 ? "," : "", it->sName.c_str(), tid, 1e6*it->dStart, 1e6*it->dDuration, step);
+		}
+		
+		void _writeRows(const map<string, double>& rows, const char * sKind, const int step)
+		{
+			for(map<string, double>::const_iterator it = rows.begin(); it != rows.end(); it++)
+				fprintf(m_fCSV, "%d,%s,%s,%e\n", step, sKind, it->first.c_str(), it->second);
+		}
+		
+		void _closeOutput()
+		{
+			if (m_fCSV != NULL) fclose(m_fCSV);
+			
+			if (m_fTrace != NULL)
+			{
+				fprintf(m_fTrace, "]\n");
+				fclose(m_fTrace);
+			}
+			
+			m_fCSV = NULL;
+			m_fTrace = NULL;
+			
+			if (_stepProfiler() == this) _stepProfiler() = NULL;
+		}
+		
+		//forbidden
+		Profiler(const Profiler&);
+		Profiler& operator=(const Profiler&);
+		
 	public:
+		
+		/**
+		 * Times the enclosing block, to be used inside TBB tasks (thread-safe).
+		 * The name must be a literal or outlive the task.
+		 */
+		class Task
+		{
+			Profiler& m_profiler;
+			const char * m_sName;
+			const double m_dStart;
+			
+		public:
+			
+			Task(Profiler& profiler, const char * sName): m_profiler(profiler), m_sName(sName), m_dStart(profiler._now()) {}
+			
+			~Task()
+			{
+				m_profiler._endTask(m_sName, m_dStart);
+			}
+		};
+		
 		void push_start(string sAgentName)
 		{
 			if (m_mapStoppedAgents.size() > 0)
@@ -154,6 +303,9 @@ namespace MRAG
 			
 			m_mapStoppedAgents.push(sAgentName);
 			getAgent(sAgentName).start();
+			
+			m_scopePaths.push(m_scopePaths.size() > 0 ? m_scopePaths.top() + "/" + sAgentName : sAgentName);
+			m_scopeStarts.push(_now());
 		}
 		
 		void pop_stop()
@@ -162,11 +314,160 @@ namespace MRAG
 			getAgent(sCurrentAgentName).stop();
 			m_mapStoppedAgents.pop();
 			
+			const double dStart = m_scopeStarts.top();
+			const double dDuration = _now() - dStart;
+			
+			ScopeTotal& total = m_mapScopeTotals[m_scopePaths.top()];
+			total.dTime += dDuration;
+			total.nSamples++;
+			m_mapStepScopes[m_scopePaths.top()] += dDuration;
+			
+			if (m_fTrace != NULL)
+				m_scopeEvents.push_back(TraceEvent(sCurrentAgentName, dStart, dDuration));
+			
+			m_scopePaths.pop();
+			m_scopeStarts.pop();
+			
 			if (m_mapStoppedAgents.size() == 0) return;
 			
 			getAgent(m_mapStoppedAgents.top()).start();
 		}
 		
+		/**
+		 * Adds to a counter of the current step (thread-safe).
+		 */
+		void count(const char * sName, const double dValue)
+		{
+			_local().counters[sName] += dValue;
+		}
+		
+		/**
+		 * Sets a gauge of the current step (e.g. number of blocks), not thread-safe.
+		 */
+		void set(const string sName, const double dValue)
+		{
+			m_mapStepGauges[sName] = dValue;
+		}
+		
+		/**
+		 * Adds to a counter of the profiler writing the step output, if any (thread-safe).
+		 * Lets the solvers and the block processing report their work without a reference to it.
+		 */
+		static void countStep(const char * sName, const double dValue)
+		{
+			Profiler * profiler = _stepProfiler();
+			
+			if (profiler != NULL) profiler->count(sName, dValue);
+		}
+		
+		/**
+		 * Writes the steps to sPrefix.csv (columns step,kind,name,value) and,
+		 * if bTrace, their timeline to sPrefix-trace.json.
+		 * With bAppend (a restarted run) the steps are added to the existing sPrefix.csv,
+		 * the header being written only to a new file; the trace always starts anew.
+		 * This profiler then receives the counters of countStep().
+		 */
+		void setOutput(const string sPrefix, const bool bTrace = false, const bool bAppend = false)
+		{
+			_closeOutput();
+			
+			m_fCSV = fopen((sPrefix + ".csv").c_str(), bAppend ? "a" : "w");
+			
+			if (m_fCSV == NULL)
+			{
+				printf("Profiler::setOutput: cannot open %s.csv. aborting.\n", sPrefix.c_str());
+				abort();
+			}
+			
+			fseek(m_fCSV, 0, SEEK_END);
+			
+			if (ftell(m_fCSV) == 0)
+				fprintf(m_fCSV, "step,kind,name,value\n");
+			
+			if (bTrace)
+			{
+				m_fTrace = fopen((sPrefix + "-trace.json").c_str(), "w");
+				
+				if (m_fTrace == NULL)
+				{
+					printf("Profiler::setOutput: cannot open %s-trace.json. aborting.\n", sPrefix.c_str());
+					abort();
+				}
+				
+				fprintf(m_fTrace, "[\n");
+				m_nTraceEvents = 0;
+			}
+			
+			_stepProfiler() = this;
+		}
+		
+		/**
+		 * Closes the step: merges the per-thread records, writes the output (if any)
+		 * and starts the next step. Must not be called while tasks are running.
+		 */
+		void endStep(const int step)
+		{
+			const double dNow = _now();
+			
+			vector<ThreadRecord*> records;
+			_records(records);
+			
+			map<string, double> tasks, counters;
+			
+			for(int i=0; i<(int)records.size(); i++)
+			{
+				ThreadRecord& record = *records[i];
+				
+				for(map<string, double>::const_iterator it = record.timers.begin(); it != record.timers.end(); it++)
+					tasks[it->first] += it->second;
+				
+				for(map<string, double>::const_iterator it = record.counters.begin(); it != record.counters.end(); it++)
+					counters[it->first] += it->second;
+				
+				if (m_fTrace != NULL)
+					_writeEvents(record.events, 1 + i, step);
+				
+				record.timers.clear();
+				record.counters.clear();
+				record.events.clear();
+			}
+			
+			if (m_fTrace != NULL)
+			{
+				_writeEvents(m_scopeEvents, 0, step);
+				fflush(m_fTrace);
+			}
+			
+#ifdef _MRAG_TBB
+			//memory of the step, the peak restarts at every step
+			{
+				const MemoryPool::Statistics memory = MemoryPool::getStatistics();
+				
+				m_mapStepGauges["memory-used-MB"] = memory.dUsedMB;
+				m_mapStepGauges["memory-peak-MB"] = memory.dPeakMB;
+				m_mapStepGauges["memory-system-MB"] = memory.dSystemMB;
+				m_mapStepGauges["memory-fragmentation"] = memory.getFragmentation();
+				
+				MemoryPool::resetPeak();
+			}
+#endif
+			
+			if (m_fCSV != NULL)
+			{
+				fprintf(m_fCSV, "%d,step,wall-clock,%e\n", step, dNow - m_dStepStart);
+				_writeRows(m_mapStepGauges, "gauge", step);
+				_writeRows(counters, "count", step);
+				_writeRows(m_mapStepScopes, "scope", step);
+				_writeRows(tasks, "task", step);
+				fflush(m_fCSV);
+			}
+			
+			m_mapStepScopes.clear();
+			m_mapStepGauges.clear();
+			m_scopeEvents.clear();
+			m_dStepStart = dNow;
+		}
+		
 		void clear()
 		{
 			for(map<string, ProfileAgent*>::iterator it = m_mapAgents.begin(); it != m_mapAgents.end(); it++)
@@ -177,15 +478,39 @@ namespace MRAG
 			}
 			
 			m_mapAgents.clear();
+			m_mapScopeTotals.clear();
 		}
 		
-		Profiler(): m_mapAgents(){}
+		Profiler(): m_mapAgents(), m_dStepStart(0), m_fCSV(NULL), m_fTrace(NULL), m_nTraceEvents(0)
+		{
+			ProfileAgent::_getTime(m_tOrigin);
+		}
 		
 		~Profiler()
 		{
+			_closeOutput();
 			clear();
 		}
 		
+		/**
+		 * Prints the inclusive time of every scope, indented by nesting depth.
+		 */
+		void printTree() const
+		{
+			for(map<string, ScopeTotal>::const_iterator it = m_mapScopeTotals.begin(); it != m_mapScopeTotals.end(); it++)
+			{
+				const string& sPath = it->first;
+				const size_t iLeaf = sPath.rfind('/');
+				int nDepth = 0;
+				
+				for(size_t i=0; i<sPath.size(); i++)
+					nDepth += (int)(sPath[i] == '/');
+				
+				printf("%*s%-*s %03.3f s\t(%d samples)\n", 2*nDepth, "", 40-2*nDepth,
+					   iLeaf == string::npos ? sPath.c_str() : sPath.c_str() + iLeaf + 1, it->second.dTime, it->second.nSamples);
+			}
+		}
+		
 		void printSummary() const
 		{
 			vector<ProfileSummaryItem> v = createSummary();
@@ -268,6 +593,8 @@ namespace MRAG
 			//printf("reset\n");
 			for(map<string, ProfileAgent*>::const_iterator it = m_mapAgents.begin(); it != m_mapAgents.end(); it++)
 				it->second->_reset();
+			
+			m_mapScopeTotals.clear();
 		}
 		
 		
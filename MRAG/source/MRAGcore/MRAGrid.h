@@ -18,6 +18,8 @@ using namespace std;
 
 #include "MRAGEnvironment.h"
 #include "MRAGGridNode.h"
+#include "MRAGLinearQuadtree.h"
+#include "MRAGNUMA.h"
 #include "MRAGCompressor.h"
 #include "MRAGRefinementPlan.h"
 #include "MRAGCommon.h"
@@ -72,13 +74,22 @@ namespace MRAG
 		float getMemorySize() const;
 		
 		//TASK - ACCESS
-		int getCurrentMaxLevel() const { return _computeMaxLevel(m_hierarchy); }
+		int getCurrentMaxLevel() const { return m_quadtree.getMaxLevel(); }
 		int getCurrentMinLevel() const { return _computeMinLevel(m_blockAtLevel); }
 		/** Return info on all blocks in the grid. @see MRAG::BlockInfo */
-        virtual vector<BlockInfo> getBlocksInfo() const;
+        virtual vector<BlockInfo> getBlocksInfo() const { return m_vInfo; }
 		vector<BlockInfo> getNeighborsInfo(const vector<BlockInfo>& vInfo, bool bConsiderGhosts=false) const;
         vector<BlockInfo> getInteriorNeighborsInfo(const vector<BlockInfo>& vInfo, bool bConsiderGhosts=false) const;
 		virtual vector<BlockInfo> getBlocksInfoAtLevel(int level) const { return m_blockAtLevel[level]; }
+		/**
+		 * Same as getBlocksInfo() and getBlocksInfoAtLevel() without the copy: the arrays are kept by the grid,
+		 * with the ptrBlock resolved, and rebuilt at every refinement/compression (see getBlocksInfoVersion()).
+		 * Passed as they are to the block processing, they are used in place.
+		 */
+		const vector<BlockInfo>& getBlocksInfoRef() const { return m_vInfo; }
+		const vector<BlockInfo>& getBlocksInfoAtLevelRef(int level) const { return m_blockAtLevel[level]; }
+		/** Incremented whenever the blocks change, the references above are valid as long as it does not. */
+		int getBlocksInfoVersion() const { return m_nInfoVersion; }
 		
         /** Return the collection of block defining all blocks in the grid. @see MRAG::BlockCollection */
 		const BlockCollection<BlockType>& getBlockCollection() { return m_blockCollection; }
@@ -101,20 +112,47 @@ namespace MRAG
 		void _collapse(HierarchyType& hierarchy, GridNode * parent, int newBlockID) const;
 		
 		//TASK - const
-		int _computeMaxLevel(const HierarchyType& hierarchy) const;
 		int _computeMinLevel(const vector<vector<BlockInfo> >& blockAtLevel) const;
-		void _computeNeighborhood(const HierarchyType& hierarchy, NeighborhoodType& neighborhood, map<GridNode *, map<int, GridNode *> > & ghostNodes) const;
-		void _computeBlockAtLevel(const HierarchyType& hierarchy, vector<vector<BlockInfo> >& blockAtLevel) const;
+		void _computeNeighborhood(const LinearQuadtree& quadtree, NeighborhoodType& neighborhood, map<GridNode *, map<int, GridNode *> > & ghostNodes) const;
+		void _computeBlocksInfo(const LinearQuadtree& quadtree, vector<BlockInfo>& vInfo) const;
+		void _computeBlockAtLevel(const LinearQuadtree& quadtree, const vector<BlockInfo>& vInfo, vector<vector<BlockInfo> >& blockAtLevel) const;
+		void _placeBlocks();
 		void _computeBoundaryInfo(BoundaryInfo& binfo, const int requested_stencil_start[3], const int requested_stencil_end[3], vector<GridNode*>& vNodesToCompute) const;
 		void _computeMaxStencilUsed(int start[3], int end[3]) const;
 		void _checkResolutionJumpCondition(int maxJump, const int * stencil_start = NULL, const int * stencil_end = NULL) const;
 		int	 _computeMaxLevelJump() const;
 		
 		//TASK - non const
+		//order of the blocks in the block infos
+		virtual void _sortBlocksInfo(vector<BlockInfo>& vInfo) const {}
+		
+		void _updateBlocksInfo()
+		{
+			_computeBlocksInfo(m_quadtree, m_vInfo);
+			_sortBlocksInfo(m_vInfo);
+			_computeBlockAtLevel(m_quadtree, m_vInfo, m_blockAtLevel);
+			
+			m_blockCollection.clearResolvedInfos();
+			
+			if (!m_vInfo.empty())
+				m_blockCollection.setResolvedInfos(&m_vInfo.front(), m_vInfo.size());
+			
+			for(int l=0; l<m_blockAtLevel.size(); l++)
+				if (!m_blockAtLevel[l].empty())
+					m_blockCollection.setResolvedInfosAtLevel(l, &m_blockAtLevel[l].front(), m_blockAtLevel[l].size());
+			
+			m_nInfoVersion++;
+		}
+		
 		virtual void _refresh(bool bUpdateLazyData = false)
 		{
-			_computeBlockAtLevel(m_hierarchy, m_blockAtLevel);
-			_computeNeighborhood(m_hierarchy, m_neighborhood, m_ghostNodes);
+			m_quadtree.build(m_hierarchy);
+			
+			if (NUMATopology::isEnabled())
+				_placeBlocks();
+			
+			_updateBlocksInfo();
+			_computeNeighborhood(m_quadtree, m_neighborhood, m_ghostNodes);
 				
 			m_mapGhost2Node.clear();
 			for(map< GridNode *, map<int, GridNode *> >::const_iterator itGridNode = m_ghostNodes.begin(); itGridNode!=m_ghostNodes.end(); itGridNode++)
@@ -140,12 +178,17 @@ namespace MRAG
 		void _dispose();
 		
 		//blocks info
+		vector<BlockInfo> m_vInfo;
 		vector<vector<BlockInfo> > m_blockAtLevel;
+		int m_nInfoVersion;
 		BlockCollection<BlockType>& m_blockCollection;
 		bool m_bCollectionOwner;
 		
-		//node info
+		//node info: the hierarchy owns the nodes and is edited by the refinement, the compression and the IO,
+		//the quadtree indexes it for the lookups and the sweeps (rebuilt in _refresh()),
+		//the neighborhood is computed from the quadtree and read by the refiners, the compressor and the boundary info
 		HierarchyType m_hierarchy;
+		LinearQuadtree m_quadtree;
 		NeighborhoodType m_neighborhood;
 		map<GridNode *, map<int, GridNode *> > m_ghostNodes;
 		map<GridNode *, GridNode *> m_mapGhost2Node;
@@ -178,7 +221,7 @@ namespace MRAG
 	private:
 		
 		//forbidden
-		Grid(const Grid&):m_blockAtLevel(), 
+		Grid(const Grid&):m_vInfo(), m_blockAtLevel(), m_nInfoVersion(0), 
 		m_blockCollection(*(new BlockCollection<BlockType>())), 
 		m_bCollectionOwner(true),
 		m_blockCollapser(),//blocks
@@ -19,11 +19,11 @@ namespace MRAG
 	
 	template <typename WaveletType, typename BlockType>
 	Grid<WaveletType, BlockType>::Grid(int nBlocksX, int nBlocksY, int nBlocksZ, BlockCollection<BlockType>* collection, bool bVerbose):
-		m_blockAtLevel(), 
+		m_vInfo(), m_blockAtLevel(), m_nInfoVersion(0), 
 		m_blockCollection((collection != NULL)? *collection : *(new BlockCollection<BlockType>())), 
 		m_bCollectionOwner(collection == NULL),
 		m_blockCollapser(), m_blockSplitter(),
-		m_hierarchy(), m_neighborhood(), m_setInvalidBBInfo(), m_boundaryInfo(), m_mapGhost2Node(), m_ghostNodes(), //nodes
+		m_hierarchy(), m_quadtree(), m_neighborhood(), m_setInvalidBBInfo(), m_boundaryInfo(), m_mapGhost2Node(), m_ghostNodes(), //nodes
 		m_status(eGridStatus_Initialized), m_bVerbose(bVerbose),
 		m_refRefiner(NULL), m_refCompressor(NULL)
 	{
@@ -54,11 +54,11 @@ namespace MRAG
 
 	template <typename WaveletType, typename BlockType>
 	Grid<WaveletType, BlockType>::Grid(int nBlocksX, int nBlocksY, int nBlocksZ, const int maxStencil[2][3], BlockCollection<BlockType>* collection, bool bVerbose):
-		m_blockAtLevel(), 
+		m_vInfo(), m_blockAtLevel(), m_nInfoVersion(0), 
 		m_blockCollection((collection != NULL)? *collection : *(new BlockCollection<BlockType>())), 
 		m_bCollectionOwner(collection == NULL),
 		m_blockCollapser(NULL), m_blockSplitter(NULL),
-		m_hierarchy(), m_neighborhood(), m_setInvalidBBInfo(), m_boundaryInfo(), m_mapGhost2Node(), m_ghostNodes(), //nodes
+		m_hierarchy(), m_quadtree(), m_neighborhood(), m_setInvalidBBInfo(), m_boundaryInfo(), m_mapGhost2Node(), m_ghostNodes(), //nodes
 		m_status(eGridStatus_Initialized), m_bVerbose(bVerbose),
 		m_refRefiner(NULL), m_refCompressor(NULL)
 	{
@@ -161,8 +161,10 @@ namespace MRAG
 		
 		//5.
 		m_hierarchy.clear();
+		m_quadtree.clear();
 		m_neighborhood.clear();
 		m_ghostNodes.clear();
+		m_vInfo.clear();
 		m_blockAtLevel.clear();
 		
 	}
@@ -170,7 +172,8 @@ namespace MRAG
 	template <typename WaveletType, typename BlockType>
 	float Grid<WaveletType, BlockType>::getMemorySize() const
 	{
-		int memsize = sizeof(this);
+		//in bytes, beyond the range of int for the large grids
+		double memsize = sizeof(this);
 		
 		for(int i=0;i<m_blockAtLevel.size(); i++)
 			memsize += sizeof(int)*m_blockAtLevel[i].size();
@@ -179,6 +182,8 @@ namespace MRAG
 		
 		memsize+= m_hierarchy.size()*(sizeof(HierarchyType::key_type) + sizeof(HierarchyType::mapped_type));
 		
+		memsize+= 1024*1024*m_quadtree.getMemorySize();
+		
 		memsize+= m_neighborhood.size()*(sizeof(NeighborhoodType::key_type) + sizeof(NeighborhoodType::mapped_type));
 		
 		memsize+= 1024*1024*m_boundaryInfo.getMemorySize();
@@ -186,42 +191,11 @@ namespace MRAG
 		return memsize/(double)(1<<20);
 	}
 		
-	template <typename WaveletType, typename BlockType>
-	vector<BlockInfo> Grid<WaveletType, BlockType>::getBlocksInfo() const 
-	{
-		vector<BlockInfo> result;
-		
-		for(typename HierarchyType::const_iterator it=m_hierarchy.begin(); it!=m_hierarchy.end(); it++)
-		{
-			const GridNode * node = it->first;
-			if(node!=NULL && !node->isEmpty)
-			{
-				const double dilate = pow(2.0, -node->level);
-				
-				const Real h[3] = {
-					(Real)(dilate*m_vSize[0]/BlockType::sizeX),
-					(Real)(m_vProcessingDirections[1]? dilate*m_vSize[1]/BlockType::sizeY  : 1),
-					(Real)(m_vProcessingDirections[2]? (dilate*m_vSize[2]/BlockType::sizeZ) : 1)
-				};
-
-				const Real p[3] = {
-					(Real)(m_vPosition[0] + node->index[0]*dilate*m_vSize[0] + (WaveletType::bIsCellCentered?0.5*h[0] : 0)),
-					(Real)(m_vPosition[1] + node->index[1]*dilate*m_vSize[1] + (WaveletType::bIsCellCentered?0.5*h[1] : 0)),
-					(Real)(m_vPosition[2] + node->index[2]*dilate*m_vSize[2] + (WaveletType::bIsCellCentered?0.5*h[2] : 0))
-				};
-				
-				result.push_back(BlockInfo(node->blockID, node->index, node->level, p, h));
-			}
-		}
-		
-		return result;
-	}
-	
 	template <typename WaveletType, typename BlockType>
 	vector<BlockInfo> Grid<WaveletType, BlockType>::getNeighborsInfo(const vector<BlockInfo>& vInfo, bool bConsiderGhosts) const
 	{
 		//1. put all input blockIDs into a set
-		//2. construct map: blockID -> GridNode
+		//2. find the GridNode of a blockID in the quadtree
 		//3. use it for BlockInfo -> GridNode
 		//4. use GridNode to get the neighbors
 		//5. select those neighbors that are not inside BlockInfo and forget about ghosts
@@ -238,33 +212,22 @@ namespace MRAG
 		for(vector<BlockInfo>::const_iterator it = vInfo.begin(); it != vInfo.end(); ++it)
 			inputIDs.insert(it->blockID);
 		
-		//2.
-		map<int, GridNode *> leafs;
-		
-		for(typename HierarchyType::const_iterator it=m_hierarchy.begin(); it!=m_hierarchy.end(); it++)
-		{
-			const GridNode * node = it->first;
-			
-			if(node!=NULL && !node->isEmpty)
-				leafs[it->first->blockID] = it->first;
-		}
-		
-		//3.
+		//2., 3.
 		set<GridNode *> to_process;
 		
 		for(vector<BlockInfo>::const_iterator it = vInfo.begin(); it != vInfo.end(); ++it)
 		{
-			GridNode * mynode = leafs[it->blockID];
+			GridNode * mynode = m_quadtree.findLeaf(it->blockID);
 			NeighborhoodType::const_iterator itNeighbors = m_neighborhood.find(mynode);
 			
 			assert(itNeighbors != m_neighborhood.end());
 			
-			vector<GridNode *> neighbors = itNeighbors->second;
+			const vector<GridNode *>& neighbors = itNeighbors->second;
 			
 			for(vector<GridNode *>::const_iterator itN = neighbors.begin(); itN != neighbors.end(); ++itN)
 			{
 				const bool bIsInput = inputIDs.find((*itN)->blockID) != inputIDs.end();
-				const bool bIsGhost = m_neighborhood.find(*itN) != m_neighborhood.end();
+				const bool bIsGhost = m_quadtree.isLeaf(*itN);
 				
 				if (!bIsInput && !bIsGhost)
 					to_process.insert(*itN);
@@ -305,7 +268,7 @@ namespace MRAG
         // same method as getNeighborsInfo but now returning only ghosts (== interior neighbors, not across domain boundaries)
         
 		//1. put all input blockIDs into a set
-		//2. construct map: blockID -> GridNode
+		//2. find the GridNode of a blockID in the quadtree
 		//3. use it for BlockInfo -> GridNode
 		//4. use GridNode to get the neighbors
 		//5. select those neighbors that are not inside BlockInfo and forget about ghosts
@@ -322,33 +285,22 @@ namespace MRAG
 		for(vector<BlockInfo>::const_iterator it = vInfo.begin(); it != vInfo.end(); ++it)
 			inputIDs.insert(it->blockID);
 		
-		//2.
-		map<int, GridNode *> leafs;
-		
-		for(typename HierarchyType::const_iterator it=m_hierarchy.begin(); it!=m_hierarchy.end(); it++)
-		{
-			const GridNode * node = it->first;
-			
-			if(node!=NULL && !node->isEmpty)
-				leafs[it->first->blockID] = it->first;
-		}
-		
-		//3.
+		//2., 3.
 		set<GridNode *> to_process;
 		
 		for(vector<BlockInfo>::const_iterator it = vInfo.begin(); it != vInfo.end(); ++it)
 		{
-			GridNode * mynode = leafs[it->blockID];
+			GridNode * mynode = m_quadtree.findLeaf(it->blockID);
 			NeighborhoodType::const_iterator itNeighbors = m_neighborhood.find(mynode);
 			
 			assert(itNeighbors != m_neighborhood.end());
 			
-			vector<GridNode *> neighbors = itNeighbors->second;
+			const vector<GridNode *>& neighbors = itNeighbors->second;
 			
 			for(vector<GridNode *>::const_iterator itN = neighbors.begin(); itN != neighbors.end(); ++itN)
 			{
 				const bool bIsInput = inputIDs.find((*itN)->blockID) != inputIDs.end();
-				const bool bIsGhost = m_neighborhood.find(*itN) != m_neighborhood.end();
+				const bool bIsGhost = m_quadtree.isLeaf(*itN);
                 
                 if (!bIsInput && bIsGhost) // want only ghosts, not neighbors now
                     to_process.insert(*itN);
@@ -423,11 +375,11 @@ namespace MRAG
 		//6. return how many blocks we created
 		
 		//1.
-		for(typename HierarchyType::const_iterator it=m_hierarchy.begin(); it!=m_hierarchy.end(); it++)
+		for(int i=0; i<m_quadtree.size(); i++)
 		{
-			GridNode * node = it->first;
+			GridNode * node = m_quadtree[i];
 			
-			if (node==NULL || node->isEmpty ) continue;
+			if (node->isEmpty) continue;
 			
 			const bool bFound = blocksToRefine.find(node->blockID) != blocksToRefine.end();
 			node->shouldBeRefined = (node->isEmpty)? false: bFound;
@@ -558,11 +510,10 @@ namespace MRAG
 		//7. refresh the other data structures depending on hierarchy
 		
 		//1.
-		for(typename HierarchyType::const_iterator it=m_hierarchy.begin(); it!=m_hierarchy.end(); it++)
+		for(int i=0; i<m_quadtree.size(); i++)
 		{
-			GridNode * node = it->first;
-			if(node!=NULL)
-					node->shouldBeCompressed = (node->isEmpty)? false: (blocksToCompress.find(node->blockID) != blocksToCompress.end());
+			GridNode * node = m_quadtree[i];
+			node->shouldBeCompressed = (node->isEmpty)? false: (blocksToCompress.find(node->blockID) != blocksToCompress.end());
 		}
 		
 		//2.
@@ -739,16 +690,12 @@ namespace MRAG
 		
 		BoundaryInfo * binfo = new BoundaryInfo;
 		
-		vector<GridNode*> vNodes(m_neighborhood.size());
-		vector<GridNode*>::iterator itVector = vNodes.begin();
+		vector<GridNode*> vNodes;
+		vNodes.reserve(m_neighborhood.size());
 		
-		for(HierarchyType::const_iterator it=m_hierarchy.begin(); it!=m_hierarchy.end(); it++)
-		{
-			if (it->first == NULL || it->first->isEmpty) continue;
-			
-			*itVector = it->first;
-			itVector++;
-		}
+		for(int i=0; i<m_quadtree.size(); i++)
+			if (!m_quadtree[i]->isEmpty)
+				vNodes.push_back(m_quadtree[i]);
 		
 		_computeBoundaryInfo(*binfo, requested_stencil_start, requested_stencil_end, vNodes);
 		
@@ -878,18 +825,6 @@ namespace MRAG
 #pragma mark -
 #pragma mark Helpers const
 
-	template <typename WaveletType, typename BlockType>
-	int Grid<WaveletType, BlockType>::_computeMaxLevel(const HierarchyType& hierarchy) const
-	{
-		int lmax = 0;
-		
-		for(typename HierarchyType::const_iterator it=hierarchy.begin(); it!=hierarchy.end(); it++)
-			if (it->first != NULL)
-				lmax = std::max(lmax, it->first->level);
-		
-		return lmax;
-	}
-	
 	template <typename WaveletType, typename BlockType>
 	int Grid<WaveletType, BlockType>::_computeMinLevel(const vector<vector<BlockInfo> >& blockAtLevel) const
 	{		
@@ -920,17 +855,85 @@ namespace MRAG
 	}
 	
 	template <typename WaveletType, typename BlockType>
-	void Grid<WaveletType, BlockType>::_computeBlockAtLevel(const HierarchyType& hierarchy, vector<vector<BlockInfo> >& blockAtLevel) const
+	void Grid<WaveletType, BlockType>::_computeBlocksInfo(const LinearQuadtree& quadtree, vector<BlockInfo>& vInfo) const 
 	{
-		vector<BlockInfo> blocks = getBlocksInfo();
+		vInfo.clear();
+		
+		//the leaves by level, in Morton order within a level
+		for(int i=0; i<quadtree.size(); i++)
+		{
+			const GridNode * node = quadtree[i];
+			if(!node->isEmpty)
+			{
+				const double dilate = pow(2.0, -node->level);
+				
+				const Real h[3] = {
+					(Real)(dilate*m_vSize[0]/BlockType::sizeX),
+					(Real)(m_vProcessingDirections[1]? dilate*m_vSize[1]/BlockType::sizeY  : 1),
+					(Real)(m_vProcessingDirections[2]? (dilate*m_vSize[2]/BlockType::sizeZ) : 1)
+				};
+
+				const Real p[3] = {
+					(Real)(m_vPosition[0] + node->index[0]*dilate*m_vSize[0] + (WaveletType::bIsCellCentered?0.5*h[0] : 0)),
+					(Real)(m_vPosition[1] + node->index[1]*dilate*m_vSize[1] + (WaveletType::bIsCellCentered?0.5*h[1] : 0)),
+					(Real)(m_vPosition[2] + node->index[2]*dilate*m_vSize[2] + (WaveletType::bIsCellCentered?0.5*h[2] : 0))
+				};
+				
+				vInfo.push_back(BlockInfo(node->blockID, node->index, node->level, p, h));
+				vInfo.back().ptrBlock = &m_blockCollection[node->blockID];
+			}
+		}
+	}
+	
+	/**
+	 * Home node of the blocks: the leaves in Morton order at the finest level, cut in
+	 * equal parts, one per NUMA node. Every node owns a compact region of the domain.
+	 */
+	template <typename WaveletType, typename BlockType>
+	void Grid<WaveletType, BlockType>::_placeBlocks()
+	{
+		const int nNodes = NUMATopology::getNodes();
+		const int maxLevel = m_quadtree.getMaxLevel();
+		
+		vector< pair<LinearQuadtree::Key, int> > leaves;
+		leaves.reserve(m_quadtree.size());
+		
+		for(int i=0; i<m_quadtree.size(); i++)
+		{
+			const GridNode * node = m_quadtree[i];
+			
+			if (node->isEmpty) continue;
+			
+			const int shift = maxLevel - node->level;
+			const int index[3] = {node->index[0] << shift, node->index[1] << shift, node->index[2] << shift};
+			
+			leaves.push_back(pair<LinearQuadtree::Key, int>(LinearQuadtree::key(maxLevel, index), node->blockID));
+		}
+		
+		sort(leaves.begin(), leaves.end());
+		
+		const int n = leaves.size();
+		vector<int> blockIDs(n), nodes(n);
+		
+		for(int i=0; i<n; i++)
+		{
+			blockIDs[i] = leaves[i].second;
+			nodes[i] = (int)(((long long)i*nNodes)/n);
+		}
 		
+		m_blockCollection.place(blockIDs, nodes);
+	}
+	
+	template <typename WaveletType, typename BlockType>
+	void Grid<WaveletType, BlockType>::_computeBlockAtLevel(const LinearQuadtree& quadtree, const vector<BlockInfo>& vInfo, vector<vector<BlockInfo> >& blockAtLevel) const
+	{
 		blockAtLevel.clear();
 		
-		const int levels = 1+_computeMaxLevel(hierarchy);
+		const int levels = 1+quadtree.getMaxLevel();
 		
 		blockAtLevel.resize(levels);
 		
-		for(vector<BlockInfo>::const_iterator it=blocks.begin(); it!=blocks.end(); it++)
+		for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
 			blockAtLevel[it->level].push_back(*it);
 	}
 	
@@ -1014,12 +1017,11 @@ namespace MRAG
 	}
 	
 	template <typename WaveletType, typename BlockType>
-	void Grid<WaveletType, BlockType>::_computeNeighborhood(const HierarchyType& hierarchy, NeighborhoodType& neighborhood, map<GridNode *, map<int, GridNode *> > & ghostNodes) const
+	void Grid<WaveletType, BlockType>::_computeNeighborhood(const LinearQuadtree& quadtree, NeighborhoodType& neighborhood, map<GridNode *, map<int, GridNode *> > & ghostNodes) const
 	{
-		//0. create a suitable data-structure for the bucket list
-		//1. generate bucket list of nodes depending on their locations
-		//2. use it to generate the neighborhood
-		//3. clear it cause i am a good boy
+		//0. clear the old neighborhood and ghosts
+		//1. for every leaf and direction, find the leaves touching it in the quadtree
+		//2. across a periodic boundary, take the image (ghost) of the neighbor
 		
 		//0.
 		{
@@ -1039,289 +1041,92 @@ namespace MRAG
 			neighborhood.clear();
 		}
 		
+		int nNeighborsConnections = 0;
+		vector<GridNode *> candidates;
 		
-		typedef MRAG::MRAGridHelpers::FlattenedBlock FlattenedBlock;
-		typedef vector< const FlattenedBlock* > B;
-		
-		//1.	
-		const int max_level = _computeMaxLevel(hierarchy);
-		const int reference_level = max_level;
-		const int reference_size = 1<<reference_level;
-		
-		const int nPeriodicBoundaries = (int)(m_vPeriodicDirection[0]) + (int)(m_vPeriodicDirection[1]) + (int)(m_vPeriodicDirection[2]);
-		
-		MRAG::Matrix3D< B > & bucket = *(new MRAG::Matrix3D< B >(
-																 m_vProcessingDirections[0]?reference_size:1, 
-																 m_vProcessingDirections[1]?reference_size:1, 
-																 m_vProcessingDirections[2]?reference_size:1));
-		
-		B pool;
+		const int nNodes = quadtree.size();
 		
+		for(int iNode=0; iNode<nNodes; iNode++)
 		{
-			int nAdded = 0;
-			for(HierarchyType::const_iterator it=hierarchy.begin(); it!=hierarchy.end(); it++)
+			GridNode * node = quadtree[iNode];
+			
+			if (node->isEmpty) continue;
+			
+			vector<GridNode *>& neighbors = neighborhood[node];
+			
+			const int n = (1 << node->level);
+			
+			for(int code=0; code<27; code++)
 			{
-				if (it->first == NULL || it->first->isEmpty) continue;
+				if (code == 1 + 3 + 9) continue;
 				
-				const GridNode & node = *(it->first);
+				const int d[3] = {code%3-1, (code/3)%3-1, (code/9)%3-1};
 				
-				const int level_difference = max_level - node.level;
-				const int level_offset = max_level - reference_level;
+				if ((!m_vProcessingDirections[0] && d[0] != 0) ||
+					(!m_vProcessingDirections[1] && d[1] != 0) ||
+					(!m_vProcessingDirections[2] && d[2] != 0)) continue;
 				
-				const int finest_start[3] = {
-					m_vProcessingDirections[0] ? ((node.index[0]<<level_difference)) : 0, 
-					m_vProcessingDirections[1] ? ((node.index[1]<<level_difference)) : 0, 
-					m_vProcessingDirections[2] ? ((node.index[2]<<level_difference)) : 0
-				};
-				
-				const int finest_end[3] = {
-					m_vProcessingDirections[0] ? (((node.index[0]+1)<<level_difference)) : 1,
-					m_vProcessingDirections[1] ? (((node.index[1]+1)<<level_difference)) : 1,
-					m_vProcessingDirections[2] ? (((node.index[2]+1)<<level_difference)) : 1
-				};
+				//1.
+				int idx[3] = {node->index[0] + d[0], node->index[1] + d[1], node->index[2] + d[2]};
+				int shift[3] = {0, 0, 0};
+				bool bOutside = false;
 				
-				const FlattenedBlock * block = new FlattenedBlock(finest_start, finest_end, &node);
-				pool.push_back(block);
+				for(int i=0; i<3; i++)
+				{
+					if (idx[i]>=0 && idx[i]<n) continue;
+					
+					if (!m_vPeriodicDirection[i]) bOutside = true;
+					
+					shift[i] = idx[i]<0 ? -1 : 1;
+					idx[i] = (idx[i]+n)%n;
+				}
 				
-				const int reference_start[3] = {
-					finest_start[0]>>level_offset, 
-					finest_start[1]>>level_offset, 
-					finest_start[2]>>level_offset
-				};
+				if (bOutside) continue;
 				
-				const int reference_end[3] = {
-					reference_start[0] + std::max((int)1, (finest_end[0]>>level_offset) - reference_start[0]), 
-					reference_start[1] + std::max((int)1, (finest_end[1]>>level_offset) - reference_start[1]),
-					reference_start[2] + std::max((int)1, (finest_end[2]>>level_offset) - reference_start[2])
+				//the leaves of the cell facing the node, none along the directions not processed
+				const int side[3] = {
+					m_vProcessingDirections[0] ? -d[0] : -1, 
+					m_vProcessingDirections[1] ? -d[1] : -1, 
+					m_vProcessingDirections[2] ? -d[2] : -1
 				};
 				
-				nAdded  += (reference_end[2]-reference_start[2])*(reference_end[1]-reference_start[1])*(reference_end[0]-reference_start[0]);
+				candidates.clear();
+				quadtree.collectLeaves(node->level, idx, side, candidates);
 				
+				//2.
+				const int shiftCode = (shift[0]+1) + 3*(shift[1]+1) + 9*(shift[2]+1);
 				
-				for(int iz = reference_start[2]; iz<reference_end[2]; iz++)
-					for(int iy = reference_start[1]; iy<reference_end[1]; iy++)
-						for(int ix = reference_start[0]; ix<reference_end[0]; ix++)
-							bucket.Access(ix,iy,iz).push_back(block);
-				
-				int ghosts = 0;
-				if (nPeriodicBoundaries>0)
+				for(vector<GridNode *>::const_iterator it = candidates.begin(); it != candidates.end(); it++)
 				{
-					const bool vProcessAndPeriodic[3] = { 
-						m_vProcessingDirections[0] && m_vPeriodicDirection[0], 
-						m_vProcessingDirections[1] && m_vPeriodicDirection[1], 
-						m_vProcessingDirections[2] && m_vPeriodicDirection[2]
-					};
-					
-					const int n = (1 << node.level);
-					
-					if (node.index[0] !=0 && node.index[1] !=0 && node.index[2] !=0 &&
-						node.index[0]!=n-1 && node.index[1]!=n-1 && node.index[2]!=n-1) continue;
-					
-					for(int code=0; code<27; code++)
-					{
-						if (code == 1 + 3 + 9) continue;
-						
-						const int d[3] = {-(code%3-1), -((code/3)%3-1), -((code/9)%3-1)};
-						int idx[3] = {node.index[0] + d[0], node.index[1] + d[1], node.index[2] + d[2]};
-						
-						if (!(idx[0]<0 || idx[0]>= n ||
-							  idx[1]<0 || idx[1]>= n ||
-							  idx[2]<0 || idx[2]>= n )) continue;
-						
-						if (vProcessAndPeriodic[0]) idx[0] = (idx[0]+n)%n;
-						if (vProcessAndPeriodic[1]) idx[1] = (idx[1]+n)%n;
-						if (vProcessAndPeriodic[2]) idx[2] = (idx[2]+n)%n;
-						
-						if (idx[0]<0 || idx[0]>= n ||
-							idx[1]<0 || idx[1]>= n ||
-							idx[2]<0 || idx[2]>= n ) continue;
-						ghosts++;
-						GridNode * ghostNode = new GridNode(node.isEmpty, node.parent, node.blockID, node.index[0] - d[0]*n, node.index[1] - d[1]*n, node.index[2] - d[2]*n, node.level);
-						ghostNodes[(GridNode*)&node][code] = ghostNode;
-					}
+					GridNode * neighbor = *it;
 					
-				}
-			}
-			printf("Total Added: %d\n", nAdded);
-			
-		}
-		
-		if (nPeriodicBoundaries>0)
-		{
-			const int nX = bucket.getSize()[0];
-			const int nY = bucket.getSize()[1];
-			const int nZ = bucket.getSize()[2];
-			
-			for(int iz = 0; iz<nZ; iz++)
-				for(int iy = 0; iy<nY; iy++)
-					for(int ix = 0; ix<nX; ix++)
+					if (shiftCode != 1 + 3 + 9)
 					{
-						//current block-list
-						if (iz !=0 && iy !=0 && ix !=0 &&
-							iz!=nZ-1 && iy!=nY-1 && ix!=nX-1)
-							ix = nX-1;
-						
+						GridNode *& ghostNode = ghostNodes[neighbor][shiftCode];
 						
-						assert(iz==nZ-1 || iy==nY-1 || ix==nX-1 || ix == 0 || iy == 0 || iz == 0);
-						
-						for(int i=0; i<27; i++)
+						if (ghostNode == NULL)
 						{
-							const int dx = i%3-1;
-							const int dy = (i/3)%3-1;
-							const int dz = (i/9)%3-1;
-							
-							//if (dz*4 + dy*2 + dx<=0) continue;
-							if (i == 1 + 3 + 9) continue;
-							
-							//const int original_idx[3] = {ix + dx, iy + dy, iz + dz};
-							int idx[3] = {ix + dx, iy + dy, iz + dz};
+							const int m = (1 << neighbor->level);
 							
-							if (m_vProcessingDirections[0] && m_vPeriodicDirection[0]) idx[0] = (idx[0]+nX)%nX;
-							if (m_vProcessingDirections[1] && m_vPeriodicDirection[1]) idx[1] = (idx[1]+nY)%nY;
-							if (m_vProcessingDirections[2] && m_vPeriodicDirection[2]) idx[2] = (idx[2]+nZ)%nZ;
-							
-							if (idx[0]<0 || idx[0]>= nX ||
-								idx[1]<0 || idx[1]>= nY ||
-								idx[2]<0 || idx[2]>= nZ ) continue;
-							
-							vector< const FlattenedBlock* >& v = bucket.Access(idx[0], idx[1], idx[2]);
-							
-							const int nElements = v.size();
-							for(int iElement=0; iElement<nElements; iElement++)
-							{
-								if(ghostNodes[(GridNode*)v[iElement]->target][i] == NULL) continue;
-								
-								
-								GridNode& g = *ghostNodes[(GridNode*)v[iElement]->target][i];
-								
-								const int level_difference = max_level - g.level;
-								//const int level_offset = max_level - reference_level;
-								
-								
-								/*	int sign[3] = {
-								 original_idx[0]-idx[0]<0?-1:1,
-								 original_idx[1]-idx[1]<0?-1:1,
-								 original_idx[2]-idx[2]<0?-1:1 };
-								 
-								 if (original_idx[0]==idx[0])sign[0]=0;
-								 if (original_idx[1]==idx[1])sign[1]=0;
-								 if (original_idx[2]==idx[2])sign[2]=0;
-								 
-								 const int displacement[3] = {
-								 sign[0]*(1<<max_level),
-								 sign[1]*(1<<max_level),
-								 sign[2]*(1<<max_level)
-								 };
-								 
-								 const int s[3] = {
-								 v[iElement]->index[0]+ displacement[0], 
-								 v[iElement]->index[1]+ displacement[1], 
-								 v[iElement]->index[2]+ displacement[2]
-								 };
-								 
-								 const int e[3] = {
-								 s[0] + v[iElement]->size[0], 
-								 s[1] + v[iElement]->size[1], 
-								 s[2] + v[iElement]->size[2]
-								 };*/
-								
-								//const int level_offset = max_level - reference_level;
-								
-								const int finest_start[3] = {
-									m_vProcessingDirections[0] ? ((g.index[0]<<level_difference)) : 0, 
-									m_vProcessingDirections[1] ? ((g.index[1]<<level_difference)) : 0, 
-									m_vProcessingDirections[2] ? ((g.index[2]<<level_difference)) : 0
-								};
-								
-								const int finest_end[3] = {
-									m_vProcessingDirections[0] ? (((g.index[0]+1)<<level_difference)) : 1,
-									m_vProcessingDirections[1] ? (((g.index[1]+1)<<level_difference)) : 1,
-									m_vProcessingDirections[2] ? (((g.index[2]+1)<<level_difference)) : 1
-								};
-								
-								
-								//printf("TOOO FASST\n");
-								//FlattenedBlock * block = new FlattenedBlock(s, e, v[iElement]->target);
-								FlattenedBlock * block = new FlattenedBlock(finest_start, finest_end, ghostNodes[(GridNode*)v[iElement]->target][i]);
-								pool.push_back(block);
-								bucket.Access(ix,iy,iz).push_back(block);
-							}
+							ghostNode = new GridNode(neighbor->isEmpty, neighbor->parent, neighbor->blockID, 
+													 neighbor->index[0] + shift[0]*m, neighbor->index[1] + shift[1]*m, neighbor->index[2] + shift[2]*m, 
+													 neighbor->level);
 						}
 						
+						neighbor = ghostNode;
 					}
-		}
-		
-		//2.
-		{
-			int nComparisons = 0;
-			int nNeighborsConnections = 0;
-			
-			
-			
-			const int nX = bucket.getSize()[0];
-			const int nY = bucket.getSize()[1];
-			const int nZ = bucket.getSize()[2];
-			
-			for(int iz = 0; iz<nZ; iz++)
-				for(int iy = 0; iy<nY; iy++)
-					for(int ix = 0; ix<nX; ix++)
+					
+					if (neighbor != node && std::find(neighbors.begin(), neighbors.end(), neighbor) == neighbors.end())
 					{
-						//current block-list
-						const B & currentlist = bucket.Access(ix,iy,iz);
-						
-						for(int i=0; i<27; i++)
-						{
-							const int dx = i%3-1;
-							const int dy = (i/3)%3-1;
-							const int dz = (i/9)%3-1;
-							
-							if (dz*4 + dy*2 + dx<0) continue;
-							
-							const int idx[3] = {ix + dx, iy + dy, iz + dz};
-							
-							
-							if (idx[0]<0 || idx[0]>= nX ||
-								idx[1]<0 || idx[1]>= nY ||
-								idx[2]<0 || idx[2]>= nZ ) continue;
-							
-							
-							const B & neighbors = bucket.Access(idx[0],idx[1],idx[2]);
-							if (neighbors.size() == 0) continue;
-							
-							const int n1 = currentlist.size();
-							const int n2 = neighbors.size();
-							
-							if (&currentlist != &neighbors)
-								for (int b2=0; b2<n2; b2++)
-									for (int b1=0; b1<n1; b1++)
-										FlattenedBlock::compareAndAdd(*currentlist[b1], *neighbors[b2], neighborhood,nComparisons, nNeighborsConnections);
-							else
-								for (int b2=0; b2<n2; b2++)
-									for (int b1=0; b1<=b2; b1++)
-										FlattenedBlock::compareAndAdd(*currentlist[b1], *currentlist[b2], neighborhood,nComparisons, nNeighborsConnections);
-						}
+						neighbors.push_back(neighbor);
+						nNeighborsConnections++;
 					}
-			
-			printf("Done N=%dx%dx%d Compared:%d Found:%d\n", nX, nY, nZ, nComparisons, nNeighborsConnections);
-		}
-		
-		//3.
-		{
-			for(map< GridNode *, map<int, GridNode *> >::const_iterator itGridNode = ghostNodes.begin(); itGridNode!=ghostNodes.end(); itGridNode++)
-			{
-				const map<int, GridNode *> & currentGhosts = itGridNode->second;
-				for(map<int, GridNode *>::const_iterator itGhostNode = currentGhosts.begin(); itGhostNode!=currentGhosts.end(); itGhostNode++)
-					neighborhood.erase(itGhostNode->second);
-			}
-			
-			for(typename B::iterator e = pool.begin(); e!= pool.end(); e++)
-			{
-				delete *e;
-				*e = NULL;
+				}
 			}
-			
-			delete &bucket;
 		}
+		
+		if (m_bVerbose)
+			printf("Grid::_computeNeighborhood: %d blocks, %d connections\n", (int)neighborhood.size(), nNeighborsConnections);
 	}
 	
 }
@@ -148,25 +148,23 @@ namespace MRAG
 	public:
 		
 		Grid_Hilbert2D(int nBlocksX, int nBlocksY=1, int nBlocksZ=1, BlockCollection<BlockType>* collection = NULL, bool bVerbose=true):
-			Grid<WaveletType, BlockType>(nBlocksX, nBlocksY, nBlocksZ, collection, bVerbose)	{}
+			Grid<WaveletType, BlockType>(nBlocksX, nBlocksY, nBlocksZ, collection, bVerbose)	
+		{
+			//the base constructor could not sort them
+			this->_updateBlocksInfo();
+		}
 		
         Grid_Hilbert2D(int nBlocksX, int nBlocksY, int nBlocksZ, const int maxStencil[2][3], BlockCollection<BlockType>* collection = NULL, bool bVerbose=true):
-		Grid<WaveletType, BlockType>(nBlocksX, nBlocksY, nBlocksZ, maxStencil, collection, bVerbose)	{}
-		
-		vector<BlockInfo> getBlocksInfo() const
-		{			
-			return _sort( Grid<WaveletType, BlockType>::getBlocksInfo() );
+		Grid<WaveletType, BlockType>(nBlocksX, nBlocksY, nBlocksZ, maxStencil, collection, bVerbose)	
+		{
+			this->_updateBlocksInfo();
 		}
 		
-		virtual void _refresh(bool bUpdateLazyData = false)
+	protected:
+		
+		void _sortBlocksInfo(vector<BlockInfo>& vInfo) const
 		{
-			Grid<WaveletType, BlockType>::_refresh(bUpdateLazyData);
-			
-			for(int level=0; level<this->m_blockAtLevel.size(); level++)
-			{
-				vector<BlockInfo> tmp = this->m_blockAtLevel[level];
-				this->m_blockAtLevel[level] = _sort(tmp);
-			}
+			vInfo = _sort(vInfo);
 		}
 	};
 }
@@ -18,6 +18,7 @@ using namespace std;
 #include "../MRAGcore/MRAGBlock.h"
 #include "../MRAGcore/MRAGGridNode.h"
 #include "../MRAGcore/MRAGBlockCollection.h"
+#include "../MRAGcore/MRAGProfiler.h"
 #include "MRAG_IO_BaseClass.h"
 #include "MRAG_IO_Native.h"
 
@@ -50,6 +51,8 @@ namespace MRAG
 			//Calling Base-Class _Write function, but now with a pointer to the binary File.
 			this->_Write( inputGrid, fileName,binaryout);
 			
+			Profiler::countStep("bytes written", ftell(binaryout));
+			
 			const int status=fclose(binaryout);
 			if(status==0)
 				cout << "Sucessfully wrote to binary file " << fileNameBinary << endl;
@@ -77,6 +80,39 @@ namespace MRAG
 			}
 		}
 		
+		
+		// Same as Read, but if the grid has already the topology of the file only the block data is read
+		// and the boundary info of the grid stays valid. Returns true in that case.
+		bool ReadReusingTopology( GridType & inputGrid, string fileName )
+		{
+			string fileNameBinary = fileName+".mrg";
+			FILE* binaryin=fopen(fileNameBinary.c_str(),"r");
+			assert(binaryin!=NULL);
+			
+			const bool bSameTopology = ReadReusingTopology( inputGrid, fileName, binaryin);
+			
+			const int status=fclose(binaryin);
+			if(status!=0)
+			{
+				cout << "Something went wrong reading from binary file " << fileNameBinary << endl;
+				abort();
+			}
+			
+			return bSameTopology;
+		}
+		
+		// Same, with the binary data (fileName.mrg) already opened by the caller, e.g. from memory
+		bool ReadReusingTopology( GridType & inputGrid, string fileName, FILE* binaryin )
+		{
+			assert(binaryin!=NULL);
+			
+			const bool bSameTopology = this->_ReadData( inputGrid, fileName, binaryin);
+			
+			if (!bSameTopology)
+				this->_Read( inputGrid, fileName, binaryin);
+			
+			return bSameTopology;
+		}
 	
 	protected:
 		
@@ -315,5 +315,97 @@ namespace MRAG
 			cout << "Input file " << fileName << " read!" << endl;
 		}	
 		
+		//Reads only the block data if the grid has already the topology stored in the file: the
+		//hierarchy, the neighborhood and the boundary info of the grid are kept. Returns false
+		//(without touching the grid nor the binary file) if the topology differs.
+		bool _ReadData( GridType & inputGrid, string fileName, FILE* binaryInputFile=NULL )
+		{
+			// Open input file
+			fileName += ".txt";
+			ifstream input( fileName.c_str() );
+			
+			if(!input)
+			{
+				printf("FILE NOT FOUND!\n");
+				abort();
+			}
+			
+			// Leaves of the grid, by level and index
+			vector< map<I3, int> > leaves;
+			int nGridLeaves = 0;
+			for(HierarchyType::const_iterator it=inputGrid.m_hierarchy.begin(); it!=inputGrid.m_hierarchy.end(); it++)
+			{
+				const GridNode * node = it->first;
+				if (node == NULL || node->isEmpty) continue;
+				
+				if (node->level >= (int)leaves.size())
+					leaves.resize(node->level+1);
+				
+				leaves[node->level][I3(node->index[0], node->index[1], node->index[2])] = node->blockID;
+				nGridLeaves++;
+			}
+			
+			// Read topology structure, map the counters of the file to the blocks of the grid
+			int numberOfNodes = 0;
+			int rootPosition = 0;
+			int nodeID = 0, level = 0, blockID = 0, parentID = 0, childrenNum = 0;
+			bool isEmpty = 0;
+			int index[3] = {0,0,0};
+			int nLeaves = 0;
+			map<int, int> mapCounterToBlockID;
+			
+			input >> numberOfNodes;
+			input >> rootPosition;
+			
+			for( unsigned int i = 0; i < numberOfNodes; i++ )
+			{
+				input >> nodeID;
+				input >> level;
+				input >> isEmpty;
+				input >> blockID;
+				input >> parentID;
+				input >> index[0];
+				input >> index[1];
+				input >> index[2];
+				input >> childrenNum;
+				
+				for( unsigned int j = 0; j < childrenNum; j++ )
+				{
+					unsigned int value = 0;
+					input >> value;
+				}
+				
+				if (nodeID == rootPosition || isEmpty) continue;
+				
+				nLeaves++;
+				
+				if (level >= (int)leaves.size()) return false;
+				
+				map<I3, int>::const_iterator itLeaf = leaves[level].find(I3(index[0], index[1], index[2]));
+				if (itLeaf == leaves[level].end()) return false;
+				
+				mapCounterToBlockID[blockID] = itLeaf->second;
+			}
+			
+			if (nLeaves != nGridLeaves) return false;
+			
+			// Read block data
+			for(int i=0; i<nLeaves; i++)
+			{
+				input >> blockID;
+				
+				TBlock& block = inputGrid.getBlockCollection().lock(mapCounterToBlockID[blockID]);
+				
+				_ReadBlock(block,input,binaryInputFile);
+				
+				inputGrid.getBlockCollection().release(mapCounterToBlockID[blockID]);
+			}
+			
+			input.close();
+			cout << "Input file " << fileName << " read (same topology)!" << endl;
+			
+			return true;
+		}
+		
 	};
 }
@@ -0,0 +1,217 @@
+/*
+ *  MRAGBlockCostModel.h
+ *  MRAG
+ *
+ *	Cost of processing the blocks with a given kernel, kept across the steps
+ *	and used to split the blocks in chunks of about equal work.
+ *	The costs are smoothed over the measurements and kept in an array indexed by
+ *	blockID: the IDs of a block type are never reused, so the entries of erased
+ *	blocks are simply never looked up again. A block never measured is estimated
+ *	from a prior (e.g. cells and ghosts) scaled to the measured blocks.
+ *	One model per collection and kernel (see BlockCollection::getCostModel()).
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "tbb/spin_mutex.h"
+
+#include "MRAGcore/MRAGCommon.h"
+
+using namespace std;
+
+namespace MRAG
+{
+	namespace Multithreading
+	{
+		class BlockCostModel
+		{
+			//smoothed cost of the block firstID + i, negative if never measured
+			vector<float> m_costs;
+			int m_firstID;
+			int m_nCalls;
+			
+			//the same kernel may run on the same collection from two threads
+			mutable tbb::spin_mutex m_mutex;
+			
+			//the array covers the blockIDs of vInfo; the part below the smallest of them
+			//is dropped once it is more than half of the array
+			void _cover(const vector<BlockInfo>& vInfo)
+			{
+				const int n = vInfo.size();
+				if (n == 0) return;
+				
+				int minID = vInfo[0].blockID, maxID = vInfo[0].blockID;
+				for(int i=1; i<n; i++)
+				{
+					minID = vInfo[i].blockID < minID ? vInfo[i].blockID : minID;
+					maxID = vInfo[i].blockID > maxID ? vInfo[i].blockID : maxID;
+				}
+				
+				if (m_costs.empty())
+					m_firstID = minID;
+				else if (minID < m_firstID)
+				{
+					m_costs.insert(m_costs.begin(), m_firstID - minID, -1.f);
+					m_firstID = minID;
+				}
+				else if (2*(minID - m_firstID) > (int)m_costs.size())
+				{
+					const int nDropped = minID - m_firstID;
+					
+					if (nDropped < (int)m_costs.size())
+						m_costs.erase(m_costs.begin(), m_costs.begin() + nDropped);
+					else
+						m_costs.clear();
+					
+					m_firstID = minID;
+				}
+				
+				if (maxID - m_firstID >= (int)m_costs.size())
+					m_costs.resize(maxID - m_firstID + 1, -1.f);
+			}
+			
+			float _cost(const int blockID) const
+			{
+				const int i = blockID - m_firstID;
+				
+				return (i >= 0 && i < (int)m_costs.size()) ? m_costs[i] : -1.f;
+			}
+			
+		public:
+
+			/** Weight of the last measurement in the smoothed cost. */
+			static float smoothing() { return 0.5f; }
+			
+			/** One block out of sampling() is timed at every call. */
+			static int sampling() { return 4; }
+
+			BlockCostModel(): m_costs(), m_firstID(0), m_nCalls(0), m_mutex() {}
+			
+			/** Forgets all the costs. */
+			void reset()
+			{
+				tbb::spin_mutex::scoped_lock lock(m_mutex);
+				
+				m_costs.clear();
+				m_firstID = 0;
+			}
+			
+			/**
+			 * Blocks to time in the next call: the i-th block of the call is timed if i % sampling() == phase.
+			 * The phase changes at every call, so that all the blocks get measured within sampling() calls.
+			 */
+			int nextPhase()
+			{
+				tbb::spin_mutex::scoped_lock lock(m_mutex);
+				
+				return m_nCalls++ % sampling();
+			}
+			
+			/**
+			 * Costs of the blocks of vInfo: measured where available, otherwise the prior of the block
+			 * times the average ratio cost/prior of the measured blocks (the prior alone if none is measured).
+			 */
+			void estimate(const vector<BlockInfo>& vInfo, const vector<double>& prior, vector<double>& cost) const
+			{
+				assert(prior.size() == vInfo.size());
+				
+				tbb::spin_mutex::scoped_lock lock(m_mutex);
+				
+				const int n = vInfo.size();
+				cost.resize(n);
+				
+				double measured = 0, measuredPrior = 0;
+				
+				for(int i=0; i<n; i++)
+				{
+					cost[i] = _cost(vInfo[i].blockID);
+					
+					if (cost[i] >= 0)
+					{
+						measured += cost[i];
+						measuredPrior += prior[i];
+					}
+				}
+				
+				const double scale = (measured > 0 && measuredPrior > 0) ? measured/measuredPrior : 1;
+				
+				for(int i=0; i<n; i++)
+					if (cost[i] < 0)
+						cost[i] = prior[i]*scale;
+			}
+			
+			/**
+			 * Adds the measurements of a call: seconds[i] for the block vInfo[i], negative if not measured.
+			 * The measurements are taken into per-call arrays, the model being updated once they are complete.
+			 */
+			void update(const vector<BlockInfo>& vInfo, const vector<float>& seconds)
+			{
+				assert(seconds.size() == vInfo.size());
+				
+				tbb::spin_mutex::scoped_lock lock(m_mutex);
+				
+				_cover(vInfo);
+				
+				const int n = vInfo.size();
+				
+				for(int i=0; i<n; i++)
+				{
+					if (seconds[i] < 0) continue;
+					
+					float& c = m_costs[vInfo[i].blockID - m_firstID];
+					
+					c = c < 0 ? seconds[i] : c + smoothing()*(seconds[i] - c);
+				}
+			}
+			
+			/**
+			 * Splits the blocks in shares.size() contiguous parts, part p getting a fraction shares[p]/sum(shares)
+			 * of the total cost. Part p holds the blocks [start[p], start[p+1]).
+			 */
+			static void split(const vector<double>& cost, const vector<double>& shares, vector<int>& start)
+			{
+				const int n = cost.size();
+				const int nParts = shares.size();
+
+				double total = 0, totalShares = 0;
+
+				for(int i=0; i<n; i++)
+					total += cost[i];
+
+				for(int p=0; p<nParts; p++)
+					totalShares += shares[p];
+
+				assert(totalShares > 0);
+
+				start.resize(nParts+1);
+				start[0] = 0;
+
+				int i = 0;
+				double sum = 0, target = 0;
+
+				for(int p=0; p<nParts-1; p++)
+				{
+					target += total*shares[p]/totalShares;
+
+					//take the block straddling the target if more than half of it falls before
+					while(i < n && sum + 0.5*cost[i] <= target)
+						sum += cost[i++];
+
+					start[p+1] = i;
+				}
+
+				start[nParts] = n;
+			}
+			
+		private:
+			//forbidden
+			BlockCostModel(const BlockCostModel&): m_costs(), m_firstID(0), m_nCalls(0), m_mutex() {abort();}
+			
+			BlockCostModel& operator=(const BlockCostModel&){abort(); return *this;}
+		};
+	}
+}
@@ -162,11 +162,11 @@ namespace MRAG
 		class BlockProcessingMT_Simple
 		{
 			ProcessingMT& processing;
-			vector<BlockInfo>& vInfo;
+			const vector<BlockInfo>& vInfo;
 			BlockType ** ptrBlocks;
 			
 		public:
-			BlockProcessingMT_Simple(vector<BlockInfo>& vInfo_, ProcessingMT& processing_, BlockType ** ptrs):
+			BlockProcessingMT_Simple(const vector<BlockInfo>& vInfo_, ProcessingMT& processing_, BlockType ** ptrs):
 			processing(processing_), vInfo(vInfo_), ptrBlocks(ptrs) {}
 			
 			template <typename BlockedRange>
@@ -200,14 +200,14 @@ namespace MRAG
 		template <typename BlockType, template <typename BB> class Lab, typename Collection, typename ProcessingMT>
 		class BlockProcessingMT
 		{
-			vector<BlockInfo>& vInfo;
+			const vector<BlockInfo>& vInfo;
 			Collection& collection;
 			BoundaryInfo& boundaryInfo;
 			ProcessingMT& processing;
 			BlockType ** ptrBlocks;
 			
 		public:
-			BlockProcessingMT(vector<BlockInfo>& vInfo_, Collection& collection_, 
+			BlockProcessingMT(const vector<BlockInfo>& vInfo_, Collection& collection_, 
 							  BoundaryInfo& boundaryInfo_, ProcessingMT& processing_, BlockType ** ptrs):
 			vInfo(vInfo_), collection(collection_), boundaryInfo(boundaryInfo_), processing(processing_), ptrBlocks(ptrs){}
 			
@@ -248,21 +248,24 @@ namespace MRAG
 		class BlockProcessing_SingleCPU
 		{
 			template<typename Collection>
-			static BlockType** createBlockPointers(vector<BlockInfo>& vInfo, Collection& collection)
+			static BlockType** createBlockPointers(const vector<BlockInfo>& vInfo, Collection& collection)
 			{
 				BlockType** result = new BlockType*[vInfo.size()];
 				
+				const bool bResolved = vInfo.size() > 0 && collection.isResolved(&vInfo.front(), vInfo.size());
+				
 				for(int i=0; i<vInfo.size(); i++)
-					result[i] = &collection.lock(vInfo[i].blockID);
+					result[i] = bResolved ? (BlockType *)vInfo[i].ptrBlock : &collection.lock(vInfo[i].blockID);
 				
 				return result;
 			}
 			
 			template<typename Collection>
-			static void destroyBlockPointers(BlockType**& ptrs, vector<BlockInfo>& vInfo , Collection& collection)
+			static void destroyBlockPointers(BlockType**& ptrs, const vector<BlockInfo>& vInfo , Collection& collection)
 			{
-				for(int i=0; i<vInfo.size(); i++)
-					collection.release(vInfo[i].blockID);
+				if (!(vInfo.size() > 0 && collection.isResolved(&vInfo.front(), vInfo.size())))
+					for(int i=0; i<vInfo.size(); i++)
+						collection.release(vInfo[i].blockID);
 				
 				delete [] ptrs;
 				ptrs = NULL;
@@ -281,7 +284,7 @@ namespace MRAG
              * @param dummy         Optional and never used (just to match signature of tbb-versions).
              */
 			template <typename Processing, typename Collection>
-			static void process(vector<BlockInfo>& vInfo, Collection& c, Processing& p, int dummy = -1)
+			static void process(const vector<BlockInfo>& vInfo, Collection& c, Processing& p, int dummy = -1)
 			{
 				BlockType** ptrs =  createBlockPointers(vInfo, c);
 				
@@ -303,7 +306,7 @@ namespace MRAG
              * @param dummy         Optional and never used (just to match signature of tbb-versions).
              */
 			template <template <typename Btype> class Lab, typename Processing, typename Collection>
-			static void process(vector<BlockInfo>& vInfo, Collection& c, BoundaryInfo& b, Processing& p, int dummy = -1)
+			static void process(const vector<BlockInfo>& vInfo, Collection& c, BoundaryInfo& b, Processing& p, int dummy = -1)
 			{
 				BlockType** ptrs =  createBlockPointers(vInfo, c);
 				
@@ -318,7 +321,7 @@ namespace MRAG
              * @see BlockProcessing_SingleCPU::process()
              */
 			template <typename Processing, typename Collection>
-			void pipeline_process(vector<BlockInfo>& vInfo, Collection& c, BoundaryInfo& b, Processing& p)
+			void pipeline_process(const vector<BlockInfo>& vInfo, Collection& c, BoundaryInfo& b, Processing& p)
 			{
 				process<BlockLab>(vInfo, c, b, p);
 			}
@@ -15,11 +15,20 @@
 #include "tbb/parallel_for.h"
 #include "tbb/pipeline.h"
 #include "tbb/concurrent_queue.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/cache_aligned_allocator.h"
+#include "tbb/tick_count.h"
+#include "tbb/atomic.h"
 
 #include "MRAGcore/MRAGEnvironment.h"
+#include "MRAGcore/MRAGProfiler.h"
+#include "MRAGcore/MRAGNUMA.h"
+#include "MRAGcore/MRAGMemoryPool.h"
 #pragma once
 #ifdef _MRAG_TBB
 #include "MRAGBlockProcessing_SingleCPU.h"
+#include "MRAGBlockCostModel.h"
+#include "MRAGBlockReduction_TBB.h"
 #undef max
 
 using namespace std;
@@ -30,77 +39,274 @@ namespace MRAG
 {
 	namespace Multithreading
 	{
+        /**
+         * The labs of type LabType, one per thread, kept by the collection across the calls and the regriddings
+         * (see BlockCollection::getProcessingCache()): they are destroyed with it.
+         * A lab is prepared again only when it is used with another boundary info or stencil.
+         */
+		template <typename LabType, typename Collection>
+		class LabPool: public Collection::ProcessingCache
+		{
+			typedef _MRAG_BLOCKLAB_ALLOCATOR<LabType> lab_allocator;
+			
+		public:
+			
+			struct Slot
+			{
+				LabType * lab;
+				bool bBusy, bTemporary;
+				
+				//what the lab was prepared for
+				const BoundaryInfo * boundaryInfo;
+				int stencil[4][3];
+				
+				Slot(const bool bTemporary_ = false): lab(NULL), bBusy(false), bTemporary(bTemporary_), boundaryInfo(NULL) {}
+				
+				//a copy gets its own lab
+				Slot(const Slot&): lab(NULL), bBusy(false), bTemporary(false), boundaryInfo(NULL) {}
+				
+				~Slot() { _destroy(lab); }
+				
+			private:
+				//forbidden
+				Slot& operator=(const Slot&){abort(); return *this;}
+			};
+			
+		private:
+			
+			enumerable_thread_specific<Slot> m_slots;
+			
+			static LabType * _create() { return new((void*)lab_allocator().allocate(1)) LabType(); }
+			
+			static void _destroy(LabType * lab)
+			{
+				if (lab == NULL) return;
+				
+				lab->~LabType();
+				lab_allocator().deallocate(lab, 1);
+			}
+			
+			template <typename Processing>
+			static bool _isPrepared(const Slot& slot, const BoundaryInfo& b, const Processing& p)
+			{
+				if (slot.boundaryInfo != &b) return false;
+				
+				for(int i=0; i<3; i++)
+					if (slot.stencil[0][i] != b.stencil_start[i] || slot.stencil[1][i] != b.stencil_end[i] ||
+						slot.stencil[2][i] != p.stencil_start[i] || slot.stencil[3][i] != p.stencil_end[i]) return false;
+				
+				return true;
+			}
+			
+			//forbidden
+			LabPool(const LabPool&): m_slots() {abort();}
+			LabPool& operator=(const LabPool&){abort(); return *this;}
+			
+		public:
+			
+			LabPool(): m_slots() {}
+			
+			/** The pool of the collection c, created at the first use. */
+			static LabPool& of(const Collection& c) { return c.template getProcessingCache<LabPool>(); }
+			
+			/**
+			 * The slot of the calling thread, its lab prepared for the collection, b and the stencil of p.
+			 * Must be given back with release(). If the lab of the thread is still in use (e.g. the thread
+			 * picked up another chunk while waiting in a nested parallel loop) a temporary slot is returned.
+			 */
+			template <typename Processing>
+			Slot& acquire(const Collection& c, const BoundaryInfo& b, const Processing& p)
+			{
+				Slot& local = m_slots.local();
+				Slot& slot = local.bBusy ? *new Slot(true) : local;
+				
+				slot.bBusy = true;
+				
+				if (slot.lab == NULL)
+					slot.lab = _create();
+				
+				if (!_isPrepared(slot, b, p))
+				{
+					// stencil_start and stencil_end required for Processing
+					slot.lab->prepare(c, b, p.stencil_start, p.stencil_end);
+					
+					slot.boundaryInfo = &b;
+					
+					for(int i=0; i<3; i++)
+					{
+						slot.stencil[0][i] = b.stencil_start[i];
+						slot.stencil[1][i] = b.stencil_end[i];
+						slot.stencil[2][i] = p.stencil_start[i];
+						slot.stencil[3][i] = p.stencil_end[i];
+					}
+				}
+				
+				return slot;
+			}
+			
+			void release(Slot& slot)
+			{
+				assert(slot.bBusy);
+				
+				if (slot.bTemporary)
+				{
+					delete &slot;
+					return;
+				}
+				
+				slot.bBusy = false;
+			}
+		}; /* LabPool */
+		
         /**
          * Functor to actually perform the operations on the blocks.
          * See MRAG::Multithreading::DummyBlockFunctor for a sample ProcessingMT type.
          */
-		template <typename BlockType, template <typename BB> class Lab, typename Collection, typename ProcessingMT, int nSlots>
+		template <typename BlockType, template <typename BB> class Lab, typename Collection, typename ProcessingMT>
 		class BlockProcessingMT_TBB
 		{
+			typedef LabPool<Lab<BlockType>, Collection> Pool;
+			
 			Collection& collection;
 			BoundaryInfo& boundaryInfo;
 			ProcessingMT& processing;
+			Pool& labs;
 		
 			const BlockInfo * ptrInfos;
 			
-			concurrent_bounded_queue<Lab<BlockType> *>& m_availableLabs;
+			float * m_costs;
+			int m_nSampling, m_phase;
 			
 		public:
-			BlockProcessingMT_TBB(concurrent_bounded_queue<Lab<BlockType> *>& availableLabs, const BlockInfo * ptrInfos_, Collection& collection_, 
-							  BoundaryInfo& boundaryInfo_, ProcessingMT& processing_):
+			BlockProcessingMT_TBB(const BlockInfo * ptrInfos_, Collection& collection_, BoundaryInfo& boundaryInfo_, ProcessingMT& processing_):
 				collection(collection_), boundaryInfo(boundaryInfo_), 
-				processing(processing_), 
+				processing(processing_), labs(Pool::of(collection_)),
 				ptrInfos(ptrInfos_), 
-				m_availableLabs(availableLabs)
+				m_costs(NULL), m_nSampling(1), m_phase(0)
 			{
-				for(int i=0; i<nSlots; i++)
-				{
-					Lab<BlockType> * lab = NULL;
-					availableLabs.pop(lab);
-					assert(lab!=NULL);
-					
-                    // stencil_start and stencil_end required for ProcessingMT
-					lab->prepare(collection_, boundaryInfo_, processing_.stencil_start, processing_.stencil_end);
-					
-					availableLabs.push(lab);
-				}
 			}
 		
 			template <typename BlockedRange>
 			void operator()(const BlockedRange& r) const
 			{
-				Lab<BlockType>* lab = NULL;
-				m_availableLabs.pop(lab);
-				assert(lab != NULL);
+				typename Pool::Slot& slot = labs.acquire(collection, boundaryInfo, processing);
+				Lab<BlockType>& lab = *slot.lab;
 				
 				const int nBlocks = r.end() - r.begin();
 				const BlockInfo* v = ptrInfos + r.begin();
 				
-				lab->inspect(processing);
+				lab.inspect(processing);
 				
 				for(int iB=0; iB<nBlocks; iB++)
 				{
 					const BlockInfo& info = v[iB];
 					BlockType& block = *(BlockType*)info.ptrBlock;
 					
-					lab->load(info);
+					const bool bTimed = m_costs != NULL && (r.begin() + iB) % m_nSampling == m_phase;
+					const tick_count tStart = bTimed ? tick_count::now() : tick_count();
+					
+					lab.load(info);
                     
 					// operator()(LabType&, const BlockInfo&, BlockType&) required for ProcessingMT
-					processing(*lab, info, block);
+					processing(lab, info, block);
+					
+					if (bTimed)
+						m_costs[r.begin() + iB] = (tick_count::now() - tStart).seconds();
 				}
 				
-				m_availableLabs.push(lab);	
+				labs.release(slot);
+				
+				Profiler::countStep("lab loads", nBlocks);
 			}	
 			
 			BlockProcessingMT_TBB(const BlockProcessingMT_TBB& p):
-			collection(p.collection), boundaryInfo(p.boundaryInfo), processing(p.processing), 
-			ptrInfos(p.ptrInfos), m_availableLabs(p.m_availableLabs){}
+			collection(p.collection), boundaryInfo(p.boundaryInfo), processing(p.processing), labs(p.labs),
+			ptrInfos(p.ptrInfos), m_costs(p.m_costs), m_nSampling(p.m_nSampling), m_phase(p.m_phase){}
+			
+			/**
+			 * Times the blocks i with i % nSampling == phase (lab load and processing) into costs,
+			 * indexed as the infos. The others are left untouched.
+			 */
+			void setCosts(float * costs, const int nSampling = 1, const int phase = 0) 
+			{
+				assert(nSampling > 0 && phase >= 0 && phase < nSampling);
+				
+				m_costs = costs;
+				m_nSampling = nSampling;
+				m_phase = phase;
+			}
 		
 		private:
 			//forbidden
 			BlockProcessingMT_TBB& operator=(const BlockProcessingMT_TBB& p){abort(); return *this;}
 		}; /* BlockProcessingMT_TBB */
 		
+        /**
+         * Runs a block functor over chunks of blocks: chunk k holds the blocks [starts[k], starts[k+1]).
+         */
+		template <typename Body>
+		class BlockProcessingMT_Chunks_TBB
+		{
+			const Body& body;
+			const int * starts;
+			
+		public:
+			
+			BlockProcessingMT_Chunks_TBB(const Body& body_, const int * starts_): body(body_), starts(starts_) {}
+			
+			BlockProcessingMT_Chunks_TBB(const BlockProcessingMT_Chunks_TBB& p): body(p.body), starts(p.starts) {}
+			
+			void operator()(const blocked_range<int>& r) const
+			{
+				for(int k=r.begin(); k<r.end(); k++)
+					if (starts[k] < starts[k+1])
+						body(blocked_range<size_t>(starts[k], starts[k+1]));
+			}
+		}; /* BlockProcessingMT_Chunks_TBB */
+		
+        /**
+         * As BlockProcessingMT_Chunks_TBB, the chunks being homed on the NUMA nodes (see NUMATopology):
+         * every iteration claims one chunk, of the node of the thread if any is left, of the next nodes otherwise.
+         */
+		template <typename Body>
+		class BlockProcessingMT_LocalChunks_TBB
+		{
+			const Body& body;
+			const int * starts;
+			const vector< vector<int> >& chunksOfNode;
+			tbb::atomic<int> * claimed;
+			
+		public:
+			
+			BlockProcessingMT_LocalChunks_TBB(const Body& body_, const int * starts_, const vector< vector<int> >& chunksOfNode_, tbb::atomic<int> * claimed_):
+			body(body_), starts(starts_), chunksOfNode(chunksOfNode_), claimed(claimed_) {}
+			
+			BlockProcessingMT_LocalChunks_TBB(const BlockProcessingMT_LocalChunks_TBB& p): 
+			body(p.body), starts(p.starts), chunksOfNode(p.chunksOfNode), claimed(p.claimed) {}
+			
+			void operator()(const blocked_range<int>& r) const
+			{
+				const int nNodes = chunksOfNode.size();
+				const int home = NUMATopology::getCurrentNode();
+				
+				for(int iteration=r.begin(); iteration<r.end(); iteration++)
+					for(int n=0; n<nNodes; n++)
+					{
+						const int node = (home + n) % nNodes;
+						const int i = claimed[node].fetch_and_increment();
+						
+						if (i >= chunksOfNode[node].size()) continue;
+						
+						const int k = chunksOfNode[node][i];
+						
+						if (starts[k] < starts[k+1])
+							body(blocked_range<size_t>(starts[k], starts[k+1]));
+						
+						break;
+					}
+			}
+		}; /* BlockProcessingMT_LocalChunks_TBB */
+		
         /**
          * Functor to actually perform the operations on the blocks.
          * See MRAG::Multithreading::DummySimpleBlockFunctor for a sample ProcessingMT type.
@@ -148,58 +354,28 @@ namespace MRAG
 		template <typename BlockType>
 		class BlockProcessing_TBB
 		{
-			static map<string, vector<void *> > s_cachedResources;
 			static BlockInfo * s_ptrInfos;
 			static int s_nBlocks;
 	
 		protected:
-			template <typename Lab>
-			static void _getResources(concurrent_bounded_queue<Lab*>& resources, const int nSlots)
+			static int _createKernelID()
 			{
-				//0. checks
-				//1. find if the resources are already in the cache
-				//2. if not allocate them, store in the cache
-				//3. fill the queue
-				
-				//0.
-				//assert(resources.size() == 0);
-				assert(resources.empty());
-				
-				//1.
-				string key = typeid(Lab).name();
-				map<string, vector<void *> >::const_iterator it = s_cachedResources.find(key);
-				const bool bCacheMiss = (it == s_cachedResources.end());
+				static tbb::atomic<int> scounterKernels;
 				
-				if (bCacheMiss)
-				{
-					//2.
-					typedef cache_aligned_allocator<Lab> lab_allocator;
-					
-					vector<void*>& new_resources = s_cachedResources[key];
-					new_resources.reserve(nSlots);
-					
-					for(int i=0; i<nSlots; i++)
-					{
-						Lab* t = lab_allocator().allocate(1);
-						Lab* lab = new((void*)(t)) Lab();
-						
-						//3.
-						new_resources.push_back(lab);
-						resources.push(lab);
-					}
-				}
-				else //3.
-					for(vector<void *>::const_iterator itElem = it->second.begin(); itElem!=it->second.end(); itElem++)
-						resources.push((Lab*)*itElem);
+				return scounterKernels.fetch_and_increment();
 			}
 			
 			template<typename Collection>
-			static const BlockInfo * _prepareBlockInfos(vector<BlockInfo>& vInfo, Collection& collection)
+			static const BlockInfo * _prepareBlockInfos(const vector<BlockInfo>& vInfo, Collection& collection)
 			{
 				typedef cache_aligned_allocator<BlockInfo> info_allocator;
 				
 				const int nCurrBlocks = vInfo.size();
 				
+				//the arrays kept by the grid have their block pointers already
+				if (nCurrBlocks > 0 && collection.isResolved(&vInfo.front(), nCurrBlocks))
+					return &vInfo.front();
+				
 				if (s_nBlocks < nCurrBlocks)
 				{
 					if (s_ptrInfos != NULL)
@@ -220,13 +396,90 @@ namespace MRAG
 				return s_ptrInfos; 
 			}
 			
+			/**
+			 * Cost of a block never measured: its cells plus its ghosts.
+			 */
+			static void _getPriors(const vector<BlockInfo>& vInfo, BoundaryInfo& b, vector<double>& prior)
+			{
+				const int n = vInfo.size();
+				const double cells = BlockType::sizeX*BlockType::sizeY*BlockType::sizeZ;
+				
+				prior.resize(n);
+				
+				for(int i=0; i<n; i++)
+				{
+					map<int, BoundaryInfoBlock*>::const_iterator it = b.boundaryInfoOfBlock.find(vInfo[i].blockID);
+					
+					double ghosts = 0;
+					if (it != b.boundaryInfoOfBlock.end())
+						for(int f=0; f<27; f++)
+							ghosts += it->second->boundary[f].nGhosts;
+					
+					prior[i] = cells + ghosts;
+				}
+			}
+			
 			template<typename Collection>
-			static void _releaseBlockPointers(vector<BlockInfo>& vInfo , Collection& collection)
+			static void _releaseBlockPointers(const vector<BlockInfo>& vInfo , Collection& collection)
 			{
+				if (vInfo.size() > 0 && collection.isResolved(&vInfo.front(), vInfo.size()))
+					return;
+				
 				for(vector<BlockInfo>::const_iterator it = vInfo.begin(); it != vInfo.end(); it++)
 					collection.release(it->blockID);
 			}
 			
+			/**
+			 * Splits n blocks in chunks of nGranularity blocks, the last one possibly smaller.
+			 */
+			static void _getEvenChunks(const int n, const int nGranularity, vector<int>& starts)
+			{
+				assert(nGranularity > 0);
+				
+				starts.clear();
+				
+				for(int s=0; s<n; s+=nGranularity)
+					starts.push_back(s);
+				
+				starts.push_back(n);
+			}
+			
+			/**
+			 * Runs body over the chunks of blocks [starts[k], starts[k+1]) of vInfo. With NUMA (see NUMATopology)
+			 * a chunk is homed on the node of its first block and claimed first by the threads of that node.
+			 */
+			template <typename Body, typename Collection>
+			static void _processChunks(const vector<BlockInfo>& vInfo, Collection& c, const Body& body, vector<int>& starts)
+			{
+				const int nChunks = (int)starts.size() - 1;
+				
+				if (nChunks <= 0) return;
+				
+				if (NUMATopology::isEnabled())
+				{
+					vector< vector<int> > chunksOfNode(NUMATopology::getNodes());
+					
+					for(int k=0; k<nChunks; k++)
+					{
+						const int node = starts[k] < starts[k+1] ? c.getNode(vInfo[starts[k]].blockID) : -1;
+						
+						chunksOfNode[max(0, node)].push_back(k);
+					}
+					
+					vector< tbb::atomic<int> > claimed(chunksOfNode.size());
+					for(int n=0; n<claimed.size(); n++)
+						claimed[n] = 0;
+					
+					BlockProcessingMT_LocalChunks_TBB<Body> chunks(body, &starts.front(), chunksOfNode, &claimed.front());
+					parallel_for(blocked_range<int>(0, nChunks, 1), chunks, simple_partitioner());
+				}
+				else
+				{
+					BlockProcessingMT_Chunks_TBB<Body> chunks(body, &starts.front());
+					parallel_for(blocked_range<int>(0, nChunks, 1), chunks, simple_partitioner());
+				}
+			}
+			
 		public:
 			BlockProcessing_TBB()
 			{
@@ -236,6 +489,18 @@ namespace MRAG
 			{
 			}
 			
+			/**
+			 * Index of the kernel Processing among the kernels processed with a lab, resolved at compile time:
+			 * the measured costs of its blocks are kept by the collection, see BlockCollection::getCostModel().
+			 */
+			template <typename Processing>
+			static int getKernelID()
+			{
+				static const int kernelID = _createKernelID();
+				
+				return kernelID;
+			}
+			
             /**
              * Process blocks in parallel using parallel_for (see tbb-doc) to split up the work.
              * @param vInfo         Info of all the blocks (to be processed) in the grid
@@ -248,7 +513,7 @@ namespace MRAG
              *                      Optional: if not set, auto_partitioner (see tbb-doc) will be used.
              */
 			template <typename Processing, typename Collection>
-			static void process(vector<BlockInfo>& vInfo, Collection& c, Processing& p, 
+			static void process(const vector<BlockInfo>& vInfo, Collection& c, Processing& p, 
 								int nGranularity = -1)
 			{								
 				const bool bAutomatic = nGranularity<0;
@@ -257,7 +522,18 @@ namespace MRAG
 				
 				BlockProcessingMT_Simple_TBB<BlockType,Processing> body(infos, p);
 				
-				if (bAutomatic)
+				if (NUMATopology::isEnabled())
+				{
+					//node-homed chunks: a few per thread if automatic
+					const int nSlots = (int)(_MRAG_TBB_NTHREADS_HINT);
+					const int n = vInfo.size();
+					const int nChunks = max(1, min(n, 4*nSlots));
+					
+					vector<int> starts;
+					_getEvenChunks(n, bAutomatic ? max(1, (n + nChunks - 1)/nChunks) : nGranularity, starts);
+					_processChunks(vInfo, c, body, starts);
+				}
+				else if (bAutomatic)
 					parallel_for(blocked_range<size_t>(0,vInfo.size()), body,  auto_partitioner());
 				else
 					parallel_for(blocked_range<size_t>(0,vInfo.size(), nGranularity), body);
@@ -275,24 +551,50 @@ namespace MRAG
              * @param p             Functor processing the block.
              *                      See MRAG::Multithreading::DummyBlockFunctor for details.
              * @param nGranularity  Granularity for the parallel_for (see tbb-doc).
-             *                      Optional: if not set, auto_partitioner (see tbb-doc) will be used.
+             *                      Optional: if not set, the blocks are split in chunks of equal cost
+             *                      according to the costs measured in the previous calls with Processing on c.
              */
 			template <template <typename Btype> class Lab, typename Processing, typename Collection>
-			static void process(vector<BlockInfo>& vInfo, Collection& c, BoundaryInfo& b, Processing& p, 
+			static void process(const vector<BlockInfo>& vInfo, Collection& c, BoundaryInfo& b, Processing& p, 
 								int nGranularity = -1)
 			{
 				const int nSlots= (int)(_MRAG_TBB_NTHREADS_HINT);
 				
-				concurrent_bounded_queue<Lab<BlockType> *> resources;
-				_getResources(resources, nSlots);
-				
 				const BlockInfo* infos = _prepareBlockInfos(vInfo, c);
 				
-				BlockProcessingMT_TBB<BlockType, Lab, Collection, Processing, nSlots> body(resources, infos, c, b, p) ;
+				BlockProcessingMT_TBB<BlockType, Lab, Collection, Processing> body(infos, c, b, p) ;
 				
 				const bool bAutomatic = nGranularity<0;
 				if (bAutomatic)
-					parallel_for(blocked_range<size_t>(0,vInfo.size()), body,  auto_partitioner());
+				{
+					BlockCostModel& costModel = c.getCostModel(getKernelID<Processing>());
+					
+					vector<double> prior, cost;
+					_getPriors(vInfo, b, prior);
+					
+					costModel.estimate(vInfo, prior, cost);
+					
+					//a few chunks per thread, so that the stealing can absorb the errors of the model
+					const int nChunks = max(1, min((int)vInfo.size(), 4*nSlots));
+					vector<int> starts;
+					BlockCostModel::split(cost, vector<double>(nChunks, 1.), starts);
+					
+					//a sample of the blocks is measured into an array of this call, the model is updated once all the blocks are done
+					vector<float> seconds(vInfo.size(), -1.f);
+					
+					if (!seconds.empty())
+						body.setCosts(&seconds.front(), BlockCostModel::sampling(), costModel.nextPhase());
+					
+					_processChunks(vInfo, c, body, starts);
+					
+					costModel.update(vInfo, seconds);
+				}
+				else if (NUMATopology::isEnabled())
+				{
+					vector<int> starts;
+					_getEvenChunks(vInfo.size(), nGranularity, starts);
+					_processChunks(vInfo, c, body, starts);
+				}
 				else
 					parallel_for(blocked_range<size_t>(0,vInfo.size(), nGranularity), body);
 				
@@ -300,9 +602,6 @@ namespace MRAG
 			}
 		}; /* BlockProcessing_TBB */
 		
-		template <typename BlockType>
-		map<string, vector<void *> > BlockProcessing_TBB<BlockType>::s_cachedResources;
-
 		template <typename BlockType>
 		BlockInfo * BlockProcessing_TBB<BlockType>::s_ptrInfos = NULL;
 		
@@ -447,7 +746,7 @@ namespace MRAG
              * @see BlockProcessing_TBB::process()
              */
 			template <typename Processing, typename Collection>
-			static void process(vector<BlockInfo>& vInfo, Collection& c, BoundaryInfo& b, Processing& p, int nGranularity = -1)
+			static void process(const vector<BlockInfo>& vInfo, Collection& c, BoundaryInfo& b, Processing& p, int nGranularity = -1)
 			{
 				BlockProcessing_TBB<BlockType>::template process<LabType>(vInfo, c, b, p, nGranularity);
 			}
@@ -457,7 +756,7 @@ namespace MRAG
              * @see BlockProcessing_TBB::process()
              */
 			template <typename Processing, typename Collection>
-			static void process(vector<BlockInfo>& vInfo, Collection& c, Processing& p, int nGranularity = -1)
+			static void process(const vector<BlockInfo>& vInfo, Collection& c, Processing& p, int nGranularity = -1)
 			{
 				BlockProcessing_TBB<BlockType>::process(vInfo, c, p, nGranularity);
 			}
@@ -475,7 +774,7 @@ namespace MRAG
              *                      Optional: if not set, auto_partitioner (see tbb-doc) will be used.
              */
 			template <typename Processing, typename Collection>
-			void pipeline_process(vector<BlockInfo>& vInfo, Collection& c, BoundaryInfo& b, Processing& p)
+			void pipeline_process(const vector<BlockInfo>& vInfo, Collection& c, BoundaryInfo& b, Processing& p)
 			{
 				//1. prepare resources
 				//2. allocate filters
@@ -0,0 +1,158 @@
+/*
+ *  MRAGBlockReduction_TBB.h
+ *  MRAG
+ *
+ *	Deterministic reductions: the result does not depend on the number of threads
+ *	nor on the scheduling, so that two runs of the same case give the same bits.
+ *	The range is cut in chunks of a fixed grain (chosen by the caller, never from
+ *	the threads), every chunk is reduced from its beginning to its end by its own
+ *	body, and the bodies are joined pairwise in a fixed tree: chunk 2i+1 into 2i,
+ *	then 4i+2 into 4i, and so on. The ranges over blocks are meant in the order given
+ *	by sortBlocksInfo, which depends on the grid only (and not on where the nodes
+ *	of the hierarchy were allocated).
+ *
+ *	The bodies are the ones of tbb::parallel_reduce: a splitting constructor,
+ *	operator()(const blocked_range<int>&) and join. The split bodies of a call are
+ *	constructed in one buffer of the MemoryPool (from the cache of the thread).
+ *
+ */
+#pragma once
+
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+
+#include "MRAGcore/MRAGCommon.h"
+#include "MRAGcore/MRAGLinearQuadtree.h"
+#include "MRAGcore/MRAGMemoryPool.h"
+
+#ifdef _MRAG_TBB
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#endif
+
+using namespace std;
+
+namespace MRAG
+{
+	namespace Multithreading
+	{
+		struct BlockInfoKeyOrder
+		{
+			static LinearQuadtree::Key key(const BlockInfo& info)
+			{
+				const int index[3] = {info.index[0], info.index[1], info.index[2]};
+
+				return LinearQuadtree::key(info.level, index);
+			}
+
+			bool operator()(const BlockInfo& a, const BlockInfo& b) const
+			{
+				return key(a) < key(b);
+			}
+		};
+
+		/** Sorts the blocks by (level, Morton code of the index), the stable order of the reductions. */
+		inline void sortBlocksInfo(vector<BlockInfo>& vInfo)
+		{
+			std::sort(vInfo.begin(), vInfo.end(), BlockInfoKeyOrder());
+		}
+
+		/**
+		 * The blocks of a grid in the order of sortBlocksInfo, with their block pointers:
+		 * sorted again only when the blocks change (see Grid::getBlocksInfoVersion()).
+		 */
+		class SortedBlocksInfo
+		{
+			const void * m_grid;
+			int m_nVersion;
+			vector<BlockInfo> m_vInfo;
+
+		public:
+			SortedBlocksInfo(): m_grid(NULL), m_nVersion(-1), m_vInfo() {}
+
+			template <typename Grid>
+			const vector<BlockInfo>& get(const Grid& grid)
+			{
+				if (m_grid != &grid || m_nVersion != grid.getBlocksInfoVersion())
+				{
+					m_vInfo = grid.getBlocksInfoRef();
+					sortBlocksInfo(m_vInfo);
+
+					m_grid = &grid;
+					m_nVersion = grid.getBlocksInfoVersion();
+				}
+
+				return m_vInfo;
+			}
+		};
+
+#ifdef _MRAG_TBB
+		template <typename Body>
+		class ReduceChunks_TBB
+		{
+			Body& m_body;
+			Body * m_splits;
+			const int m_nElements, m_nGrain;
+
+		public:
+			ReduceChunks_TBB(Body& body, Body * splits, const int nElements, const int nGrain):
+			m_body(body), m_splits(splits), m_nElements(nElements), m_nGrain(nGrain) {}
+
+			ReduceChunks_TBB(const ReduceChunks_TBB& c):
+			m_body(c.m_body), m_splits(c.m_splits), m_nElements(c.m_nElements), m_nGrain(c.m_nGrain) {}
+
+			void operator()(const tbb::blocked_range<int>& r) const
+			{
+				for(int k=r.begin(); k<r.end(); k++)
+				{
+					const int s = k*m_nGrain;
+					const int e = s + m_nGrain < m_nElements ? s + m_nGrain : m_nElements;
+
+					Body& body = k == 0 ? m_body : m_splits[k-1];
+
+					body(tbb::blocked_range<int>(s, e, m_nGrain));
+				}
+			}
+		};
+
+		/**
+		 * Reduces [0, nElements) into body, in chunks of nGrain elements joined in a fixed tree.
+		 * The body keeps the first chunk, the others are reduced by bodies split from it.
+		 * The result depends on nGrain: it has to be a constant of the call site.
+		 */
+		template <typename Body>
+		void deterministic_reduce(const int nElements, Body& body, const int nGrain)
+		{
+			assert(nGrain > 0);
+
+			if (nElements <= 0) return;
+
+			const int nChunks = (nElements + nGrain - 1)/nGrain;
+			const int nSplits = nChunks - 1;
+
+			//chunk k>0 is reduced by splits[k-1]; the splits read the body: all of them before it starts working
+			Body * const splits = nSplits > 0 ? (Body *)MemoryPool::allocate(nSplits*sizeof(Body)) : NULL;
+
+			for(int k=0; k<nSplits; k++)
+				new ((void *)(splits + k)) Body(body, tbb::split());
+
+			ReduceChunks_TBB<Body> chunks(body, splits, nElements, nGrain);
+			tbb::parallel_for(tbb::blocked_range<int>(0, nChunks, 1), chunks, tbb::simple_partitioner());
+
+			for(int stride=1; stride<nChunks; stride*=2)
+				for(int k=0; k+stride<nChunks; k+=2*stride)
+				{
+					Body& dest = k == 0 ? body : splits[k-1];
+
+					dest.join(splits[k+stride-1]);
+				}
+
+			for(int k=0; k<nSplits; k++)
+				splits[k].~Body();
+
+			MemoryPool::deallocate(splits, nSplits*sizeof(Body));
+		}
+#endif
+	}
+}
@@ -13,6 +13,7 @@
 #include "../MRAGcore/MRAGRefiner.h"
 #include "../MRAGcore/MRAGProfiler.h"
 #include "../MRAGcore/MRAGBlockFWT.h"
+#include "MRAGMemoryBudget.h"
 
 namespace MRAG
 {
@@ -27,6 +28,7 @@ namespace MRAG
 		
 		Profiler* m_refProfiler;
 		Refiner * m_refRefiner;
+		MemoryBudget<Grid> * m_refBudget;
 		
 		Grid& m_grid;
 		BlockFWT& m_fwt;
@@ -47,12 +49,15 @@ namespace MRAG
 		
 		AutomaticRefiner(Grid& grid, BlockFWT& fwt, Refiner * refiner, double dMaxMemorySizeMB = 1000.0, Profiler* profiler = NULL):
 		Refiner(refiner->getMaxLevelJump()), 
-		m_grid(grid), m_fwt(fwt), m_refRefiner(refiner), m_refProfiler(profiler),
+		m_grid(grid), m_fwt(fwt), m_refRefiner(refiner), m_refProfiler(profiler), m_refBudget(NULL),
 		m_dMaxMemorySizeMB(dMaxMemorySizeMB)
 		{
 			m_grid.setRefiner(this);
 		}
 		
+		//with a budget, the ghost tables of the coldest blocks are compressed before a refinement is refused
+		void setMemoryBudget(MemoryBudget<Grid> * budget) { m_refBudget = budget; }
+		
 		//inherited from refiner interface
 		virtual RefinementPlan* createPlan(const HierarchyType& hierarchy, const NeighborhoodType& neighborhood, const bool vProcessingDirections[3], vector<NodeToRefine>& vRefinements)
 		{
@@ -62,9 +67,15 @@ namespace MRAG
 			const double avgBlockSize = _computeAverageBlockSize(m_grid);
 			const double currentGridSize = m_grid.getMemorySize();
 			
-			const double estimatedSize = currentGridSize + additionalBlocks*avgBlockSize;
+			double estimatedSize = currentGridSize + additionalBlocks*avgBlockSize;
 			const double margin = 5.0*avgBlockSize;//MB
-			const bool bExceeding = (estimatedSize + margin>= m_dMaxMemorySizeMB);
+			bool bExceeding = (estimatedSize + margin>= m_dMaxMemorySizeMB);
+			
+			if (bExceeding && m_refBudget != NULL)
+			{
+				estimatedSize -= m_refBudget->reclaim(m_grid, m_dMaxMemorySizeMB - margin - additionalBlocks*avgBlockSize);
+				bExceeding = (estimatedSize + margin>= m_dMaxMemorySizeMB);
+			}
 			
 			if (bVerbose)
 			{
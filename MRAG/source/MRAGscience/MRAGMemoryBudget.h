@@ -0,0 +1,149 @@
+/*
+ *  MRAGMemoryBudget.h
+ *  MRAG
+ *
+ *	Keeps the memory of a grid (blocks and ghost tables, see Grid::getMemorySize)
+ *	within a budget by compressing the ghost tables of the coldest blocks.
+ *	The coarsest blocks, typically in the far field, are the coldest and are
+ *	compressed first, the largest tables of a level first: the blocks of the finest
+ *	levels keep their tables decoded for as long as the budget allows.
+ *	A compressed table is decoded on demand in the shared LRU of BoundaryInfoBlock,
+ *	it is replaced by an uncompressed one only when the grid rebuilds it. The LRU is
+ *	bounded while the grid is under pressure and gets its capacity back afterwards.
+ *
+ */
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "../MRAGcore/MRAGCommon.h"
+#include "../MRAGcore/MRAGBoundaryBlockInfo.h"
+
+using namespace std;
+
+namespace MRAG
+{
+	template<typename Grid>
+	class MemoryBudget
+	{
+		static const bool bVerbose = false;
+
+		double m_dMaxMemorySizeMB;
+		double m_dPressure;
+		int m_nDecodedTables;
+		int m_nPreviousDecodedTables; //capacity of the LRU before the pressure, 0 if not bounded
+
+		struct Candidate
+		{
+			int level;
+			float MB;
+			BoundaryInfoBlock * bbi;
+
+			Candidate(int level, float MB, BoundaryInfoBlock * bbi): level(level), MB(MB), bbi(bbi) {}
+
+			bool operator<(const Candidate& c) const
+			{
+				return level < c.level || (level == c.level && MB > c.MB);
+			}
+		};
+
+	public:
+
+		/**
+		 * dMaxMemorySizeMB: the budget, 0 for none.
+		 * dPressure: the grid is under pressure above this fraction of the budget.
+		 * nDecodedTables: capacity of the LRU of decoded tables, part of the footprint of the compressed blocks.
+		 */
+		MemoryBudget(double dMaxMemorySizeMB, double dPressure = 0.9, int nDecodedTables = 64):
+		m_dMaxMemorySizeMB(dMaxMemorySizeMB), m_dPressure(dPressure), m_nDecodedTables(nDecodedTables), m_nPreviousDecodedTables(0)
+		{
+			assert(dMaxMemorySizeMB >= 0);
+			assert(dPressure > 0 && dPressure <= 1);
+			assert(nDecodedTables > 0);
+		}
+
+		double getMaxMemorySizeMB() const { return m_dMaxMemorySizeMB; }
+
+		bool isEnabled() const { return m_dMaxMemorySizeMB > 0; }
+
+		/**
+		 * Compresses the ghost tables of the coldest blocks until the grid takes at most dTargetMB
+		 * or all tables are compressed. Returns the MB reclaimed.
+		 * If the grid already fits, the LRU of decoded tables gets back the capacity it had before the pressure.
+		 * Not to be called while the grid is processed.
+		 */
+		double reclaim(Grid& grid, const double dTargetMB)
+		{
+			BoundaryInfo& boundaryInfo = grid.getBoundaryInfo();
+
+			const double startMB = grid.getMemorySize();
+
+			if (startMB <= dTargetMB)
+			{
+				if (m_nPreviousDecodedTables > 0)
+				{
+					BoundaryInfoBlock::setDecodedTablesCapacity(m_nPreviousDecodedTables);
+					m_nPreviousDecodedTables = 0;
+				}
+
+				return 0;
+			}
+
+			//the decoded copies of the compressed tables left by the last steps go first,
+			//the LRU is bounded only now that the tables have to be compressed
+			if (m_nPreviousDecodedTables == 0)
+				m_nPreviousDecodedTables = BoundaryInfoBlock::getDecodedTablesCapacity();
+
+			BoundaryInfoBlock::setDecodedTablesCapacity(m_nDecodedTables);
+
+			double currentMB = grid.getMemorySize();
+
+			if (currentMB <= dTargetMB) return startMB - currentMB;
+
+			//1. collect the uncompressed tables
+			//2. compress the coldest first
+
+			//1.
+			const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
+
+			vector<Candidate> candidates;
+			candidates.reserve(vInfo.size());
+
+			for(vector<BlockInfo>::const_iterator it = vInfo.begin(); it != vInfo.end(); it++)
+			{
+				map<int, BoundaryInfoBlock*>::iterator itBBI = boundaryInfo.boundaryInfoOfBlock.find(it->blockID);
+
+				if (itBBI == boundaryInfo.boundaryInfoOfBlock.end() || itBBI->second->isCompressed()) continue;
+
+				candidates.push_back(Candidate(it->level, itBBI->second->getMemorySize(), itBBI->second));
+			}
+
+			sort(candidates.begin(), candidates.end());
+
+			//2.
+			int nCompressed = 0;
+
+			for(typename vector<Candidate>::const_iterator it = candidates.begin(); it != candidates.end() && currentMB > dTargetMB; it++, nCompressed++)
+			{
+				it->bbi->compress();
+
+				currentMB -= it->MB - it->bbi->getMemorySize();
+			}
+
+			if (bVerbose)
+				printf("MemoryBudget: compressed %d ghost tables out of %d, %f MB -> %f MB (target %f MB)\n",
+					   nCompressed, (int)candidates.size(), startMB, currentMB, dTargetMB);
+
+			return startMB - currentMB;
+		}
+
+		/** If the grid is under pressure, brings it back below the pressure threshold. Returns the MB reclaimed. */
+		double enforce(Grid& grid)
+		{
+			if (!isEnabled()) return 0;
+
+			return reclaim(grid, m_dPressure*m_dMaxMemorySizeMB);
+		}
+	};
+}
@@ -12,6 +12,7 @@
 #include "MRAGcore/MRAGProfiler.h"
 #include "MRAGcore/MRAGBlockFWT.h"
 #include "MRAGSimpleLevelsetBlock.h"
+#include "MRAGMemoryBudget.h"
 
 #include <vector>
 #include <set>
@@ -35,13 +36,16 @@ namespace MRAG
          * @param profiler              Optional profiler to monitor performance.
          * @param fillGrid(Grid&)       Optional function to fill the refined grid.
          *                              (otherwise wavelets used to interpolate values)
+         * @param dont_refine           Optional blockIDs not to refine (iMaxLoops must then be 1).
+         * @param budget                Optional memory budget, enforced after every refinement.
          * 
-         * @see MRAG::BlockFWT, #make_projector
+         * @see MRAG::BlockFWT, #make_projector, MRAG::MemoryBudget
          */
 		template < int iFirstChannel, int iLastChannel, typename Grid, typename BlockFWT>
 		int AutomaticRefinement(Grid& g, BlockFWT& fwt, const double dAbsoluteTolerance, 
 								 const int iMaxLevel = -1, const int iMaxLoops=-1, 
-								 MRAG::Profiler* profiler=NULL, void (*fillGrid)(Grid& g)=NULL, set<int> * dont_refine=NULL)
+								 MRAG::Profiler* profiler=NULL, void (*fillGrid)(Grid& g)=NULL, set<int> * dont_refine=NULL,
+								 MemoryBudget<Grid> * budget=NULL)
 		{
 			int loopCounter = 0;
 			
@@ -109,6 +113,9 @@ namespace MRAG
 				g.getBoundaryInfo();
 				if (profiler !=NULL) profiler->getAgent("boundaries").stop();
 				
+				//the new blocks come with decoded ghost tables
+				if (budget != NULL) budget->enforce(g);
+				
 				if (fillGrid != NULL) fillGrid(g);
 				
 			//	printf("AutomaticRefinement:: Refined %d, FWT skipped blocks:%d\n", shouldBeRefined.size(), nSkippedBlocks);
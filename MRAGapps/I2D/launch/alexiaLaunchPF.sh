@@ -13,6 +13,7 @@ SETTINGS+=" -ypos 0.0001"
 SETTINGS+=" -gamma 0.9"
 #SETTINGS+=" -greedyEps 0.005"
 SETTINGS+=" -shared 1"
+SETTINGS+=" -nenvs 1" # number of schools learning the shared policy side by side (needs -shared 1)
 
 SETTINGS+=" -smooth 0"
 SETTINGS+=" -isControlled 1"
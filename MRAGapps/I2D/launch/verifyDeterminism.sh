@@ -0,0 +1,46 @@
+#!/bin/bash
+#
+# Runs the same case with two thread counts and checks that the report.txt are identical
+# (the global reductions are deterministic, see MRAGBlockReduction_TBB.h).
+#
+# usage: ./verifyDeterminism.sh NTHREADS_A NTHREADS_B EXECUTABLE [SETTINGS...]
+# The settings must not contain -nthreads. Example:
+# ./verifyDeterminism.sh 1 8 ../makefiles/avemaria -study FLOW_PAST_FIXED_OBSTACLE -bpd 8 -tend 0.1
+
+if [ $# -lt 3 ]; then
+	echo "usage: $0 NTHREADS_A NTHREADS_B EXECUTABLE [SETTINGS...]"
+	exit 1
+fi
+
+NTHREADS_A=$1
+NTHREADS_B=$2
+EXECNAME=$(readlink -f $3)
+shift 3
+SETTINGS="$@"
+
+BASEPATH=$(mktemp -d determinism.XXXX)
+
+for NTHREADS in $NTHREADS_A $NTHREADS_B
+do
+	FOLDER=${BASEPATH}/nthreads${NTHREADS}
+	mkdir -p ${FOLDER}
+	echo "running ${EXECNAME} ${SETTINGS} -nthreads ${NTHREADS} in ${FOLDER}"
+	(cd ${FOLDER} && ${EXECNAME} ${SETTINGS} -nthreads ${NTHREADS} > output.txt 2>&1)
+done
+
+REPORT_A=${BASEPATH}/nthreads${NTHREADS_A}/report.txt
+REPORT_B=${BASEPATH}/nthreads${NTHREADS_B}/report.txt
+
+if [ ! -s ${REPORT_A} ] || [ ! -s ${REPORT_B} ]; then
+	echo "no report.txt written, see the output.txt in ${BASEPATH}"
+	exit 1
+fi
+
+if cmp -s ${REPORT_A} ${REPORT_B}; then
+	echo "report.txt identical with ${NTHREADS_A} and ${NTHREADS_B} threads"
+	exit 0
+fi
+
+echo "report.txt differ with ${NTHREADS_A} and ${NTHREADS_B} threads:"
+diff ${REPORT_A} ${REPORT_B} | head -20
+exit 1
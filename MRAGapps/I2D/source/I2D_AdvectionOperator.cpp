@@ -124,58 +124,55 @@ struct RHSUpwind3rdOrder
 struct GetUMax
 {
 	Real Uinf[2];
-	map< int, Real>& local_max_velocities;
+	const vector<BlockInfo>& vInfo;
+	const BlockCollection<B>& coll;
+	Real maxvel;
 	
-	GetUMax(map< int, Real>& local_max_velocities, Real Uinf[2]):local_max_velocities(local_max_velocities) 
+	GetUMax(const vector<BlockInfo>& vInfo, const BlockCollection<B>& coll, const Real Uinf[2]): vInfo(vInfo), coll(coll), maxvel(0)
 	{
 		this->Uinf[0] = Uinf[0];
 		this->Uinf[1] = Uinf[1];
 	}
 	
-	GetUMax(const GetUMax& c): local_max_velocities(c.local_max_velocities)
+	GetUMax(const GetUMax& c, tbb::split): vInfo(c.vInfo), coll(c.coll), maxvel(0)
 	{
 		Uinf[0] = c.Uinf[0];
 		Uinf[1] = c.Uinf[1];
 	}
 	
-	inline void operator() (const BlockInfo& info, FluidBlock2D& b) const
+	void operator()(const blocked_range<int>& range)
 	{
-		Real maxVel[2] = {0.0,0.0};
-		
-		FluidElement2D * e = &b(0,0);
-		
-		static const int n = FluidBlock2D::sizeY*FluidBlock2D::sizeX;
-		for(int i=0; i<n; i++) 
+		for(int i=range.begin(); i<range.end(); i++)
 		{
-			maxVel[0] = max((Real)fabs(Uinf[0] + e[i].u[0]), maxVel[0]);
-			maxVel[1] = max((Real)fabs(Uinf[1] + e[i].u[1]), maxVel[1]);
+			FluidBlock2D& b = coll[vInfo[i].blockID];
+			
+			FluidElement2D * e = &b(0,0);
+			
+			static const int n = FluidBlock2D::sizeY*FluidBlock2D::sizeX;
+			for(int j=0; j<n; j++) 
+			{
+				maxvel = max((Real)fabs(Uinf[0] + e[j].u[0]), maxvel);
+				maxvel = max((Real)fabs(Uinf[1] + e[j].u[1]), maxvel);
+			}
 		}
-		
-		map< int, Real>::iterator it = local_max_velocities.find(info.blockID);
-		assert(it != local_max_velocities.end());
-		
-		it->second = max(maxVel[0],maxVel[1]);
+	}
+	
+	void join(const GetUMax& c)
+	{
+		maxvel = max(maxvel, c.maxvel);
 	}
 };
 
 Real I2D_AdvectionOperator::compute_maxvel()
 {
-	map<int, Real> velocities;
-	
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
-	for(vector<BlockInfo>::iterator it=vInfo.begin(); it!=vInfo.end(); it++)
-		velocities[it->blockID] = 0;
-	
-	GetUMax get_velocities(velocities, Uinf);
-	block_processing.process(vInfo, grid.getBlockCollection(), get_velocities);
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	
-	Real maxvel = 0;
-	for(map< int, Real>::iterator it=velocities.begin(); it!=velocities.end(); it++)
-		maxvel = max(maxvel, it->second);
+	GetUMax get_velocities(vInfo, grid.getBlockCollection(), Uinf);
+	Multithreading::deterministic_reduce(vInfo.size(), get_velocities, 4);
 	
-	tmp_maxvel = maxvel;
+	tmp_maxvel = get_velocities.maxvel;
 	
-	return maxvel;
+	return tmp_maxvel;
 }
 
 Real I2D_AdvectionOperator::estimate_largest_dt()
@@ -209,7 +206,7 @@ struct AdvectionSimple
 	template< template<typename BT> class CorrectLab>
 	void integrate(double dt)
 	{
-		vector<BlockInfo> vInfo = grid.getBlocksInfo();
+		const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 		BoundaryInfo& binfo=grid.getBoundaryInfo();  
 		const BlockCollection<B>& coll = grid.getBlockCollection();
 		
@@ -280,7 +277,8 @@ struct AdvectionLTS
 			}
 		}
 		
-		vector<BlockInfo> vInfo = grid.getBlocksInfo();
+		// filled by the sorter with the blocks of one level at a time
+		vector<BlockInfo> vInfo;
 		BoundaryInfo& binfo=grid.getBoundaryInfo();  
 		const BlockCollection<B>& coll = grid.getBlockCollection();
 		
@@ -11,7 +11,7 @@
 #include "I2D_VectorBlockLab.h"
 #include "I2D_ParticleBlockLab.h"
 #include "I2D_GradOfVector.h"
-#include "I2D_ParticleBlockLab.h"
+#include "I2D_ParticlePushRemesh.h"
 
 struct GetGradUMax: I2D_GradOfVector_4thOrder
 {
@@ -90,8 +90,8 @@ Real I2D_AdvectionOperator_Particles::estimate_largest_dt()
 	
 	map<int, Real> max_grad_u;
 	
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
-	for(vector<BlockInfo>::iterator it=vInfo.begin(); it!=vInfo.end(); it++)
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
+	for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
 		max_grad_u[it->blockID] = 0;
 	
 	BoundaryInfo& binfo=grid.getBoundaryInfo();  
@@ -111,72 +111,16 @@ Real I2D_AdvectionOperator_Particles::estimate_largest_dt()
 	return min(dtCFL, dtLCFL);
 }
 
-struct PushRemesh
-{
-	Real dt,t;
-	Real Uinf[2];
-	
-	int stencil_start[3], stencil_end[3];
-	
-	PushRemesh(Real dt, Real Uinf[2]): t(0), dt(dt)
-	{
-		stencil_start[0] = stencil_start[1] = -3;
-		stencil_end[0] = stencil_end[1] = +4;
-		stencil_start[2] = 0;
-		stencil_end[2] = 1;
-		
-		this->Uinf[0] = Uinf[0];
-		this->Uinf[1] = Uinf[1];
-	}
-	
-	PushRemesh(const PushRemesh& c): t(0), dt(c.dt)
-	{
-		stencil_start[0] = stencil_start[1] = -3;
-		stencil_end[0] = stencil_end[1] = +4;
-		stencil_start[2] = 0;
-		stencil_end[2] = 1;
-		
-		Uinf[0] = c.Uinf[0];
-		Uinf[1] = c.Uinf[1];
-	}
-	
-	template<typename Lab>
-	inline void operator()(Lab& lab, const BlockInfo& info, FluidBlock2D& out) const 
-	{
-		lab.pcore.push(info, lab, dt, Uinf);
-		lab.pcore.remesh(lab);
-		
-		for(int iy=0; iy<FluidBlock2D::sizeY; iy++)
-				for(int ix=0; ix<FluidBlock2D::sizeX; ix++)
-					out.external_data[iy][ix] = lab.pcore.omega_new[iy][ix];
-	}
-};
-
-struct UpdateOmega
-{
-	inline void operator() (const BlockInfo& info, FluidBlock2D& b) const
-	{	
-		FluidElement2D * const dest = &b(0,0);
-		
-		const Real * const src = &b.external_data[0][0];
-		
-		const int n = FluidBlock2D::sizeY*FluidBlock2D::sizeX;
-		
-		for(int i=0; i<n; i++)
-			dest[i].omega = src[i];
-	}
-};
-
 void I2D_AdvectionOperator_Particles::perform_timestep(double dt)
 {
 	assert(state == Ready);
 	state = Done;
 	
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	BoundaryInfo& binfo=grid.getBoundaryInfo();  
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
-	PushRemesh push_remesh(dt, Uinf);
+	PushRemesh<0> push_remesh(dt, Uinf);
 	block_processing.process< I2D_ParticleBlockLab >(vInfo, coll, binfo, push_remesh);
 	
 	UpdateOmega update;
@@ -0,0 +1,41 @@
+/*
+ *  I2D_AdvectionOperator_ParticlesRK.cpp
+ *  IncompressibleFluids2D
+ *
+ */
+
+#include "I2D_AdvectionOperator_ParticlesRK.h"
+#include "I2D_ParticleBlockLab.h"
+#include "I2D_ParticlePushRemesh.h"
+
+I2D_AdvectionOperator_ParticlesRK::I2D_AdvectionOperator_ParticlesRK(Grid<W,B>& grid, double CFL, double LCFL):
+I2D_AdvectionOperator_Particles(grid, CFL, LCFL)
+{
+	assert(CFL > 0 && CFL < 1 + margin);
+	assert(LCFL > 0 && LCFL < 1);
+}
+
+void I2D_AdvectionOperator_ParticlesRK::perform_timestep(double dt)
+{
+	assert(state == Ready);
+	state = Done;
+	
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
+	BoundaryInfo& binfo=grid.getBoundaryInfo();  
+	const BlockCollection<B>& coll = grid.getBlockCollection();
+	
+	if (binfo.stencil_start[0] > -3 - margin || binfo.stencil_end[0] < +4 + margin ||
+		binfo.stencil_start[1] > -3 - margin || binfo.stencil_end[1] < +4 + margin)
+	{
+		printf("I2D_AdvectionOperator_ParticlesRK: the grid stencil is too small for the particles. aborting...\n");
+		abort();
+	}
+	
+	PushRemesh<margin> push_remesh(dt, Uinf);
+	block_processing.process< I2D_ParticleBlockLabRK >(vInfo, coll, binfo, push_remesh);
+	
+	UpdateOmega update;
+	block_processing.process(vInfo, coll, update);
+	
+	rhscounter = vInfo.size();
+}
@@ -0,0 +1,28 @@
+/*
+ *  I2D_AdvectionOperator_ParticlesRK.h
+ *  IncompressibleFluids2D
+ *
+ *	this operator advect omega with the velocity field u with CFL particles
+ *	pushed with the midpoint scheme, as I2D_AdvectionOperator_Particles, but
+ *	the particle set of each block is one cell wider, so CFL up to 2 is allowed.
+ *	LCFL stays below 1: it is the particle overlap limit dt*|grad u|_inf < 1,
+ *	whatever the push, and the remeshing is not level-aware (see I2D_CoreParticlesRK).
+ *	The grid must be created with a particle stencil of at least [-4,+5].
+ *
+ *	IN: omega, u[0-1]
+ *	OUT: omega
+ */
+#pragma once
+
+#include "I2D_AdvectionOperator_Particles.h"
+
+class I2D_AdvectionOperator_ParticlesRK: public I2D_AdvectionOperator_Particles
+{
+public:
+	//additional cells travelled per step with respect to I2D_AdvectionOperator_Particles
+	static const int margin = 1;
+	
+	I2D_AdvectionOperator_ParticlesRK(Grid<W,B>& grid, double CFL=0.25, double LCFL=0.25);
+	
+	void perform_timestep(double dt);
+};
@@ -35,7 +35,7 @@ public:
 
 	void compute (Grid<W,B>& grid, Real t)
     {
-        std::vector<BlockInfo> vInfo = grid.getBlocksInfo();
+        const std::vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 
 		Real J20 = 0, J02 = 0, J11 = 0;
 		Real Gamma = 0;
@@ -179,6 +179,9 @@ velsolver(NULL), advection(NULL), initialCondition(NULL)
 	bFMMSKIP = parser("-fmm-skip").asBool();
 	sIC = parser ("-ic").asString();
 
+	// per-step counters and timings (perfmon.csv, continued by a restart), -perftrace also writes the timeline of every step
+	profiler.setOutput(parser("-perfmon").asString("perfmon"), parser("-perftrace").asBool(), bRESTART);
+
 	parser.set_strict_mode();
 
 	BPD = parser("-bpd").asInt();
@@ -551,10 +554,11 @@ void I2D_Axisymmetrization::_tnext(Real &tnext, Real& tnext_dump, Real& tend)
 		FILE * f = fopen("report.txt", step_id == 0 ? "w" : "a");
 		assert(f!=NULL);
 
-		fprintf(f, "####################### t is %e, dt is %e and is bound by: %s", t, tnext - t, dtBound.c_str());
-		fprintf(f, "stepid=%d\tT=%e\tDT=%e\t", step_id, tnext*nondim_factor_time, (tnext - t)*nondim_factor_time);
+		//all the digits: two runs are compared bit for bit (see launch/verifyDeterminism.sh)
+		fprintf(f, "####################### t is %.17g, dt is %.17g and is bound by: %s", t, tnext - t, dtBound.c_str());
+		fprintf(f, "stepid=%d\tT=%.17g\tDT=%.17g\t", step_id, tnext*nondim_factor_time, (tnext - t)*nondim_factor_time);
 		for(int i=0; i<tnext_candidates.size(); i++)
-			fprintf(f, "%s: %2.2e,\t", tnext_names[i].c_str(), tnext_candidates[i] - t);
+			fprintf(f, "%s: %.17g,\t", tnext_names[i].c_str(), tnext_candidates[i] - t);
 
 		fprintf(f, "\n");
 		fclose(f);
@@ -618,19 +622,12 @@ void I2D_Axisymmetrization::run()
 				const tbb::tick_count now = tbb::tick_count::now();
 				const Real Tcurr = t*nondim_factor_time;
 				const Real wallclock = (now-start_instant).seconds();
-				const int nblocks = grid->getBlocksInfo().size();
-
-				FILE * f = fopen("more-perfmon.txt", step_id == 1 ? "w" : "a");
-
-				if (f!=NULL)
-				{
-					if (step_id == 0)
-						fprintf(f,"stepid\twall-clock[s]\tT[-]\tblocks\tADV-rhs\tDIFF-rhs\n");
-
-					fprintf(f,"%d\t%e\t%e\t%d\t%d\n", step_id, wallclock, Tcurr, nblocks, advection->get_nofrhs());
+				profiler.set("wall-clock", wallclock);
+				profiler.set("T", Tcurr);
+				profiler.set("blocks", grid->getBlocksInfo().size());
+				profiler.set("ADV-rhs", advection->get_nofrhs());
 
-					fclose(f);
-				};
+				profiler.endStep(step_id);
 			}
 
 			printf("END TIME STEP (%d over %d)\n", i, ADAPTFREQ);
@@ -0,0 +1,561 @@
+/*
+ *  I2D_Benchmark.cpp
+ *  IncompressibleFluids2D
+ *
+ */
+
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "I2D_Benchmark.h"
+#include "I2D_ScalarBlockLab.h"
+#include "I2D_DiffusionOperator.h"
+#include "I2D_AdvectionOperator_Particles.h"
+#include "I2D_VelocitySolver_Mani.h"
+
+#include "mani-fmm2d/VortexExpansions.h"
+#include "mani-fmm2d/hcfmm_box.h"
+#include "mani-fmm2d/hcfmm_boxBuilder_serial.h"
+
+static const int benchmarkStencil[2][3] = {
+		-3, -3, 0,
+		+4, +4, 1
+};
+
+struct LoadOnly
+{
+	Real t;
+	int stencil_start[3], stencil_end[3];
+
+	LoadOnly(): t(0)
+	{
+		stencil_start[0] = stencil_start[1] = -2;
+		stencil_end[0] = stencil_end[1] = +3;
+		stencil_start[2] = 0;
+		stencil_end[2] = 1;
+	}
+
+	LoadOnly(const LoadOnly& c): t(c.t)
+	{
+		stencil_start[0] = stencil_start[1] = -2;
+		stencil_end[0] = stencil_end[1] = +3;
+		stencil_start[2] = 0;
+		stencil_end[2] = 1;
+	}
+
+	template<typename Lab>
+	inline void operator()(Lab& lab, const BlockInfo& info, FluidBlock2D& out) const
+	{
+		//touch the ghosts so that the load is not optimized away
+		out.external_data[0][0] = lab(-2, -2) + lab(_BLOCKSIZE_+2, _BLOCKSIZE_+2);
+	}
+};
+
+struct KernelLabLoad
+{
+	Grid<W,B>& grid;
+	BlockProcessing block_processing;
+
+	KernelLabLoad(Grid<W,B>& grid): grid(grid) {}
+
+	double operator()()
+	{
+		vector<BlockInfo> vInfo = grid.getBlocksInfo();
+		LoadOnly load;
+
+		block_processing.process< I2D_ScalarBlockLab< Streamer_Omega >::Lab >(vInfo, grid.getBlockCollection(), grid.getBoundaryInfo(), load);
+
+		return vInfo.size();
+	}
+};
+
+struct KernelDiffusion
+{
+	I2D_DiffusionOperator_4thOrder diffusion;
+
+	KernelDiffusion(Grid<W,B>& grid): diffusion(grid, 1e-4, 0.5) {}
+
+	double operator()()
+	{
+		//the smallest dt avoids the local time stepping: two right-hand sides per block
+		diffusion.perform_timestep(diffusion.estimate_smallest_dt());
+
+		return diffusion.get_nofrhs();
+	}
+};
+
+struct KernelParticles
+{
+	Grid<W,B>& grid;
+	I2D_AdvectionOperator_Particles advection;
+
+	KernelParticles(Grid<W,B>& grid): grid(grid), advection(grid)
+	{
+		Real Uinf[2] = {0,0};
+		advection.set_Uinfinity(Uinf);
+	}
+
+	double operator()()
+	{
+		advection.perform_timestep(advection.estimate_largest_dt());
+
+		return grid.getBlocksInfo().size();
+	}
+};
+
+struct KernelRefineCheck
+{
+	Grid<W,B>& grid;
+	BlockFWT<W, B, vorticity_projector, false, 1>& fwt;
+	const Real rtol;
+	const int lmax;
+
+	KernelRefineCheck(Grid<W,B>& grid, BlockFWT<W, B, vorticity_projector, false, 1>& fwt, Real rtol, int lmax):
+	grid(grid), fwt(fwt), rtol(rtol), lmax(lmax) {}
+
+	double operator()()
+	{
+		const int nblocks = grid.getBlocksInfo().size();
+
+		Science::AutomaticRefinement<0,0>(grid, fwt, rtol, lmax, 1, NULL, (void (*)(Grid<W,B>&))NULL);
+
+		return nblocks;
+	}
+};
+
+struct KernelCompressCheck
+{
+	Grid<W,B>& grid;
+	BlockFWT<W, B, vorticity_projector, false, 1>& fwt;
+	const Real ctol;
+
+	KernelCompressCheck(Grid<W,B>& grid, BlockFWT<W, B, vorticity_projector, false, 1>& fwt, Real ctol):
+	grid(grid), fwt(fwt), ctol(ctol) {}
+
+	double operator()()
+	{
+		const int nblocks = grid.getBlocksInfo().size();
+
+		Science::AutomaticCompression<0,0>(grid, fwt, ctol, 1);
+
+		return nblocks;
+	}
+};
+
+//gives access to the stages of the velocity solver
+class BenchmarkVelocitySolver: public I2D_VelocitySolver_Mani
+{
+	typedef HCFMM::Box<_VortexExpansions<VelocitySourceParticle, _ORDER_>,_FMM_MAX_LEVEL_> tBox;
+	typedef HCFMM::boxBuilder_serial<_VortexExpansions<VelocitySourceParticle, _ORDER_>,_FMM_MAX_LEVEL_> tBoxBuilder;
+
+	vector<VelocitySourceParticle> copy;
+
+public:
+
+	BenchmarkVelocitySolver(Grid<W,B>& grid, ArgumentParser& parser): I2D_VelocitySolver_Mani(grid, parser) {}
+
+	~BenchmarkVelocitySolver()
+	{
+		_cleanup();
+	}
+
+	int particles() const { return nsource_particles; }
+
+	double collect()
+	{
+		_cleanup();
+		_count_sourceparticles();
+
+		if (nsource_particles > 0)
+			_collect_sourceparticles();
+
+		return grid_ptr->getBlocksInfo().size();
+	}
+
+	double tree()
+	{
+		assert(nsource_particles > 0);
+
+		//the builder reorders the particles, work on a copy
+		copy.assign(srcparticles, srcparticles + nsource_particles);
+
+		tBox * root = new tBox;
+		tBoxBuilder::buildBoxes(&copy.front(), nsource_particles, root);
+		tBoxBuilder::generateExpansions(root);
+		delete root;
+
+		return nsource_particles;
+	}
+
+	double solve()
+	{
+		const int nblocks = grid_ptr->getBlocksInfo().size();
+
+		_compute();
+		_updateBlocks();
+		VelocityBlock::deallocate(my_velBlocks);
+
+		return nsource_particles*(double)nblocks*_BLOCKSIZE_*_BLOCKSIZE_;
+	}
+};
+
+struct KernelFMMCollect
+{
+	BenchmarkVelocitySolver& solver;
+
+	KernelFMMCollect(BenchmarkVelocitySolver& solver): solver(solver) {}
+
+	double operator()() { return solver.collect(); }
+};
+
+struct KernelFMMTree
+{
+	BenchmarkVelocitySolver& solver;
+
+	KernelFMMTree(BenchmarkVelocitySolver& solver): solver(solver) {}
+
+	double operator()() { return solver.tree(); }
+};
+
+struct KernelFMMSolve
+{
+	BenchmarkVelocitySolver& solver;
+
+	KernelFMMSolve(BenchmarkVelocitySolver& solver): solver(solver) {}
+
+	double operator()() { return solver.solve(); }
+};
+
+static double _filesize(const string filename)
+{
+	struct stat s;
+
+	if (stat(filename.c_str(), &s) != 0)
+	{
+		printf("I2D_Benchmark: cannot stat %s. Aborting\n", filename.c_str());
+		abort();
+	}
+
+	return s.st_size;
+}
+
+struct KernelRestartWrite
+{
+	Grid<W,B>& grid;
+	const string filename;
+
+	KernelRestartWrite(Grid<W,B>& grid, const string filename): grid(grid), filename(filename) {}
+
+	double operator()()
+	{
+		IO_Binary<W,B> serializer;
+		serializer.Write(grid, filename);
+
+		return _filesize(filename + ".mrg");
+	}
+};
+
+struct KernelRestartRead
+{
+	Grid<W,B>& grid;
+	const string filename;
+
+	KernelRestartRead(Grid<W,B>& grid, const string filename): grid(grid), filename(filename) {}
+
+	double operator()()
+	{
+		IO_Binary<W,B> serializer;
+		serializer.Read(grid, filename);
+
+		return _filesize(filename + ".mrg");
+	}
+};
+
+//value of "key": in a line of the JSON written by _write()
+static string _field(const string& line, const string key)
+{
+	const size_t start = line.find("\"" + key + "\": ");
+
+	if (start == string::npos) return string();
+
+	size_t begin = start + key.size() + 4;
+	size_t end;
+
+	if (line[begin] == '"')
+		end = line.find('"', ++begin);
+	else
+		end = line.find_first_of(",}", begin);
+
+	return line.substr(begin, end == string::npos ? string::npos : end - begin);
+}
+
+I2D_Benchmark::I2D_Benchmark(const int argc, const char ** argv):
+parser(argc, argv), grid(NULL), refiner(NULL), compressor(NULL), nregressions(0)
+{
+	printf("////////////////////////////////////////////////////////////\n");
+	printf("/////////////////         BENCHMARK        /////////////////\n");
+	printf("////////////////////////////////////////////////////////////\n");
+
+	NTHREADS = max(1, parser("-nthreads").asInt());
+	JUMP = max(1, parser("-jump").asInt(2));
+	REPS = max(1, parser("-reps").asInt(5));
+	RTOL = parser("-rtol").asDouble(1e-3);
+	CTOL = parser("-ctol").asDouble(1e-5);
+	TOLERANCE = parser("-tolerance").asDouble(0.1);
+	sOUTPUT = parser("-out").asString("benchmark.json");
+	sBASELINE = parser("-baseline").asString();
+
+	parser.set_strict_mode();
+
+	//also required by the velocity solver
+	BPD = parser("-bpd").asInt();
+	LMAX = parser("-lmax").asInt();
+	parser("-fmm-theta").asDouble();
+
+	parser.unset_strict_mode();
+
+	assert(BPD > 1);
+	assert(LMAX >= 0);
+}
+
+I2D_Benchmark::~I2D_Benchmark()
+{
+	_cleanup();
+}
+
+void I2D_Benchmark::_ic(Grid<W,B>& grid)
+{
+	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+
+	for(int i=0; i<(int)vInfo.size(); i++)
+	{
+		BlockInfo info = vInfo[i];
+		B& b = grid.getBlockCollection()[vInfo[i].blockID];
+
+		for(int iy=0; iy<B::sizeY; iy++)
+			for(int ix=0; ix<B::sizeX; ix++)
+			{
+				Real p[2];
+				info.pos(p, ix, iy);
+
+				const Real radius = sqrt(pow(p[0]-0.35, 2) + pow(p[1]-0.35, 2));
+
+				b(ix, iy).omega = radius < 0.1;
+				b(ix, iy).u[0] = 2*pow(sin(M_PI*p[0]),2)*sin(2*M_PI*p[1]);
+				b(ix, iy).u[1] = -sin(2*M_PI*p[0])*pow(sin(M_PI*p[1]),2);
+				b(ix, iy).tmp = 0;
+			}
+	}
+}
+
+void I2D_Benchmark::_setup(const bool bUniform)
+{
+	_cleanup();
+
+	grid = new Grid<W,B>(BPD, BPD, 1, benchmarkStencil);
+	refiner = new Refiner(JUMP, LMAX);
+	compressor = new Compressor(JUMP);
+
+	grid->setRefiner(refiner);
+	grid->setCompressor(compressor);
+
+	_ic(*grid);
+
+	if (!bUniform)
+		while(Science::AutomaticRefinement<0,0>(*grid, fwt_omega, RTOL, LMAX, 1, NULL, _ic) > 0);
+}
+
+void I2D_Benchmark::_cleanup()
+{
+	delete grid;
+	delete refiner;
+	delete compressor;
+
+	grid = NULL;
+	refiner = NULL;
+	compressor = NULL;
+}
+
+template<typename Kernel>
+void I2D_Benchmark::_measure(const string sCase, const string sComponent, const string sUnit, Kernel& kernel)
+{
+	kernel();
+
+	vector<double> times(REPS);
+	double work = 0;
+
+	for(int r=0; r<REPS; r++)
+	{
+		const tbb::tick_count t0 = tbb::tick_count::now();
+		work = kernel();
+		times[r] = (tbb::tick_count::now() - t0).seconds();
+	}
+
+	sort(times.begin(), times.end());
+
+	Result result;
+	result.sCase = sCase;
+	result.sComponent = sComponent;
+	result.sUnit = sUnit;
+	result.nblocks = grid->getBlocksInfo().size();
+	result.tmin = times.front();
+	result.tmedian = times[REPS/2];
+	result.work = work;
+
+	printf("%-12s %-20s %6d blocks  %.3e s  %.3e %s\n", sCase.c_str(), sComponent.c_str(), result.nblocks, result.tmin, result.throughput(), sUnit.c_str());
+
+	results.push_back(result);
+}
+
+void I2D_Benchmark::_run(const string sCase, const bool bUniform)
+{
+	_setup(bUniform);
+
+	//the grid is not modified until the particles (last)
+	if (!bUniform)
+	{
+		KernelRefineCheck refine(*grid, fwt_omega, RTOL, LMAX);
+		_measure(sCase, "fwt-refine-check", "blocks/s", refine);
+
+		KernelCompressCheck compress(*grid, fwt_omega, CTOL);
+		_measure(sCase, "fwt-compress-check", "blocks/s", compress);
+
+		//the warm-up adapted the grid if it had to
+		_ic(*grid);
+	}
+
+	{
+		KernelLabLoad labload(*grid);
+		_measure(sCase, "lab-load", "blocks/s", labload);
+	}
+
+	{
+		BenchmarkVelocitySolver solver(*grid, parser);
+
+		KernelFMMCollect collect(solver);
+		_measure(sCase, "fmm-particles", "blocks/s", collect);
+
+		KernelFMMTree tree(solver);
+		_measure(sCase, "fmm-tree", "particles/s", tree);
+
+		KernelFMMSolve solve(solver);
+		_measure(sCase, "fmm-solve", "interactions/s", solve);
+	}
+
+	{
+		KernelRestartWrite write(*grid, "benchmark_restart");
+		_measure(sCase, "restart-write", "B/s", write);
+
+		KernelRestartRead read(*grid, "benchmark_restart");
+		_measure(sCase, "restart-read", "B/s", read);
+
+		remove("benchmark_restart.mrg");
+		_ic(*grid);
+	}
+
+	{
+		KernelDiffusion diffusion(*grid);
+		_measure(sCase, "diffusion-rhs", "blocks/s", diffusion);
+	}
+
+	{
+		_ic(*grid);
+
+		KernelParticles particles(*grid);
+		_measure(sCase, "particles", "blocks/s", particles);
+	}
+
+	_cleanup();
+}
+
+void I2D_Benchmark::_write() const
+{
+	FILE * f = fopen(sOUTPUT.c_str(), "w");
+
+	if (f == NULL)
+	{
+		printf("I2D_Benchmark: cannot write %s. Aborting\n", sOUTPUT.c_str());
+		abort();
+	}
+
+	fprintf(f, "{\n");
+	fprintf(f, "\t\"config\": {\"blocksize\": %d, \"real\": %d, \"threads\": %d, \"bpd\": %d, \"lmax\": %d, \"order\": %d, \"reps\": %d},\n",
+			_BLOCKSIZE_, (int)sizeof(Real), NTHREADS, BPD, LMAX, _ORDER_, REPS);
+	fprintf(f, "\t\"results\": [\n");
+
+	//one result per line, read back by _compare()
+	for(int i=0; i<(int)results.size(); i++)
+	{
+		const Result& r = results[i];
+
+		fprintf(f, "\t\t{\"case\": \"%s\", \"component\": \"%s\", \"blocks\": %d, \"seconds_min\": %e, \"seconds_median\": %e, \"work\": %e, \"unit\": \"%s\", \"throughput\": %e}%s\n",
+				r.sCase.c_str(), r.sComponent.c_str(), r.nblocks, r.tmin, r.tmedian, r.work, r.sUnit.c_str(), r.throughput(), i+1 < (int)results.size() ? "," : "");
+	}
+
+	fprintf(f, "\t]\n}\n");
+	fclose(f);
+}
+
+void I2D_Benchmark::_compare()
+{
+	FILE * f = fopen(sBASELINE.c_str(), "r");
+
+	if (f == NULL)
+	{
+		printf("I2D_Benchmark: cannot read the baseline %s. Aborting\n", sBASELINE.c_str());
+		abort();
+	}
+
+	map<string, double> baseline;
+	char buf[4096];
+
+	while(fgets(buf, sizeof(buf), f) != NULL)
+	{
+		const string line(buf);
+		const string throughput = _field(line, "throughput");
+
+		if (throughput != "")
+			baseline[_field(line, "case") + "/" + _field(line, "component")] = atof(throughput.c_str());
+	}
+
+	fclose(f);
+
+	printf("COMPARISON WITH %s (tolerance %.0f%%)\n", sBASELINE.c_str(), 100*TOLERANCE);
+
+	for(vector<Result>::const_iterator it=results.begin(); it!=results.end(); it++)
+	{
+		const string key = it->sCase + "/" + it->sComponent;
+		map<string, double>::const_iterator b = baseline.find(key);
+
+		if (b == baseline.end() || b->second <= 0)
+		{
+			printf("%-32s no baseline\n", key.c_str());
+			continue;
+		}
+
+		const double ratio = it->throughput()/b->second;
+		const bool bRegression = ratio < 1 - TOLERANCE;
+
+		printf("%-32s %6.2fx %s\n", key.c_str(), ratio, bRegression ? "REGRESSION" : (ratio > 1 + TOLERANCE ? "faster" : ""));
+
+		nregressions += (int)bRegression;
+	}
+}
+
+void I2D_Benchmark::run()
+{
+	results.clear();
+	nregressions = 0;
+
+	_run("uniform", true);
+	_run("multilevel", false);
+
+	_write();
+	printf("RESULTS WRITTEN TO %s\n", sOUTPUT.c_str());
+
+	if (sBASELINE != "")
+	{
+		_compare();
+		printf("%d REGRESSION(S)\n", nregressions);
+	}
+}
@@ -0,0 +1,67 @@
+/*
+ *  I2D_Benchmark.h
+ *  IncompressibleFluids2D
+ *
+ *	Times the components of a time step in isolation on deterministic grids:
+ *	a uniform grid of bpd x bpd blocks and a multi-level grid refined around
+ *	the vorticity patch of the advection/diffusion tests up to lmax.
+ *	Every component is run once to warm up and then reps times, the fastest
+ *	repetition gives the throughput. The results are written as JSON (-out)
+ *	and, if -baseline names the JSON of an earlier run, compared to it: a
+ *	throughput below (1-tolerance) times the baseline is a regression and
+ *	makes the benchmark exit with 1.
+ *
+ *	./if2d-bench -bpd 16 -lmax 4 -fmm-theta 0.5 -nthreads 8 -baseline ../benchmarks/baseline.json
+ *
+ */
+#pragma once
+
+#include "I2D_Headers.h"
+#include "I2D_Types.h"
+
+class I2D_Benchmark: public I2D_Test
+{
+	struct Result
+	{
+		string sCase, sComponent, sUnit;
+		int nblocks;
+		double tmin, tmedian, work;
+
+		double throughput() const { return work/tmin; }
+	};
+
+	ArgumentParser parser;
+
+	int BPD, LMAX, JUMP, REPS, NTHREADS;
+	Real RTOL, CTOL, TOLERANCE;
+	string sOUTPUT, sBASELINE;
+
+	Grid<W,B> * grid;
+	Refiner * refiner;
+	Compressor * compressor;
+	BlockFWT<W, B, vorticity_projector, false, 1> fwt_omega;
+
+	vector<Result> results;
+	int nregressions;
+
+	static void _ic(Grid<W,B>& grid);
+	void _setup(const bool bUniform);
+	void _cleanup();
+
+	template<typename Kernel>
+	void _measure(const string sCase, const string sComponent, const string sUnit, Kernel& kernel);
+
+	void _run(const string sCase, const bool bUniform);
+	void _write() const;
+	void _compare();
+
+public:
+
+	I2D_Benchmark(const int argc, const char ** argv);
+	~I2D_Benchmark();
+
+	void run();
+	void paint() {}
+
+	int regressions() const { return nregressions; }
+};
@@ -0,0 +1,24 @@
+/*
+ *  I2D_BenchmarkMain.cpp
+ *  IncompressibleFluids2D
+ *
+ */
+
+#include "I2D_Benchmark.h"
+
+using namespace MRAG;
+using namespace std;
+
+int main (int argc,  const char ** argv)
+{
+	ArgumentParser parser(argc, argv);
+
+	Environment::setup(max(1, parser("-nthreads").asInt()));
+	NUMATopology::setup(parser("-numa").asInt());
+	MemoryPool::setHugePages(parser("-hugepages").asBool());
+
+	I2D_Benchmark benchmark(argc, argv);
+	benchmark.run();
+
+	return benchmark.regressions() > 0 ? 1 : 0;
+}
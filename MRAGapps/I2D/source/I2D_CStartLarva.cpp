@@ -11,7 +11,6 @@
 #include "I2D_VectorBlockLab.h"
 #include "I2D_GradOfVector.h"
 #include <limits>
-#include <omp.h>
 
 I2D_CStartLarva::CStartLarva::CStartLarva(double xm, double ym, double _D, double Tprep, double Tprop, double phase, double tau, double angle_rad, vector<double> BASELINE, vector<double> CURVATURE, double angleInSpace_rad,
 					   double eps, const int LMAX, const bool isSharp):  Tprep(Tprep), Tprop(Tprop), StefanFish(xm, ym, _D, Tprop, phase, tau, angle_rad, BASELINE, CURVATURE, angleInSpace_rad, eps, LMAX, isSharp)
@@ -159,27 +158,22 @@ void I2D_CStartLarva::CStartLarva::updateInSpace(const double t)
 	_createShapeBoundary(X, Y, W, NORX, NORY, SHAPEX, SHAPEY, N);
 	_fillDefGrid();
 
-	// Go into center of mass frame of reference
-	_getCenterOfMassFull(hCMX, hCMY); xxx = hCMX; yyy = hCMY;
+	// Go into center of mass frame of reference (mass, momenta and inertia in a single pass)
+	_getMomentsFull(hCMX, hCMY, hVCMX, hVCMY, cmL, cmII); xxx = hCMX; yyy = hCMY;
 	if(xxx<0.0){ printf("cazzo xxx negative!!\n"); abort(); }
 
-	_getVelCenterOfMassFull(hVCMX, hVCMY);
 	_centerlineCenterOfMassFrameTransform(hCMX, hCMY, hVCMX, hVCMY);
 	_defGridCenterOfMassFrameTransform(hCMX, hCMY, hVCMX, hVCMY);
 
 	// Correction for the rotational impulse in the center of mass reference frame
-	_getAngularMomentumFull(cmL);
-	_getScalarMomentOfInertiaFull(cmII);
 	omega = -cmL/cmII;
 	_correctCenterlineForRotationalImpulse(omega);
 	_correctDefGridForRotationalImpulse(omega);
 
 #ifndef NDEBUG
 	// Check, the angular momentum here should be almost zero
-	double hL = 0.0;
-	_getCenterOfMassFull(hCMX, hCMY);
-	_getVelCenterOfMassFull(hVCMX, hVCMY);
-	_getAngularMomentumFull(hL);
+	double hL = 0.0, hII = 0.0;
+	_getMomentsFull(hCMX, hCMY, hVCMX, hVCMY, hL, hII);
 	if( (fabs(hL) > 1e-10) || (fabs(hCMX) > 1e-10) || (fabs(hCMY) > 1e-10) || (fabs(hVCMX) > 1e-10) || (fabs(hVCMY) > 1e-10) )
 	{
 		printf("(Everything should be zero!) cmx=%e, cmy=%e\n", hCMX, hCMY);
@@ -13,7 +13,235 @@
 #include "I2D_VectorBlockLab.h"
 #include "I2D_GradOfVector.h"
 #include <limits>
-#include <omp.h>
+#include <tbb/parallel_reduce.h>
+
+namespace FishEngine
+{
+// Runs a member kernel of the fish on a range of columns of its grids
+template<typename F>
+struct ColumnRange
+{
+	F * fish;
+	void (F::*kernel)(const int, const int);
+
+	ColumnRange(F * fish, void (F::*kernel)(const int, const int)): fish(fish), kernel(kernel) {}
+
+	ColumnRange(const ColumnRange& c): fish(c.fish), kernel(c.kernel) {}
+
+	inline void operator()(const blocked_range<int>& range) const
+	{
+		(fish->*kernel)(range.begin(), range.end());
+	}
+};
+
+// Runs a member kernel of the fish on the chunks of columns 2k+parity, one chunk per task
+template<typename F>
+struct ChunkRange
+{
+	F * fish;
+	void (F::*kernel)(const int, const int);
+	const int width, ncolumns, nchunks, parity;
+
+	ChunkRange(F * fish, void (F::*kernel)(const int, const int), const int width, const int ncolumns, const int nchunks, const int parity):
+		fish(fish), kernel(kernel), width(width), ncolumns(ncolumns), nchunks(nchunks), parity(parity) {}
+
+	ChunkRange(const ChunkRange& c): fish(c.fish), kernel(c.kernel), width(c.width), ncolumns(c.ncolumns), nchunks(c.nchunks), parity(c.parity) {}
+
+	inline void operator()(const blocked_range<int>& range) const
+	{
+		for(int k=range.begin(); k<range.end(); k++)
+		{
+			const int c = 2*k + parity;
+			(fish->*kernel)(c*width, c==nchunks-1 ? ncolumns : (c+1)*width);
+		}
+	}
+};
+
+// Raw moments of the deformation grid weighted by the characteristic function, all in one pass
+struct DefGridMoments
+{
+	const double * X, * Y, * VX, * VY, * CHI;
+	double M, Sx, Sy, Svx, Svy, L, II;
+
+	DefGridMoments(const double * X, const double * Y, const double * VX, const double * VY, const double * CHI):
+		X(X), Y(Y), VX(VX), VY(VY), CHI(CHI), M(0), Sx(0), Sy(0), Svx(0), Svy(0), L(0), II(0)
+	{
+	}
+
+	DefGridMoments(const DefGridMoments& c, tbb::split):
+		X(c.X), Y(c.Y), VX(c.VX), VY(c.VY), CHI(c.CHI), M(0), Sx(0), Sy(0), Svx(0), Svy(0), L(0), II(0)
+	{
+	}
+
+	void join(const DefGridMoments& c)
+	{
+		M += c.M;
+		Sx += c.Sx;
+		Sy += c.Sy;
+		Svx += c.Svx;
+		Svy += c.Svy;
+		L += c.L;
+		II += c.II;
+	}
+
+	void operator()(const blocked_range<int>& range)
+	{
+		for(int i=range.begin(); i<range.end(); i++)
+		{
+			const double Xs = CHI[i];
+
+			M += Xs;
+			Sx += Xs*X[i];
+			Sy += Xs*Y[i];
+			Svx += Xs*VX[i];
+			Svy += Xs*VY[i];
+			L += Xs*( X[i]*VY[i] - Y[i]*VX[i] );
+			II += Xs*( X[i]*X[i] + Y[i]*Y[i] );
+		}
+	}
+};
+
+// x <- R x + dx, v <- R (v + omega x) + dv on every node of the deformation grid
+struct TransformDefGrid
+{
+	double * X, * Y, * VX, * VY;
+	double R[2][2], dx[2], dv[2], omega;
+
+	TransformDefGrid(double * X, double * Y, double * VX, double * VY, const double _R[2][2], const double _dx[2], const double _dv[2], const double omega):
+		X(X), Y(Y), VX(VX), VY(VY), omega(omega)
+	{
+		for(int i=0; i<2; i++)
+		{
+			R[i][0] = _R[i][0];
+			R[i][1] = _R[i][1];
+			dx[i] = _dx[i];
+			dv[i] = _dv[i];
+		}
+	}
+
+	TransformDefGrid(const TransformDefGrid& c): X(c.X), Y(c.Y), VX(c.VX), VY(c.VY), omega(c.omega)
+	{
+		memcpy(R, c.R, sizeof(R));
+		memcpy(dx, c.dx, sizeof(dx));
+		memcpy(dv, c.dv, sizeof(dv));
+	}
+
+	inline void operator()(const blocked_range<int>& range) const
+	{
+		for(int i=range.begin(); i<range.end(); i++)
+		{
+			const double xx = X[i];
+			const double yy = Y[i];
+			const double vx = VX[i] - omega*yy;
+			const double vy = VY[i] + omega*xx;
+
+			X[i] = R[0][0]*xx + R[0][1]*yy + dx[0];
+			Y[i] = R[1][0]*xx + R[1][1]*yy + dx[1];
+			VX[i] = R[0][0]*vx + R[0][1]*vy + dv[0];
+			VY[i] = R[1][0]*vx + R[1][1]*vy + dv[1];
+		}
+	}
+};
+
+// Raw moments of the uniform maps, restricted to the rasterized band
+struct UniformMapMoments
+{
+	const double * CHI, * VDEFX, * VDEFY;
+	const int * bandStart, * bandEnd;
+	int MAPSIZEX;
+	double H;
+	double M, Sx, Sy, Svx, Svy, Sxvy, Syvx, Sxx, Syy;
+
+	UniformMapMoments(const double * CHI, const double * VDEFX, const double * VDEFY, const int * bandStart, const int * bandEnd, const int MAPSIZEX, const double H):
+		CHI(CHI), VDEFX(VDEFX), VDEFY(VDEFY), bandStart(bandStart), bandEnd(bandEnd), MAPSIZEX(MAPSIZEX), H(H),
+		M(0), Sx(0), Sy(0), Svx(0), Svy(0), Sxvy(0), Syvx(0), Sxx(0), Syy(0)
+	{
+	}
+
+	UniformMapMoments(const UniformMapMoments& c, tbb::split):
+		CHI(c.CHI), VDEFX(c.VDEFX), VDEFY(c.VDEFY), bandStart(c.bandStart), bandEnd(c.bandEnd), MAPSIZEX(c.MAPSIZEX), H(c.H),
+		M(0), Sx(0), Sy(0), Svx(0), Svy(0), Sxvy(0), Syvx(0), Sxx(0), Syy(0)
+	{
+	}
+
+	void join(const UniformMapMoments& c)
+	{
+		M += c.M;
+		Sx += c.Sx;
+		Sy += c.Sy;
+		Svx += c.Svx;
+		Svy += c.Svy;
+		Sxvy += c.Sxvy;
+		Syvx += c.Syvx;
+		Sxx += c.Sxx;
+		Syy += c.Syy;
+	}
+
+	void operator()(const blocked_range<int>& range)
+	{
+		for(int iy=range.begin(); iy<range.end(); iy++)
+			for(int ix=bandStart[iy]; ix<bandEnd[iy]; ix++)
+			{
+				const double xx = (double)ix*H;
+				const double yy = (double)iy*H;
+				const int idx = ix + MAPSIZEX*iy;
+				const double Xs = CHI[idx];
+				const double vxx = VDEFX[idx];
+				const double vyy = VDEFY[idx];
+
+				M += Xs;
+				Sx += Xs*xx;
+				Sy += Xs*yy;
+				Svx += Xs*vxx;
+				Svy += Xs*vyy;
+				Sxvy += Xs*xx*vyy;
+				Syvx += Xs*yy*vxx;
+				Sxx += Xs*xx*xx;
+				Syy += Xs*yy*yy;
+			}
+	}
+};
+
+// Removes the spurious linear and angular momentum from the deformation velocities of the uniform maps
+struct CorrectUniformMap
+{
+	double * VDEFX, * VDEFY;
+	const int * bandStart, * bandEnd;
+	int MAPSIZEX;
+	double H, corrV[2], xcm[2], omega;
+
+	CorrectUniformMap(double * VDEFX, double * VDEFY, const int * bandStart, const int * bandEnd, const int MAPSIZEX, const double H, const double _corrV[2], const double _xcm[2], const double omega):
+		VDEFX(VDEFX), VDEFY(VDEFY), bandStart(bandStart), bandEnd(bandEnd), MAPSIZEX(MAPSIZEX), H(H), omega(omega)
+	{
+		corrV[0] = _corrV[0];
+		corrV[1] = _corrV[1];
+		xcm[0] = _xcm[0];
+		xcm[1] = _xcm[1];
+	}
+
+	CorrectUniformMap(const CorrectUniformMap& c): VDEFX(c.VDEFX), VDEFY(c.VDEFY), bandStart(c.bandStart), bandEnd(c.bandEnd), MAPSIZEX(c.MAPSIZEX), H(c.H), omega(c.omega)
+	{
+		corrV[0] = c.corrV[0];
+		corrV[1] = c.corrV[1];
+		xcm[0] = c.xcm[0];
+		xcm[1] = c.xcm[1];
+	}
+
+	inline void operator()(const blocked_range<int>& range) const
+	{
+		for(int iy=range.begin(); iy<range.end(); iy++)
+			for(int ix=bandStart[iy]; ix<bandEnd[iy]; ix++)
+			{
+				const double xx = (double)ix*H;
+				const double yy = (double)iy*H;
+				const int idx = ix + MAPSIZEX*iy;
+
+				VDEFX[idx] += - corrV[0] - omega*(yy-xcm[1]);
+				VDEFY[idx] += - corrV[1] + omega*(xx-xcm[0]);
+			}
+	}
+};
+}
 
 I2D_CarlingFish::Fish::Fish(double xm, double ym, double _D, double _T, double phase, double angle_rad, double angleInSpace_rad, double eps, const int LMAX, const bool isSharp):
 angle(angle_rad), angleInSpace(angleInSpace_rad), D(_D), xm(xm), ym(ym), phase(phase), angular_velocity(0), vx(0), vy(0), vdefx(0), vdefy(0), N(0), SIZEX(0), SIZEY(0), MAPSIZEX(0), MAPSIZEY(0),
@@ -117,6 +345,9 @@ m(1.0), J(1.0), WH(0), SB(0), WT(0), ST(0), T(_T), EXTENSION(4.0), EPS(0), DS( 0
 	memset(VDEFX,0,sizeMap*sizeof(double));
 	memset(VDEFY,0,sizeMap*sizeof(double));
 
+	bandStart.assign(MAPSIZEY, MAPSIZEX);
+	bandEnd.assign(MAPSIZEY, 0);
+
 	for(int i = 0; i < N; i++ )
 	{
 		S[i] = DS*(double)i;
@@ -175,11 +406,37 @@ int I2D_CarlingFish::Fish::_ud2l(const int & ix, const int & iy) const
 
 void I2D_CarlingFish::Fish::clearUniformGrids()
 {
-	const int sizeMap = MAPSIZEX*MAPSIZEY;
-	memset(CHI,0,sizeMap*sizeof(double));
-	memset(VDEFX,0,sizeMap*sizeof(double));
-	memset(VDEFY,0,sizeMap*sizeof(double));
-	memset(CHI2,0,sizeMap*sizeof(double));
+	// Only the band written since the last clear can be nonzero
+	for(int iy=0; iy<MAPSIZEY; iy++)
+	{
+		if (bandStart[iy] >= bandEnd[iy]) continue;
+
+		const int offset = _ud2l(bandStart[iy], iy);
+		const int n = bandEnd[iy] - bandStart[iy];
+
+		memset(CHI+offset,0,n*sizeof(double));
+		memset(VDEFX+offset,0,n*sizeof(double));
+		memset(VDEFY+offset,0,n*sizeof(double));
+		memset(CHI2+offset,0,n*sizeof(double));
+
+		bandStart[iy] = MAPSIZEX;
+		bandEnd[iy] = 0;
+	}
+}
+
+bool I2D_CarlingFish::Fish::_inBand(const double x, const double y) const
+{
+	// All the sampling stencils read the maps within [floor-1, floor+2] (clamped to the map)
+	const int sx = min(MAPSIZEX-1, max(0, (int)floor(x)-1));
+	const int sy = min(MAPSIZEY-1, max(0, (int)floor(y)-1));
+	const int ex = min(MAPSIZEX-1, sx+3);
+	const int ey = min(MAPSIZEY-1, sy+3);
+
+	for(int iy=sy; iy<=ey; iy++)
+		if (bandStart[iy] <= ex && bandEnd[iy] > sx)
+			return true;
+
+	return false;
 }
 
 double I2D_CarlingFish::Fish::mollified_heaviside(const double dist, const double eps)
@@ -540,6 +797,7 @@ double I2D_CarlingFish::Fish::sample(const double x_, const double y_, const dou
 	const double myh = 1./(MAPSIZEX-1);
 	if (xobject[0]< myh || xobject[0] > 1.0 ) return 0;
 	if (xobject[1]< myh || xobject[1] > 1.0 ) return 0;
+	if (!_inBand(xobject[0]*(MAPSIZEX-1), xobject[1]*(MAPSIZEY-1))) return 0;
 	return _sample(xobject[0]*(MAPSIZEX-1), xobject[1]*(MAPSIZEY-1), h_);
 }
 
@@ -562,6 +820,7 @@ void I2D_CarlingFish::Fish::sample(const double x_, const double y_, double & Xs
 	const double myh = 1./(MAPSIZEX-1);
 	if (xobject[0]< myh || xobject[0] > 1.0 ) return;
 	if (xobject[1]< myh || xobject[1] > 1.0 ) return;
+	if (!_inBand(xobject[0]*(MAPSIZEX-1), xobject[1]*(MAPSIZEY-1))) return;
 	_sample(xobject[0]*(MAPSIZEX-1), xobject[1]*(MAPSIZEY-1), Xs, defvelx, defvely, h_);
 
 	//SIMPLE BACK ROTATION!
@@ -585,6 +844,7 @@ double I2D_CarlingFish::Fish::sample(const double x_, const double y_) const
   const double myh = 1./(MAPSIZEX-1);
   if (xobject[0]< myh || xobject[0] > 1.0 ) return 0;
   if (xobject[1]< myh || xobject[1] > 1.0 ) return 0;
+  if (!_inBand(xobject[0]*(MAPSIZEX-1), xobject[1]*(MAPSIZEY-1))) return 0;
   return _sample(xobject[0]*(MAPSIZEX-1), xobject[1]*(MAPSIZEY-1));
 }
 
@@ -607,6 +867,7 @@ void I2D_CarlingFish::Fish::sample(const double x_, const double y_, double & Xs
   const double myh = 1./(MAPSIZEX-1);
   if (xobject[0]< myh || xobject[0] > 1.0 ) return;
   if (xobject[1]< myh || xobject[1] > 1.0 ) return;
+  if (!_inBand(xobject[0]*(MAPSIZEX-1), xobject[1]*(MAPSIZEY-1))) return;
   _sample(xobject[0]*(MAPSIZEX-1), xobject[1]*(MAPSIZEY-1), Xs, defvelx, defvely);
 
   //SIMPLE BACK ROTATION!                                                                                                                                                                                                                                                                                               
@@ -690,27 +951,22 @@ void I2D_CarlingFish::Fish::updateInSpace(const double t)
 	_createShapeBoundary(X, Y, W, NORX, NORY, SHAPEX, SHAPEY, N);
 	_fillDefGrid();	
 
-	// Go into center of mass frame of reference
-	_getCenterOfMassFull(hCMX, hCMY); xxx = hCMX; yyy = hCMY;
+	// Go into center of mass frame of reference (mass, momenta and inertia in a single pass)
+	_getMomentsFull(hCMX, hCMY, hVCMX, hVCMY, cmL, cmII); xxx = hCMX; yyy = hCMY;
 	if(xxx<0.0){ printf("cazzo xxx negative!!\n"); abort(); }
 
-	_getVelCenterOfMassFull(hVCMX, hVCMY);
 	_centerlineCenterOfMassFrameTransform(hCMX, hCMY, hVCMX, hVCMY);
 	_defGridCenterOfMassFrameTransform(hCMX, hCMY, hVCMX, hVCMY);
 
 	// Correction for the rotational impulse in the center of mass reference frame
-	_getAngularMomentumFull(cmL);
-	_getScalarMomentOfInertiaFull(cmII);
 	omega = -cmL/cmII;
 	_correctCenterlineForRotationalImpulse(omega);
 	_correctDefGridForRotationalImpulse(omega);
 
 #ifndef NDEBUG
 	// Check, the angular momentum here should be almost zero
-	double hL = 0.0;
-	_getCenterOfMassFull(hCMX, hCMY);		
-	_getVelCenterOfMassFull(hVCMX, hVCMY);	
-	_getAngularMomentumFull(hL);	
+	double hL = 0.0, hII = 0.0;
+	_getMomentsFull(hCMX, hCMY, hVCMX, hVCMY, hL, hII);
 	if( (fabs(hL) > 1e-10) || (fabs(hCMX) > 1e-10) || (fabs(hCMY) > 1e-10) || (fabs(hVCMX) > 1e-10) || (fabs(hVCMY) > 1e-10) )
 	{
 		printf("(Everything should be zero!) cmx=%e, cmy=%e\n", hCMX, hCMY);
@@ -918,104 +1174,31 @@ void I2D_CarlingFish::Fish::_getUniformGridProperties()
 {
 	const double H = 1.0/(MAPSIZEX-1);
 
-	double lcum = 0.0;
-	double IIcum = 0.0;
-	double M = 0.0;
-	double meanVx = 0.0;
-	double meanVy = 0.0;
-	double meanX = 0.0;
-	double meanY = 0.0;
-
-	// Compute actual center of mass and mean velocity
-#pragma omp parallel for reduction(+:M,meanVx,meanVy,meanX,meanY) schedule(static,1)
-	for(int ix=0; ix<MAPSIZEX; ix++)
-		for(int iy=0; iy<MAPSIZEY; iy++)
-		{
-			const double xx = (double)ix*H;
-			const double yy = (double)iy*H;
-			const int idx = _ud2l(ix,iy);
-			const double Xs = CHI[idx];
-			const double vxx = VDEFX[idx];
-			const double vyy = VDEFY[idx];
-			M += Xs;
-			meanVx += Xs*vxx;
-			meanVy += Xs*vyy;
-			meanX += Xs*xx;
-			meanY += Xs*yy;
-		}
-	const double corrVx = meanVx/M;
-	const double corrVy = meanVy/M;
-	const double xxcm = meanX/M;
-	const double yycm = meanY/M;
-
-	// Compute actual angular momentum and scalar momentum of inertia
-	lcum = IIcum = M = meanVx = meanVy = meanX = meanY = 0.0;
-#pragma omp parallel for reduction(+:lcum,IIcum) schedule(static,1)
-	for(int ix=0; ix<MAPSIZEX; ix++)
-		for(int iy=0; iy<MAPSIZEY; iy++)
-		{
-			const double xx = (double)ix*H;
-			const double yy = (double)iy*H;
-			const int idx = _ud2l(ix,iy);
-			VDEFX[idx] -= corrVx;
-			VDEFY[idx] -= corrVy;
-
-			const double Xs = CHI[idx];
-			const double vxx = VDEFX[idx];
-			const double vyy = VDEFY[idx];
-			lcum += Xs*( (xx-xxcm)*vyy - (yy-yycm)*vxx );
-			IIcum += Xs*( (xx-xxcm)*(xx-xxcm) + (yy-yycm)*(yy-yycm) );
-		}
-	const double omega = -lcum/IIcum;
+	// Mass, momentum, angular momentum and inertia in a single pass over the rasterized band
+	FishEngine::UniformMapMoments moments(CHI, VDEFX, VDEFY, &bandStart.front(), &bandEnd.front(), MAPSIZEX, H);
+	Multithreading::deterministic_reduce(MAPSIZEY, moments, 16);
 
-	// Perform the necessary corrections
-	lcum = IIcum = M = meanVx = meanVy = meanX = meanY = 0.0;
-#pragma omp parallel for
-	for(int ix=0; ix<MAPSIZEX; ix++)
-		for(int iy=0; iy<MAPSIZEY; iy++)
-		{
-			const double xx = (double)ix*H;
-			const double yy = (double)iy*H;
-			const int idx = _ud2l(ix,iy);
-
-			double vRotX = 0.0;
-			double vRotY = 0.0;
-			_getRotationalVelocityAboutTheOrigin(omega, (xx-xxcm), (yy-yycm), vRotX, vRotY);
-			VDEFX[idx] += vRotX;
-			VDEFY[idx] += vRotY;
-		}
+	const double M = moments.M;
+	const double corrV[2] = { moments.Svx/M, moments.Svy/M };
+	const double xcm[2] = { moments.Sx/M, moments.Sy/M };
 
-#ifndef NDEBUG
-	lcum = IIcum = M = meanVx = meanVy = meanX = meanY = 0.0;
-#pragma omp parallel for reduction(+:M,meanVx,meanVy,lcum,IIcum) schedule(static,1)
-	for(int ix=0; ix<MAPSIZEX; ix++)
-		for(int iy=0; iy<MAPSIZEY; iy++)
-		{
-			const double xx = (double)ix*H;
-			const double yy = (double)iy*H;
-			const int idx = _ud2l(ix,iy);
+	// Angular momentum (after the removal of corrV) and inertia about the center of mass
+	const double lcum = (moments.Sxvy - moments.Syvx) - M*(xcm[0]*corrV[1] - xcm[1]*corrV[0]);
+	const double IIcum = (moments.Sxx + moments.Syy) - M*(xcm[0]*xcm[0] + xcm[1]*xcm[1]);
+	const double omega = -lcum/IIcum;
 
-			const double Xs = CHI[idx];
-			const double vxx = VDEFX[idx];
-			const double vyy = VDEFY[idx];
+	// Perform the necessary corrections (outside the band the characteristic function is zero)
+	FishEngine::CorrectUniformMap correct(VDEFX, VDEFY, &bandStart.front(), &bandEnd.front(), MAPSIZEX, H, corrV, xcm, omega);
+	tbb::parallel_for(blocked_range<int>(0, MAPSIZEY), correct, auto_partitioner());
 
-			M += Xs;
-			meanVx += Xs*vxx;
-			meanVy += Xs*vyy;
-			lcum += Xs*( (xx-xxcm)*vyy - (yy-yycm)*vxx );
-			IIcum += Xs*( (xx-xxcm)*(xx-xxcm) + (yy-yycm)*(yy-yycm) );
-		}
-	const double meanVxAfter = meanVx/M;
-	const double meanVyAfter = meanVy/M;
-	const double omegaAfter = -lcum/IIcum;
-	const double offsetX = (0.5+traslX);
-	const double offsetY = (0.5+traslY);
+#ifndef NDEBUG
+	FishEngine::UniformMapMoments check(CHI, VDEFX, VDEFY, &bandStart.front(), &bandEnd.front(), MAPSIZEX, H);
+	Multithreading::deterministic_reduce(MAPSIZEY, check, 16);
 
-	//printf("meanVxAfter=%e\n",meanVxAfter);
-	//printf("meanVyAfter=%e\n",meanVyAfter);
-	//printf("offsetX=%e\n",(offsetX-xxcm));
-	//printf("offsetY=%e\n",(offsetY-yycm));
-	//printf("omegaAfter=%e\n",omegaAfter);
+	const double meanVxAfter = check.Svx/check.M;
+	const double meanVyAfter = check.Svy/check.M;
+	const double lAfter = (check.Sxvy - check.Syvx) - (xcm[0]*check.Svy - xcm[1]*check.Svx);
+	const double omegaAfter = -lAfter/IIcum;
 
 	if( (fabs(meanVxAfter) > 1e-10) || (fabs(meanVyAfter) > 1e-10) || (fabs(omegaAfter) > 1e-10) )
 	{
@@ -1057,20 +1240,13 @@ void I2D_CarlingFish::Fish::_getDefGridCharFunc(const int & ix, const int & iy,
 	sdf = signIn*minDist;
 }
 
-void I2D_CarlingFish::Fish::_fillDefGrid()
-{	
-	// Set variables
+void I2D_CarlingFish::Fish::_fillDefGridColumns(const int ixStart, const int ixEnd)
+{
 	const int coeff = floor((double)(N-1)/(double)(SIZEX-1));
 	const double dg = (double)(coeff)*DS;
-
-	// Check consistency
-	if( coeff*(SIZEX-1) != (N-1) ){ printf("non multiple!\n"); abort(); }
-
 	const int spanY = (int)((double)(SIZEY-1)/2.0);
-	if( SIZEY != 2*spanY+1 ){ printf("Error span!\n"); abort(); }
 
-#pragma omp parallel for 
-	for(int ix = 0; ix<SIZEX; ix++)
+	for(int ix = ixStart; ix<ixEnd; ix++)
 		for(int iy = -spanY; iy<=spanY; iy++)
 		{
 			double xCoord = 0.0;
@@ -1087,29 +1263,37 @@ void I2D_CarlingFish::Fish::_fillDefGrid()
 
 			double sdf = 0.0;
 			_getDefGridCharFunc(ix, iy+spanY, spanY, dg, coeff, X, Y, W, sdf);
-			dataDist[ _dd2l(ix,iy+spanY) ] = sdf;
+			dataDist[ _dd2l(ix,iy+spanY) ] = mollified_heaviside(sdf,EPS);
 			dataSDF [ _dd2l(ix,iy+spanY) ] = sdf;
 		}
+}
 
-#pragma omp parallel for
-	for(int ix = 0; ix<SIZEX; ix++)
-		for(int iy = 0; iy<SIZEY; iy++)
-		{
-		  dataDist[ _dd2l(ix,iy) ] = mollified_heaviside(dataDist[ _dd2l(ix,iy) ],EPS);
-		}
+void I2D_CarlingFish::Fish::_fillDefGrid()
+{	
+	// Check consistency
+	const int coeff = floor((double)(N-1)/(double)(SIZEX-1));
+	if( coeff*(SIZEX-1) != (N-1) ){ printf("non multiple!\n"); abort(); }
+
+	const int spanY = (int)((double)(SIZEY-1)/2.0);
+	if( SIZEY != 2*spanY+1 ){ printf("Error span!\n"); abort(); }
 
+	FishEngine::ColumnRange<Fish> fill(this, &Fish::_fillDefGridColumns);
+	tbb::parallel_for(blocked_range<int>(0, SIZEX), fill, auto_partitioner());
+}
+
+void I2D_CarlingFish::Fish::_transformDefGrid(const double R[2][2], const double dx[2], const double dv[2], const double omega)
+{
+	FishEngine::TransformDefGrid transform(dataX, dataY, dataVX, dataVY, R, dx, dv, omega);
+	tbb::parallel_for(blocked_range<int>(0, SIZEX*SIZEY), transform, auto_partitioner());
 }
 
 void I2D_CarlingFish::Fish::_rigidTranslation(const Real x, const Real y )
 {
-#pragma omp parallel for
-	for(int ix = 0; ix<SIZEX; ix++)
-		for(int iy = 0; iy<SIZEY; iy++)
-		{
-			const int idx = _dd2l(ix,iy);
-			dataX[idx] += x;
-			dataY[idx] += y;			
-		}
+	const double R[2][2] = { {1, 0}, {0, 1} };
+	const double dx[2] = { x, y };
+	const double dv[2] = { 0, 0 };
+
+	_transformDefGrid(R, dx, dv, 0);
 }
 
 void I2D_CarlingFish::Fish::_cross(const double * v1, const double * v2, double * v3) const
@@ -1187,70 +1371,21 @@ bool I2D_CarlingFish::Fish::_bilinearTriangle(const double * p, const double * a
 	return (u>=0.0) && (t>=0.0) && (u+t<=1.0);
 }
 
-void I2D_CarlingFish::Fish::_getCenterOfMassFull(double & xCoord, double & yCoord) const
+void I2D_CarlingFish::Fish::_getMomentsFull(double & cmX, double & cmY, double & vcmX, double & vcmY, double & L, double & II) const
 {
-	double M = 0.0;
-	double xCum = 0.0;
-	double yCum = 0.0;
-#pragma omp parallel for reduction(+:xCum,yCum,M) schedule(static,1)
-	for(int ix=0; ix<SIZEX; ix++)
-		for(int iy=0; iy<SIZEY; iy++)
-		{
-			const int idx = _dd2l(ix,iy);
-			const double Xs = dataDist[idx];
-			xCum += Xs*dataX[idx];
-			yCum += Xs*dataY[idx];
-			M += Xs;
-		}
-	xCoord = xCum/M;
-	yCoord = yCum/M;
-}
+	FishEngine::DefGridMoments moments(dataX, dataY, dataVX, dataVY, dataDist);
+	Multithreading::deterministic_reduce(SIZEX*SIZEY, moments, 4096);
 
-void I2D_CarlingFish::Fish::_getVelCenterOfMassFull(double & vxCoord, double & vyCoord) const
-{
-	double M = 0.0;
-	double vxCum = 0.0;
-	double vyCum = 0.0;
-#pragma omp parallel for reduction(+:vxCum,vyCum,M) schedule(static,1)
-	for(int ix=0; ix<SIZEX; ix++)
-		for(int iy=0; iy<SIZEY; iy++)
-		{
-			const int idx = _dd2l(ix,iy);
-			const double Xs = dataDist[idx];
-			vxCum += Xs*dataVX[idx];
-			vyCum += Xs*dataVY[idx];
-			M += Xs;
-		}
-	vxCoord = vxCum/M;
-	vyCoord = vyCum/M;
-}
+	const double M = moments.M;
 
-void I2D_CarlingFish::Fish::_getAngularMomentumFull(double & L) const
-{
-	double lcum = 0.0;
-#pragma omp parallel for reduction(+:lcum) schedule(static,1)
-	for(int ix=0; ix<SIZEX; ix++)
-		for(int iy=0; iy<SIZEY; iy++)
-		{
-			const int idx = _dd2l(ix,iy);
-			const double Xs = dataDist[idx];
-			lcum += Xs*( dataX[idx]*dataVY[idx] - dataY[idx]*dataVX[idx] );
-		}
-	L = lcum*DS*DS;
-}
+	cmX = moments.Sx/M;
+	cmY = moments.Sy/M;
+	vcmX = moments.Svx/M;
+	vcmY = moments.Svy/M;
 
-void I2D_CarlingFish::Fish::_getScalarMomentOfInertiaFull(double & II) const
-{
-	double IIcum = 0.0;
-#pragma omp parallel for reduction(+:IIcum) schedule(static,1)
-	for(int ix=0; ix<SIZEX; ix++)
-		for(int iy=0; iy<SIZEY; iy++)
-		{			
-			const int idx = _dd2l(ix,iy);
-			const double Xs = dataDist[idx];
-			IIcum += Xs*( dataX[idx]*dataX[idx] + dataY[idx]*dataY[idx] );
-		}
-	II = IIcum*DS*DS;
+	// Angular momentum and inertia in the center of mass frame of reference
+	L = (moments.L - M*(cmX*vcmY - cmY*vcmX))*DS*DS;
+	II = (moments.II - M*(cmX*cmX + cmY*cmY))*DS*DS;
 }
 
 void I2D_CarlingFish::Fish::_centerlineCenterOfMassFrameTransform(const double & cmX, const double & cmY, const double & vcmX, const double & vcmY)
@@ -1266,16 +1401,11 @@ void I2D_CarlingFish::Fish::_centerlineCenterOfMassFrameTransform(const double &
 
 void I2D_CarlingFish::Fish::_defGridCenterOfMassFrameTransform(const double & cmX, const double & cmY, const double & vcmX, const double & vcmY)
 {
-#pragma omp parallel for
-	for(int ix=0; ix<SIZEX; ix++)
-		for(int iy=0; iy<SIZEY; iy++)
-		{
-			const int idx = _dd2l(ix,iy);
-			dataX[idx] -= cmX;
-			dataY[idx] -= cmY;
-			dataVX[idx] -= vcmX;
-			dataVY[idx] -= vcmY;
-		}
+	const double R[2][2] = { {1, 0}, {0, 1} };
+	const double dx[2] = { -cmX, -cmY };
+	const double dv[2] = { -vcmX, -vcmY };
+
+	_transformDefGrid(R, dx, dv, 0);
 }
 
 void I2D_CarlingFish::Fish::_getRotationalVelocityAboutTheOrigin(const double & omega, const double & rX, const double & rY, double & vRotX, double & vRotY) const
@@ -1298,17 +1428,11 @@ void I2D_CarlingFish::Fish::_correctCenterlineForRotationalImpulse(const double
 
 void I2D_CarlingFish::Fish::_correctDefGridForRotationalImpulse(const double & omega)
 {
-#pragma omp parallel for
-	for(int ix=0; ix<SIZEX; ix++)
-		for(int iy=0; iy<SIZEY; iy++)
-		{
-			const int idx = _dd2l(ix,iy);
-			double vRotX = 0.0;
-			double vRotY = 0.0;
-			_getRotationalVelocityAboutTheOrigin(omega, dataX[idx], dataY[idx], vRotX, vRotY);
-			dataVX[idx] += vRotX;
-			dataVY[idx] += vRotY;
-		}
+	const double R[2][2] = { {1, 0}, {0, 1} };
+	const double dx[2] = { 0, 0 };
+	const double dv[2] = { 0, 0 };
+
+	_transformDefGrid(R, dx, dv, omega);
 }
 
 void I2D_CarlingFish::Fish::_rotateAboutTheOrigin(const double & theta, double * x, double * y, const int n)
@@ -1328,36 +1452,101 @@ void I2D_CarlingFish::Fish::_rotateAboutTheOrigin(const double & theta, double *
 
 void I2D_CarlingFish::Fish::_rotateDefGridAboutTheOrigin(const double & theta)
 {
-	const double a00 = cos(theta);
-	const double a01 = -sin(theta);
-	const double a10 = sin(theta);
-	const double a11 = cos(theta);
-#pragma omp parallel for
-	for(int ix=0; ix<SIZEX; ix++)
-		for(int iy=0; iy<SIZEY; iy++)
+	const double R[2][2] = { {cos(theta), -sin(theta)}, {sin(theta), cos(theta)} };
+	const double dx[2] = { 0, 0 };
+	const double dv[2] = { 0, 0 };
+
+	_transformDefGrid(R, dx, dv, 0);
+}
+
+void I2D_CarlingFish::Fish::bilinearInterpolation()
+{
+	const double H = 1.0/(MAPSIZEX-1);
+
+	// The columns are rasterized by chunks, the even chunks and then the odd ones: CHI2 is written over the
+	// whole bounding box of a triangle, and the bounding boxes of adjacent columns overlap
+	const int ncolumns = SIZEX-1;
+	const int nchunks = min(16, ncolumns);
+	const int width = ncolumns/nchunks;
+
+	// Extend the band with the footprint of the triangles about to be rasterized, collect the footprint of the chunks
+	vector<int> chunkBox(4*nchunks);
+	for(int c=0; c<nchunks; c++)
+	{
+		chunkBox[4*c+0] = MAPSIZEX;
+		chunkBox[4*c+1] = 0;
+		chunkBox[4*c+2] = MAPSIZEY;
+		chunkBox[4*c+3] = 0;
+	}
+
+	for(int ixD=0; ixD<ncolumns; ixD++)
+	{
+		int * const box = &chunkBox[4*min(ixD/width, nchunks-1)];
+
+		for(int iyD=0; iyD<SIZEY-1; iyD++)
+		{
+			const int vertices[2][3] = {
+				{ _dd2l(ixD,iyD), _dd2l(ixD,iyD+1), _dd2l(ixD+1,iyD) },
+				{ _dd2l(ixD+1,iyD), _dd2l(ixD+1,iyD+1), _dd2l(ixD,iyD+1) }
+			};
+
+			for(int t=0; t<2; t++)
+			{
+				const double A[2] = { dataX[vertices[t][0]], dataY[vertices[t][0]] };
+				const double B[2] = { dataX[vertices[t][1]], dataY[vertices[t][1]] };
+				const double C[2] = { dataX[vertices[t][2]], dataY[vertices[t][2]] };
+
+				int ixMax = 0;
+				int ixMin = 0;
+				int iyMax = 0;
+				int iyMin = 0;
+				_boundingBoxTriangle(A, B, C, H, ixMax, ixMin, iyMax, iyMin);
+
+				for(int iy=iyMin; iy<iyMax; iy++)
+				{
+					bandStart[iy] = min(bandStart[iy], ixMin);
+					bandEnd[iy] = max(bandEnd[iy], ixMax);
+				}
+
+				box[0] = min(box[0], ixMin);
+				box[1] = max(box[1], ixMax);
+				box[2] = min(box[2], iyMin);
+				box[3] = max(box[3], iyMax);
+			}
+		}
+	}
+
+	// the chunks of a pass must not write the same points: a strongly bent body is rasterized serially
+	bool bDisjoint = true;
+	for(int c=0; c<nchunks; c++)
+		for(int d=c+2; d<nchunks; d+=2)
 		{
-			const int idx = _dd2l(ix,iy);
-			const double xx = dataX[idx];
-			const double yy = dataY[idx];
-			const double vx = dataVX[idx];
-			const double vy = dataVY[idx];
-			dataX[idx] = a00*xx + a01*yy;
-			dataY[idx] = a10*xx + a11*yy;
-			dataVX[idx] = a00*vx + a01*vy;
-			dataVY[idx] = a10*vx + a11*vy;
+			const int * const a = &chunkBox[4*c];
+			const int * const b = &chunkBox[4*d];
+
+			bDisjoint &= !(a[0]<b[1] && b[0]<a[1] && a[2]<b[3] && b[2]<a[3]);
 		}
+
+	if (!bDisjoint)
+	{
+		_rasterizeColumns(0, ncolumns);
+		return;
+	}
+
+	for(int parity=0; parity<2; parity++)
+	{
+		FishEngine::ChunkRange<Fish> rasterize(this, &Fish::_rasterizeColumns, width, ncolumns, nchunks, parity);
+		tbb::parallel_for(blocked_range<int>(0, (nchunks+1-parity)/2, 1), rasterize, simple_partitioner());
+	}
 }
 
-void I2D_CarlingFish::Fish::bilinearInterpolation()
+void I2D_CarlingFish::Fish::_rasterizeColumns(const int ixStart, const int ixEnd)
 {
 	const double H = 1.0/(MAPSIZEX-1);
-	const int sX = 0;
 	const int sY = 0;
-	const int eX = SIZEX-1;
 	const int eY = SIZEY-1;
 
-#pragma omp parallel for
-	for(int ixD=sX; ixD<eX; ixD++)
+	for(int ixD=ixStart; ixD<ixEnd; ixD++)
 		for(int iyD=sY; iyD<eY; iyD++)
 		{		
 			// First triangle
@@ -2103,7 +2292,7 @@ I2D_CarlingFish::~I2D_CarlingFish()
 
 void I2D_CarlingFish::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	if(!(shape->SHARP))
@@ -2118,6 +2307,33 @@ void I2D_CarlingFish::characteristic_function()
 	    }
 }
 
+bool I2D_CarlingFish::getBoundingBox(Real xmin[2], Real xmax[2]) const
+{
+	double bbox[2][2];
+	shape->bbox(eps, bbox[0], bbox[1]);
+
+	xmin[0] = bbox[0][0];
+	xmin[1] = bbox[0][1];
+	xmax[0] = bbox[1][0];
+	xmax[1] = bbox[1][1];
+
+	return true;
+}
+
+void I2D_CarlingFish::rasterize(const BlockInfo& info, FluidBlock2D& b) const
+{
+	if(!(shape->SHARP))
+	{
+		FloatingFish::FillBlocks fill(eps,shape);
+		fill(info, b);
+	}
+	else
+	{
+		FloatingFish::FillBlocksTowers fill(eps,shape);
+		fill(info, b);
+	}
+}
+
 void I2D_CarlingFish::restart(const double t, string filename)
 {
 	// Restart shape
@@ -2278,7 +2494,7 @@ void I2D_CarlingFish::create(const double t)
 	double vybar = 0.0;
 	double omegabar = 0.0;
 
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	map<int, vector<double> > integrals;
@@ -2348,7 +2564,7 @@ void I2D_CarlingFish::computeDesiredVelocity(const double t)
 	double vybar = 0.0;
 	double omegabar = 0.0;
 
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	map<int, vector<double> > integrals;
@@ -2383,19 +2599,13 @@ void I2D_CarlingFish::computeDesiredVelocity(const double t)
 	shape->J = J;
 
 	// Prepare desired velocity blocks
-	for	(map<int, const VelocityBlock *>::iterator it = desired_velocity.begin(); it!= desired_velocity.end(); it++)
-	{
-		assert(it->second != NULL);
-		VelocityBlock::deallocate(it->second);
-	}
 	desired_velocity.clear();
 	vector<pair< BlockInfo, VelocityBlock *> > velblocks;
 	for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
 	{
 		if(nonempty[it->blockID] == true)
 		{
-			VelocityBlock * velblock = VelocityBlock::allocate(1);
-			desired_velocity[it->blockID] = velblock;
+			VelocityBlock * velblock = desired_velocity.allocate(it->blockID);
 			velblocks.push_back(pair< BlockInfo, VelocityBlock *>(*it, velblock));
 		}
 	}
@@ -49,6 +49,9 @@ public:
 		double * VDEFX;
 		double * VDEFY;
 		double * dataSDF;
+
+		// Rows of the uniform maps touched by the rasterization since the last clear: [bandStart, bandEnd)
+		vector<int> bandStart, bandEnd;
 		
 		template<typename R> void _w2o(const R xw[2], R xo[2]) const;
 		template<typename R> void _o2w(const R xo[2], R xw[2]) const;
@@ -71,10 +74,11 @@ public:
 		void _getDefGridCharFunc(const int & ix, const int & iy, const int & spany, const double & dg, const int & coeff, const double * rX, const double * rY, const double * width, double & sdf) const;
 		void _fillDefGrid();
 		void _rigidTranslation(const Real x, const Real y );
-		void _getCenterOfMassFull(double & xCoord, double & yCoord) const;
-		void _getVelCenterOfMassFull(double & vxCoord, double & vyCoord) const;
-		void _getAngularMomentumFull(double & L) const;
-		void _getScalarMomentOfInertiaFull(double & II) const;
+		void _getMomentsFull(double & cmX, double & cmY, double & vcmX, double & vcmY, double & L, double & II) const;
+		void _transformDefGrid(const double R[2][2], const double dx[2], const double dv[2], const double omega);
+		void _fillDefGridColumns(const int ixStart, const int ixEnd);
+		void _rasterizeColumns(const int ixStart, const int ixEnd);
+		bool _inBand(const double x, const double y) const;
 		void _centerlineCenterOfMassFrameTransform(const double & cmX, const double & cmY, const double & vcmX, const double & vcmY);
 		void _defGridCenterOfMassFrameTransform(const double & cmX, const double & cmY, const double & vcmX, const double & vcmY);
 		void _getRotationalVelocityAboutTheOrigin(const double & omega, const double & rX, const double & rY, double & vRotX, double & vRotY) const;
@@ -134,6 +138,8 @@ public:
 	virtual ~I2D_CarlingFish();
 	
 	void characteristic_function();		
+	bool getBoundingBox(Real xmin[2], Real xmax[2]) const;
+	void rasterize(const BlockInfo& info, FluidBlock2D& b) const;
 	Real getD() const {return D;}
 	
 	void create(const double t);
@@ -11,7 +11,6 @@
 #include "I2D_VectorBlockLab.h"
 #include "I2D_GradOfVector.h"
 #include <limits>
-#include <omp.h>
 
 I2D_CarlingFishMorph::CarlingFishMorph::CarlingFishMorph(double xm, double ym, double _D, double _T, double phase, double angle_rad, vector<double> WIDTH, double angleInSpace_rad, double eps, const int LMAX):
 Fish(xm,ym,_D,_T,phase,angle_rad,angleInSpace_rad,eps,LMAX)
@@ -88,6 +88,8 @@ int main (int argc, const char ** argv)
 	ArgumentParser parser(argc, argv);
 
 	Environment::setup(max(1, parser("-nthreads").asInt()));
+	NUMATopology::setup(parser("-numa").asInt());
+	MemoryPool::setHugePages(parser("-hugepages").asBool());
 
 	if( parser("-study").asString() == "FLOW_PAST_FLOATING_OBSTACLE" )
 		test = new I2D_FlowPastFloatingObstacle(argc, argv);
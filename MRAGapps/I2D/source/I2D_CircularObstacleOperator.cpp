@@ -106,7 +106,7 @@ Real I2D_CircularObstacleOperator::mollified_heaviside(const Real x, const Real
 /*
 void I2D_CircularObstacleOperator::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	FillBlocks fill(smooth_radius+smoothing_length, smooth_radius, smoothing_length, position);
@@ -283,7 +283,7 @@ struct FillBlocksTowers
 
 void I2D_CircularObstacleOperator::characteristic_function()
 {
-  vector<BlockInfo> vInfo = grid.getBlocksInfo();
+  const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
   const BlockCollection<B>& coll = grid.getBlockCollection();
 
   if(!SHARP)
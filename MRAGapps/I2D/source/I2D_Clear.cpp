@@ -38,7 +38,7 @@ struct I2D_VelToZero
 
 void I2D_Clear::clearTmp(Grid<W,B> & grid)
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	I2D_TmpToZero clean;
@@ -47,7 +47,7 @@ void I2D_Clear::clearTmp(Grid<W,B> & grid)
 
 void I2D_Clear::clearVel(Grid<W,B> & grid)
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	I2D_VelToZero clean;
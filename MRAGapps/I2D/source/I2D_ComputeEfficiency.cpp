@@ -154,11 +154,11 @@ void I2D_ComputeEfficiency::compute(I2D_FloatingObstacleOperator * floatingObsta
 	{
 		I2D_FloatingObstacleVector * vec = static_cast<I2D_FloatingObstacleVector*>(floatingObstacle);
 
-		vector<BlockInfo> vInfo = grid.getBlocksInfo();
+		const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 		BoundaryInfo& binfo=grid.getBoundaryInfo();
 		const BlockCollection<B>& coll = grid.getBlockCollection();
 		map<int, Real> local_data;
-		for(vector<BlockInfo>::iterator it=vInfo.begin(); it!=vInfo.end(); it++)
+		for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
 			local_data[it->blockID] = 0;
 
 		// Get Masses
@@ -171,12 +171,23 @@ void I2D_ComputeEfficiency::compute(I2D_FloatingObstacleOperator * floatingObsta
 		vector<I2D_FloatingObstacleOperator *>::iterator it=agents.begin();
 		I2D_CarlingFishMorph * b = static_cast<I2D_CarlingFishMorph*>(*it);
 
+		// the hydrodynamic integrals are the ones of the computeDragAndStuff(t) of this step, called before
+		if(b->getDiagnosticsTime() != (Real)t)
+		{
+			printf("I2D_ComputeEfficiency: the diagnostics are of t=%e, not t=%e: call computeDragAndStuff(t) before compute(t). Aborting.\n", b->getDiagnosticsTime(), t);
+			abort();
+		}
+
 		vector< vector<double> > infoShapes;
 		vector<double> positions;
 		positions.push_back(b->shape->xm);
 		positions.push_back(b->shape->ym);
 		infoShapes.push_back(positions);
 
+		// Hydrodynamic integrals of this step (all the agents are done in one sweep)
+		vector<const I2D_FloatingObstacleOperator::Diagnostics *> diagShapes;
+		diagShapes.push_back(&b->getDiagnostics());
+
 		assert( masses.size() == (infoShapes.size()+1) );
 
 		// Compute dissipated power
@@ -212,6 +223,18 @@ void I2D_ComputeEfficiency::compute(I2D_FloatingObstacleOperator * floatingObsta
 
 		// Cloase file
 		fclose(ppFile);
+
+		// Per shape: force, torque, deformation power and efficiency (see I2D_FloatingObstacleOperator::Diagnostics)
+		ppFile = fopen("efficiencies_shapes.txt", "a");
+		assert(ppFile!=NULL);
+		fprintf(ppFile,"%e",t);
+		for(int i=0; i<diagShapes.size();++i)
+		{
+			const I2D_FloatingObstacleOperator::Diagnostics& diag = *diagShapes[i];
+			fprintf(ppFile," %e %e %e %e %e",diag.force[0],diag.force[1],diag.torque,diag.deformationPower,diag.efficiency);
+		}
+		fprintf(ppFile,"\n");
+		fclose(ppFile);
 	}
 }
 
@@ -30,6 +30,8 @@ public:
 
 	virtual ~I2D_ComputeEfficiency(){};
 
+	// appends the global energies to efficiencies.txt and the integrals of the shapes to efficiencies_shapes.txt,
+	// the diagnostics of floatingObstacle must be the ones of t: computeDragAndStuff(t) is called before
 	void compute(I2D_FloatingObstacleOperator * floatingObstacle, double t, double dt, double startTime, double endTime);
 };
 
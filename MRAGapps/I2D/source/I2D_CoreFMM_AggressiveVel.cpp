@@ -308,6 +308,17 @@ void I2D_CoreFMM_AggressiveVel::solve(const Real theta, const Real inv_scaling,
 	tick_count end = tick_count::now ();
 
 	if (timestamp++ % 5 == 0) profiler.printSummary();
+
+	{
+		double direct_evals = 0, indirect_evals = 0;
+		for (int i=0; i<nblocks; ++i) {
+			direct_evals += (double)measurements.num_direct_evals[i];
+			indirect_evals += (double)measurements.num_indirect_evals[i];
+		}
+
+		Profiler::countStep("FMM direct interactions", direct_evals);
+		Profiler::countStep("FMM indirect interactions", indirect_evals);
+	}
 	
 	if (b_verbose) {
 	
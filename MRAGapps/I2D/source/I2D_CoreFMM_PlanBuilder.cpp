@@ -106,7 +106,7 @@ void PlanBuilder::operator () (const blocked_range<int>& range) const {
 	{
 		const BlockInfo info = m_target_blocks [iblock];
 		
-		HCFMM::BoxIterator<tBox,tbb::scalable_allocator> it1(m_root_node);
+		HCFMM::BoxIterator<tBox,PoolAllocator> it1(m_root_node);
 		
 		bool canRemove;
 		
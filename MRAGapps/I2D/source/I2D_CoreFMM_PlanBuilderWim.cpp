@@ -52,7 +52,7 @@ void PlanBuilderWim::operator () (const blocked_range<int>& range) const
 	{
 		const BlockInfo info = m_target_blocks [iblock];
 		
-		HCFMM::BoxIterator<tBox,tbb::scalable_allocator> srcBox(m_root_node);
+		HCFMM::BoxIterator<tBox,PoolAllocator> srcBox(m_root_node);
 		
 		Real block_org[2];
 		info.pos(block_org,0,0);        
@@ -97,14 +97,14 @@ struct FloatVelocityBlock
 	
 	static FloatVelocityBlock * allocate()
 	{
-		cache_aligned_allocator<FloatVelocityBlock> allocator;
+		PoolAllocator<FloatVelocityBlock> allocator;
 		FloatVelocityBlock * ptr = allocator.allocate(1);
 		return ptr;
 	}
 	
 	static void deallocate(FloatVelocityBlock *& velblocks)
 	{
-		cache_aligned_allocator<FloatVelocityBlock> allocator;
+		PoolAllocator<FloatVelocityBlock> allocator;
 		allocator.deallocate(velblocks, 1);
 		velblocks = NULL;
 	}
@@ -181,12 +181,13 @@ public:
 	float xstart, ystart, h;
 };
 
+//the containers of the plan grow concurrently, per target block: per-thread heaps of tbb
 typedef std::vector <DirectInfo, tbb::scalable_allocator<DirectInfo > > DirectInfoVector;
 typedef std::vector <IndirectInfo, tbb::scalable_allocator<IndirectInfo > > IndirectInfoVector;
 typedef std::vector <std::pair <int,int>,  tbb::scalable_allocator<std::pair <int,int> > > IntervalVector;
 typedef std::vector <IntervalVector, tbb::scalable_allocator <IntervalVector> > IntervalVectors;
 typedef std::vector <std::vector <bool, tbb::scalable_allocator <bool> >, tbb::scalable_allocator <std::vector <bool, tbb::scalable_allocator <bool> > > > OverlappingVectors;
-typedef std::list <std::pair <int,int>, tbb::scalable_allocator <std::pair<int,int> > > IntervalList;
+typedef std::list <std::pair <int,int>, PoolAllocator <std::pair<int,int> > > IntervalList;
 
 class PlanPerBlock {
 public:
@@ -274,16 +275,18 @@ public:
 	}
 	
 	~SSE_Plan () {
+		MemoryArena& arena = MemoryArena::transient();
+		
 		if (m_direct_buffer_size > 0) {
 			assert (m_xs != NULL && m_ws != NULL && m_ws != NULL);
-			_mm_free (m_xs);
-			_mm_free (m_ys);
-			_mm_free (m_ws);
+			arena.deallocate (m_xs, sizeof(float)*m_direct_buffer_size);
+			arena.deallocate (m_ys, sizeof(float)*m_direct_buffer_size);
+			arena.deallocate (m_ws, sizeof(float)*m_direct_buffer_size);
 		}
 		if (m_indirect_buffer_size > 0) {
 			assert (m_real_values != NULL && m_imag_values != NULL);
-			_mm_free (m_real_values);
-			_mm_free (m_imag_values);
+			arena.deallocate (m_real_values, sizeof(float)*m_indirect_buffer_size);
+			arena.deallocate (m_imag_values, sizeof(float)*m_indirect_buffer_size);
 		}
 	}
 	
@@ -404,11 +407,11 @@ public:
 			assert (m_direct_buffer_size > 0);
 		}
 		
-		//allocate memory
+		//allocate memory, for the solve: from the transient arena (see MRAGMemoryPool.h)
 		assert (m_xs == NULL && m_ys == NULL && m_ws == NULL);
-		m_xs = (float*)_mm_malloc(sizeof(float)*m_direct_buffer_size, 16);
-		m_ys = (float*)_mm_malloc(sizeof(float)*m_direct_buffer_size, 16);
-		m_ws = (float*)_mm_malloc(sizeof(float)*m_direct_buffer_size, 16);
+		m_xs = (float*)MemoryArena::transient().allocate(sizeof(float)*m_direct_buffer_size);
+		m_ys = (float*)MemoryArena::transient().allocate(sizeof(float)*m_direct_buffer_size);
+		m_ws = (float*)MemoryArena::transient().allocate(sizeof(float)*m_direct_buffer_size);
 		
 		//copy data
 		TranslationMap::const_iterator map_iter;
@@ -607,8 +610,8 @@ public:
 		
 		assert (m_real_values == NULL && m_imag_values == NULL);
 		
-		m_real_values = (float*)_mm_malloc(sizeof(float)*m_indirect_buffer_size, 16);
-		m_imag_values = (float*)_mm_malloc(sizeof(float)*m_indirect_buffer_size, 16);
+		m_real_values = (float*)MemoryArena::transient().allocate(sizeof(float)*m_indirect_buffer_size);
+		m_imag_values = (float*)MemoryArena::transient().allocate(sizeof(float)*m_indirect_buffer_size);
 		
 		// loop over all elements in m_indirect_interactions
 		CreateExpansionPlan create_indirect_plan(m_real_values, m_imag_values, m_indirect_interactions, m_indirect_source_id2index, m_plan_per_block);
@@ -840,7 +843,7 @@ public:
 				{
 					ReduceDirectSourceContributions reduce_direct (m_plan.m_plan_per_block[i].m_direct_infos, target_info);
 					const int ndirect = m_plan.m_plan_per_block [i].m_direct_infos.size ();
-					parallel_reduce (tbb::blocked_range <int> (0,ndirect), reduce_direct, auto_partitioner ());
+					Multithreading::deterministic_reduce (ndirect, reduce_direct, 4);
 					
 					for (int d=0; d<2; ++d) 
 						for (int y=0; y<_BLOCKSIZE_; ++y) 
@@ -858,7 +861,7 @@ public:
 				{
 					ReduceIndirectSourceContributions reduce_indirect (m_plan.m_plan_per_block[i].m_indirect_infos, target_info);
 					const int nindirect = m_plan.m_plan_per_block [i].m_indirect_infos.size ();
-					parallel_reduce (tbb::blocked_range <int> (0,nindirect), reduce_indirect, auto_partitioner ());
+					Multithreading::deterministic_reduce (nindirect, reduce_indirect, 4);
 					
 					for (int d=0; d<2; ++d) 
 						for (int y=0; y<_BLOCKSIZE_; ++y) 
@@ -994,6 +997,17 @@ void I2D_CoreFMM_SSE::solve(const Real theta, const Real inv_scaling, BlockInfo
 	profiler.pop_stop();
 	
 	if(b_verbose || timestamp % 5 == 0) profiler.printSummary();
+
+	{
+		double direct_calls = 0, indirect_calls = 0;
+		for (int i=0; i<evaluator.m_num_target_blocks; ++i) {
+			direct_calls += evaluator.m_plan.m_plan_per_block [i].m_direct_infos.size ();
+			indirect_calls += evaluator.m_plan.m_plan_per_block [i].m_indirect_infos.size ();
+		}
+
+		Profiler::countStep("FMM direct interactions", direct_calls);
+		Profiler::countStep("FMM indirect interactions", indirect_calls);
+	}
 	
 	if((b_verbose && timestamp % 5 == 0) || timestamp % 10 == 0)
 	{
@@ -0,0 +1,187 @@
+/*
+ *  I2D_CoreParticlesRK.h
+ *  IncompressibleFluids2D
+ *
+ *	Midpoint push and M'4 remeshing for the CFL particles. Same kernels as
+ *	I2D_CoreParticles, but the particle set is extended by MARGIN cells beyond
+ *	the default one so that particles travelling up to (1+MARGIN) cells per
+ *	step are still remeshed.
+ *
+ *	The remeshing is a gather: every block collects the contributions of its
+ *	own particles and of the ghost particles of the lab, so no two threads ever
+ *	write into the same block. The ghost particles are seeded on the lab, i.e.
+ *	on the neighbours interpolated at the resolution of the block: across a
+ *	level jump they are not the particles of the neighbour, and nothing is
+ *	scattered onto a neighbour at its own resolution. The remeshing is not
+ *	level-aware and does not allow a larger LCFL than I2D_CoreParticles.
+ *
+ */
+#pragma once
+
+#include "I2D_CoreParticles.h"
+
+template<int MARGIN>
+class I2D_CoreParticlesRK
+{
+	static const int KS = -1;
+	static const int KE = +3;
+
+	static const int VSX = -3 - MARGIN;
+	static const int VSY = -3 - MARGIN;
+
+	static const int VEX = B::sizeX + 3 + MARGIN;
+	static const int VEY = B::sizeY + 3 + MARGIN;
+
+	static const int PSX = -2 - MARGIN;
+	static const int PSY = -2 - MARGIN;
+
+	static const int PEX = B::sizeX + 2 + MARGIN;
+	static const int PEY = B::sizeY + 2 + MARGIN;
+
+	static const int NPX = PEX-PSX;
+	static const int NPY = PEY-PSY;
+
+	inline void _computeWeights(const Real xp[2], const Real ap[2], Real (weights[2])[4]) const
+	{
+		for(int c=0; c<2; c++)
+		{
+			const Real t[4] = {
+				fabs(xp[c] - (ap[c] + -1)),
+				fabs(xp[c] - (ap[c] + +0)),
+				fabs(xp[c] - (ap[c] + +1)),
+				fabs(xp[c] - (ap[c] + +2))
+			};
+
+			for(int i=0; i<4; i++)
+				weights[c][i] = a0[i] + t[i]*(a1[i] + t[i]*(a2[i] + t[i]*a3[i]));
+		}
+	}
+
+	//velocity (in cells per step) at the position xp, measured in cells from the block origin
+	template<typename LabVel>
+	inline void _velocity(const Real xp[2], LabVel& lab, const Real factor, const Real Uinf[2], Real k[2]) const
+	{
+		const Real ap[2] = {
+			floor(xp[0]),
+			floor(xp[1]) };
+
+		const int iap[2] = {
+			(int)ap[0],
+			(int)ap[1] };
+
+		Real w[2][4];
+		_computeWeights(xp, ap, w);
+
+		const int start[2] = {
+			max(KS, VSX - iap[0]),
+			max(KS, VSY - iap[1])
+		};
+
+		const int end[2] = {
+			min(KE, VEX - iap[0]),
+			min(KE, VEY - iap[1])
+		};
+
+		Real u[2] = {0, 0};
+
+		for(int sy=start[1]; sy<end[1]; sy++)
+		{
+			const Real wy = w[1][sy-KS];
+
+			for(int sx=start[0]; sx<end[0]; sx++)
+			{
+				const Real wxwy = wy*w[0][sx-KS];
+
+				u[0] += wxwy * lab.template get<1>(iap[0] + sx, iap[1] + sy);
+				u[1] += wxwy * lab.template get<2>(iap[0] + sx, iap[1] + sy);
+			}
+		}
+
+		k[0] = factor*(Uinf[0] + u[0]);
+		k[1] = factor*(Uinf[1] + u[1]);
+	}
+
+public:
+
+	Real xparticles[NPY][NPX][2];
+	Real omega_new[B::sizeY][B::sizeX];
+
+	//midpoint push: the particles start on the grid points, where M'4 is interpolating, the first stage is read directly
+	template<typename LabVel>
+	void push(const BlockInfo& info, LabVel& lab, double dt, const Real Uinf[2])
+	{
+		const Real factor = dt/info.h[0];
+
+		for(int iy=PSY; iy<PEY; iy++)
+			for(int ix=PSX; ix<PEX; ix++)
+			{
+				const Real x0[2] = {(Real)ix, (Real)iy};
+
+				const Real k1[2] = {
+					factor*(Uinf[0] + lab.template get<1>(ix, iy)),
+					factor*(Uinf[1] + lab.template get<2>(ix, iy)) };
+
+				const Real x1[2] = { x0[0] + 0.5*k1[0], x0[1] + 0.5*k1[1] };
+				Real k2[2];
+				_velocity(x1, lab, factor, Uinf, k2);
+
+				Real * const final_xp = xparticles[iy-PSY][ix-PSX];
+				final_xp[0] = x0[0] + k2[0];
+				final_xp[1] = x0[1] + k2[1];
+
+#ifndef NDEBUG
+				//particles travelling more than the margin would be lost by the remeshing
+				assert(fabs(final_xp[0] - x0[0]) < 1 + MARGIN);
+				assert(fabs(final_xp[1] - x0[1]) < 1 + MARGIN);
+#endif
+			}
+	}
+
+	template<typename LabVel>
+	void remesh(LabVel& lab)
+	{
+		for(int iy=0; iy<B::sizeY; iy++)
+			for(int ix=0; ix<B::sizeX; ix++)
+				omega_new[iy][ix] = 0;
+
+		for(int iy=PSY; iy<PEY; iy++)
+			for(int ix=PSX; ix<PEX; ix++)
+			{
+				const Real * const xp = xparticles[iy-PSY][ix-PSX];
+
+				const Real ap[2] = {
+					floor(xp[0]),
+					floor(xp[1]) };
+
+				const int iap[2] = {
+					(int)ap[0],
+					(int)ap[1] };
+
+				const int start[2] = {
+					max(KS, 0 - iap[0]),
+					max(KS, 0 - iap[1])
+				};
+
+				const int end[2] = {
+					min(KE, B::sizeX - iap[0]),
+					min(KE, B::sizeY - iap[1])
+				};
+
+				//particle does not reach this block
+				if (start[0] >= end[0] || start[1] >= end[1]) continue;
+
+				Real w[2][4];
+				_computeWeights(xp, ap, w);
+
+				const Real omega = lab.template get<0>(ix, iy);
+
+				for(int sy=start[1]; sy<end[1]; sy++)
+				{
+					const Real wy = w[1][sy-KS]*omega;
+
+					for(int sx=start[0]; sx<end[0]; sx++)
+						omega_new[iap[1]+sy][iap[0]+sx] += wy*w[0][sx-KS];
+				}
+			}
+	}
+};
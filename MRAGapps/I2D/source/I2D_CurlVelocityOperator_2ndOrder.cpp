@@ -59,7 +59,7 @@ struct CurlVel_2ndOrder: I2D_GradOfVector_2ndOrder
 
 void I2D_CurlVelocityOperator_2ndOrder::perform()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	BoundaryInfo& binfo=grid.getBoundaryInfo();  
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
@@ -60,7 +60,7 @@ struct CurlVel_4thOrder: I2D_GradOfVector_4thOrder
 
 void I2D_CurlVelocityOperator_4thOrder::perform()
 {	
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	BoundaryInfo& binfo=grid.getBoundaryInfo();  
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
@@ -0,0 +1,189 @@
+/*
+ *  I2D_DesiredVelocityField.h
+ *  IncompressibleFluids2D
+ *
+ *	Desired velocity of a collection of obstacles, stored densely: the blocks
+ *	carrying a desired velocity are slots addressed by blockID through a flat
+ *	table, so that penalization and diagnostics never search a map. The slots
+ *	live in a pool that is recycled from one step to the next and only grows
+ *	when more blocks are covered. Every slot keeps the list of the agents
+ *	contributing to it; merge() sums them and can run concurrently on
+ *	different slots.
+ *	The desired velocity of a single obstacle is kept in the same way, in a flat
+ *	table indexed by blockID (I2D_DesiredVelocityBlocks).
+ *
+ */
+#pragma once
+
+#include "I2D_Types.h"
+
+//Desired velocity of one obstacle: a flat table of its velocity blocks indexed
+//by blockID (NULL where it has none), the blocks are owned by the table
+class I2D_DesiredVelocityBlocks
+{
+	vector<const VelocityBlock *> id2block;
+	vector<int> ids;
+
+	//forbidden
+	I2D_DesiredVelocityBlocks(const I2D_DesiredVelocityBlocks&);
+	I2D_DesiredVelocityBlocks& operator=(const I2D_DesiredVelocityBlocks&);
+
+public:
+
+	I2D_DesiredVelocityBlocks() {}
+
+	~I2D_DesiredVelocityBlocks() { clear(); }
+
+	//releases all the blocks, the table keeps its size
+	void clear()
+	{
+		for(vector<int>::const_iterator it=ids.begin(); it!=ids.end(); it++)
+		{
+			assert(id2block[*it] != NULL);
+			VelocityBlock::deallocate(id2block[*it]);
+			id2block[*it] = NULL;
+		}
+
+		ids.clear();
+	}
+
+	VelocityBlock * allocate(const int blockID)
+	{
+		assert(blockID >= 0);
+
+		if (blockID >= (int)id2block.size())
+			id2block.resize(blockID+1, (const VelocityBlock *)NULL);
+
+		assert(id2block[blockID] == NULL);
+
+		VelocityBlock * velblock = VelocityBlock::allocate(1);
+		id2block[blockID] = velblock;
+		ids.push_back(blockID);
+
+		return velblock;
+	}
+
+	const VelocityBlock * find(const int blockID) const
+	{
+		return blockID < (int)id2block.size() ? id2block[blockID] : NULL;
+	}
+
+	int size() const { return ids.size(); }
+};
+
+class I2D_DesiredVelocityField
+{
+public:
+
+	struct Contribution
+	{
+		int agent;
+		const VelocityBlock * src;
+
+		Contribution(int agent, const VelocityBlock * src): agent(agent), src(src) {}
+	};
+
+private:
+
+	vector<int> id2slot;
+	vector<int> slot2id;
+	vector< vector<Contribution> > contributions;
+
+	VelocityBlock * pool;
+	int capacity, nslots;
+
+	//forbidden
+	I2D_DesiredVelocityField(const I2D_DesiredVelocityField&);
+	I2D_DesiredVelocityField& operator=(const I2D_DesiredVelocityField&);
+
+public:
+
+	I2D_DesiredVelocityField(): pool(NULL), capacity(0), nslots(0) {}
+
+	~I2D_DesiredVelocityField()
+	{
+		if (pool != NULL)
+			VelocityBlock::deallocate(pool);
+	}
+
+	//forget all the slots, the table is sized for blockIDs up to maxBlockID
+	void reset(const int maxBlockID)
+	{
+		id2slot.assign(maxBlockID+1, -1);
+		slot2id.clear();
+
+		for(int s=0; s<nslots; s++)
+			contributions[s].clear();
+
+		nslots = 0;
+	}
+
+	void add(const int blockID, const int agent, const VelocityBlock * src)
+	{
+		assert(blockID >= 0 && blockID < (int)id2slot.size());
+		assert(src != NULL);
+
+		int& s = id2slot[blockID];
+
+		if (s < 0)
+		{
+			s = nslots++;
+			slot2id.push_back(blockID);
+
+			if ((int)contributions.size() < nslots)
+				contributions.resize(nslots);
+		}
+
+		contributions[s].push_back(Contribution(agent, src));
+	}
+
+	//to be called once all the contributions are registered, before merge()
+	void allocate()
+	{
+		if (nslots <= capacity) return;
+
+		if (pool != NULL)
+			VelocityBlock::deallocate(pool);
+
+		capacity = max(nslots, capacity + capacity/2);
+		pool = VelocityBlock::allocate(capacity);
+	}
+
+	void merge(const int slot)
+	{
+		assert(slot >= 0 && slot < nslots && slot < capacity);
+
+		VelocityBlock& dest = pool[slot];
+		dest.clear();
+
+		const vector<Contribution>& c = contributions[slot];
+
+		for(vector<Contribution>::const_iterator it=c.begin(); it!=c.end(); it++)
+		{
+			const VelocityBlock * src = it->src;
+
+			for(int iy=0; iy<_BLOCKSIZE_; iy++)
+				for(int ix=0; ix<_BLOCKSIZE_; ix++)
+				{
+					dest.u[0][iy][ix] += src->u[0][iy][ix];
+					dest.u[1][iy][ix] += src->u[1][iy][ix];
+				}
+		}
+	}
+
+	int slot(const int blockID) const
+	{
+		return blockID < (int)id2slot.size() ? id2slot[blockID] : -1;
+	}
+
+	const VelocityBlock * find(const int blockID) const
+	{
+		const int s = slot(blockID);
+
+		return s < 0 ? NULL : pool + s;
+	}
+
+	const vector<Contribution>& agents(const int slot) const { return contributions[slot]; }
+
+	int size() const { return nslots; }
+};
@@ -80,7 +80,7 @@ struct DiffusionSimple_4thOrder
 	template< template<typename BT> class CorrectLab >
 	void integrate(double viscosity, double dt)
 	{
-		vector<BlockInfo> vInfo = grid.getBlocksInfo();
+		const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 		BoundaryInfo& binfo=grid.getBoundaryInfo();  
 		const BlockCollection<B>& coll = grid.getBlockCollection();
 		
@@ -147,7 +147,8 @@ struct DiffusionLTS_4thOrder
 			}
 		}
 		
-		vector<BlockInfo> vInfo = grid.getBlocksInfo();
+		// filled by the sorter with the blocks of one level at a time
+		vector<BlockInfo> vInfo;
 		BoundaryInfo& binfo=grid.getBoundaryInfo();  
 		const BlockCollection<B>& coll = grid.getBlockCollection();
 		
@@ -54,7 +54,7 @@ struct DivOp: I2D_GradOfVector_4thOrder
 
 void I2D_DivOperator::perform()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	BoundaryInfo& binfo=grid.getBoundaryInfo();  
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
@@ -147,7 +147,7 @@ Real I2D_EllipticalObstacleOperator::mollified_heaviside(const Real x, const Rea
 
 void I2D_EllipticalObstacleOperator::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	EllyStuff::FillBlocksElly fill(semiMajorAxis, aspectRatio, angle, epsilon, position);
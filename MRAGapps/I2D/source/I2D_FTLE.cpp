@@ -44,9 +44,9 @@ struct FTLE
 {
 	double T;
 	map< I3, unsigned int > & code;
-	map<long int, vector<Real> > & particles;
+	I2D_TracerStore & particles;
 
-	FTLE(double T, map<long int, vector<Real> > & particles, map< I3, unsigned int > & code): T(T), particles(particles), code(code)
+	FTLE(double T, I2D_TracerStore & particles, map< I3, unsigned int > & code): T(T), particles(particles), code(code)
 	{
 	}
 
@@ -104,10 +104,10 @@ struct FTLE
 					const unsigned int ixx = ix + 1;
 					const unsigned int iyy = iy;
 					const unsigned int idx = offset + (ixx+1) + (iyy+1)*(B::sizeX+2);
-					map<long int, vector<Real> >::iterator it = particles.find(idx);
-					assert(it!=particles.end());
-					eastX = it->second[0];
-					eastY = it->second[1];
+					assert(idx<particles.size());
+					const int slot = particles.slot(idx);
+					eastX = particles.x[slot];
+					eastY = particles.y[slot];
 					assert(eastX==eastX);
 					assert(eastY==eastY);
 				}
@@ -117,10 +117,10 @@ struct FTLE
 					const unsigned int ixx = ix - 1;
 					const unsigned int iyy = iy;
 					const unsigned int idx = offset + (ixx+1) + (iyy+1)*(B::sizeX+2);
-					map<long int, vector<Real> >::iterator it = particles.find(idx);
-					assert(it!=particles.end());
-					westX = it->second[0];
-					westY = it->second[1];
+					assert(idx<particles.size());
+					const int slot = particles.slot(idx);
+					westX = particles.x[slot];
+					westY = particles.y[slot];
 					assert(westX==westX);
 					assert(westY==westY);
 				}
@@ -130,10 +130,10 @@ struct FTLE
 					const unsigned int ixx = ix;
 					const unsigned int iyy = iy + 1;
 					const unsigned int idx = offset + (ixx+1) + (iyy+1)*(B::sizeX+2);
-					map<long int, vector<Real> >::iterator it = particles.find(idx);
-					assert(it!=particles.end());
-					northX = it->second[0];
-					northY = it->second[1];
+					assert(idx<particles.size());
+					const int slot = particles.slot(idx);
+					northX = particles.x[slot];
+					northY = particles.y[slot];
 					assert(northX==northX);
 					assert(northY==northY);
 				}
@@ -143,10 +143,10 @@ struct FTLE
 					const unsigned int ixx = ix;
 					const unsigned int iyy = iy - 1;
 					const unsigned int idx = offset + (ixx+1) + (iyy+1)*(B::sizeX+2);
-					map<long int, vector<Real> >::iterator it = particles.find(idx);
-					assert(it!=particles.end());
-					southX = it->second[0];
-					southY = it->second[1];
+					assert(idx<particles.size());
+					const int slot = particles.slot(idx);
+					southX = particles.x[slot];
+					southY = particles.y[slot];
 					assert(southX==southX);
 					assert(southY==southY);
 				}
@@ -184,6 +184,15 @@ I2D_FTLE::I2D_FTLE(const int argc, const char ** argv): parser(argc, argv), t_co
 	TSTARTFTLE = parser("-tStartFTLE").asDouble();
 	TENDFTLE = parser("-tEndFTLE").asDouble();
 	bRESTART = parser("-restart").asBool();
+
+	parser.unset_strict_mode();
+
+	// backward FTLE of the same windows, computed in the same sweeps over the snapshots
+	bBACKWARD = parser("-bwdFTLE").asBool();
+
+	// number of snapshots kept in memory (at least 2: the one being used and the one being read)
+	const int NSNAPSHOTS = max(2, parser("-ftleCache").asInt(2));
+
 	parser.save_options();
 
 	// Instantiate grid
@@ -203,12 +212,15 @@ I2D_FTLE::I2D_FTLE(const int argc, const char ** argv): parser(argc, argv), t_co
 	grid->setRefiner(refiner);
 	grid->setCompressor(compressor);
 
+	stream = new I2D_SnapshotStream(NSNAPSHOTS);
+
 	if(bRESTART)
 		_restart();
 }
 
 I2D_FTLE::~I2D_FTLE()
 {
+	if(stream!=NULL){ delete stream; stream=NULL; }
 	if(grid!=NULL){ delete grid; grid=NULL; }
 	if(refiner!=NULL){ delete refiner; refiner=NULL; }
 	if(compressor!=NULL){ delete compressor; compressor=NULL; }
@@ -312,7 +324,7 @@ void I2D_FTLE::_createDtsSet(const map< string, double > & subset, vector<Real>
 	}
 }
 
-void I2D_FTLE::_createParticleSet(string restart, map<long int, vector<Real> > & particles, map< I3, unsigned int > & code)
+void I2D_FTLE::_createParticleSet(string restart, I2D_TracerStore & particles, map< I3, unsigned int > & code)
 {
 	particles.clear();
 	code.clear();
@@ -320,6 +332,7 @@ void I2D_FTLE::_createParticleSet(string restart, map<long int, vector<Real> > &
 	_loadGrid( restart );
 	vector<BlockInfo> vInfo = grid->getBlocksInfo();
 	const unsigned int ppb = (B::sizeX+2)*(B::sizeY+2);
+	particles.resize(ppb*vInfo.size());
 	for(unsigned int i=0; i<vInfo.size(); i++)
 	{
 		I3 node(vInfo[i].index[0],vInfo[i].index[1],vInfo[i].level);
@@ -334,10 +347,8 @@ void I2D_FTLE::_createParticleSet(string restart, map<long int, vector<Real> > &
 				vInfo[i].pos(p,ix,iy);
 				assert(p[0]==p[0]);
 				assert(p[1]==p[1]);
-				vector<Real> pos;
-				pos.push_back(p[0]);
-				pos.push_back(p[1]);
-				particles[offset+idx] = pos;
+				particles.x[offset+idx] = p[0];
+				particles.y[offset+idx] = p[1];
 			}
 	}
 }
@@ -350,7 +361,7 @@ void I2D_FTLE::_extractSubset(double tStart, double tEnd, const map< string, dou
 			subset[it->first] = it->second;
 }
 
-void I2D_FTLE::_FTLE(string initialField, double T, map<long int, vector<Real> > & particles, vector<Real> & dts, map< I3, unsigned int > & code)
+void I2D_FTLE::_FTLE(string initialField, double T, I2D_TracerStore & particles, vector<Real> & dts, map< I3, unsigned int > & code)
 {
 	_loadGrid( initialField );
 	vector<BlockInfo> vInfo = grid->getBlocksInfo();
@@ -359,86 +370,51 @@ void I2D_FTLE::_FTLE(string initialField, double T, map<long int, vector<Real> >
 	block_processing.process(vInfo,coll,ftle);
 }
 
-double I2D_FTLE::_advectParticles(map<long int, vector<Real> > & particles, vector<Real> & dts, map< string, double > &subset)
+double I2D_FTLE::_advectParticles(I2D_TracerStore & particles, vector<Real> & dts, map< string, double > &subset, const bool bBackward)
 {
-	unsigned int counter = 0;
-	double T = 0.0;
+	// Forward: from the first snapshot to the last one, backward: the other way around
+	vector<string> files;
 	for(map< string, double >::const_iterator it=subset.begin(); it!=subset.end(); ++it)
-	{
-		vector<I3> leaves;
-		map<I3, vector<long int> > block2particles;
+		files.push_back(PATH + "/" + it->first);
 
-		// Load grid
-		profiler.push_start("LOADGRID");
-		_loadGrid(PATH + "/" + it->first);
-		profiler.pop_stop();
+	assert(files.size()>=2);
+	assert(dts.size()==files.size()-1);
 
-		vector<BlockInfo> vInfo = grid->getBlocksInfo();
-		const BlockCollection<B>& coll = grid->getBlockCollection();
-		BoundaryInfo& binfo = grid->getBoundaryInfo();
+	vector<string> schedule;
+	vector<Real> steps;
+	for(int k=0; k<(int)dts.size(); k++)
+	{
+		schedule.push_back(bBackward ? files[files.size()-1-k] : files[k]);
+		steps.push_back(bBackward ? -dts[dts.size()-1-k] : dts[k]);
+	}
 
-		// Get leaves
-		profiler.push_start("GETLEAVES");
-		for(int i=0; i<vInfo.size(); i++)
-		{
-			I3 node(vInfo[i].index[0],vInfo[i].index[1],vInfo[i].level);
-			leaves.push_back(node);
-			block2particles[node] = vector<long int>();
-		}
-		profiler.pop_stop();
+	stream->setSchedule(schedule);
 
-		// Instantiate octree and perform neighbors search
-		profiler.push_start("CREATETREE");
-		const int LMAX =  grid->getCurrentMaxLevel();
-		double origin[2] = {0.0,0.0};
-		const double width = 1.0;
-		QuadTree tree(LMAX+1,width,origin);
-		tree.split(leaves);
+	double T = 0.0;
+	for(int k=0; k<(int)steps.size(); k++)
+	{
+		// Get the snapshot (the next one is read in the background meanwhile)
+		profiler.push_start("LOADGRID");
+		Grid<W,B>& snapshot = stream->next();
 		profiler.pop_stop();
 
-		// Assign particles to blocks
-		// THIS PART SHOULD BE PARALLELIZED!
+		vector<BlockInfo> vInfo = snapshot.getBlocksInfo();
+		const BlockCollection<B>& coll = snapshot.getBlockCollection();
+		BoundaryInfo& binfo = snapshot.getBoundaryInfo();
+
+		// Assign particles to blocks (particles outside the domain are left out)
 		profiler.push_start("LOCATECELL");
 		assert(particles.size()>0);
-		for(map<long int, vector<Real> >::const_iterator it=particles.begin(); it!=particles.end(); ++it)
-		{
-			assert(it->second.size()==2);
-			const double p[2] = {it->second[0],it->second[1]};
-			if( p[0]>=0.0 && p[0]<1.0 && p[1]>=0.0 && p[1]<1.0 )
-			{
-
-				I3 myblock = tree.locateCellIndex(p);
-				(block2particles[myblock]).push_back(it->first);
-
-
-#ifndef NDEBUG
-				const Real dx = 1.0/pow(2.0, myblock.i[2]); /// dx of the block
-				Real startBlock[2] = {myblock.i[0]*dx, myblock.i[1]*dx}; /// actual location of the start of the block
-				Real endBlock[2] = {startBlock[0]+dx, startBlock[1]+dx}; /// actual location of the end limits of the block
-				const bool isInBlock = ( p[0]>=startBlock[0] && p[0]<endBlock[0] && p[1]>=startBlock[1] && p[1]<endBlock[1] );
-				if(!isInBlock)
-				{
-					printf("p[0]=%e, p[1]=%e\n",p[0],p[1]);
-					printf("startBlock[0]=%e, startBlock[1]=%e\n",startBlock[0],startBlock[1]);
-					printf("endBlock[0]=%e, endBlock[1]=%e\n",endBlock[0],endBlock[1]);
-				}
-				assert(isInBlock);
-#endif
-			}
-		}
+		particles.bin(vInfo);
 		profiler.pop_stop();
 
 		// Update passive tracer positions
-		const double dt = dts[counter];
-		I2D_TracerAdvection_RK advect(particles, block2particles, dt, Uinf);
+		const double dt = steps[k];
+		I2D_TracerAdvection_RK advect(particles, dt, Uinf);
 		profiler.push_start("ADVECT");
 		block_processing.process<I2D_ParticleBlockLab>(vInfo, coll, binfo, advect);
 		profiler.pop_stop();
-		T += dt;
-
-		counter++;
-		if( counter==(subset.size()-1) )
-			break;
+		T += fabs(dt);
 	}
 
 	return T;
@@ -472,39 +448,58 @@ void I2D_FTLE::_save(string filename)
 	printf("****SERIALIZING DONE****\n");
 }
 
-void I2D_FTLE::_computeFwdFTLE(double tStart, double tEnd, int idx, map< string, double > & mapping)
+void I2D_FTLE::_computeFTLE(double tStart, double tEnd, int idx, map< string, double > & mapping)
 {
 	map< string, double > subset;
-	map< I3, unsigned int > code;
-	map<long int, vector<Real> > particles;
 	vector<Real> dts;
 
 	_extractSubset(tStart, tEnd, mapping, subset);
 	_createDtsSet(subset, dts);
-	_createParticleSet(PATH + "/" + (subset.begin())->first, particles, code);
 
-	// Compute preview FTLE
-	const Real T1 = _advectParticles(particles,dts,subset);
-	_FTLE( PATH + "/" + (subset.begin())->first, T1, particles, dts, code);
+	// The forward field is seeded on the first snapshot of the window, the backward one on the last
+	const int nFields = bBACKWARD ? 2 : 1;
+	const string seeds[2] = { PATH + "/" + (subset.begin())->first, PATH + "/" + (subset.rbegin())->first };
+	const string ftleTmps[2] = { "ftleTmpFwd", "ftleTmpBwd" };
+	const char * dumpNames[2] = { "fwdFTLE_%07d", "bwdFTLE_%07d" };
 
-	// Refine obtained field
-	_refine();
-	string ftleTmp("ftleTmp");
-	_save(ftleTmp);
-	sleep(2);
+	map< I3, unsigned int > code[2];
+	I2D_TracerStore particles[2];
+	Real T[2] = {0.0, 0.0};
+
+	// Compute preview FTLEs: the two legs walk the window in opposite directions,
+	// the second one starts from the snapshots left in memory by the first one
+	for(int d=0; d<nFields; d++)
+	{
+		_createParticleSet(seeds[d], particles[d], code[d]);
+		T[d] = _advectParticles(particles[d], dts, subset, d==1);
+	}
 
-	// Compute final FTLE
-	_createParticleSet(ftleTmp, particles, code);
-	const Real T2 = _advectParticles(particles,dts,subset);
-	assert(T1==T2);
+	// Refine obtained fields
+	for(int d=0; d<nFields; d++)
+	{
+		_FTLE(seeds[d], T[d], particles[d], dts, code[d]);
+		_refine();
+		_save(ftleTmps[d]);
+	}
 	sleep(2);
-	_FTLE( ftleTmp, T2, particles, dts, code);
 
-	// Print out obtained field
-	char buf[500];
-	sprintf(buf, "fwdFTLE_%07d", (int)idx);
-	string dumpFile(buf);
-	_dump(dumpFile);
+	// Compute final FTLEs
+	for(int d=0; d<nFields; d++)
+	{
+		_createParticleSet(ftleTmps[d], particles[d], code[d]);
+		const Real Tfinal = _advectParticles(particles[d], dts, subset, d==1);
+		assert(T[d]==Tfinal);
+		sleep(2);
+		_FTLE(ftleTmps[d], Tfinal, particles[d], dts, code[d]);
+
+		// Print out obtained field
+		char buf[500];
+		sprintf(buf, dumpNames[d], (int)idx);
+		string dumpFile(buf);
+		_dump(dumpFile);
+	}
+
+	stream->printSummary();
 }
 
 void I2D_FTLE::_save()
@@ -549,9 +544,9 @@ void I2D_FTLE::run()
 
 		if(tStart > t_completed)
 		{
-			printf("...computing fwd FTLE from time=%f to time=%f (t_completed=%e)\n",tStart,tEnd,t_completed);
+			printf("...computing %s FTLE from time=%f to time=%f (t_completed=%e)\n",bBACKWARD?"fwd and bwd":"fwd",tStart,tEnd,t_completed);
 
-			_computeFwdFTLE(tStart, tEnd, i+idxOffset, mapping);
+			_computeFTLE(tStart, tEnd, i+idxOffset, mapping);
 
 			t_completed = tStart + DTFTLE/2.0;
 			_save();
@@ -25,6 +25,8 @@
 
 #include "I2D_Headers.h"
 #include "I2D_Types.h"
+#include "I2D_TracerStore.h"
+#include "I2D_SnapshotStream.h"
 
 class I2D_FTLE: public I2D_Test
 {
@@ -33,7 +35,7 @@ protected:
 	string PATH;
 	Real RTOL, DTFTLE, TFTLE, TSTARTFTLE, TENDFTLE, Uinf[2];
 	int JUMP, LMAX;
-	bool bUNIFORM, bRESTART;
+	bool bUNIFORM, bRESTART, bBACKWARD;
 
 	//state of the sim
 	Real t_completed;
@@ -43,6 +45,7 @@ protected:
 	Profiler profiler;
 
 	Grid<W,B> * grid;
+	I2D_SnapshotStream * stream;
 
 	BlockProcessing block_processing;
 
@@ -62,15 +65,15 @@ protected:
 	double _loadStatus(string restart);
 	void _loadGrid(string restart);
 	void _dump(string filename);
-	void _computeFwdFTLE(double tStart, double tEnd, int idx, map< string, double > & mapping);
+	void _computeFTLE(double tStart, double tEnd, int idx, map< string, double > & mapping);
 	void _save(string filename);
 	void _save();
 	void _restart();
 	void _refine();
-	double _advectParticles(map<long int, vector<Real> > & particles, vector<Real> & dts, map< string, double > &subset);
-	void _FTLE(string initialField, double T, map<long int, vector<Real> > & particles, vector<Real> & dts, map< I3, unsigned int > & code);
+	double _advectParticles(I2D_TracerStore & particles, vector<Real> & dts, map< string, double > &subset, const bool bBackward);
+	void _FTLE(string initialField, double T, I2D_TracerStore & particles, vector<Real> & dts, map< I3, unsigned int > & code);
 	void _extractSubset(double tStart, double tEnd, const map< string, double > &mapping, map< string, double > &subset);
-	void _createParticleSet(string restart, map<long int, vector<Real> > & particles, map< I3, unsigned int > & code);
+	void _createParticleSet(string restart, I2D_TracerStore & particles, map< I3, unsigned int > & code);
 	void _createDtsSet(const map< string, double > & subset, vector<Real> & dts);
 
 public:
@@ -317,13 +317,25 @@ I2D_FloatingCylinder::~I2D_FloatingCylinder()
 
 void I2D_FloatingCylinder::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	FloatingCylinder::FillBlocks fill(eps,shape);
 	block_processing.process(vInfo, coll, fill);
 }
 
+bool I2D_FloatingCylinder::getBoundingBox(Real xmin[2], Real xmax[2]) const
+{
+	shape->bbox(eps, xmin, xmax);
+	return true;
+}
+
+void I2D_FloatingCylinder::rasterize(const BlockInfo& info, FluidBlock2D& b) const
+{
+	FloatingCylinder::FillBlocks fill(eps,shape);
+	fill(info, b);
+}
+
 void I2D_FloatingCylinder::restart(const double t, string filename)
 {
 	FILE * ppFile = NULL;
@@ -496,7 +508,7 @@ void I2D_FloatingCylinder::computeDesiredVelocity(const double t)
 	double vybar = 0.0;
 	double omegabar = 0.0;
 	
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	map<int, vector<double> > integrals;
@@ -540,11 +552,6 @@ void I2D_FloatingCylinder::computeDesiredVelocity(const double t)
 	printf("\n\n");
 	
 	// Set desired velocities
-	for	(map<int, const VelocityBlock *>::iterator it = desired_velocity.begin(); it!= desired_velocity.end(); it++)
-	{
-		assert(it->second != NULL);
-		VelocityBlock::deallocate(it->second);
-	}
 	
 	desired_velocity.clear();
 	
@@ -553,8 +560,7 @@ void I2D_FloatingCylinder::computeDesiredVelocity(const double t)
 	{
 		if(nonempty[it->blockID] == true)
 		{
-			VelocityBlock * velblock = VelocityBlock::allocate(1);
-			desired_velocity[it->blockID] = velblock;
+			VelocityBlock * velblock = desired_velocity.allocate(it->blockID);
 			velblocks.push_back(pair< BlockInfo, VelocityBlock *>(*it, velblock));
 		}
 	}
@@ -43,6 +43,8 @@ public:
 	~I2D_FloatingCylinder();
 	
 	void characteristic_function();		
+	bool getBoundingBox(Real xmin[2], Real xmax[2]) const;
+	void rasterize(const BlockInfo& info, FluidBlock2D& b) const;
 	Real getD() const {return D;}
 	
 	void update(const double dt, const double t, string filename = std::string(), map< string, vector<I2D_FloatingObstacleOperator *> > * _data = NULL);
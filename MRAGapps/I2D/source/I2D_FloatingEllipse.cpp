@@ -366,13 +366,25 @@ I2D_FloatingEllipse::~I2D_FloatingEllipse()
 
 void I2D_FloatingEllipse::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	FloatingEllipse::FillBlocks fill(eps,shape);
 	block_processing.process(vInfo, coll, fill);
 }
 
+bool I2D_FloatingEllipse::getBoundingBox(Real xmin[2], Real xmax[2]) const
+{
+	shape->bbox(eps, xmin, xmax);
+	return true;
+}
+
+void I2D_FloatingEllipse::rasterize(const BlockInfo& info, FluidBlock2D& b) const
+{
+	FloatingEllipse::FillBlocks fill(eps,shape);
+	fill(info, b);
+}
+
 void I2D_FloatingEllipse::restart(const double t, string filename)
 {
 	FILE * ppFile = NULL;
@@ -545,7 +557,7 @@ void I2D_FloatingEllipse::computeDesiredVelocity(const double t)
 	double vybar = 0.0;
 	double omegabar = 0.0;
 	
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	map<int, vector<double> > integrals;
@@ -589,11 +601,6 @@ void I2D_FloatingEllipse::computeDesiredVelocity(const double t)
 	printf("\n\n");
 	
 	// Set desired velocities
-	for	(map<int, const VelocityBlock *>::iterator it = desired_velocity.begin(); it!= desired_velocity.end(); it++)
-	{
-		assert(it->second != NULL);
-		VelocityBlock::deallocate(it->second);
-	}
 	
 	desired_velocity.clear();
 	
@@ -602,8 +609,7 @@ void I2D_FloatingEllipse::computeDesiredVelocity(const double t)
 	{
 		if(nonempty[it->blockID] == true)
 		{
-			VelocityBlock * velblock = VelocityBlock::allocate(1);
-			desired_velocity[it->blockID] = velblock;
+			VelocityBlock * velblock = desired_velocity.allocate(it->blockID);
 			velblocks.push_back(pair< BlockInfo, VelocityBlock *>(*it, velblock));
 		}
 	}
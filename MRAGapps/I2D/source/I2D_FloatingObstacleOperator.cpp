@@ -8,6 +8,8 @@
 #include "I2D_FloatingObstacleOperator.h"
 #include "I2D_Clear.h"
 
+#include <tbb/parallel_reduce.h>
+
 namespace FloatingObstacleOperatorStuff
 {
 
@@ -41,97 +43,149 @@ struct Mass
 	}
 };
 
-struct Diagnostic
-{
-	Real force[2];
-	Real area;
-	Real gridpoints;
-
-	Diagnostic():area(0), gridpoints(0)
-	{
-		force[0] = force[1] = 0;
-	}
-
-	const Diagnostic& operator += (const Diagnostic& c)
-	{
-		force[0] += c.force[0];
-		force[1] += c.force[1];
-		area += c.area;
-		gridpoints += c.gridpoints;
-
-		return *this;
-	}
-};
-
 struct ComputeDiagnostics
 {
+	typedef I2D_FloatingObstacleOperator::Diagnostics Diagnostics;
+
 	Real lambda, Uinf[2];
-	map<int, Diagnostic>& diagnostics;
-	map<int, const VelocityBlock *>& desiredVels;
+	const vector<BlockInfo>& vInfo;
+	const BlockCollection<B>& coll;
+	const I2D_DesiredVelocityBlocks& desiredVels;
+	Diagnostics diag;
 
-	ComputeDiagnostics(map< int, Diagnostic>& diagnostics, map<int, const VelocityBlock *>& desiredVels, Real lambda, const Real _Uinf[2]):
-		diagnostics(diagnostics), desiredVels(desiredVels), lambda(lambda)
+	ComputeDiagnostics(const vector<BlockInfo>& vInfo, const BlockCollection<B>& coll, const I2D_DesiredVelocityBlocks& desiredVels, Real lambda, const Real _Uinf[2]):
+		vInfo(vInfo), coll(coll), desiredVels(desiredVels), lambda(lambda)
 	{
 		this->Uinf[0] = _Uinf[0];
 		this->Uinf[1] = _Uinf[1];
 	}
 
-	ComputeDiagnostics(const ComputeDiagnostics& c): diagnostics(c.diagnostics), desiredVels(c.desiredVels), lambda(c.lambda)
+	ComputeDiagnostics(const ComputeDiagnostics& c, tbb::split): vInfo(c.vInfo), coll(c.coll), desiredVels(c.desiredVels), lambda(c.lambda)
 	{
 		this->Uinf[0] = c.Uinf[0];
 		this->Uinf[1] = c.Uinf[1];
 	}
 
-	inline void operator()(const BlockInfo& info, FluidBlock2D& b) const
+	void operator()(const blocked_range<int>& range)
 	{
-		map<int, const VelocityBlock *>::iterator it = desiredVels.find(info.blockID);
-
-		if( it!=desiredVels.end() )
+		for(int i=range.begin(); i<range.end(); i++)
 		{
-			const VelocityBlock * targetVelBlock = it->second;
-
-			map< int, Diagnostic>::iterator it = diagnostics.find(info.blockID);
-			assert(it != diagnostics.end());
-			Diagnostic& diag = it->second;
+			const BlockInfo& info = vInfo[i];
 
-			diag.force[0] = diag.force[1]  = 0.0;
-			diag.area = 0.0;
-			diag.gridpoints = 0.0;
+			const VelocityBlock * targetVelBlock = desiredVels.find(info.blockID);
 
-			for(int iy=0; iy<FluidBlock2D::sizeY; iy++)
-				for(int ix=0; ix<FluidBlock2D::sizeX; ix++)
-				{
-					Real p[2];
-					info.pos(p,ix,iy);
+			if (targetVelBlock != NULL)
+				diag.integrate(info, coll[info.blockID], *targetVelBlock, lambda, Uinf);
+		}
+	}
 
-					const Real Xs = b(ix,iy).tmp;
-					const Real ux = b(ix,iy).u[0];
-					const Real uy = b(ix,iy).u[1];
-					const Real ux_target = targetVelBlock->u[0][iy][ix];
-					const Real uy_target = targetVelBlock->u[1][iy][ix];
+	void join(const ComputeDiagnostics& c)
+	{
+		diag += c.diag;
+	}
+};
 
-					diag.force[0] += (ux-ux_target)*Xs;
-					diag.force[1] += (uy-uy_target)*Xs;
+}
 
-					diag.area += Xs;
-					diag.gridpoints += Xs;
-				}
 
-			const Real dA = pow(info.h[0], 2);
+I2D_FloatingObstacleOperator::Diagnostics::Diagnostics(): moment(0), power(0), area(0), angular(0), inertia(0), torque(0), angularVelocity(0), usefulPower(0), deformationPower(0), efficiency(0)
+{
+	force[0] = force[1] = 0;
+	first[0] = first[1] = 0;
+	impulse[0] = impulse[1] = 0;
+	centroid[0] = centroid[1] = 0;
+	velocity[0] = velocity[1] = 0;
+}
 
-			diag.force[0] *= dA*lambda;
-			diag.force[1] *= dA*lambda;
+I2D_FloatingObstacleOperator::Diagnostics& I2D_FloatingObstacleOperator::Diagnostics::operator += (const Diagnostics& c)
+{
+	force[0] += c.force[0];
+	force[1] += c.force[1];
+	moment += c.moment;
+	power += c.power;
+	area += c.area;
+	first[0] += c.first[0];
+	first[1] += c.first[1];
+	impulse[0] += c.impulse[0];
+	impulse[1] += c.impulse[1];
+	angular += c.angular;
+	inertia += c.inertia;
+
+	return *this;
+}
 
-			diag.area *= dA;
+void I2D_FloatingObstacleOperator::Diagnostics::integrate(const BlockInfo& info, FluidBlock2D& b, const VelocityBlock& target, const Real lambda, const Real Uinf[2])
+{
+	Real f[2] = {0, 0}, m = 0, p = 0, a = 0, x[2] = {0, 0}, v[2] = {0, 0}, l = 0, j = 0;
 
-			diag.force[0] += diag.area*lambda*Uinf[0];
-			diag.force[1] += diag.area*lambda*Uinf[1];
+	for(int iy=0; iy<FluidBlock2D::sizeY; iy++)
+		for(int ix=0; ix<FluidBlock2D::sizeX; ix++)
+		{
+			const Real Xs = b(ix,iy).tmp;
+
+			if (Xs == 0) continue;
+
+			Real pos[2];
+			info.pos(pos,ix,iy);
+
+			const Real us[2] = { target.u[0][iy][ix], target.u[1][iy][ix] };
+			const Real df[2] = {
+				(b(ix,iy).u[0] + Uinf[0] - us[0])*Xs,
+				(b(ix,iy).u[1] + Uinf[1] - us[1])*Xs };
+
+			f[0] += df[0];
+			f[1] += df[1];
+			m += pos[0]*df[1] - pos[1]*df[0];
+			p += df[0]*us[0] + df[1]*us[1];
+
+			a += Xs;
+			x[0] += pos[0]*Xs;
+			x[1] += pos[1]*Xs;
+			v[0] += us[0]*Xs;
+			v[1] += us[1]*Xs;
+			l += (pos[0]*us[1] - pos[1]*us[0])*Xs;
+			j += (pos[0]*pos[0] + pos[1]*pos[1])*Xs;
 		}
-	}
-};
 
+	const Real dA = pow(info.h[0], 2);
+
+	force[0] += f[0]*dA*lambda;
+	force[1] += f[1]*dA*lambda;
+	moment += m*dA*lambda;
+	power += p*dA*lambda;
+
+	area += a*dA;
+	first[0] += x[0]*dA;
+	first[1] += x[1]*dA;
+	impulse[0] += v[0]*dA;
+	impulse[1] += v[1]*dA;
+	angular += l*dA;
+	inertia += j*dA;
 }
 
+void I2D_FloatingObstacleOperator::Diagnostics::finalize()
+{
+	if (area > 0)
+	{
+		centroid[0] = first[0]/area;
+		centroid[1] = first[1]/area;
+		velocity[0] = impulse[0]/area;
+		velocity[1] = impulse[1]/area;
+	}
+
+	torque = moment - (centroid[0]*force[1] - centroid[1]*force[0]);
+
+	// rigid rotation of the body about its centroid
+	const Real angularCentroid = angular - area*(centroid[0]*velocity[1] - centroid[1]*velocity[0]);
+	const Real inertiaCentroid = inertia - area*(centroid[0]*centroid[0] + centroid[1]*centroid[1]);
+	angularVelocity = (inertiaCentroid > 0) ? angularCentroid/inertiaCentroid : 0;
+
+	// int f.(U + omega x (x - centroid)) = F.U + omega*torque, the rest of the power goes to the deformation
+	usefulPower = force[0]*velocity[0] + force[1]*velocity[1];
+	deformationPower = usefulPower + angularVelocity*torque - power;
+
+	efficiency = (usefulPower > 0 && deformationPower > 0) ? usefulPower/deformationPower : 0;
+}
 
 void I2D_FloatingObstacleOperator::_dist(const double x2[2], const double x1[2], double d[2]) const
 {
@@ -163,11 +217,11 @@ int I2D_FloatingObstacleOperator::_discretizeRange(const double value, const dou
 	return  max(0,min(levels-1,(int)floor((value+minvalue)/h)));
 }
 
-void I2D_FloatingObstacleOperator::savePolicy(string name)
+void I2D_FloatingObstacleOperator::savePolicy(string name, bool bBackground)
 {
 	if(policy!=NULL)
 		if((*policy)!=NULL)
-			(*policy)->save(name);
+			(*policy)->save(name, bBackground);
 }
 
 void I2D_FloatingObstacleOperator::restartPolicy(string name)
@@ -182,22 +236,23 @@ void I2D_FloatingObstacleOperator::computeDragAndStuff(const Real time, const Re
 	if(charVel<=0.0){ printf("Something wrong with characteristic velocity, charVel=%e!\n", charVel); abort(); }
 	if(charLength<=0.0){ printf("Something wrong with characteristic lenght, charLength=%e!\n", charLength); abort(); }
 
-	typedef FloatingObstacleOperatorStuff::Diagnostic DiagType; // stores force, area and grid points of each object
-
-	map<int, DiagType> diagnostics; // stores all objects
+	// summed in the order of the blocks in the tree, the same for any number of threads
+	const vector<BlockInfo>& vInfo = sorted_blocks.get(grid);
 
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
-	for(map<int, const VelocityBlock *>::iterator it=desired_velocity.begin(); it!=desired_velocity.end(); it++)
-		diagnostics[it->first] = DiagType(); // create information container (force, area, grid points) for each object
+	FloatingObstacleOperatorStuff::ComputeDiagnostics getDiag(vInfo, grid.getBlockCollection(), desired_velocity, penalization.getLambda(), Uinf);
+	Multithreading::deterministic_reduce(vInfo.size(), getDiag, 4);
 
-	FloatingObstacleOperatorStuff::ComputeDiagnostics getDiag(diagnostics, desired_velocity, penalization.getLambda(), Uinf);
-	block_processing.process(vInfo, grid.getBlockCollection(), getDiag); // compute force for each object and assign it to object
+	Diagnostics global = getDiag.diag;
+	global.finalize();
 
-	DiagType global;
-	for(map< int, DiagType>::iterator it=diagnostics.begin(); it!=diagnostics.end(); it++)
-		global += it->second;
+	setDiagnostics(global, time, charLength, charVel);
+}
 
-	this->Cd = 2*global.force[0]/(pow(charVel, 2)*charLength);
+void I2D_FloatingObstacleOperator::setDiagnostics(const Diagnostics& d, const Real time, const Real charLength, const Real charVel)
+{
+	this->diagnostics = d;
+	this->diagnosticsTime = time;
+	this->Cd = 2*d.force[0]/(pow(charVel, 2)*charLength);
 	this->dimT = 2*charVel*time/charLength;
 }
 
@@ -266,11 +321,11 @@ std::vector<Real> I2D_FloatingObstacleOperator::getMass()
 
 	characteristic_function();
 
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	map<int, Real> local_data;
-	for(vector<BlockInfo>::iterator it=vInfo.begin(); it!=vInfo.end(); it++)
+	for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
 			local_data[it->blockID] = 0;
 
 	// Compute mass
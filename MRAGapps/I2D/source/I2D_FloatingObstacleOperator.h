@@ -23,16 +23,47 @@
 using namespace std;
 
 class I2D_FloatingObstacleOperator : public I2D_ObstacleOperator
-{		
+{
+public:
+	// Penalization integrals over the support of the obstacle. The raw sums (force, moment about the
+	// origin, power, area, first moments, impulse) are additive across blocks and threads; finalize()
+	// turns them into the torque about the centroid, the mean velocity of the body and the efficiency
+	// P_useful/(P_useful + P_deformation), with P_useful = F.U the power of the hydrodynamic force
+	// Integrals over the body, f = lambda*chi*(u - us) being the force density of the fluid on the body:
+	// force, moment (about the origin) and power = int f.us (positive when the fluid does work on the body).
+	// The body velocity us splits into the rigid motion U + omega x (x - centroid) and the deformation.
+	// deformationPower = -int f.(us - U - omega x (x - centroid)) is the power the body spends deforming
+	// (positive when it works on the fluid), usefulPower = F.U the power of the fluid force along the motion.
+	// efficiency = usefulPower/deformationPower (the Froude-type efficiency of a self-propelled deforming
+	// body), 0 when either power is not positive.
+	struct Diagnostics
+	{
+		Real force[2], moment, power, area, first[2], impulse[2], angular, inertia;
+		Real torque, centroid[2], velocity[2], angularVelocity, usefulPower, deformationPower, efficiency;
+
+		Diagnostics();
+
+		Diagnostics& operator += (const Diagnostics& c);
+
+		// chi is read from tmp, the desired velocity of the obstacle from target
+		void integrate(const BlockInfo& info, FluidBlock2D& b, const VelocityBlock& target, const Real lambda, const Real Uinf[2]);
+		void finalize();
+	};
+
 protected:
 	// Hydrodynamics
 	Real eps, D, Cd, dimT;
 	Real Uinf[2];
+	Diagnostics diagnostics;
+	// time the diagnostics were computed at, negative before the first computeDragAndStuff
+	Real diagnosticsTime;
 
 	Grid<W,B>& grid;
 	BlockProcessing block_processing;
+	// blocks in the order of the deterministic reductions
+	Multithreading::SortedBlocksInfo sorted_blocks;
 
-	map<int, const VelocityBlock *> desired_velocity;
+	I2D_DesiredVelocityBlocks desired_velocity;
 	I2D_PenalizationOperator& penalization;
 
 	// Online learning
@@ -64,7 +95,7 @@ protected:
 
 public:
 	I2D_FloatingObstacleOperator(ArgumentParser & parser, Grid<W,B>& grid, const Real D, const Real eps, const Real Uinf[2], I2D_PenalizationOperator& penalization, const int _ID = 0, RL::RL_TabularPolicy ** _policy = NULL, const int seed = 0) :
-		grid(grid), eps(eps), D(D), Cd(0.0), dimT(0.0), penalization(penalization), ID(_ID), policy(_policy), policystore(NULL), integralReward(0.0), status(Ready), learningInterval(0.0), learningTimer(0.0)
+		grid(grid), eps(eps), D(D), Cd(0.0), dimT(0.0), diagnosticsTime(-1), penalization(penalization), ID(_ID), policy(_policy), policystore(NULL), integralReward(0.0), status(Ready), learningInterval(0.0), learningTimer(0.0)
 	{
 		this->Uinf[0] = Uinf[0];
 		this->Uinf[1] = Uinf[1];
@@ -119,14 +150,25 @@ public:
 	virtual void save(const double t, string filename = std::string()) = 0;
 	virtual void restart(const double t, string filename = std::string()) = 0;
 	virtual void refresh(const double t, string filename = std::string()) = 0;
-	map<int , const VelocityBlock *> getDesiredVelocity(){ return desired_velocity; }
+	const I2D_DesiredVelocityBlocks& getDesiredVelocity() const { return desired_velocity; }
 	virtual vector<Real> getMass();
 
+	// Diagnostics of the last computeDragAndStuff (the obstacle vector computes them for all the agents in one sweep)
+	void setDiagnostics(const Diagnostics& d, const Real time, const Real charLength, const Real charVel);
+	const Diagnostics& getDiagnostics() const { return diagnostics; }
+	Real getDiagnosticsTime() const { return diagnosticsTime; }
+
+	// Shared rasterization (see I2D_FloatingObstacleVector): an agent that can bound its support
+	// returns true and writes its characteristic function (max into tmp) one block at a time
+	virtual bool getBoundingBox(Real xmin[2], Real xmax[2]) const { return false; }
+	virtual void rasterize(const BlockInfo& info, FluidBlock2D& b) const {}
+
 	// Online learning
 	enum Label { FISH };
 	int ID;
-	virtual void savePolicy(string name=string());
+	virtual void savePolicy(string name=string(), bool bBackground=false);
 	virtual void restartPolicy(string name=string());
+	RL::RL_TabularPolicy * getPolicy() const { return (policy!=NULL) ? (*policy) : NULL; }
 	virtual bool choose(const double t, map< string, vector<I2D_FloatingObstacleOperator *> > * _data = NULL);
 	virtual void stopTest(const double t, map< string, vector<I2D_FloatingObstacleOperator *> > * _data = NULL);
 	virtual void learn(const double t, map< string, vector<I2D_FloatingObstacleOperator *> > * _data = NULL,string name=string());
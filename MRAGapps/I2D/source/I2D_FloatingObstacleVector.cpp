@@ -9,6 +9,9 @@
 #include "I2D_FloatingObstacleVector.h"
 #include "I2D_Clear.h"
 
+#include <set>
+#include <tbb/parallel_reduce.h>
+
 namespace FloatingObstacleVectorStuff
 {
 
@@ -42,11 +45,192 @@ struct Mass
 	}
 };
 
+// Block-level spatial index of the agents: for every block (by its position in vInfo) the list of
+// the agents whose bounding box overlaps it. The boxes are binned on the dense block lattice of the
+// grid, so that building the index costs O(blocks + covered blocks) array lookups instead of
+// O(blocks x agents). Agents that cannot bound their support are kept aside in "unbounded".
+struct AgentIndex
+{
+	vector< vector<int> > block2agents;
+	vector<int> unbounded;
+	vector<int> id2ordinal;
+
+	AgentIndex(const vector<BlockInfo>& vInfo, const I2D_FloatingObstacleVector::BlockLattice& lattice, const vector<I2D_FloatingObstacleOperator *>& agents):
+		block2agents(vInfo.size())
+	{
+		int maxid = 0;
+		for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
+			maxid = max(maxid, it->blockID);
+
+		id2ordinal.resize(maxid+1, -1);
+
+		for(int i=0; i<(int)vInfo.size(); i++)
+			id2ordinal[vInfo[i].blockID] = i;
+
+		// the box test of the agents is done on the cell centers, this is only a conservative filter
+		const double tol = 1e-4;
+
+		for(int a=0; a<(int)agents.size(); a++)
+		{
+			Real xmin[2], xmax[2];
+
+			if (!agents[a]->getBoundingBox(xmin, xmax))
+			{
+				unbounded.push_back(a);
+				continue;
+			}
+
+			for(int l=0; l<(int)lattice.levels.size(); l++)
+			{
+				const I2D_FloatingObstacleVector::BlockLattice::Level& level = lattice.levels[l];
+
+				if (level.nx == 0) continue;
+
+				const int start[2] = {
+					max(level.ix0, (int)floor((xmin[0] - level.x0)/level.L - tol)),
+					max(level.iy0, (int)floor((xmin[1] - level.y0)/level.L - tol))
+				};
+
+				const int end[2] = {
+					min(level.ix0 + level.nx, (int)floor((xmax[0] - level.x0)/level.L + tol) + 1),
+					min(level.iy0 + level.ny, (int)floor((xmax[1] - level.y0)/level.L + tol) + 1)
+				};
+
+				for(int iy=start[1]; iy<end[1]; iy++)
+					for(int ix=start[0]; ix<end[0]; ix++)
+					{
+						const int blockID = lattice.find(l, ix, iy);
+
+						if (blockID >= 0)
+							block2agents[id2ordinal[blockID]].push_back(a);
+					}
+			}
+		}
+	}
+
+	int maxBlockID() const { return (int)id2ordinal.size() - 1; }
+
+	int ordinal(const BlockInfo& info) const
+	{
+		assert(info.blockID < (int)id2ordinal.size() && id2ordinal[info.blockID] >= 0);
+		return id2ordinal[info.blockID];
+	}
+};
+
+// Visits every block once: overwrites tmp with the max of the characteristic functions of the overlapping
+// agents and, if a desired velocity field is given, merges the slot of the block
+struct Rasterize
+{
+	const AgentIndex& index;
+	const vector<I2D_FloatingObstacleOperator *>& agents;
+	I2D_DesiredVelocityField * field;
+
+	Rasterize(const AgentIndex& index, const vector<I2D_FloatingObstacleOperator *>& agents, I2D_DesiredVelocityField * field = NULL):
+		index(index), agents(agents), field(field)
+	{
+	}
+
+	Rasterize(const Rasterize& c): index(c.index), agents(c.agents), field(c.field)
+	{
+	}
+
+	inline void operator()(const BlockInfo& info, FluidBlock2D& b) const
+	{
+		const int n = FluidBlock2D::sizeX*FluidBlock2D::sizeY;
+
+		FluidElement2D * const e = &b(0,0);
+		for(int i=0; i<n; i++)
+			e[i].tmp = 0;
+
+		const vector<int>& overlapping = index.block2agents[index.ordinal(info)];
+
+		for(vector<int>::const_iterator it=overlapping.begin(); it!=overlapping.end(); it++)
+			agents[*it]->rasterize(info, b);
+
+		if (field == NULL) return;
+
+		const int slot = field->slot(info.blockID);
+
+		if (slot >= 0)
+			field->merge(slot);
+	}
+};
+
+// Diagnostics of all the indexed agents in one sweep over the blocks they cover. The accumulators are
+// per agent and private to each body of the reduction; on a block shared by several agents the
+// characteristic function of each one is rasterized in turn into tmp, which is restored afterwards.
+struct AgentDiagnostics
+{
+	typedef I2D_FloatingObstacleOperator::Diagnostics Diagnostics;
+	typedef I2D_DesiredVelocityField::Contribution Contribution;
+
+	const vector<BlockInfo>& vInfo;
+	const BlockCollection<B>& coll;
+	const vector<I2D_FloatingObstacleOperator *>& agents;
+	const vector<int>& work;
+	const vector< vector<Contribution> >& contributions;
+	Real lambda, Uinf[2];
+
+	vector<Diagnostics> diag;
+
+	AgentDiagnostics(const vector<BlockInfo>& vInfo, const BlockCollection<B>& coll, const vector<I2D_FloatingObstacleOperator *>& agents,
+			const vector<int>& work, const vector< vector<Contribution> >& contributions, Real lambda, const Real _Uinf[2]):
+		vInfo(vInfo), coll(coll), agents(agents), work(work), contributions(contributions), lambda(lambda), diag(agents.size())
+	{
+		Uinf[0] = _Uinf[0];
+		Uinf[1] = _Uinf[1];
+	}
+
+	AgentDiagnostics(const AgentDiagnostics& c, tbb::split):
+		vInfo(c.vInfo), coll(c.coll), agents(c.agents), work(c.work), contributions(c.contributions), lambda(c.lambda), diag(c.agents.size())
+	{
+		Uinf[0] = c.Uinf[0];
+		Uinf[1] = c.Uinf[1];
+	}
+
+	void operator()(const blocked_range<int>& range)
+	{
+		const int n = FluidBlock2D::sizeX*FluidBlock2D::sizeY;
+
+		Real chi[n];
+
+		for(int w=range.begin(); w<range.end(); w++)
+		{
+			const int i = work[w];
+			const BlockInfo& info = vInfo[i];
+			FluidBlock2D& b = coll[info.blockID];
+			FluidElement2D * const e = &b(0,0);
+
+			for(int k=0; k<n; k++)
+				chi[k] = e[k].tmp;
+
+			const vector<Contribution>& c = contributions[i];
+
+			for(vector<Contribution>::const_iterator it=c.begin(); it!=c.end(); it++)
+			{
+				for(int k=0; k<n; k++)
+					e[k].tmp = 0;
+
+				agents[it->agent]->rasterize(info, b);
+				diag[it->agent].integrate(info, b, *it->src, lambda, Uinf);
+			}
+
+			for(int k=0; k<n; k++)
+				e[k].tmp = chi[k];
+		}
+	}
+
+	void join(const AgentDiagnostics& c)
+	{
+		for(int a=0; a<(int)diag.size(); a++)
+			diag[a] += c.diag[a];
+	}
+};
 }
 
 
 I2D_FloatingObstacleVector::I2D_FloatingObstacleVector(ArgumentParser & parser, Grid<W,B>& grid, const Real eps, const Real Uinf[2], I2D_PenalizationOperator& penalization, map< string, vector<I2D_FloatingObstacleOperator *> > _data, Real charLength, Real charVel):
-												I2D_FloatingObstacleOperator(parser, grid, 1, eps, Uinf, penalization), data(_data), arrayVelBlock(NULL), charLength(charLength), charVel(charVel)
+												I2D_FloatingObstacleOperator(parser, grid, 1, eps, Uinf, penalization), data(_data), charLength(charLength), charVel(charVel)
 {
 	for( map< string, vector<I2D_FloatingObstacleOperator *> >::iterator it = data.begin(); it!=data.end(); ++it)
 		for( vector<I2D_FloatingObstacleOperator *>::iterator it2 = it->second.begin(); it2!=it->second.end(); ++it2)
@@ -73,6 +257,66 @@ I2D_FloatingObstacleVector::~I2D_FloatingObstacleVector()
 		}
 }
 
+void I2D_FloatingObstacleVector::BlockLattice::build(const vector<BlockInfo>& vInfo)
+{
+	int maxlevel = 0;
+	for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
+		maxlevel = max(maxlevel, (int)it->level);
+
+	// index range of every level, origin of the block (0,0) and block extent
+	levels.assign(maxlevel+1, Level());
+	vector<int> ix1(maxlevel+1, -1), iy1(maxlevel+1, -1);
+
+	for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
+	{
+		Level& l = levels[it->level];
+
+		if (ix1[it->level] < 0)
+		{
+			l.L = it->h[0]*FluidBlock2D::sizeX;
+			l.x0 = it->origin[0] - it->index[0]*l.L;
+			l.y0 = it->origin[1] - it->index[1]*l.L;
+			l.ix0 = ix1[it->level] = it->index[0];
+			l.iy0 = iy1[it->level] = it->index[1];
+		}
+
+		l.ix0 = min(l.ix0, (int)it->index[0]);
+		l.iy0 = min(l.iy0, (int)it->index[1]);
+		ix1[it->level] = max(ix1[it->level], (int)it->index[0]);
+		iy1[it->level] = max(iy1[it->level], (int)it->index[1]);
+	}
+
+	int total = 0;
+	for(int l=0; l<=maxlevel; l++)
+	{
+		if (ix1[l] < 0) continue;
+
+		levels[l].start = total;
+		levels[l].nx = ix1[l] - levels[l].ix0 + 1;
+		levels[l].ny = iy1[l] - levels[l].iy0 + 1;
+		total += levels[l].nx*levels[l].ny;
+	}
+
+	blockIDs.assign(total, -1);
+
+	for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
+	{
+		const Level& l = levels[it->level];
+		blockIDs[l.start + (it->index[0] - l.ix0) + l.nx*(it->index[1] - l.iy0)] = it->blockID;
+	}
+}
+
+const I2D_FloatingObstacleVector::BlockLattice& I2D_FloatingObstacleVector::_lattice()
+{
+	if (block_lattice.version != grid.getBlocksInfoVersion())
+	{
+		block_lattice.build(grid.getBlocksInfoRef());
+		block_lattice.version = grid.getBlocksInfoVersion();
+	}
+
+	return block_lattice;
+}
+
 Real I2D_FloatingObstacleVector::getD() const
 {
 	printf("The call to this method is for an eterogeneous collection of obstacle, not implemented yet!\n");
@@ -91,11 +335,15 @@ Real I2D_FloatingObstacleVector::getDrag() const
 
 void I2D_FloatingObstacleVector::characteristic_function()
 {
-	I2D_Clear cleaner;
-	cleaner.clearTmp(grid);
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 
-	for( vector<I2D_FloatingObstacleOperator *>::iterator it = agents.begin(); it!=agents.end(); ++it)
-		(*it)->characteristic_function();
+	// One sweep over the blocks for all the agents that can be indexed (it also clears tmp)
+	FloatingObstacleVectorStuff::AgentIndex index(vInfo, _lattice(), agents);
+	FloatingObstacleVectorStuff::Rasterize rasterize(index, agents);
+	block_processing.process(vInfo, grid.getBlockCollection(), rasterize);
+
+	for(vector<int>::const_iterator it = index.unbounded.begin(); it!=index.unbounded.end(); ++it)
+		agents[*it]->characteristic_function();
 }
 
 void I2D_FloatingObstacleVector::update(const double dt, const double t, string filename, map< string, vector<I2D_FloatingObstacleOperator *> > * _data)
@@ -132,53 +380,38 @@ void I2D_FloatingObstacleVector::computeDesiredVelocity(const double t)
 	for( vector<I2D_FloatingObstacleOperator *>::iterator it = agents.begin(); it!=agents.end(); ++it)
 		(*it)->computeDesiredVelocity(t);
 
-	// Clean up obstacle vector desired velocity (TODO: blocks could be allocated/deallocated sync with refinement/compression)
-	if(arrayVelBlock!=NULL)
-		VelocityBlock::deallocate(arrayVelBlock);
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 
-	desired_velocity.clear();
+	// Only the agents overlapping a block (and the ones without bounding box) can contribute to it
+	FloatingObstacleVectorStuff::AgentIndex index(vInfo, _lattice(), agents);
 
-	// Instantiate global map
-	map<int , VelocityBlock *> gmap;
+	desired_field.reset(index.maxBlockID());
 
-	// Pack all obstacles' desired velocities into a global one
-	vector< map<int , const VelocityBlock *> > vectorDesiredVelocities;
-	for( vector<I2D_FloatingObstacleOperator *>::iterator it = agents.begin(); it!=agents.end(); ++it)
-		vectorDesiredVelocities.push_back( (*it)->getDesiredVelocity() );
-
-	// Create set of ids of all involved blocks
-	set<int> idx;
-	for(vector< map<int , const VelocityBlock *> >::iterator ito = vectorDesiredVelocities.begin(); ito!=vectorDesiredVelocities.end(); ito++)
-		for(map<int, const VelocityBlock *>::iterator it = (*ito).begin(); it!=(*ito).end(); it++)
-			idx.insert(it->first);
-
-	// Allocate all blocks
-	int counter = 0;
-	arrayVelBlock = VelocityBlock::allocate(idx.size());
-	memset(arrayVelBlock,0,idx.size()*sizeof(VelocityBlock));
-	for(set<int>::iterator it = idx.begin(); it!=idx.end(); it++, counter++ )
-		gmap[*it] = &arrayVelBlock[counter];
-
-	// Cumulate values
-	for(vector< map<int , const VelocityBlock *> >::iterator ito = vectorDesiredVelocities.begin(); ito!=vectorDesiredVelocities.end(); ito++)
-		for(map<int, const VelocityBlock *>::iterator it = (*ito).begin(); it!=(*ito).end(); it++)
+	for(int i=0; i<(int)vInfo.size(); i++)
+		for(int pass=0; pass<2; pass++)
 		{
-			VelocityBlock * dest = gmap[it->first];
-			const VelocityBlock * src = it->second;
-
-			for(int iy=0; iy<FluidBlock2D::sizeY; iy++)
-				for(int ix=0; ix<FluidBlock2D::sizeX; ix++)
-				{
-					dest->u[0][iy][ix] += src->u[0][iy][ix];
-					dest->u[1][iy][ix] += src->u[1][iy][ix];
-				}
+			const vector<int>& candidates = pass==0 ? index.block2agents[i] : index.unbounded;
+
+			for(vector<int>::const_iterator it=candidates.begin(); it!=candidates.end(); it++)
+			{
+				const VelocityBlock * velblock = agents[*it]->getDesiredVelocity().find(vInfo[i].blockID);
+
+				if (velblock != NULL)
+					desired_field.add(vInfo[i].blockID, *it, velblock);
+			}
 		}
 
-	// Register penalization and global desired velocity
-	for	(map<int, VelocityBlock *>::iterator it = gmap.begin(); it!= gmap.end(); it++)
-		desired_velocity[it->first] = it->second;
+	desired_field.allocate();
+
+	// Merged characteristic function and desired velocity in the same sweep
+	FloatingObstacleVectorStuff::Rasterize rasterize(index, agents, &desired_field);
+	block_processing.process(vInfo, grid.getBlockCollection(), rasterize);
+
+	for(vector<int>::const_iterator it = index.unbounded.begin(); it!=index.unbounded.end(); ++it)
+		agents[*it]->characteristic_function();
 
-	penalization.set_desired_velocity(&desired_velocity);
+	// Register penalization and global desired velocity
+	penalization.set_desired_velocity(&desired_field);
 }
 
 void I2D_FloatingObstacleVector::save(const double t, string filename)
@@ -256,14 +489,61 @@ void I2D_FloatingObstacleVector::refresh(const double t, string filename)
 
 void I2D_FloatingObstacleVector::computeDragAndStuff(const Real time, const Real charLength, const Real charVel)
 {
+	typedef I2D_DesiredVelocityField::Contribution Contribution;
+
+	// summed in the order of the blocks in the tree, the same for any number of threads
+	const vector<BlockInfo>& vInfo = sorted_blocks.get(grid);
+
+	FloatingObstacleVectorStuff::AgentIndex index(vInfo, _lattice(), agents);
+
+	// (agent, desired velocity) pairs of every block, only the blocks with at least one pair are visited
+	vector< vector<Contribution> > contributions(vInfo.size());
+	vector<int> work;
+
+	for(int i=0; i<(int)vInfo.size(); i++)
+	{
+		const vector<int>& candidates = index.block2agents[i];
+
+		for(vector<int>::const_iterator it=candidates.begin(); it!=candidates.end(); it++)
+		{
+			const VelocityBlock * velblock = agents[*it]->getDesiredVelocity().find(vInfo[i].blockID);
+
+			if (velblock != NULL)
+				contributions[i].push_back(Contribution(*it, velblock));
+		}
+
+		if (contributions[i].size() > 0)
+			work.push_back(i);
+	}
+
+	FloatingObstacleVectorStuff::AgentDiagnostics getDiag(vInfo, grid.getBlockCollection(), agents, work, contributions, penalization.getLambda(), Uinf);
+	Multithreading::deterministic_reduce(work.size(), getDiag, 4);
+
+	vector<bool> indexed(agents.size(), true);
+	for(vector<int>::const_iterator it = index.unbounded.begin(); it!=index.unbounded.end(); ++it)
+		indexed[*it] = false;
+
+	for(int a=0; a<(int)agents.size(); a++)
+		if (indexed[a])
+		{
+			Diagnostics d = getDiag.diag[a];
+			d.finalize();
+			agents[a]->setDiagnostics(d, time, this->charLength, this->charVel);
+		}
+
+	// The agents without bounding box need their own characteristic function in tmp
+	if (index.unbounded.size() == 0) return;
+
 	I2D_Clear cleaner;
 
-	for( vector<I2D_FloatingObstacleOperator *>::iterator it = agents.begin(); it!=agents.end(); ++it)
+	for(vector<int>::const_iterator it = index.unbounded.begin(); it!=index.unbounded.end(); ++it)
 	{
 		cleaner.clearTmp(grid);
-		(*it)->characteristic_function();
-		(*it)->computeDragAndStuff(time, this->charLength, this->charVel);
+		agents[*it]->characteristic_function();
+		agents[*it]->computeDragAndStuff(time, this->charLength, this->charVel);
 	}
+
+	characteristic_function();
 }
 
 std::vector<Real> I2D_FloatingObstacleVector::getMass()
@@ -281,11 +561,11 @@ std::vector<Real> I2D_FloatingObstacleVector::getMass()
 
 	characteristic_function();
 
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	map<int, Real> local_data;
-	for(vector<BlockInfo>::iterator it=vInfo.begin(); it!=vInfo.end(); it++)
+	for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
 		local_data[it->blockID] = 0;
 
 	// Compute mass
@@ -334,8 +614,10 @@ void I2D_FloatingObstacleVector::reward(const double t, map< string, vector<I2D_
 		(*it)->reward(t,&data);
 }
 
-void I2D_FloatingObstacleVector::savePolicy(string name)
+// a policy shared by several agents is saved (and restarted) once, under the name of its first agent
+void I2D_FloatingObstacleVector::savePolicy(string name, bool bBackground)
 {
+	set<RL::RL_TabularPolicy *> saved;
 	unsigned int counter = 0;
 	for( vector<I2D_FloatingObstacleOperator *>::iterator it = agents.begin(); it!=agents.end(); ++it)
 	{
@@ -343,13 +625,15 @@ void I2D_FloatingObstacleVector::savePolicy(string name)
 		sprintf(ending, "shape_%04d", counter);
 		string dummy(ending);
 		string name("saveQ_" + dummy);
-		(*it)->savePolicy(name);
+		if(saved.insert((*it)->getPolicy()).second)
+			(*it)->savePolicy(name, bBackground);
 		counter++;
 	}
 }
 
 void I2D_FloatingObstacleVector::restartPolicy(string name)
 {
+	set<RL::RL_TabularPolicy *> restarted;
 	unsigned int counter = 0;
 		for( vector<I2D_FloatingObstacleOperator *>::iterator it = agents.begin(); it!=agents.end(); ++it)
 	{
@@ -357,7 +641,8 @@ void I2D_FloatingObstacleVector::restartPolicy(string name)
 		sprintf(ending, "shape_%04d", counter);
 		string dummy(ending);
 		string name("saveQ_" + dummy);
-		(*it)->restartPolicy(name);
+		if(restarted.insert((*it)->getPolicy()).second)
+			(*it)->restartPolicy(name);
 		counter++;
 	}
 }
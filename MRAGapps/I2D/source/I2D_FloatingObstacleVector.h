@@ -13,6 +13,7 @@
 #include "I2D_Headers.h"
 #include "I2D_Types.h"
 #include "I2D_FloatingObstacleOperator.h"
+#include "I2D_DesiredVelocityField.h"
 
 using namespace std;
 
@@ -20,7 +21,42 @@ class I2D_FloatingObstacleVector : public I2D_FloatingObstacleOperator
 {
 	const Real charLength, charVel;
 	vector<I2D_FloatingObstacleOperator *> agents;
-	VelocityBlock * arrayVelBlock;
+	I2D_DesiredVelocityField desired_field;
+
+public:
+	// Dense table of the blocks by (level, index) over the index range of each level,
+	// rebuilt only when the blocks of the grid change (see Grid::getBlocksInfoVersion())
+	struct BlockLattice
+	{
+		struct Level
+		{
+			int start, ix0, iy0, nx, ny;
+			double x0, y0, L;
+
+			Level(): start(0), ix0(0), iy0(0), nx(0), ny(0), x0(0), y0(0), L(0) {}
+		};
+
+		int version;
+		vector<Level> levels;
+		vector<int> blockIDs; // -1 where there is no block
+
+		BlockLattice(): version(-1) {}
+
+		void build(const vector<BlockInfo>& vInfo);
+
+		int find(const int level, const int ix, const int iy) const
+		{
+			const Level& l = levels[level];
+			const int x = ix - l.ix0, y = iy - l.iy0;
+
+			return (x < 0 || y < 0 || x >= l.nx || y >= l.ny) ? -1 : blockIDs[l.start + x + l.nx*y];
+		}
+	};
+
+private:
+	BlockLattice block_lattice;
+	const BlockLattice& _lattice();
+
 public:
 	map< string, vector<I2D_FloatingObstacleOperator *> > data;
 
@@ -43,7 +79,7 @@ public:
 
 
 	// Online learning
-	void savePolicy(string name=string());
+	void savePolicy(string name=string(), bool bBackground=false);
 	void restartPolicy(string name=string());
 	bool choose(const double t, map< string, vector<I2D_FloatingObstacleOperator *> > * _data = NULL );
 	void learn(const double t, map< string, vector<I2D_FloatingObstacleOperator *> > * _data = NULL, string name=string());
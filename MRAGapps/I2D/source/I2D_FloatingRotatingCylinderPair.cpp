@@ -415,7 +415,7 @@ I2D_FloatingRotatingCylinderPair::~I2D_FloatingRotatingCylinderPair()
 
 void I2D_FloatingRotatingCylinderPair::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	FloatingRotatingCylinderPair::FillBlocks fill(eps,shape);
@@ -487,7 +487,7 @@ void I2D_FloatingRotatingCylinderPair::computeDesiredVelocity(const double t)
 	double vybar = 0.0;
 	double omegabar = 0.0;
 	
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	map<int, vector<double> > integrals;
@@ -535,11 +535,6 @@ void I2D_FloatingRotatingCylinderPair::computeDesiredVelocity(const double t)
 	printf("\n\n");
 	
 	// Set desired velocities
-	for	(map<int, const VelocityBlock *>::iterator it = desired_velocity.begin(); it!= desired_velocity.end(); it++)
-	{
-		assert(it->second != NULL);
-		VelocityBlock::deallocate(it->second);
-	}
 	
 	desired_velocity.clear();
 	
@@ -548,8 +543,7 @@ void I2D_FloatingRotatingCylinderPair::computeDesiredVelocity(const double t)
 	{
 		if(nonempty[it->blockID] == true)
 		{
-			VelocityBlock * velblock = VelocityBlock::allocate(1);
-			desired_velocity[it->blockID] = velblock;
+			VelocityBlock * velblock = desired_velocity.allocate(it->blockID);
 			velblocks.push_back(pair< BlockInfo, VelocityBlock *>(*it, velblock));
 		}
 	}
@@ -18,6 +18,7 @@
 
 #include "I2D_FlowPastFixedObstacle.h"
 #include "I2D_AdvectionOperator_Particles.h"
+#include "I2D_AdvectionOperator_ParticlesRK.h"
 #include "I2D_VelocitySolver_Mani.h"
 #include "I2D_VelocitySolver_Wim.h"
 
@@ -36,9 +37,15 @@ static const int maxParticleStencil[2][3] = {
 		+4, +4, +1
 };
 
+//the wide particles need one more cell, see I2D_AdvectionOperator_ParticlesRK::margin
+static const int maxParticleStencilRK[2][3] = {
+		-4, -4, 0,
+		+5, +5, +1
+};
+
 I2D_FlowPastFixedObstacle::I2D_FlowPastFixedObstacle(const int argc, const char ** argv): 
 												parser(argc, argv), t(0), step_id(0),
-												velsolver(NULL),obstacle(NULL), penalization(NULL), advection(NULL), diffusion(NULL)
+												velsolver(NULL),obstacle(NULL), penalization(NULL), advection(NULL), diffusion(NULL), budget(NULL)
 {
 	printf("////////////////////////////////////////////////////////////\n");
 	printf("////////////            AVE MARIA         ///////////////\n");
@@ -52,6 +59,10 @@ I2D_FlowPastFixedObstacle::I2D_FlowPastFixedObstacle(const int argc, const char
 	LAMBDADT = parser("-lambdadt").asDouble();
 	XPOS = parser("-xpos").asDouble();
 	YPOS = parser("-ypos").asDouble();
+	RKORDER = parser("-particles-rk").asInt();
+
+	// per-step counters and timings (perfmon.csv, continued by a restart), -perftrace also writes the timeline of every step
+	profiler.setOutput(parser("-perfmon").asString("perfmon"), parser("-perftrace").asBool(), bRESTART);
 
 	if (sOBSTACLE == "")
 		sOBSTACLE = "cyl";
@@ -80,6 +91,7 @@ I2D_FlowPastFixedObstacle::I2D_FlowPastFixedObstacle(const int argc, const char
 	Uinf[0] = parser("-uinfx").asDouble();
 	Uinf[1] = parser("-uinfy").asDouble();
 	FC = parser("-fc").asDouble();
+	MEMBUDGET = parser("-membudget").asDouble(0);
 	const bool HILBERT = parser("-hilbert").asBool();
 
 	parser.save_options();
@@ -91,8 +103,9 @@ I2D_FlowPastFixedObstacle::I2D_FlowPastFixedObstacle(const int argc, const char
 	assert(JUMP >= 1);
 	assert(LMAX >= 0);
 	assert(RE > 0);
-	assert(CFL > 0 && CFL<1);
-	assert(LCFL > 0 && LCFL<1);
+	assert(RKORDER == 0 || (bPARTICLES && RKORDER == 2));
+	assert(CFL > 0 && CFL < (RKORDER == 0 ? 1 : 1 + I2D_AdvectionOperator_ParticlesRK::margin));
+	assert(LCFL > 0 && LCFL < 1);
 	assert(RTOL > 0);
 	assert(CTOL > 0);
 	assert(LAMBDA > 0);
@@ -100,6 +113,7 @@ I2D_FlowPastFixedObstacle::I2D_FlowPastFixedObstacle(const int argc, const char
 	assert(sRIGID_INLET_TYPE != "");
 	assert(MOLLFACTOR > 0);
 	assert(FC>0.0 && FC<1.0);
+	assert(MEMBUDGET >= 0);
 
 #ifdef _I2D_MPI_
 	if (sFMMSOLVER == "mpi-velocity")
@@ -125,17 +139,19 @@ I2D_FlowPastFixedObstacle::I2D_FlowPastFixedObstacle(const int argc, const char
 
 	nu = charVel*D/RE;
 
+	const int (* const particleStencil)[3] = RKORDER == 0 ? maxParticleStencil : maxParticleStencilRK;
+
 	if (HILBERT)
 	{
 		if (bPARTICLES)
-			grid = new Grid_Hilbert2D<W,B>(BPD,BPD,1, maxParticleStencil);
+			grid = new Grid_Hilbert2D<W,B>(BPD,BPD,1, particleStencil);
 		else
 			grid = new Grid_Hilbert2D<W,B>(BPD,BPD,1);
 	}
 	else
 	{
 		if (bPARTICLES)
-			grid = new Grid<W,B>(BPD,BPD,1, maxParticleStencil);
+			grid = new Grid<W,B>(BPD,BPD,1, particleStencil);
 		else
 			grid = new Grid<W,B>(BPD,BPD,1);
 	}
@@ -148,6 +164,9 @@ I2D_FlowPastFixedObstacle::I2D_FlowPastFixedObstacle(const int argc, const char
 	grid->setRefiner(refiner);
 	grid->setCompressor(compressor);
 
+	//ghost tables of the coarse blocks compressed above 90% of -membudget MB, after every refinement
+	budget = new MemoryBudget< Grid<W,B> >(MEMBUDGET);
+
 	//const Real h_spaceconv = 1./FluidBlock2D::sizeX*pow(0.5, 4);
 	//epsilon = (Real)MOLLFACTOR*sqrt(2.)*h_spaceconv;
 
@@ -155,7 +174,9 @@ I2D_FlowPastFixedObstacle::I2D_FlowPastFixedObstacle(const int argc, const char
 
 	penalization = new I2D_PenalizationOperator(*grid, LAMBDA, Uinf, bRESTART);
 
-	if (bPARTICLES)
+	if (bPARTICLES && RKORDER > 0)
+		advection =new I2D_AdvectionOperator_ParticlesRK(*grid, CFL, LCFL);
+	else if (bPARTICLES)
 		advection =new I2D_AdvectionOperator_Particles(*grid, CFL, LCFL);
 	else
 		advection =new I2D_AdvectionOperator(*grid, CFL);
@@ -237,6 +258,7 @@ I2D_FlowPastFixedObstacle::~I2D_FlowPastFixedObstacle()
 {
 	if(velsolver!=NULL){ delete velsolver; velsolver=NULL; }
 	if(obstacle!=NULL){ delete obstacle; obstacle=NULL; }
+	if(budget!=NULL){ delete budget; budget=NULL; }
 	if(penalization!=NULL){ delete penalization; penalization=NULL; }
 	if(advection!=NULL){ delete advection; advection=NULL; }
 	if(diffusion!=NULL){ delete diffusion; diffusion=NULL; }
@@ -425,7 +447,7 @@ void I2D_FlowPastFixedObstacle::_refine(bool bUseIC)
 		while(true)
 		{
 			((Refiner_BlackList*)refiner)->set_blacklist(&boundary_blocks);
-			const int refinements = Science::AutomaticRefinement<0,0>(*grid, fwt_obstacle, RTOL, LMAX, 1, NULL, (void (*)(Grid<W,B>&))NULL, &boundary_blocks);
+			const int refinements = Science::AutomaticRefinement<0,0>(*grid, fwt_obstacle, RTOL, LMAX, 1, NULL, (void (*)(Grid<W,B>&))NULL, &boundary_blocks, budget);
 			_ic(*grid);
 			if (refinements == 0) break;
 		}
@@ -437,7 +459,7 @@ void I2D_FlowPastFixedObstacle::_refine(bool bUseIC)
 		while(true)
 		{
 			((Refiner_BlackList*)refiner)->set_blacklist(&boundary_blocks);
-			const int refinements = Science::AutomaticRefinement<0,2>(*grid, fwt_wuv, RTOL, LMAX, 1, NULL, (void (*)(Grid<W,B>&))NULL, &boundary_blocks);
+			const int refinements = Science::AutomaticRefinement<0,2>(*grid, fwt_wuv, RTOL, LMAX, 1, NULL, (void (*)(Grid<W,B>&))NULL, &boundary_blocks, budget);
 			if (refinements == 0) break;
 		}
 	}
@@ -446,7 +468,7 @@ void I2D_FlowPastFixedObstacle::_refine(bool bUseIC)
 		while(true)
 		{
 			((Refiner_BlackList*)refiner)->set_blacklist(&boundary_blocks);
-			const int refinements = Science::AutomaticRefinement<0,0>(*grid, fwt_omega, RTOL, LMAX, 1, NULL, (void (*)(Grid<W,B>&))NULL, &boundary_blocks);
+			const int refinements = Science::AutomaticRefinement<0,0>(*grid, fwt_omega, RTOL, LMAX, 1, NULL, (void (*)(Grid<W,B>&))NULL, &boundary_blocks, budget);
 			if (refinements == 0) break;
 		}
 	}
@@ -566,12 +588,13 @@ void I2D_FlowPastFixedObstacle::_tnext(double &tnext, double &tnext_dump, double
 		FILE * f = fopen("report.txt", step_id == 0 ? "w" : "a");
 		assert(f!=NULL);
 
-		fprintf(f, "####################### t is %e, dt is %e and is bound by: %s", t, tnext - t, dtBound.c_str());
-		fprintf(f, "stepid=%d\tT=%e\tDT=%e\t", (int)step_id, tnext*nondim_factor, (tnext - t)*nondim_factor);
+		//all the digits: two runs are compared bit for bit (see launch/verifyDeterminism.sh)
+		fprintf(f, "####################### t is %.17g, dt is %.17g and is bound by: %s", t, tnext - t, dtBound.c_str());
+		fprintf(f, "stepid=%d\tT=%.17g\tDT=%.17g\t", (int)step_id, tnext*nondim_factor, (tnext - t)*nondim_factor);
 		for(int i=0; i<(int)tnext_candidates.size(); i++)
-			fprintf(f, "%s: %2.2e,\t", tnext_names[i].c_str(), tnext_candidates[i] - t);
+			fprintf(f, "%s: %.17g,\t", tnext_names[i].c_str(), tnext_candidates[i] - t);
 
-		fprintf(f, "GTS-Fc: %2.2e,\t", FC*pow(min_dx,2)/(8.0*nu));
+		fprintf(f, "GTS-Fc: %.17g,\t", FC*pow(min_dx,2)/(8.0*nu));
 
 		fprintf(f, "\n");
 		fclose(f);
@@ -667,19 +690,13 @@ void I2D_FlowPastFixedObstacle::run()
 				const tbb::tick_count now = tbb::tick_count::now();
 				const Real Tcurr = t*nondim_factor;
 				const Real wallclock = (now-start_instant).seconds();
-				const int nblocks = grid->getBlocksInfo().size();
-
-				FILE * f = fopen("more-perfmon.txt", step_id == 1 ? "w" : "a");
-
-				if (f!=NULL)
-				{
-					if (step_id == 0)
-						fprintf(f,"stepid\twall-clock[s]\tT[-]\tblocks\tADV-rhs\tDIFF-rhs\n");
-
-					fprintf(f,"%d\t%e\t%e\t%d\t%d\t%d\n", (int)step_id, wallclock, Tcurr, nblocks, advection->get_nofrhs(), diffusion->get_nofrhs());
+				profiler.set("wall-clock", wallclock);
+				profiler.set("T", Tcurr);
+				profiler.set("blocks", grid->getBlocksInfo().size());
+				profiler.set("ADV-rhs", advection->get_nofrhs());
+				profiler.set("DIFF-rhs", diffusion->get_nofrhs());
 
-					fclose(f);
-				};
+				profiler.endStep(step_id);
 			}
 
 			printf("END TIME STEP (%d over %d)\n", i, ADAPTFREQ);
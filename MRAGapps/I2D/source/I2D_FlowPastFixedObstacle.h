@@ -35,8 +35,8 @@ class I2D_FlowPastFixedObstacle: public I2D_Test
 {
 protected:
 	//"constants" of the sim
-	int BPD, JUMP, LMAX, ADAPTFREQ, SAVEFREQ, RAMP, MOLLFACTOR;
-	Real DUMPFREQ, RE, CFL, LCFL, RTOL, CTOL, LAMBDA, D, TEND, Uinf[2], nu, LAMBDADT, XPOS, YPOS, epsilon, FC;
+	int BPD, JUMP, LMAX, ADAPTFREQ, SAVEFREQ, RAMP, MOLLFACTOR, RKORDER;
+	Real DUMPFREQ, RE, CFL, LCFL, RTOL, CTOL, LAMBDA, D, TEND, Uinf[2], nu, LAMBDADT, XPOS, YPOS, epsilon, FC, MEMBUDGET;
 	bool bPARTICLES, bUNIFORM, bCORRECTION, bRESTART, bREFINEOMEGAONLY, bFMMSKIP;
 	string sFMMSOLVER, sOBSTACLE, sRIGID_INLET_TYPE;
 	
@@ -50,6 +50,7 @@ protected:
 	
 	Refiner * refiner;
 	Compressor * compressor;
+	MemoryBudget< Grid<W,B> > * budget;
 	
 	BlockFWT<W, B, vorticity_projector, false, 1> fwt_omega;
 	BlockFWT<W, B, velocity_projector, false, 2> fwt_velocity;
@@ -11,6 +11,8 @@
 
 #include "MRAGcore/MRAGCommon.h"
 #include "MRAGcore/MRAGEnvironment.h"
+#include "MRAGcore/MRAGNUMA.h"
+#include "MRAGcore/MRAGMemoryPool.h"
 
 #ifdef __APPLE__
 #ifdef _MRAG_GLUT_VIZ
@@ -44,6 +46,7 @@
 
 #include "MRAGscience/MRAGScienceCore.h"
 #include "MRAGscience/MRAGAutomaticRefiner.h"
+#include "MRAGscience/MRAGMemoryBudget.h"
 #include "MRAGscience/MRAGSimpleLevelsetBlock.h"
 #include "MRAGscience/MRAGSpaceTimeSorter.h"
 #include "MRAGscience/candidate_SpaceTimeSorterRK2.h"
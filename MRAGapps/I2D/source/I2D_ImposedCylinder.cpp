@@ -286,7 +286,7 @@ I2D_ImposedCylinder::~I2D_ImposedCylinder()
 
 void I2D_ImposedCylinder::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	ImposedCylinder::FillBlocks fill(eps,shape);
@@ -477,7 +477,7 @@ void I2D_ImposedCylinder::computeDesiredVelocity(const double t)
 {
 	_setMotionPattern(t);
 
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	map<int, vector<double> > integrals;
@@ -493,12 +493,6 @@ void I2D_ImposedCylinder::computeDesiredVelocity(const double t)
 	block_processing.process(vInfo, coll, getNonEmpty);
 
 	// Set desired velocities
-	for	(map<int, const VelocityBlock *>::iterator it = desired_velocity.begin(); it!= desired_velocity.end(); it++)
-	{
-		assert(it->second != NULL);
-		VelocityBlock::deallocate(it->second);
-		it->second = NULL;
-	}	
 	desired_velocity.clear();
 
 	vector<pair< BlockInfo, VelocityBlock *> > velblocks;
@@ -506,8 +500,7 @@ void I2D_ImposedCylinder::computeDesiredVelocity(const double t)
 	{
 		if(nonempty[it->blockID] == true)
 		{
-			VelocityBlock * velblock = VelocityBlock::allocate(1);
-			desired_velocity[it->blockID] = velblock;
+			VelocityBlock * velblock = desired_velocity.allocate(it->blockID);
 			velblocks.push_back(pair< BlockInfo, VelocityBlock *>(*it, velblock));
 		}
 	}
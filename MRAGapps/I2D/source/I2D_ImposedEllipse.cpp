@@ -353,7 +353,7 @@ I2D_ImposedEllipse::~I2D_ImposedEllipse()
 
 void I2D_ImposedEllipse::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	ImposedEllipse::FillBlocks fill(eps,shape);
@@ -533,7 +533,7 @@ void I2D_ImposedEllipse::computeDesiredVelocity(const double t)
 {
 	_setMotionPattern(t);
 	
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	map<int, vector<double> > integrals;
@@ -549,12 +549,6 @@ void I2D_ImposedEllipse::computeDesiredVelocity(const double t)
 	block_processing.process(vInfo, coll, getNonEmpty);
 	
 	// Set desired velocities
-	for	(map<int, const VelocityBlock *>::iterator it = desired_velocity.begin(); it!= desired_velocity.end(); it++)
-	{
-		assert(it->second != NULL);
-		VelocityBlock::deallocate(it->second);
-		it->second = NULL;
-	}	
 	desired_velocity.clear();
 	
 	vector<pair< BlockInfo, VelocityBlock *> > velblocks;
@@ -562,8 +556,7 @@ void I2D_ImposedEllipse::computeDesiredVelocity(const double t)
 	{
 		if(nonempty[it->blockID] == true)
 		{
-			VelocityBlock * velblock = VelocityBlock::allocate(1);
-			desired_velocity[it->blockID] = velblock;
+			VelocityBlock * velblock = desired_velocity.allocate(it->blockID);
 			velblocks.push_back(pair< BlockInfo, VelocityBlock *>(*it, velblock));
 		}
 	}
@@ -58,7 +58,7 @@ namespace KillStuff
 
 void I2D_KillVortRightBoundaryOperator::killVorticity()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	const Real max_dx= (1./B::sizeX)*pow(0.5,grid.getCurrentMinLevel());;
 	
@@ -251,19 +251,13 @@ void I2D_MRAGOptimisation::run()
 				const Real nondim_factor = sqrt(Uinf[0]*Uinf[0]+Uinf[1]*Uinf[1])*2/D;
 				const Real Tcurr = t*nondim_factor;
 				const Real wallclock = (now-start_instant).seconds();
-				const int nblocks = grid->getBlocksInfo().size();
+				profiler.set("wall-clock", wallclock);
+				profiler.set("T", Tcurr);
+				profiler.set("blocks", grid->getBlocksInfo().size());
+				profiler.set("ADV-rhs", advection->get_nofrhs());
+				profiler.set("DIFF-rhs", diffusion->get_nofrhs());
 				
-				FILE * f = fopen("more-perfmon.txt", step_id == 1 ? "w" : "a");
-				
-				if (f!=NULL)
-				{
-					if (step_id == 0)
-						fprintf(f,"stepid\twall-clock[s]\tT[-]\tblocks\tADV-rhs\tDIFF-rhs\n");
-					
-					fprintf(f,"%d\t%e\t%e\t%d\t%d\t%d\n", (int)step_id, wallclock, Tcurr, nblocks, advection->get_nofrhs(), diffusion->get_nofrhs());
-					
-					fclose(f);
-				};
+				profiler.endStep(step_id);
 			}
 			
 			printf("END TIME STEP (%d over %d)\n", i, ADAPTFREQ);
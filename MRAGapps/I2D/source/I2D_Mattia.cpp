@@ -70,6 +70,8 @@ int main (int argc, const char ** argv)
 	ArgumentParser parser(argc, argv);
 	
 	Environment::setup(max(1, parser("-nthreads").asInt()));
+	NUMATopology::setup(parser("-numa").asInt());
+	MemoryPool::setHugePages(parser("-hugepages").asBool());
 	
 	//test = new I2D_FlowPastObstacleRK(argc, argv);
 	test = new I2D_FlowPastObstacle_Gudonov(argc, argv);	
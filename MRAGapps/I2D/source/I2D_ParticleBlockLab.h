@@ -10,6 +10,7 @@
 
 #include "I2D_VectorBlockLab.h"
 #include "I2D_CoreParticles.h"
+#include "I2D_CoreParticlesRK.h"
 
 struct Streamer_OmegaAndVelocity
 {
@@ -24,11 +25,11 @@ template <> inline void Streamer_OmegaAndVelocity::operate<3>(FluidElement2D& in
 	output[2] = input.u[1];
 }
 
-template<typename BlockType>
-class I2D_ParticleBlockLab: public I2D_VectorBlockLab<Streamer_OmegaAndVelocity, 3>::Lab<BlockType>
+template<typename BlockType, typename CoreParticles>
+class I2D_ParticleBlockLab_Base: public I2D_VectorBlockLab<Streamer_OmegaAndVelocity, 3>::Lab<BlockType>
 {
 public:
-	I2D_CoreParticles pcore;
+	CoreParticles pcore;
 	
 	void load(const BlockInfo& info)
 	{
@@ -42,4 +43,11 @@ public:
 					this->m_sourceData[0][this->base_offset + ix + iy*this->row_size] = 0;
 		}
 	}
-};
\ No newline at end of file
+};
+
+template<typename BlockType>
+class I2D_ParticleBlockLab: public I2D_ParticleBlockLab_Base<BlockType, I2D_CoreParticles> {};
+
+//lab for the wide particles, see I2D_AdvectionOperator_ParticlesRK
+template<typename BlockType>
+class I2D_ParticleBlockLabRK: public I2D_ParticleBlockLab_Base<BlockType, I2D_CoreParticlesRK<1> > {};
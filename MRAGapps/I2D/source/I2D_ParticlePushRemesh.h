@@ -0,0 +1,72 @@
+/*
+ *  I2D_ParticlePushRemesh.h
+ *  IncompressibleFluids2D
+ *
+ *	Block functors shared by the particle advection operators:
+ *	PushRemesh pushes the particles of the lab and remeshes them into external_data,
+ *	UpdateOmega copies external_data back to omega once all the blocks are done.
+ *	MARGIN is the number of cells the particles may travel beyond one: 0 for
+ *	I2D_CoreParticles, the margin of I2D_CoreParticlesRK otherwise.
+ */
+#pragma once
+
+#include "I2D_Types.h"
+
+template<int MARGIN>
+struct PushRemesh
+{
+	Real dt,t;
+	Real Uinf[2];
+
+	int stencil_start[3], stencil_end[3];
+
+	PushRemesh(Real dt, const Real Uinf[2]): dt(dt), t(0)
+	{
+		_setup();
+
+		this->Uinf[0] = Uinf[0];
+		this->Uinf[1] = Uinf[1];
+	}
+
+	PushRemesh(const PushRemesh& c): dt(c.dt), t(0)
+	{
+		_setup();
+
+		Uinf[0] = c.Uinf[0];
+		Uinf[1] = c.Uinf[1];
+	}
+
+	void _setup()
+	{
+		stencil_start[0] = stencil_start[1] = -3 - MARGIN;
+		stencil_end[0] = stencil_end[1] = +4 + MARGIN;
+		stencil_start[2] = 0;
+		stencil_end[2] = 1;
+	}
+
+	template<typename Lab>
+	inline void operator()(Lab& lab, const BlockInfo& info, FluidBlock2D& out) const
+	{
+		lab.pcore.push(info, lab, dt, Uinf);
+		lab.pcore.remesh(lab);
+
+		for(int iy=0; iy<FluidBlock2D::sizeY; iy++)
+			for(int ix=0; ix<FluidBlock2D::sizeX; ix++)
+				out.external_data[iy][ix] = lab.pcore.omega_new[iy][ix];
+	}
+};
+
+struct UpdateOmega
+{
+	inline void operator() (const BlockInfo& info, FluidBlock2D& b) const
+	{
+		FluidElement2D * const dest = &b(0,0);
+
+		const Real * const src = &b.external_data[0][0];
+
+		const int n = FluidBlock2D::sizeY*FluidBlock2D::sizeX;
+
+		for(int i=0; i<n; i++)
+			dest[i].omega = src[i];
+	}
+};
@@ -24,12 +24,9 @@ I2D_PassiveTracer::I2D_PassiveTracer(ArgumentParser & parser, Grid<W,B>& grid, c
 	this->Uinf[1] = Uinf[1];
 
 	particles.clear();
-	block2particles.clear();
-
-	vector<Real> pos;
-	pos.push_back(_xm);
-	pos.push_back(_ym);
-	particles[0] = pos;
+	particles.resize(1);
+	particles.x[0] = _xm;
+	particles.y[0] = _ym;
 }
 
 // Destructor
@@ -43,50 +40,20 @@ I2D_PassiveTracer::~I2D_PassiveTracer()
 // @param filename
 void I2D_PassiveTracer::update(const double dt, const double t, string filename, map< string, vector<I2D_FloatingObstacleOperator *> > * _data)
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	BoundaryInfo& binfo = grid.getBoundaryInfo();
 
-	// Create tree
-	vector<I3> leaves;
-	for(int i=0; i<vInfo.size(); i++)
-	{
-		I3 node(vInfo[i].index[0],vInfo[i].index[1],vInfo[i].level);
-		leaves.push_back(node); //-----> input to tree
-		block2particles[node] = vector<long int>();
-	}
-
-	// Instantiate octree and perform neighbors search
-	const int LMAX =  grid.getCurrentMaxLevel();
-	double origin[2] = {0.0,0.0};
-	const double width = 1.0;
-	QuadTree tree(LMAX+1,width,origin);
-	tree.split(leaves);
-
+	// Assign the tracer to its block
 	assert(particles.size()>0);
-	for(map<long int, vector<Real> >::iterator it=particles.begin(); it!=particles.end(); ++it)
-	{
-		assert(it->second.size()==2);
-		const double p[2] = {it->second[0],it->second[1]};
-		I3 myblock = tree.locateCellIndex(p);
-
-#ifndef NDEBUG
-		const Real dx = 1.0/pow(2.0, myblock.i[2]); /// dx of the block
-		Real startBlock[2] = {myblock.i[0]*dx, myblock.i[1]*dx}; /// actual location of the start of the block
-		Real endBlock[2] = {startBlock[0]+dx, startBlock[1]+dx}; /// actual location of the end limits of the block
-		const bool isInBlock = ( p[0]>=startBlock[0] && p[0]<endBlock[0] && p[1]>=startBlock[1] && p[1]<endBlock[1] );
-		assert(isInBlock);
-#endif
-
-		(block2particles[myblock]).push_back(it->first);
-	}
+	particles.bin(vInfo);
 
 	// Update passive tracer positions
-	I2D_TracerAdvection_RK advect(particles, block2particles, dt, Uinf);
+	I2D_TracerAdvection_RK advect(particles, dt, Uinf);
 	block_processing.process<I2D_ParticleBlockLab>(vInfo, coll, binfo, advect);
 
-	const Real x = particles[0][0];
-	const Real y = particles[0][1];
+	const Real x = particles.x[0];
+	const Real y = particles.y[0];
 
 	/// File I/O
 	FILE * ppFile = NULL;
@@ -115,8 +82,8 @@ void I2D_PassiveTracer::save(const double t, string filename)
 		assert(ppFile != NULL);
 	}
 
-	const Real x = particles[0][0];
-	const Real y = particles[0][1];
+	const Real x = particles.x[0];
+	const Real y = particles.y[0];
 	fprintf(ppFile, "x: %20.20e\n", x);
 	fprintf(ppFile, "y: %20.20e\n", y);
 	fclose(ppFile);
@@ -143,15 +110,13 @@ void I2D_PassiveTracer::restart(const double t, string filename)
 	}
 
 	particles.clear();
-	block2particles.clear();
+	particles.resize(1);
 
-	vector<Real> pos;
 	fscanf(ppFile, "x: %e\n", &val);
-	pos.push_back(val);
+	particles.x[0] = val;
 	fscanf(ppFile, "y: %e\n", &val);
-	pos.push_back(val);
-	particles[0] = pos;
-	printf("PassiveTracer restart (x, y) is: (%e, %e)\n", particles[0][0], particles[0][1]);
+	particles.y[0] = val;
+	printf("PassiveTracer restart (x, y) is: (%e, %e)\n", particles.x[0], particles.y[0]);
 }
 
 
@@ -10,14 +10,14 @@
 #include "I2D_Headers.h"
 #include "I2D_Types.h"
 #include "I2D_FloatingObstacleOperator.h"
+#include "I2D_TracerStore.h"
 #include <vector>
 #include <map>
 
 class I2D_PassiveTracer: public I2D_FloatingObstacleOperator
 {
 protected:
-	map<long int, vector<Real> > particles;
-	map<I3, vector<long int> > block2particles;
+	I2D_TracerStore particles;
 
 public:
 	I2D_PassiveTracer(ArgumentParser & parser, Grid<W,B>& grid, const Real _xm, const Real _ym, const Real D, const Real eps, const Real Uinf[2], I2D_PenalizationOperator& penalization);
@@ -11,6 +11,8 @@
 #include "I2D_VectorBlockLab.h"
 #include "I2D_GradOfVector.h"
 
+#include <tbb/parallel_reduce.h>
+
 struct Penalization
 {
 	Real dt, lambda;
@@ -54,13 +56,14 @@ struct Penalization
 	}
 };
 
+template<typename DesiredVelocities>
 struct PenalizationCustomizedVelocity
 {
 	Real dt, lambda;
 	Real Uinf[2];
-	const map<int, const VelocityBlock *>& customized_velocity;
+	const DesiredVelocities& customized_velocity;
 	
-	PenalizationCustomizedVelocity(Real dt, Real lambda, const map<int, const VelocityBlock *>& customized_velocity, const Real Uinf[2]):  lambda(lambda), dt(dt), customized_velocity(customized_velocity)
+	PenalizationCustomizedVelocity(Real dt, Real lambda, const DesiredVelocities& customized_velocity, const Real Uinf[2]):  lambda(lambda), dt(dt), customized_velocity(customized_velocity)
 	{
 		this->Uinf[0] = Uinf[0];
 		this->Uinf[1] = Uinf[1];
@@ -79,12 +82,10 @@ struct PenalizationCustomizedVelocity
 		
 		const Real lamdt = lambda*dt;
 						
-		const map<int, const VelocityBlock *>::const_iterator it = customized_velocity.find(info.blockID);
+		const VelocityBlock * u_desired = customized_velocity.find(info.blockID);
 
-		if (it!=customized_velocity.end())
+		if (u_desired != NULL)
 		{
-			const VelocityBlock * u_desired = it->second;
-			assert(u_desired != NULL);
 
 			for(int iy=0; iy<FluidBlock2D::sizeY; iy++)		
 				for(int ix=0; ix<FluidBlock2D::sizeX; ix++)		
@@ -177,18 +178,25 @@ struct UpdateVelocities
 
 void I2D_PenalizationOperator::perform_timestep(Real dt)
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	BoundaryInfo& binfo=grid.getBoundaryInfo();  
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
-	if (desired_velocities == NULL)
+	if (desired_field != NULL)
+	{
+		PenalizationCustomizedVelocity<I2D_DesiredVelocityField> penalization(dt, lambda, *desired_field, Uinf);
+		block_processing.process(vInfo, coll, penalization);
+
+		desired_field = NULL;
+	}
+	else if (desired_velocities == NULL)
 	{
 		Penalization penalization(dt, lambda, Uinf);
 		block_processing.process(vInfo, coll, penalization);
 	}
 	else 
 	{
-		PenalizationCustomizedVelocity penalization(dt, lambda, *desired_velocities, Uinf);
+		PenalizationCustomizedVelocity<I2D_DesiredVelocityBlocks> penalization(dt, lambda, *desired_velocities, Uinf);
 		block_processing.process(vInfo, coll, penalization);
 		
 		desired_velocities = NULL;
@@ -230,12 +238,15 @@ struct Diagnostic
 	}
 };
 
+// the blocks are reduced directly into the diagnostic of each thread, no per-block storage
 struct ComputeDiagnostics
 {
 	Real lambda, Uinf[2], cor[2]; // cor is Center Of Rotation
-	map<int, Diagnostic>& diagnostics;
+	const vector<BlockInfo>& vInfo;
+	const BlockCollection<B>& coll;
+	Diagnostic global;
 	
-	ComputeDiagnostics(map< int, Diagnostic>& diagnostics, Real lambda, const Real Uinf[2], const Real cor[2]):diagnostics(diagnostics), lambda(lambda)
+	ComputeDiagnostics(const vector<BlockInfo>& vInfo, const BlockCollection<B>& coll, Real lambda, const Real Uinf[2], const Real cor[2]): vInfo(vInfo), coll(coll), lambda(lambda)
 	{
 		this->Uinf[0] = Uinf[0];
 		this->Uinf[1] = Uinf[1];
@@ -243,7 +254,7 @@ struct ComputeDiagnostics
 		this->cor[1] = cor[1];
 	}
 	
-	ComputeDiagnostics(const ComputeDiagnostics& c): diagnostics(c.diagnostics), lambda(c.lambda)
+	ComputeDiagnostics(const ComputeDiagnostics& c, tbb::split): vInfo(c.vInfo), coll(c.coll), lambda(c.lambda)
 	{
 		Uinf[0] = c.Uinf[0];
 		Uinf[1] = c.Uinf[1];
@@ -251,17 +262,20 @@ struct ComputeDiagnostics
 		cor[1] = c.cor[1];
 	}
 	
-	inline void operator()(const BlockInfo& info, FluidBlock2D& b) const
+	void operator()(const blocked_range<int>& range)
 	{
-		map< int, Diagnostic>::iterator it = diagnostics.find(info.blockID);
-		assert(it != diagnostics.end());
-		Diagnostic& diag = it->second;
-		
-		diag.force[0] = diag.force[1]  = 0.0;
-		diag.torque[0] = diag.torque[1]  = 0.0;
-		diag.area = 0.0;
-		diag.gridpoints = 0.0;
-		diag.circulation = 0.0;
+		for(int i=range.begin(); i<range.end(); i++)
+			global += _diagnostic(vInfo[i], coll[vInfo[i].blockID]);
+	}
+	
+	void join(const ComputeDiagnostics& c)
+	{
+		global += c.global;
+	}
+	
+	inline Diagnostic _diagnostic(const BlockInfo& info, FluidBlock2D& b) const
+	{
+		Diagnostic diag;
 		
 		for(int iy=0; iy<FluidBlock2D::sizeY; iy++)
 			for(int ix=0; ix<FluidBlock2D::sizeX; ix++)
@@ -294,6 +308,8 @@ struct ComputeDiagnostics
 		
 		diag.force[0] += diag.area*lambda*Uinf[0];
 		diag.force[1] += diag.area*lambda*Uinf[1];
+		
+		return diag;
 	}
 };
 
@@ -302,18 +318,13 @@ void I2D_PenalizationOperator::compute_dragandstuff(Real time, const Real D, con
 	const Real maxu = max(fabs(Uinf[0]), fabs(Uinf[1]));
 	const Real U_infinity = (maxu==0.0)?1:maxu;
 	
-	map<int, Diagnostic> diagnostics;
+	// summed in the order of the blocks in the tree, the same for any number of threads
+	const vector<BlockInfo>& vInfo = sorted_blocks.get(grid);
 	
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
-	for(vector<BlockInfo>::iterator it=vInfo.begin(); it!=vInfo.end(); it++)
-		diagnostics[it->blockID] = Diagnostic();
+	ComputeDiagnostics get_diag(vInfo, grid.getBlockCollection(), lambda, Uinf, cor);
+	Multithreading::deterministic_reduce(vInfo.size(), get_diag, 4);
 	
-	ComputeDiagnostics get_diag(diagnostics, lambda, Uinf, cor);
-	block_processing.process(vInfo, grid.getBlockCollection(), get_diag);
-	
-	Diagnostic global;
-	for(map< int, Diagnostic>::iterator it=diagnostics.begin(); it!=diagnostics.end(); it++)
-		global += it->second;
+	const Diagnostic& global = get_diag.global;
 	
 	const Real cD = 2*global.force[0]/(pow(U_infinity, 2)*D);
 	const Real cL = 2*global.force[1]/(pow(U_infinity, 2)*D);
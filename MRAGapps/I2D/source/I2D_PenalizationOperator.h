@@ -22,6 +22,7 @@
 
 #include "I2D_Headers.h"
 #include "I2D_Types.h"
+#include "I2D_DesiredVelocityField.h"
 
 class I2D_PenalizationOperator
 {
@@ -30,24 +31,33 @@ class I2D_PenalizationOperator
 	
 	Grid<W,B>& grid;
 	BlockProcessing block_processing;
+	Multithreading::SortedBlocksInfo sorted_blocks;
 	
 	bool bAppendToFile;
 	
-	const map<int, const VelocityBlock*> * desired_velocities;
+	const I2D_DesiredVelocityBlocks * desired_velocities;
+	const I2D_DesiredVelocityField * desired_field;
 	
 public:
 	
 	I2D_PenalizationOperator(Grid<W,B>& grid, Real lambda, const Real Uinf[2], bool bAppendToFile=false): 
-		grid(grid), lambda(lambda), bAppendToFile(bAppendToFile), desired_velocities(NULL)
+		grid(grid), lambda(lambda), bAppendToFile(bAppendToFile), desired_velocities(NULL), desired_field(NULL)
 	{
 		this->Uinf[0] = Uinf[0];
 		this->Uinf[1] = Uinf[1];
 		
 	}
 	
-	void set_desired_velocity(const map<int, const VelocityBlock*> * desired_velocities_)
+	void set_desired_velocity(const I2D_DesiredVelocityBlocks * desired_velocities_)
 	{
 		this->desired_velocities = desired_velocities_;
+		this->desired_field = NULL;
+	}
+
+	void set_desired_velocity(const I2D_DesiredVelocityField * desired_field_)
+	{
+		this->desired_velocities = NULL;
+		this->desired_field = desired_field_;
 	}
 	
 	void perform_timestep(Real dt);
@@ -36,11 +36,11 @@ void I2D_PotentialSolver_Mattia::_updateBlocks()
 
 void I2D_PotentialSolver_Mattia::_count_sourceparticles()
 {
-	vector<BlockInfo> vInfo = grid_ptr->getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid_ptr->getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid_ptr->getBlockCollection();
 
 	blockid2info.clear();
-	for(vector<BlockInfo>::iterator it=vInfo.begin(); it!=vInfo.end(); it++)
+	for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
 		blockid2info[it->blockID] = SourceParticlesInfo();
 
 	ThresholdParticles<GetTmp,0> countparticles(tolParticle,scaling_factor, blockid2info);
@@ -58,7 +58,7 @@ void I2D_PotentialSolver_Mattia::_count_sourceparticles()
 
 void I2D_PotentialSolver_Mattia::_collect_sourceparticles()
 {
-	vector<BlockInfo> vInfo = grid_ptr->getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid_ptr->getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid_ptr->getBlockCollection();
 
 	srcparticles = new VelocitySourceParticle[nsource_particles];
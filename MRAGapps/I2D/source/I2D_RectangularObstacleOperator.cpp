@@ -150,7 +150,7 @@ struct FillBlocksPlate
 
 void I2D_RectangularObstacleOperator::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	const double LX = D*aspect_ratioX - 2*eps0;
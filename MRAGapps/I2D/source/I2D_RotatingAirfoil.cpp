@@ -931,7 +931,7 @@ I2D_RotatingAirfoil::~I2D_RotatingAirfoil()
 
 void I2D_RotatingAirfoil::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	AirfoilStuff::FillBlocks fill(eps,airfoil);
@@ -1132,7 +1132,7 @@ void I2D_RotatingAirfoil::computeDesiredVelocity(const double t)
 	double J=0;
 	double omegabar=0;
 
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	map<int, vector<double> > integrals;
@@ -1177,11 +1177,6 @@ void I2D_RotatingAirfoil::computeDesiredVelocity(const double t)
 		printf("\n\n");
 
 // -----------------------Set desired velocities-----------------------------------------------
-	for	(map<int, const VelocityBlock *>::iterator it = desired_velocity.begin(); it!= desired_velocity.end(); it++)
-	{
-		assert(it->second != NULL);
-		VelocityBlock::deallocate(it->second);
-	}
 
 	desired_velocity.clear();
 
@@ -1190,8 +1185,7 @@ void I2D_RotatingAirfoil::computeDesiredVelocity(const double t)
 	{
 		if(nonempty[it->blockID] == true)
 		{
-			VelocityBlock * velblock = VelocityBlock::allocate(1);
-			desired_velocity[it->blockID] = velblock;
+			VelocityBlock * velblock = desired_velocity.allocate(it->blockID);
 			velblocks.push_back(pair< BlockInfo, VelocityBlock *>(*it, velblock));
 		}
 	}
@@ -237,12 +237,13 @@ void I2D_RotatingCylinderPair::_tnext(double &tnext, double &tnext_dump, double
 		FILE * f = fopen("report.txt", step_id == 0 ? "w" : "a");
 		assert(f!=NULL);
         
-		fprintf(f, "####################### t is %e, dt is %e and is bound by: %s", t, tnext - t, dtBound.c_str());
-		fprintf(f, "stepid=%d\tT=%e\tDT=%e\t", (int)step_id, tnext/TIMESCALE, (tnext - t)/TIMESCALE);
+		//all the digits: two runs are compared bit for bit (see launch/verifyDeterminism.sh)
+		fprintf(f, "####################### t is %.17g, dt is %.17g and is bound by: %s", t, tnext - t, dtBound.c_str());
+		fprintf(f, "stepid=%d\tT=%.17g\tDT=%.17g\t", (int)step_id, tnext/TIMESCALE, (tnext - t)/TIMESCALE);
 		for(int i=0; i<(int)tnext_candidates.size(); i++)
-        fprintf(f, "%s: %2.2e,\t", tnext_names[i].c_str(), tnext_candidates[i] - t);
+        fprintf(f, "%s: %.17g,\t", tnext_names[i].c_str(), tnext_candidates[i] - t);
         
-		fprintf(f, "GTS-Fc: %2.2e,\t", pow(min_dx,2)/(8.0*nu));
+		fprintf(f, "GTS-Fc: %.17g,\t", pow(min_dx,2)/(8.0*nu));
         
 		fprintf(f, "\n");
 		fclose(f);
@@ -341,19 +342,13 @@ void I2D_RotatingCylinderPair::run()
 				const Real nondim_factor = sqrt(Uinf[0]*Uinf[0]+Uinf[1]*Uinf[1])*2/D;
 				const Real Tcurr = t*nondim_factor;
 				const Real wallclock = (now-start_instant).seconds();
-				const int nblocks = grid->getBlocksInfo().size();
-                
-				FILE * f = fopen("more-perfmon.txt", step_id == 1 ? "w" : "a");
-                
-				if (f!=NULL)
-				{
-					if (step_id == 0)
-                    fprintf(f,"stepid\twall-clock[s]\tT[-]\tblocks\tADV-rhs\tDIFF-rhs\n");
-                    
-					fprintf(f,"%d\t%e\t%e\t%d\t%d\t%d\n", (int)step_id, wallclock, Tcurr, nblocks, advection->get_nofrhs(), diffusion->get_nofrhs());
-                    
-					fclose(f);
-				};
+				profiler.set("wall-clock", wallclock);
+				profiler.set("T", Tcurr);
+				profiler.set("blocks", grid->getBlocksInfo().size());
+				profiler.set("ADV-rhs", advection->get_nofrhs());
+				profiler.set("DIFF-rhs", diffusion->get_nofrhs());
+				
+				profiler.endStep(step_id);
 			}
             
 			printf("END TIME STEP (%d over %d)\n", i, ADAPTFREQ);
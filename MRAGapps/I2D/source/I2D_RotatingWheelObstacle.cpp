@@ -873,7 +873,7 @@ grid(grid),  smoothing_length(smoothing_length), radius(radius), penalization(pe
 
 void I2D_RotatingWheelObstacle::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	for(vector<RotatingWheels::Wheel*>::const_iterator it = RotatingWheels::Wheel::wheels.begin(); it!= RotatingWheels::Wheel::wheels.end(); ++it)
@@ -899,14 +899,8 @@ void I2D_RotatingWheelObstacle::computeDesiredVelocity(const double t)
 	
 	const int NWHEELS = RotatingWheels::Wheel::wheels.size();
 	
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
-
-	for	(map<int, const VelocityBlock *>::iterator it = desired_velocity.begin(); it!= desired_velocity.end(); it++)
-	{
-		assert(it->second != NULL);
-		VelocityBlock::deallocate(it->second);
-	}
 	
 	map<int, bool> nonempty;
 	for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
@@ -922,8 +916,7 @@ void I2D_RotatingWheelObstacle::computeDesiredVelocity(const double t)
 	{
 		if(nonempty[it->blockID] == true)
 		{
-			VelocityBlock * velblock = VelocityBlock::allocate(1);
-			desired_velocity[it->blockID] = velblock;
+			VelocityBlock * velblock = desired_velocity.allocate(it->blockID);
 			velblocks.push_back(pair< BlockInfo, VelocityBlock *>(*it, velblock));
 		}
 #ifndef NDEBUG
@@ -949,7 +942,7 @@ void I2D_RotatingWheelObstacle::update(const double dt, const double t, string,
 {
 	const int NWHEELS = RotatingWheels::Wheel::wheels.size();
 	
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	map<int, vector<double> > integrals;
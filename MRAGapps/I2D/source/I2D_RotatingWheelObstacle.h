@@ -22,7 +22,7 @@ class I2D_RotatingWheelObstacle: public I2D_FloatingObstacleOperator
 	Grid<W,B>& grid;
 	BlockProcessing block_processing;
 	
-	map<int , const VelocityBlock *> desired_velocity;
+	I2D_DesiredVelocityBlocks desired_velocity;
 	I2D_PenalizationOperator& penalization;
 		
 public:
@@ -0,0 +1,223 @@
+/*
+ *  I2D_SnapshotStream.h
+ *  IncompressibleFluids2D
+ *
+ *	Serves restart snapshots in a given order to a post-processing driver
+ *	(FTLE) while a loader thread reads the file of the next scheduled
+ *	snapshot into memory. The loader only does raw I/O: the grid is rebuilt
+ *	from the bytes in next(), on the calling thread, since the rebuild goes
+ *	through state of MRAG shared by all the grids (block IDs, caches of the
+ *	boundary info, profiler). The grids form a small LRU cache: a snapshot
+ *	still in memory is not read again, so that a leg walking the files in the
+ *	opposite direction of the previous one starts from memory. A grid that is
+ *	refilled with a snapshot of the same topology keeps its hierarchy and its
+ *	BoundaryInfo, only the block data is read.
+ *
+ */
+#pragma once
+
+#include <stdio.h>
+
+#include "I2D_Headers.h"
+#include "I2D_Types.h"
+
+#include <tbb/tbb_thread.h>
+
+class I2D_SnapshotStream
+{
+	struct Slot
+	{
+		Grid<W,B> * grid;
+		string file;
+		int lastUse;
+	};
+
+	struct Load
+	{
+		string file;
+		vector<char> * data;
+
+		Load(string file, vector<char> * data): file(file), data(data) {}
+
+		void operator()()
+		{
+			const string fileNameBinary = file + ".mrg";
+
+			FILE * f = fopen(fileNameBinary.c_str(), "rb");
+			if (f == NULL)
+			{
+				printf("I2D_SnapshotStream: could not open %s. Aborting.\n", fileNameBinary.c_str());
+				abort();
+			}
+
+			fseek(f, 0, SEEK_END);
+			const long bytes = ftell(f);
+			fseek(f, 0, SEEK_SET);
+
+			data->resize(bytes);
+			const bool bRead = bytes <= 0 || fread(&data->front(), 1, bytes, f) == (size_t)bytes;
+			fclose(f);
+
+			if (!bRead)
+			{
+				printf("I2D_SnapshotStream: could not read %s. Aborting.\n", fileNameBinary.c_str());
+				abort();
+			}
+		}
+	};
+
+	vector<Slot> slots;
+	vector<string> schedule;
+	int scheduled, current, clock;
+
+	tbb::tbb_thread * loader;
+	string loadingFile;
+	vector<char> loadingData;
+
+	int nReads, nSameTopology, nHits;
+
+	int _find(const string& file) const
+	{
+		for(int s=0; s<(int)slots.size(); s++)
+			if (slots[s].file == file)
+				return s;
+
+		return -1;
+	}
+
+	int _victim() const
+	{
+		int victim = -1;
+
+		for(int s=0; s<(int)slots.size(); s++)
+			if (s != current && (victim < 0 || slots[s].lastUse < slots[victim].lastUse))
+				victim = s;
+
+		assert(victim >= 0);
+		return victim;
+	}
+
+	//waits for the loader and rebuilds the snapshot it read in the least recently used grid
+	void _wait()
+	{
+		if (loader == NULL) return;
+
+		loader->join();
+		delete loader;
+		loader = NULL;
+
+		const int s = _victim();
+		slots[s].file = string();
+
+		FILE * binaryin = loadingData.empty() ? NULL : fmemopen(&loadingData.front(), loadingData.size(), "rb");
+		if (binaryin == NULL)
+		{
+			printf("I2D_SnapshotStream: %s.mrg is empty. Aborting.\n", loadingFile.c_str());
+			abort();
+		}
+
+		IO_Binary<W,B> serializer;
+		const bool bSameTopology = serializer.ReadReusingTopology(*slots[s].grid, loadingFile, binaryin);
+		fclose(binaryin);
+
+		slots[s].file = loadingFile;
+		nReads++;
+		nSameTopology += (int)bSameTopology;
+
+		//the capacity is kept for the next file
+		loadingData.clear();
+	}
+
+	void _start(const string& file)
+	{
+		assert(loader == NULL);
+
+		loadingFile = file;
+		loader = new tbb::tbb_thread(Load(file, &loadingData));
+	}
+	//forbidden
+	I2D_SnapshotStream(const I2D_SnapshotStream&);
+	I2D_SnapshotStream& operator=(const I2D_SnapshotStream&);
+
+public:
+
+	I2D_SnapshotStream(const int nGrids): scheduled(0), current(-1), clock(0), loader(NULL),
+		nReads(0), nSameTopology(0), nHits(0)
+	{
+		assert(nGrids >= 2);
+
+		slots.resize(nGrids);
+
+		for(int s=0; s<nGrids; s++)
+		{
+			slots[s].grid = new Grid<W,B>(8,8,1);
+			slots[s].lastUse = 0;
+		}
+	}
+
+	~I2D_SnapshotStream()
+	{
+		//the file being read is not needed anymore
+		if (loader != NULL)
+		{
+			loader->join();
+			delete loader;
+		}
+
+		for(int s=0; s<(int)slots.size(); s++)
+			delete slots[s].grid;
+	}
+
+	// files in the order they will be requested by next()
+	void setSchedule(const vector<string>& files)
+	{
+		schedule = files;
+		scheduled = 0;
+	}
+
+	bool done() const { return scheduled >= (int)schedule.size(); }
+
+	// grid holding the next scheduled snapshot, valid until the following call
+	Grid<W,B>& next()
+	{
+		assert(!done());
+
+		const string& file = schedule[scheduled++];
+
+		if (loader != NULL && loadingFile == file)
+		{
+			_wait();
+			current = _find(file);
+		}
+		else
+		{
+			current = _find(file);
+
+			if (current >= 0)
+				nHits++;
+			else
+			{
+				_wait();
+
+				_start(file);
+				_wait();
+
+				current = _find(file);
+			}
+		}
+
+		assert(current >= 0);
+		slots[current].lastUse = ++clock;
+
+		// read the file of the following snapshot while the caller works on this one
+		if (!done() && loader == NULL && _find(schedule[scheduled]) < 0)
+			_start(schedule[scheduled]);
+
+		return *slots[current].grid;
+	}
+
+	void printSummary() const
+	{
+		printf("SnapshotStream: %d snapshots read (%d with the topology already in memory), %d served from memory\n", nReads, nSameTopology, nHits);
+	}
+};
@@ -217,7 +217,7 @@ double I2D_SolverOperator_4thOrder::estimate_largest_dt() const
 
 void I2D_SolverOperator_4thOrder::perform_timestep(double dt)
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	BoundaryInfo& binfo=grid.getBoundaryInfo();  
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
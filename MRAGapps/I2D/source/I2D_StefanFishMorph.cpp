@@ -11,7 +11,6 @@
 #include "I2D_VectorBlockLab.h"
 #include "I2D_GradOfVector.h"
 #include <limits>
-#include <omp.h>
 
 I2D_StefanFishMorph::StefanFishMorph::StefanFishMorph(double xm, double ym, double _D, double _T, double phase, double tau, double angle_rad, vector<double> WIDTH, vector<double> BASELINE, vector<double> CURVATURE, double angleInSpace_rad, double eps, const int LMAX, const bool isSharp):
   StefanFish(xm, ym, _D, _T, phase, tau, angle_rad, BASELINE, CURVATURE, angleInSpace_rad, eps, LMAX, isSharp)
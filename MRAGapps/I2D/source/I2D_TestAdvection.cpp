@@ -9,24 +9,33 @@
 
 #include "I2D_TestAdvection.h"
 #include "I2D_AdvectionOperator_Particles.h"
+#include "I2D_AdvectionOperator_ParticlesRK.h"
 
 static const int maxParticleStencil[2][3] = {
 		-3, -3, 0,
 		+4, +4, 1
 };
 
+static const int maxParticleStencilRK[2][3] = {
+		-4, -4, 0,
+		+5, +5, 1
+};
+
 I2D_TestAdvection::I2D_TestAdvection(const int argc, const char ** argv): parser(argc, argv), step_id(0)
 {
 	printf("////////////////////////////////////////////////////////////\n");
 	printf("//////////////////       ADVECTION TEST     ////////////////\n");
 	printf("////////////////////////////////////////////////////////////\n");
 
+	const int rkorder = parser("-particles-rk").asInt();
+	assert(rkorder == 0 || rkorder == 2);
+
 	parser.set_strict_mode();
 	const int bpd = parser("-bpd").asInt();
 	assert(bpd > 1);
 
 	if (parser("-particles").asBool())
-		grid = new Grid<W,B>(bpd,bpd,1, maxParticleStencil);
+		grid = new Grid<W,B>(bpd,bpd,1, rkorder == 0 ? maxParticleStencil : maxParticleStencilRK);
 	else
 		grid = new Grid<W,B>(bpd,bpd,1);
 
@@ -47,7 +56,9 @@ I2D_TestAdvection::I2D_TestAdvection(const int argc, const char ** argv): parser
 
 	//if (parser("-dumpfreq").asInt() > 0 ) _dump("ic_advection");
 
-	if (parser("-particles").asBool())
+	if (parser("-particles").asBool() && rkorder > 0)
+		advection = new I2D_AdvectionOperator_ParticlesRK(*grid, 0.25, 0.25);
+	else if (parser("-particles").asBool())
 		advection = new I2D_AdvectionOperator_Particles(*grid);
 	else
 		advection = new I2D_AdvectionOperator(*grid);
@@ -0,0 +1,136 @@
+/*
+ *  I2D_TestSnapshotStream.cpp
+ *  IncompressibleFluids2D
+ *
+ */
+
+#include "I2D_TestSnapshotStream.h"
+#include "I2D_SnapshotStream.h"
+#include "I2D_DivOperator.h"
+
+I2D_TestSnapshotStream::I2D_TestSnapshotStream(const int argc, const char ** argv): parser(argc, argv)
+{
+	printf("////////////////////////////////////////////////////////////\n");
+	printf("/////////////////  SNAPSHOT STREAM TEST  ///////////////////\n");
+	printf("////////////////////////////////////////////////////////////\n");
+
+	BPD = max(2, parser("-bpd").asInt(8));
+	NSNAPSHOTS = max(4, parser("-nsnapshots").asInt(8));
+	NGRIDS = max(2, parser("-ftleCache").asInt(2));
+
+	// the first half on one topology, the second half on a finer one
+	for(int k=0; k<NSNAPSHOTS; k++)
+	{
+		char buf[256];
+		sprintf(buf, "snapshotstream_%04d", k);
+		files.push_back(buf);
+
+		const int bpd = k < NSNAPSHOTS/2 ? BPD : 2*BPD;
+		Grid<W,B> grid(bpd, bpd, 1);
+		_ic(grid, k);
+
+		IO_Binary<W,B> serializer;
+		serializer.Write(grid, files.back());
+	}
+}
+
+void I2D_TestSnapshotStream::_ic(Grid<W,B>& grid, const int k)
+{
+	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+
+	for(int i=0; i<(int)vInfo.size(); i++)
+	{
+		B& b = grid.getBlockCollection()[vInfo[i].blockID];
+
+		for(int iy=0; iy<B::sizeY; iy++)
+			for(int ix=0; ix<B::sizeX; ix++)
+			{
+				Real p[2];
+				vInfo[i].pos(p, ix, iy);
+
+				b(ix, iy).omega = k + p[0] + 2*p[1];
+				b(ix, iy).u[0] = k + p[0];
+				b(ix, iy).u[1] = p[1];
+				b(ix, iy).tmp = 0;
+			}
+	}
+}
+
+int I2D_TestSnapshotStream::_check(Grid<W,B>& grid, const int k)
+{
+	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+
+	int nErrors = 0;
+
+	for(int i=0; i<(int)vInfo.size(); i++)
+	{
+		B& b = grid.getBlockCollection()[vInfo[i].blockID];
+
+		for(int iy=0; iy<B::sizeY; iy++)
+			for(int ix=0; ix<B::sizeX; ix++)
+			{
+				Real p[2];
+				vInfo[i].pos(p, ix, iy);
+
+				const Real omega = k + p[0] + 2*p[1];
+				const Real u[2] = { k + p[0], p[1] };
+
+				nErrors += (int)(b(ix, iy).omega != omega || b(ix, iy).u[0] != u[0] || b(ix, iy).u[1] != u[1]);
+			}
+	}
+
+	return nErrors;
+}
+
+void I2D_TestSnapshotStream::run()
+{
+	// forward and then backward, as the forward and backward FTLE legs
+	vector<string> schedule;
+	vector<int> snapshots;
+	for(int k=0; k<NSNAPSHOTS; k++)
+	{
+		schedule.push_back(files[k]);
+		snapshots.push_back(k);
+	}
+	for(int k=NSNAPSHOTS-1; k>=0; k--)
+	{
+		schedule.push_back(files[k]);
+		snapshots.push_back(k);
+	}
+
+	I2D_SnapshotStream stream(NGRIDS);
+	stream.setSchedule(schedule);
+
+	int nErrors = 0;
+	for(int s=0; s<(int)schedule.size(); s++)
+	{
+		Grid<W,B>& snapshot = stream.next();
+
+		const int k = snapshots[s];
+		const int bpd = k < NSNAPSHOTS/2 ? BPD : 2*BPD;
+
+		// block processing with labs on the snapshot while the loader reads the next file
+		I2D_DivOperator div(snapshot);
+		div.perform();
+
+		const int nBlockErrors = (int)snapshot.getBlocksInfo().size() != bpd*bpd;
+		const int nCellErrors = _check(snapshot, k);
+
+		if (nBlockErrors + nCellErrors > 0)
+			printf("snapshot %d (request %d): %d blocks instead of %d, %d wrong cells\n", k, s, (int)snapshot.getBlocksInfo().size(), bpd*bpd, nCellErrors);
+
+		nErrors += nBlockErrors + nCellErrors;
+	}
+
+	stream.printSummary();
+
+	if (nErrors > 0)
+	{
+		printf("I2D_TestSnapshotStream: FAILED. Aborting.\n");
+		abort();
+	}
+
+	printf("I2D_TestSnapshotStream: passed\n");
+
+	exit(0);
+}
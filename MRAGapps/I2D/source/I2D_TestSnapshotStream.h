@@ -0,0 +1,32 @@
+/*
+ *  I2D_TestSnapshotStream.h
+ *  IncompressibleFluids2D
+ *
+ *	Writes a series of snapshots of known fields (two topologies), walks them
+ *	forward and backward with I2D_SnapshotStream while a block processing runs
+ *	on every snapshot served, meanwhile the loader reads the next one, and
+ *	checks the fields of every snapshot against the ones written.
+ *
+ */
+#pragma once
+
+#include "I2D_Headers.h"
+#include "I2D_Types.h"
+
+class I2D_TestSnapshotStream: public I2D_Test
+{
+	ArgumentParser parser;
+
+	int BPD, NSNAPSHOTS, NGRIDS;
+	vector<string> files;
+
+	static void _ic(Grid<W,B>& grid, const int k);
+	static int _check(Grid<W,B>& grid, const int k);
+
+public:
+
+	I2D_TestSnapshotStream(const int argc, const char ** argv);
+
+	void run();
+	void paint() {}
+};
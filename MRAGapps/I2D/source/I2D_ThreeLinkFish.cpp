@@ -1108,7 +1108,7 @@ I2D_ThreeLinkFish::~I2D_ThreeLinkFish()
  */
 void I2D_ThreeLinkFish::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	ThreeLinkFish::FillBlocks fill(eps,shape);
@@ -1299,7 +1299,7 @@ void I2D_ThreeLinkFish::computeDesiredVelocity(const double t)
 	double vybar = 0.0;
 	double omegabar = 0.0;
 
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	map<int, vector<double> > integrals;
@@ -1350,11 +1350,6 @@ void I2D_ThreeLinkFish::computeDesiredVelocity(const double t)
 	shape->J = J;
 
 	// Set desired velocities
-	for	(map<int, const VelocityBlock *>::iterator it = desired_velocity.begin(); it!= desired_velocity.end(); it++)
-	{
-		assert(it->second != NULL);
-		VelocityBlock::deallocate(it->second);
-	}
 
 	desired_velocity.clear();
 
@@ -1363,8 +1358,7 @@ void I2D_ThreeLinkFish::computeDesiredVelocity(const double t)
 	{
 		if(nonempty[it->blockID] == true)
 		{
-			VelocityBlock * velblock = VelocityBlock::allocate(1);
-			desired_velocity[it->blockID] = velblock;
+			VelocityBlock * velblock = desired_velocity.allocate(it->blockID);
 			velblocks.push_back(pair< BlockInfo, VelocityBlock *>(*it, velblock));
 		}
 	}
@@ -1412,7 +1406,7 @@ void I2D_ThreeLinkFish::create(const double t)
 	double vbar = 0.0;
 	double omegabar = 0.0;
 
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 
 	map<int, vector<double> > integrals;
@@ -12,11 +12,11 @@
 #include "I2D_Headers.h"
 #include "I2D_Types.h"
 #include "I2D_ParticleBlockLab.h"
+#include "I2D_TracerStore.h"
 
 struct I2D_TracerAdvection_RK
 {
-	map<long int, vector<Real> > & particles;
-	map<I3, vector<long int> > & block2particles;
+	I2D_TracerStore & tracers;
 
 	Real dt, t;
 	Real Uinf[2];
@@ -24,11 +24,10 @@ struct I2D_TracerAdvection_RK
 	int stencil_start[3], stencil_end[3];
 
 	// Constructor
-	// @param x
-	// @param y
+	// @param tracers, already binned on the grid
 	// @param dt
 	// @param Uinf
-	I2D_TracerAdvection_RK(map<long int, vector<Real> > & particles, map<I3, vector<long int> > & block2particles, Real dt, Real Uinf[2]): t(0), particles(particles), block2particles(block2particles), dt(dt)
+	I2D_TracerAdvection_RK(I2D_TracerStore & tracers, Real dt, Real Uinf[2]): t(0), tracers(tracers), dt(dt)
 	{
 		stencil_start[0] = stencil_start[1] = -4;
 		stencil_end[0] = stencil_end[1] = +5;
@@ -41,7 +40,7 @@ struct I2D_TracerAdvection_RK
 
 	// Copy constructor
 	// @param c
-	I2D_TracerAdvection_RK(const I2D_TracerAdvection_RK& c): t(0), particles(c.particles), block2particles(c.block2particles), dt(c.dt)
+	I2D_TracerAdvection_RK(const I2D_TracerAdvection_RK& c): t(0), tracers(c.tracers), dt(c.dt)
 	{
 		stencil_start[0] = stencil_start[1] = -4;
 		stencil_end[0] = stencil_end[1] = +5;
@@ -84,13 +83,14 @@ struct I2D_TracerAdvection_RK
 		const Real endBlock[2] = {startBlock[0]+dx, startBlock[1]+dx}; /// actual location of the end limits of the block
 		const Real ori[2] = {info.origin[0],info.origin[1]};
 
-		I3 currentBlock(info.index[0],info.index[1],info.level);
-		const vector<long int> & currentParticles = block2particles[currentBlock];
+		/// The tracers of the block are a contiguous range of slots, each tracer is touched by one block only
+		const int currentBegin = tracers.begin(info);
+		const int currentEnd = tracers.end(info);
 
-		for(unsigned int j=0; j<currentParticles.size(); j++)
+		for(int j=currentBegin; j<currentEnd; j++)
 		{
-			Real & x = particles[currentParticles[j]][0];
-			Real & y = particles[currentParticles[j]][1];
+			Real & x = tracers.x[j];
+			Real & y = tracers.y[j];
 
 			/// Check if this passive tracer is in the block, exit if not in block
 			assert( x>=startBlock[0] && x<endBlock[0] && y>=startBlock[1] && y<endBlock[1] );
@@ -0,0 +1,224 @@
+/*
+ *  I2D_TracerStore.h
+ *  IncompressibleFluids2D
+ *
+ *	Passive tracers (FTLE seeds, passive tracer obstacles) in a flat store:
+ *	the positions are kept as two contiguous arrays.
+ *	bin() assigns the tracers to the leaf blocks of the grid without building
+ *	a tree: every tracer gets the Morton key of the finest block containing it,
+ *	the keys are sorted in parallel and the positions are permuted in the
+ *	order of the keys, so that the tracers of a block (whose keys are a
+ *	contiguous interval of the Z-curve) are a contiguous range of slots of x
+ *	and y. The tracer ids given at resize() are followed through slot().
+ *	The domain is the unit square, tracers outside of it are not binned.
+ *
+ */
+#pragma once
+
+#include "I2D_Types.h"
+
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+
+class I2D_TracerStore
+{
+public:
+
+	typedef unsigned long long Key;
+
+	// positions by slot, in the order of the last bin()
+	vector<Real> x, y;
+
+private:
+
+	struct Entry
+	{
+		Key key;
+		int id;
+
+		bool operator<(const Entry& e) const { return key < e.key || (key == e.key && id < e.id); }
+	};
+
+	static const Key outside = ~(Key)0;
+
+	vector<Entry> entries;
+	vector<int> slot2id, id2slot;
+	vector<int> rangeStart, rangeEnd;
+
+	// buffers of the permutation, recycled from one bin() to the next
+	vector<Real> xsorted, ysorted;
+	vector<int> idsorted;
+	int maxlevel;
+
+	static Key _interleave(const unsigned int ix, const unsigned int iy)
+	{
+		Key key = 0;
+
+		for(int b=0; b<32; b++)
+			key |= (((Key)(ix >> b) & 1) << (2*b)) | (((Key)(iy >> b) & 1) << (2*b+1));
+
+		return key;
+	}
+
+	struct ComputeKeys
+	{
+		I2D_TracerStore& store;
+
+		ComputeKeys(I2D_TracerStore& store): store(store) {}
+
+		ComputeKeys(const ComputeKeys& c): store(c.store) {}
+
+		void operator()(const blocked_range<int>& range) const
+		{
+			const int n = 1 << store.maxlevel;
+
+			for(int i=range.begin(); i<range.end(); i++)
+			{
+				Entry& e = store.entries[i];
+				e.id = i;
+
+				const Real p[2] = { store.x[i], store.y[i] };
+
+				if (p[0] >= 0 && p[0] < 1 && p[1] >= 0 && p[1] < 1)
+					e.key = _interleave(min(n-1, (int)(p[0]*n)), min(n-1, (int)(p[1]*n)));
+				else
+					e.key = outside;
+			}
+		}
+	};
+
+	struct FindRanges
+	{
+		I2D_TracerStore& store;
+		const vector<BlockInfo>& vInfo;
+
+		FindRanges(I2D_TracerStore& store, const vector<BlockInfo>& vInfo): store(store), vInfo(vInfo) {}
+
+		FindRanges(const FindRanges& c): store(c.store), vInfo(c.vInfo) {}
+
+		void operator()(const blocked_range<int>& range) const
+		{
+			const vector<Entry>& entries = store.entries;
+
+			for(int i=range.begin(); i<range.end(); i++)
+			{
+				const BlockInfo& info = vInfo[i];
+				const int shift = 2*(store.maxlevel - info.level);
+
+				Entry first, last;
+				first.key = _interleave(info.index[0], info.index[1]) << shift;
+				first.id = -1;
+				last.key = first.key + ((Key)1 << shift);
+				last.id = -1;
+
+				store.rangeStart[info.blockID] = lower_bound(entries.begin(), entries.end(), first) - entries.begin();
+				store.rangeEnd[info.blockID] = lower_bound(entries.begin(), entries.end(), last) - entries.begin();
+			}
+		}
+	};
+
+	struct Permute
+	{
+		I2D_TracerStore& store;
+
+		Permute(I2D_TracerStore& store): store(store) {}
+
+		Permute(const Permute& c): store(c.store) {}
+
+		void operator()(const blocked_range<int>& range) const
+		{
+			for(int i=range.begin(); i<range.end(); i++)
+			{
+				const int s = store.entries[i].id;
+				const int id = store.slot2id[s];
+
+				store.xsorted[i] = store.x[s];
+				store.ysorted[i] = store.y[s];
+				store.idsorted[i] = id;
+				store.id2slot[id] = i;
+			}
+		}
+	};
+
+public:
+
+	I2D_TracerStore(): maxlevel(0) {}
+
+	// the tracers get the ids 0..n-1, to be called before the first bin()
+	void resize(const int n)
+	{
+		x.resize(n);
+		y.resize(n);
+		slot2id.resize(n);
+		id2slot.resize(n);
+
+		for(int i=0; i<n; i++)
+			slot2id[i] = id2slot[i] = i;
+	}
+
+	int size() const { return x.size(); }
+
+	void clear()
+	{
+		x.clear();
+		y.clear();
+		entries.clear();
+		slot2id.clear();
+		id2slot.clear();
+		rangeStart.clear();
+		rangeEnd.clear();
+	}
+
+	// to be called whenever the tracers moved or the grid changed
+	void bin(const vector<BlockInfo>& vInfo)
+	{
+		const int n = size();
+
+		maxlevel = 0;
+		int maxid = 0;
+		for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
+		{
+			maxlevel = max(maxlevel, (int)it->level);
+			maxid = max(maxid, it->blockID);
+		}
+
+		assert(maxlevel < 32);
+
+		entries.resize(n);
+		xsorted.resize(n);
+		ysorted.resize(n);
+		idsorted.resize(n);
+		rangeStart.assign(maxid+1, 0);
+		rangeEnd.assign(maxid+1, 0);
+
+		tbb::parallel_for(blocked_range<int>(0, n), ComputeKeys(*this), auto_partitioner());
+		tbb::parallel_sort(entries.begin(), entries.end());
+		tbb::parallel_for(blocked_range<int>(0, n), Permute(*this), auto_partitioner());
+
+		x.swap(xsorted);
+		y.swap(ysorted);
+		slot2id.swap(idsorted);
+
+		tbb::parallel_for(blocked_range<int>(0, vInfo.size()), FindRanges(*this, vInfo), auto_partitioner());
+	}
+
+	// slots of the tracers lying in the block, valid until the next bin()
+	int begin(const BlockInfo& info) const
+	{
+		assert(info.blockID < (int)rangeStart.size());
+		return rangeStart[info.blockID];
+	}
+
+	int end(const BlockInfo& info) const
+	{
+		assert(info.blockID < (int)rangeEnd.size());
+		return rangeEnd[info.blockID];
+	}
+
+	// current slot of the tracer id
+	int slot(const int id) const
+	{
+		assert(id >= 0 && id < (int)id2slot.size());
+		return id2slot[id];
+	}
+};
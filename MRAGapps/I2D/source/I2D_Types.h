@@ -22,23 +22,24 @@ struct VelocityBlock
 		memset(u, 0, sizeof(Real)*_BLOCKSIZE_*_BLOCKSIZE_*2);
 	}
 	
+	//pooled: the velocity blocks are allocated and released at every step
 	static VelocityBlock * allocate(const int nitems)
 	{
-		VelocityBlock * ptr = (VelocityBlock*)_mm_malloc(sizeof(VelocityBlock)*nitems, 16);
+		VelocityBlock * ptr = (VelocityBlock*)MemoryPool::allocateTagged(sizeof(VelocityBlock)*nitems);
 		
 		return new (ptr) VelocityBlock[nitems];
 	}
 	
 	static void deallocate(const VelocityBlock *& velblocks)
 	{
-		_mm_free(const_cast<VelocityBlock *>(velblocks));
+		MemoryPool::deallocateTagged(const_cast<VelocityBlock *>(velblocks));
 		
 		velblocks = NULL;
 	}
 	
 	static void deallocate(VelocityBlock *& velblocks)
 	{
-		_mm_free(velblocks);
+		MemoryPool::deallocateTagged(velblocks);
 		
 		velblocks = NULL;
 	}
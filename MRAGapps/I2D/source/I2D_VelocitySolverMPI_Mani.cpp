@@ -45,7 +45,11 @@ void I2D_VelocitySolverMPI_Mani::_wait_for_work()
 	{
 		_bcast_header();
 		_bcast_sourcedata();
+		
+		const double t0 = MPI_Wtime();
 		_compute();
+		compute_time = MPI_Wtime() - t0;
+		
 		_collect_results();
 		
 		stepid++;
@@ -105,7 +109,7 @@ void I2D_VelocitySolverMPI_Mani::_bcast_header()
 }
 
 I2D_VelocitySolverMPI_Mani::I2D_VelocitySolverMPI_Mani(const int argc, const char ** argv):
-I2D_VelocitySolver_Mani(argc, argv), stepid(0)
+I2D_VelocitySolver_Mani(argc, argv), stepid(0), compute_time(0)
 {
 	MPI_Init(const_cast<int *>(&argc), const_cast<char***>(&argv));
 	MPI_Comm_rank (MPI_COMM_WORLD, &comm_rank); /* get current process id */
@@ -155,6 +159,9 @@ void I2D_VelocitySolverMPI_Mani::_collect_results()
 				assert(res == MPI_SUCCESS);
 			}
 			
+			//after the blocks: same source and tag, the master receives them in this order
+			MPI_Send(&compute_time, 1, MPI_DOUBLE, 0, stepid, MPI_COMM_WORLD);
+			
 			//printf("rank %d: cleanup now!\n", comm_rank);
 		}
 	}
@@ -163,6 +170,8 @@ void I2D_VelocitySolverMPI_Mani::_collect_results()
 		Velocity_MPI::requests.resize(comm_size);
 		set<int> pending_slaves;
 		
+		time2node = vector<double>(comm_size);
+		
 		for(int slave=1; slave<comm_size; slave++)
 		{
 			////printf("master: from slave %d i expect
@@ -193,16 +202,25 @@ void I2D_VelocitySolverMPI_Mani::_collect_results()
 				}
 			
 			pending_slaves.erase(slave);
+			
+			const double t0 = MPI_Wtime();
 			_master_update_blocks(slave);
+			compute_time += MPI_Wtime() - t0;
+			
+			MPI_Status status;
+			MPI_Recv(&time2node[slave], 1, MPI_DOUBLE, slave, stepid, MPI_COMM_WORLD, &status);
 		}
 		
 		assert(pending_slaves.size() == 0);
 		
+		//the master is busy for its own blocks and for the update of everyone's results, not while it waits
+		time2node[0] = compute_time;
+		
 		//printf("rank %d: cleanup now!\n", comm_rank);
 	}
 	
 	//cleanup
-	delete [] srcparticles; srcparticles = NULL;
+	TransientAllocator<VelocitySourceParticle>().deallocate(srcparticles, nsource_particles); srcparticles = NULL;
 	nsource_particles = 0;
 	
 	//delete [] mydestblocks; mydestblocks = NULL;
@@ -221,6 +239,8 @@ void I2D_VelocitySolverMPI_Mani::_collect_results()
 	mydestinfo.clear();
 	workIDstart2node.clear();
 	work2node.clear();
+	
+	MemoryArena::transient().reset();
 }
 
 void I2D_VelocitySolverMPI_Mani::_bcast_sourcedata()
@@ -241,7 +261,7 @@ void I2D_VelocitySolverMPI_Mani::_bcast_sourcedata()
 		
 		ptr += particle_bytes;
 		
-		vector<BlockInfo> vInfo = grid_ptr->getBlocksInfo();
+		const vector<BlockInfo>& vInfo = grid_ptr->getBlocksInfoRef();
 		for(int iblock=0; iblock<ntotaldest_blocks; iblock++)
 		{
 			short int * info = (short int *)ptr;
@@ -267,7 +287,8 @@ void I2D_VelocitySolverMPI_Mani::_bcast_sourcedata()
 		
 		const char * ptr = message;
 		
-		srcparticles = new VelocitySourceParticle[nsource_particles];
+		//as on the master, see _collect_sourceparticles
+		srcparticles = TransientAllocator<VelocitySourceParticle>().allocate(nsource_particles);
 		assert(srcparticles != NULL);
 		
 		memcpy(srcparticles, ptr, particle_bytes );
@@ -322,7 +343,7 @@ void I2D_VelocitySolverMPI_Mani::_bcast_sourcedata()
 	}
 	else 
 	{
-		vector<BlockInfo> vInfo = grid_ptr->getBlocksInfo();
+		const vector<BlockInfo>& vInfo = grid_ptr->getBlocksInfoRef();
 		
 		const int start = workIDstart2node[comm_rank];
 		const int end = start + work2node[comm_rank];
@@ -350,7 +371,7 @@ void I2D_VelocitySolverMPI_Mani::_bcast_sourcedata()
 
 void I2D_VelocitySolverMPI_Mani::_master_update_blocks(int rank)
 {
-	vector<BlockInfo> vInfo = grid_ptr->getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid_ptr->getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid_ptr->getBlockCollection();
 	
 	const int start = workIDstart2node[rank];
@@ -367,6 +388,81 @@ void I2D_VelocitySolverMPI_Mani::_master_update_blocks(int rank)
 	tbb::parallel_for(blocked_range<int>(0, work2node[rank]), update, auto_partitioner());
 }
 
+/**
+ * Partition of the target blocks in contiguous ranges, one per rank, of about equal time.
+ * The evaluation is timed per rank (every rank solves its blocks at once): a target block is estimated
+ * to cost its cells plus its own source particles, which stand for the direct interactions around it,
+ * and a rank is expected to go through these costs as fast as it did in the previous steps.
+ * The time of the master also includes the update of the blocks with the results of every rank,
+ * so its measured speed accounts for the scatter and its share shrinks accordingly.
+ * Until every rank was measured, the master takes 3/7 of the blocks of an even split (it also gathers
+ * the sources and scatters the results), the slaves share the rest evenly.
+ */
+void I2D_VelocitySolverMPI_Mani::_partition(const vector<BlockInfo>& vInfo)
+{
+	const int n = vInfo.size();
+	
+	vector<double> cost(n);
+	for(int i=0; i<n; i++)
+		cost[i] = B::sizeX*B::sizeY + blockid2info[vInfo[i].blockID].nsource_particles;
+	
+	bool bMeasured = (int)speed2node.size() == comm_size;
+	for(int r=0; r<(int)speed2node.size(); r++)
+		bMeasured = bMeasured && speed2node[r] > 0;
+	
+	vector<double> shares(comm_size, 1.);
+	
+	if (bMeasured)
+		shares = speed2node;
+	else if (comm_size > 1)
+	{
+		shares[0] = 3./7./comm_size;
+		
+		for(int r=1; r<comm_size; r++)
+			shares[r] = (1 - shares[0])/(comm_size - 1);
+	}
+	
+	vector<int> starts;
+	Multithreading::BlockCostModel::split(cost, shares, starts);
+	
+	work2node = vector<int>(comm_size);
+	workIDstart2node = vector<int>(comm_size);
+	work_cost2node = vector<double>(comm_size);
+	
+	for(int r=0; r<comm_size; r++)
+	{
+		workIDstart2node[r] = starts[r];
+		work2node[r] = starts[r+1] - starts[r];
+		
+		for(int i=starts[r]; i<starts[r+1]; i++)
+			work_cost2node[r] += cost[i];
+	}
+}
+
+/**
+ * Speed of every rank (cost per second) from the times of this step, smoothed as the block costs.
+ * A rank without work or time this step keeps its previous speed.
+ */
+void I2D_VelocitySolverMPI_Mani::_measure_speeds()
+{
+	assert((int)time2node.size() == comm_size);
+	assert((int)work_cost2node.size() == comm_size);
+	
+	if ((int)speed2node.size() != comm_size)
+		speed2node = vector<double>(comm_size, -1);
+	
+	const double smoothing = Multithreading::BlockCostModel::smoothing();
+	
+	for(int r=0; r<comm_size; r++)
+	{
+		if (work_cost2node[r] <= 0 || time2node[r] <= 0) continue;
+		
+		const double speed = work_cost2node[r]/time2node[r];
+		
+		speed2node[r] = speed2node[r] < 0 ? speed : speed2node[r] + smoothing*(speed - speed2node[r]);
+	}
+}
+
 void I2D_VelocitySolverMPI_Mani::compute_velocity()
 {
 	Profiler profiler;
@@ -381,44 +477,18 @@ void I2D_VelocitySolverMPI_Mani::compute_velocity()
 	assert(srcparticles == NULL);
 	assert(nsource_particles == 0);
 	
-	//estimate the partition of work:
-	vector<BlockInfo> vInfo = grid_ptr->getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid_ptr->getBlocksInfoRef();
 	ntotaldest_blocks = vInfo.size();
 	
-	const int slaves = comm_size - 1;
-	int master_work = -1, slave_homogenous_work = -1, slave_remainder_work = -1;
-	
-	if(slaves > 0)
-	{
-		master_work =  (int)(3./7.*vInfo.size()/comm_size);
-		slave_homogenous_work = (vInfo.size()-master_work)/slaves;
-		slave_remainder_work = vInfo.size() - master_work - slaves*slave_homogenous_work;
-	}
-	else
-	{
-		master_work = vInfo.size();
-		slave_homogenous_work = slave_remainder_work = 0;
-	}
-	
-	work2node = vector<int>(comm_size);
-	work2node[0] = master_work;
-	for(int i=1; i<comm_size; i++)
-		work2node[i] = slave_homogenous_work;
-	
-	for(int i=0; i<slave_remainder_work; i++)
-		work2node[i+1]++;
-	
-	print(work2node, "decomposition");	
-	workIDstart2node = vector<int> (comm_size);
-	workIDstart2node[0]=0;
-	for(int i=1; i<comm_size; i++)
-		workIDstart2node[i] = workIDstart2node[i-1] + work2node[i-1];
-	
 	profiler.push_start("MPI-FMM");
 	profiler.push_start("count source particles");
 	_count_sourceparticles();
 	profiler.pop_stop();
 	
+	_partition(vInfo);
+	
+	print(work2node, "decomposition");
+	
 	if(nsource_particles == 0)
 	{
 		const BlockCollection<B>& coll = grid_ptr->getBlockCollection();
@@ -442,14 +512,18 @@ void I2D_VelocitySolverMPI_Mani::compute_velocity()
 	profiler.pop_stop();
 	
 	profiler.push_start("the master part");
+	const double t0 = MPI_Wtime();
 	_compute();
 	_master_update_blocks(0);
+	compute_time = MPI_Wtime() - t0;
 	profiler.pop_stop();//("compute and collect results");
 	
 	profiler.push_start("compute and collect results");
 	_collect_results();
 	profiler.pop_stop();
 	
+	_measure_speeds();
+	
 	stepid++;
 	profiler.pop_stop();
 	profiler.printSummary();
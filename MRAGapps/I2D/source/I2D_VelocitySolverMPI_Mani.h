@@ -26,6 +26,11 @@ class I2D_VelocitySolverMPI_Mani: public I2D_VelocitySolver_Mani
 	vector<int> workIDstart2node, work2node;
 	int comm_rank, comm_size, stepid, ntotaldest_blocks;
 	
+	//time of the last _compute of this rank (on the master, plus the update of all blocks);
+	//on the master, the time, work and speed of every rank
+	double compute_time;
+	vector<double> time2node, work_cost2node, speed2node;
+	
 	vector<BlockInfo> mydestinfo;
 	vector< VelocityBlock *> alldestblocks;
 	VelocityBlock * mydestblocks;
@@ -36,6 +41,8 @@ class I2D_VelocitySolverMPI_Mani: public I2D_VelocitySolver_Mani
 	void _compute();
 	void _master_update_blocks(int rank);
 	void _collect_results();
+	void _partition(const vector<BlockInfo>& vInfo);
+	void _measure_speeds();
 	
 public:
 	
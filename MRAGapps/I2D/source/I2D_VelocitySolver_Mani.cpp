@@ -21,11 +21,11 @@ struct GetOmega { static inline Real stream(FluidElement2D& out) { return out.om
 
 void I2D_VelocitySolver_Mani::_count_sourceparticles()
 {
-	vector<BlockInfo> vInfo = grid_ptr->getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid_ptr->getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid_ptr->getBlockCollection();
 	
 	blockid2info.clear();
-	for(vector<BlockInfo>::iterator it=vInfo.begin(); it!=vInfo.end(); it++)
+	for(vector<BlockInfo>::const_iterator it=vInfo.begin(); it!=vInfo.end(); it++)
 		blockid2info[it->blockID] = SourceParticlesInfo();
 	
 	ThresholdParticles<GetOmega,0> countparticles(tolParticle,scaling_factor,blockid2info);
@@ -43,12 +43,18 @@ void I2D_VelocitySolver_Mani::_count_sourceparticles()
 
 void I2D_VelocitySolver_Mani::_collect_sourceparticles()
 {
-	vector<BlockInfo> vInfo = grid_ptr->getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid_ptr->getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid_ptr->getBlockCollection();
 	
-	srcparticles = new VelocitySourceParticle[nsource_particles];
+	//released by the end of the step, see _cleanup
+	TransientAllocator<VelocitySourceParticle> allocator;
+	
+	srcparticles = allocator.allocate(nsource_particles);
 	assert(srcparticles != NULL);
 	
+	for(int i=0; i<nsource_particles; i++)
+		allocator.construct(srcparticles + i, VelocitySourceParticle());
+	
 	ThresholdParticles<GetOmega,1> collectparticles(tolParticle,scaling_factor,blockid2info);
 	collectparticles.destptr = srcparticles;
 	block_processing.process(vInfo, coll, collectparticles);
@@ -60,7 +66,7 @@ void I2D_VelocitySolver_Mani::_compute()
 		vDest = grid_ptr->getBlocksInfo();
 	else
 	{
-		vector<BlockInfo> vInfo = grid_ptr->getBlocksInfo();
+		const vector<BlockInfo>& vInfo = grid_ptr->getBlocksInfoRef();
 				
 		for(unsigned int i=0; i<vInfo.size(); i++)
 		{
@@ -105,10 +111,13 @@ void I2D_VelocitySolver_Mani::_updateBlocks()
 
 void I2D_VelocitySolver_Mani::_cleanup()
 {
-	delete [] srcparticles; srcparticles = NULL;
+	TransientAllocator<VelocitySourceParticle>().deallocate(srcparticles, nsource_particles); srcparticles = NULL;
 	nsource_particles = 0;
 	
 	VelocityBlock::deallocate(my_velBlocks);
+	
+	//the plan of the FMM is gone as well: nothing of the solve is left in the arena
+	MemoryArena::transient().reset();
 }
 
 void I2D_VelocitySolver_Mani::compute_velocity()
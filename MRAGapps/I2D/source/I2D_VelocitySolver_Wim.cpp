@@ -70,7 +70,7 @@ struct Core_VelocitySolver
         
         static const int BS = FluidBlock2D::sizeZ*FluidBlock2D::sizeY*FluidBlock2D::sizeX;
         
-        vector<BlockInfo> vInfo = grid.getBlocksInfo();
+        const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
         const BlockCollection<B>& coll = grid.getBlockCollection();
         
         int nof_sources = -1;
@@ -78,7 +78,7 @@ struct Core_VelocitySolver
         //find the amount of sources
         {
             int n = 0;
-            for(vector<BlockInfo>::iterator itBlock = vInfo.begin(); itBlock!=vInfo.end(); ++itBlock)
+            for(vector<BlockInfo>::const_iterator itBlock = vInfo.begin(); itBlock!=vInfo.end(); ++itBlock)
             {
                 FluidElement2D * const e = &coll[itBlock->blockID](0,0,0);
                 for(int i=0; i<BS; i++) n += (int)(fabs(e[i].omega) > tolParticle);
@@ -94,7 +94,7 @@ struct Core_VelocitySolver
         
         {
             int c = 0;
-            for(vector<BlockInfo>::iterator itBlock = vInfo.begin(); itBlock!=vInfo.end(); ++itBlock)
+            for(vector<BlockInfo>::const_iterator itBlock = vInfo.begin(); itBlock!=vInfo.end(); ++itBlock)
             {
                 const Real dV = std::pow(itBlock->h[0],2);
                 const Real prefac = scaling_factor*dV;
@@ -305,7 +305,7 @@ public:
 	{
         Profiler profiler;
         
-		vector<BlockInfo> vInfo = grid.getBlocksInfo();
+		const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 		const BlockCollection<B>& coll = grid.getBlockCollection();
 		
 		VelocitySourceParticle * sources = NULL;
@@ -355,7 +355,7 @@ void I2D_VelocitySolver_Wim::compute_velocity()
 	I2D_Clear cleaner;
 	cleaner.clearVel(*grid_ptr);
     
-	vector<BlockInfo> vInfo = grid_ptr->getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid_ptr->getBlocksInfoRef();
 	
     Core_VelocitySolver core(*grid_ptr);
     const long long nsources = core.execute(block_processing, tolParticle, scaling_factor,theta);
@@ -267,7 +267,7 @@ Real I2D_WingAngleOfAttack::mollified_heaviside(const Real x, const Real eps)
 
 void I2D_WingAngleOfAttack::characteristic_function()
 {
-	vector<BlockInfo> vInfo = grid.getBlocksInfo();
+	const vector<BlockInfo>& vInfo = grid.getBlocksInfoRef();
 	const BlockCollection<B>& coll = grid.getBlockCollection();
 	
 	Real CM[2] = {position[0], position[1]};
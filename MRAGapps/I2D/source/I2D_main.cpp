@@ -15,6 +15,7 @@
 #include "I2D_TestPoissonEquation.h"
 #include "I2D_TestPoissonEquationPotential.h"
 #include "I2D_TestMultipole.h"
+#include "I2D_TestSnapshotStream.h"
 
 using namespace MRAG;
 using namespace std;
@@ -85,6 +86,8 @@ int main (int argc,  const char ** argv)
 	ArgumentParser parser(argc, argv);
 	
 	Environment::setup(max(1, parser("-nthreads").asInt()));
+	NUMATopology::setup(parser("-numa").asInt());
+	MemoryPool::setHugePages(parser("-hugepages").asBool());
 	
 	printf("INPUT IS %s\n", parser("-study").asString().data());
 	if(parser("-study").asString() == "diffusion")
@@ -101,6 +104,8 @@ int main (int argc,  const char ** argv)
         test = new I2D_TestMultipole(argc, (const char **)argv);
 	else if(parser("-study").asString() == "dumping")
 		test = new I2D_TestDumping(argc, (const char **)argv);
+	else if(parser("-study").asString() == "snapshotstream")
+		test = new I2D_TestSnapshotStream(argc, (const char **)argv);
 	else
 	{
 		printf("Study case is not set!\n");
@@ -6,6 +6,7 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <assert.h>
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
 #include "RL_AgentVector.h"
@@ -284,10 +285,10 @@ void RL_AgentVector::update(const double dt, const double t, map< string, vector
 	TBB_update tbb_update(dt,t,agents,&data);
 	tbb::parallel_for(tbb::blocked_range<size_t>(0,agents.size()), tbb_update, tbb::auto_partitioner());
 
-	// Common dump serial
+	// Common dump serial, environments running side by side dump to their own file
 	if(counterAgents%10000==0)
 	{
-		ofstream out("commondump", ios_base::app);
+		ofstream out((filename==string()) ? "commondump" : filename.c_str(), ios_base::app);
 		for( vector<RL_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
 			(*it)->dump(t,out);
 
@@ -331,25 +332,39 @@ void RL_AgentVector::learn(const double t, map< string, vector<RL_Agent *> > * _
 	}
 	else
 	{
-		// Set reward SERIAL
-		for( vector<RL_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
-			(*it)->setReward(t);
+		collect(t);
+		learnCollected(t);
+	}
+}
 
-		// Map end state PARALLEL
-		TBB_map_test tbb_map_test(t,agents,&data);
-		tbb::parallel_for(tbb::blocked_range<size_t>(0,agents.size()), tbb_map_test, tbb::auto_partitioner());
+void RL_AgentVector::collect(const double t)
+{
+	assert(shared);
 
-		// Stop test SERIAL
-		for( vector<RL_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
-			(*it)->stopTest(t,&data);
+	// Set reward SERIAL
+	for( vector<RL_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
+		(*it)->setReward(t);
 
-		// Learn SERIAL
-		unsigned int counter = 0;
-		for( vector<RL_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
-		{
-			(*it)->learn(t,&data,name_learning[counter]);
-			counter++;
-		}
+	// Map end state PARALLEL
+	TBB_map_test tbb_map_test(t,agents,&data);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0,agents.size()), tbb_map_test, tbb::auto_partitioner());
+
+	// Stop test SERIAL
+	for( vector<RL_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
+		(*it)->stopTest(t,&data);
+}
+
+void RL_AgentVector::learnCollected(const double t)
+{
+	assert(shared);
+
+	// Learn: the first agent hands the samples of all the agents to the shared policy, which computes
+	// their increments PARALLEL and applies them in the agents order (see RL_QLearning::setDeterministic)
+	unsigned int counter = 0;
+	for( vector<RL_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
+	{
+		(*it)->learn(t,&data,name_learning[counter]);
+		counter++;
 	}
 }
 
@@ -39,6 +39,12 @@ public:
 	void learn(const double t, map< string, vector<RL_Agent *> > * _data = NULL, string name = string());
 	void reward(const double t, map< string, vector<RL_Agent *> > * _data = NULL);
 
+	// The two halves of learn() with a shared policy: collect() hands the rewards and end states
+	// of the agents to the policy, learnCollected() updates it with all the samples handed so far.
+	// Several vectors sharing a policy collect first, then learn (see RL_TestTabular::run).
+	void collect(const double t);
+	void learnCollected(const double t);
+
 #ifdef _RL_VIZ
 	virtual void paint();
 #endif
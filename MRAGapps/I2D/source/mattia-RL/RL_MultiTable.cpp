@@ -9,21 +9,200 @@
 #include <iostream>
 #include <fstream>
 #include <assert.h>
+#include <algorithm>
+#include <limits>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <tbb/tbb_thread.h>
 
 #include "RL_MultiTable.h"
 
 namespace RL
 {
 
-RL_MultiTable::RL_MultiTable(vector<int> dim):dim(dim)
+static const char policyMagic[8] = {'R','L','Q','T','A','B','1','\0'};
+
+// the header is padded to a multiple of 8 bytes, the payload is aligned
+static size_t _padding(const size_t offset)
+{
+	return (8 - offset%8)%8;
+}
+
+// FNV-1a
+static unsigned long long _checksum(const void * const data, const size_t bytes, unsigned long long hash = 0xcbf29ce484222325ULL)
+{
+	const unsigned char * const p = (const unsigned char *)data;
+
+	for(size_t i=0; i<bytes; i++)
+		hash = (hash ^ p[i])*0x100000001b3ULL;
+
+	return hash;
+}
+
+// used entries of a table, in the order of their flat index
+struct RL_MultiTable::Snapshot
+{
+	string name;
+	vector<int> dim;
+	vector<long long> index;
+	vector<double> value;
+
+	void write() const
+	{
+		const string nameTmp = name + ".tmp";
+		FILE * f = fopen(nameTmp.c_str(), "wb");
+		if(f==NULL){ printf("Could not open %s: %s\n", nameTmp.c_str(), strerror(errno)); abort(); }
+
+		const int DIM = dim.size();
+		const long long count = index.size();
+		const unsigned long long checksum = _checksum(count ? &value.front() : NULL, count*sizeof(double), _checksum(count ? &index.front() : NULL, count*sizeof(long long)));
+
+		bool ok = true;
+		ok &= fwrite(policyMagic, sizeof(policyMagic), 1, f)==1;
+		ok &= fwrite(&DIM, sizeof(int), 1, f)==1;
+		ok &= DIM==0 || fwrite(&dim.front(), sizeof(int), DIM, f)==(size_t)DIM;
+		const char zeros[8] = {0,0,0,0,0,0,0,0};
+		const size_t padding = _padding(sizeof(policyMagic) + (1+DIM)*sizeof(int));
+		ok &= padding==0 || fwrite(zeros, 1, padding, f)==padding;
+		ok &= fwrite(&count, sizeof(long long), 1, f)==1;
+		ok &= fwrite(&checksum, sizeof(unsigned long long), 1, f)==1;
+		if(count>0)
+		{
+			ok &= fwrite(&index.front(), sizeof(long long), count, f)==(size_t)count;
+			ok &= fwrite(&value.front(), sizeof(double), count, f)==(size_t)count;
+		}
+		ok &= fflush(f)==0;
+		ok &= fsync(fileno(f))==0;
+		ok &= fclose(f)==0;
+
+		if(!ok || rename(nameTmp.c_str(), name.c_str())!=0)
+		{
+			printf("Could not write policy %s: %s\n", name.c_str(), strerror(errno));
+			abort();
+		}
+
+		// the rename is durable only once the directory entry is
+		const size_t slash = name.rfind('/');
+		const string directory = (slash == string::npos) ? string(".") : (slash == 0) ? string("/") : name.substr(0, slash);
+		const int fd = open(directory.c_str(), O_RDONLY);
+		if(fd<0 || fsync(fd)!=0)
+		{
+			printf("Could not sync directory %s of policy %s: %s\n", directory.c_str(), name.c_str(), strerror(errno));
+			abort();
+		}
+		close(fd);
+
+		printf("saved %s (%lld entries)\n", name.c_str(), count);
+	}
+};
+
+struct RL_MultiTable::Writer
+{
+	struct Write
+	{
+		Snapshot * snapshot;
+
+		Write(Snapshot * snapshot): snapshot(snapshot) {}
+
+		void operator()()
+		{
+			snapshot->write();
+			delete snapshot;
+		}
+	};
+
+	tbb::tbb_thread thread;
+
+	Writer(Snapshot * snapshot): thread(Write(snapshot)) {}
+};
+
+RL_MultiTable::RL_MultiTable(vector<int> dim):dim(dim), nstates(0), nactions(0), bDense(true), nused(0), nrows(0), writer(NULL)
+{
+	_setup();
+}
+
+RL_MultiTable::RL_MultiTable(const RL_MultiTable & t):
+dim(t.dim), nstates(t.nstates), nactions(t.nactions), bDense(t.bDense), values(t.values), used(t.used), nused(t.nused),
+keys(t.keys), key2row(t.key2row), nrows(t.nrows), writer(NULL)
+{
+}
+
+RL_MultiTable & RL_MultiTable::operator=(const RL_MultiTable & t)
 {
+	if(this==&t) return *this;
+
+	wait();
+
+	dim = t.dim;
+	nstates = t.nstates;
+	nactions = t.nactions;
+	bDense = t.bDense;
+	values = t.values;
+	used = t.used;
+	nused = t.nused;
+	keys = t.keys;
+	key2row = t.key2row;
+	nrows = t.nrows;
+
+	return *this;
 }
 
 RL_MultiTable::~RL_MultiTable()
 {
+	wait();
+}
+
+void RL_MultiTable::_setup()
+{
+	const int DIM = dim.size();
+
+	nactions = DIM>0 ? dim[DIM-1] : 0;
+	nstates = 1;
+
+	// the flat indices (state*nactions + action) must fit in a long long
+	const long long maxIndex = numeric_limits<long long>::max();
+
+	bool bHuge = false;
+	for(int i=0; i<DIM; i++)
+	{
+		if(dim[i]<=0 || nstates > maxIndex/dim[i])
+		{
+			printf("RL_MultiTable: the dimensions do not fit in a flat index (dim[%d]=%d)!\n", i, dim[i]);
+			abort();
+		}
+
+		if(i==DIM-1) break;
+
+		bHuge |= (nstates > maxDenseEntries);
+		nstates *= dim[i];
+	}
+
+	bDense = !bHuge && (nstates*nactions <= maxDenseEntries);
+
+	values.clear();
+	used.clear();
+	keys.clear();
+	key2row.clear();
+	nused = 0;
+	nrows = 0;
+
+	if(DIM==0) return;
+
+	if(bDense)
+	{
+		values.resize(nstates*nactions, 0.0);
+		used.resize(nstates*nactions, 0);
+	}
+	else
+		_rehash(1024);
 }
 
-bool RL_MultiTable::_check_bounds(vector<int> idx)const
+bool RL_MultiTable::_check_bounds(const vector<int> & idx)const
 {
 	const unsigned int DIM = dim.size();
 	assert( DIM > 0 );
@@ -35,26 +214,141 @@ bool RL_MultiTable::_check_bounds(vector<int> idx)const
 	return true;
 }
 
+long long RL_MultiTable::_state(const vector<int> & idx) const
+{
+	const int DIM = dim.size();
+
+	long long state = 0;
+	for(int i=0; i<DIM-1; i++)
+		state = state*dim[i] + idx[i];
+
+	return state;
+}
+
+void RL_MultiTable::_decode(const long long state, const int action, vector<int> & idx) const
+{
+	const int DIM = dim.size();
+
+	idx.resize(DIM);
+	idx[DIM-1] = action;
+
+	long long s = state;
+	for(int i=DIM-2; i>=0; i--)
+	{
+		idx[i] = s%dim[i];
+		s /= dim[i];
+	}
+}
+
+void RL_MultiTable::_rehash(const int nslots)
+{
+	assert((nslots & (nslots-1)) == 0);
+
+	const vector<long long> oldkeys(keys);
+	const vector<int> oldrows(key2row);
+
+	keys.assign(nslots, -1);
+	key2row.assign(nslots, -1);
+
+	for(int i=0; i<(int)oldkeys.size(); i++)
+	{
+		if(oldkeys[i]<0) continue;
+
+		unsigned long long slot = ((unsigned long long)oldkeys[i]*0x9E3779B97F4A7C15ULL) & (nslots-1);
+		while(keys[slot]>=0)
+			slot = (slot+1) & (nslots-1);
+
+		keys[slot] = oldkeys[i];
+		key2row[slot] = oldrows[i];
+	}
+}
+
+int RL_MultiTable::_row(const long long state)
+{
+	assert(state>=0 && state<nstates);
+
+	if(bDense)
+		return (int)state;
+
+	const int nslots = keys.size();
+
+	unsigned long long slot = ((unsigned long long)state*0x9E3779B97F4A7C15ULL) & (nslots-1);
+	while(keys[slot]>=0)
+	{
+		if(keys[slot]==state)
+			return key2row[slot];
+
+		slot = (slot+1) & (nslots-1);
+	}
+
+	// new state: append a row, keep the load factor below 1/2
+	const int row = nrows++;
+	keys[slot] = state;
+	key2row[slot] = row;
+
+	values.resize((long long)nrows*nactions, 0.0);
+	used.resize((long long)nrows*nactions, 0);
+
+	if(2*nrows > nslots)
+		_rehash(2*nslots);
+
+	return row;
+}
+
 double & RL_MultiTable::operator()(const vector<int> & idx)
 {
 	assert(_check_bounds(idx));
-	return data[idx];
+	return _entry(_state(idx), idx[dim.size()-1]);
 }
 
 double RL_MultiTable::read(const vector<int> & idx)
 {
 	assert(_check_bounds(idx));
-	return data[idx];
+	return _entry(_state(idx), idx[dim.size()-1]);
 }
 
-double RL_MultiTable::usage() const
+const double * RL_MultiTable::actions(const vector<int> & state) const
+{
+	assert( state.size() == dim.size()-1 );
+
+	return find(_state(state));
+}
+
+const double * RL_MultiTable::find(const long long state) const
+{
+	assert(state>=0 && state<nstates);
+
+	if(bDense)
+		return values.empty() ? NULL : &values[state*nactions];
+
+	const int nslots = keys.size();
+
+	unsigned long long slot = ((unsigned long long)state*0x9E3779B97F4A7C15ULL) & (nslots-1);
+	while(keys[slot]>=0)
+	{
+		if(keys[slot]==state)
+			return &values[(long long)key2row[slot]*nactions];
+
+		slot = (slot+1) & (nslots-1);
+	}
+
+	return NULL;
+}
+
+void RL_MultiTable::touch(const long long state)
 {
-	const int n = data.size();
-	int maxn = 1;
-	for(int i=0; i<(int)dim.size(); i++)
-		maxn *= dim[i];
+	const long long first = (long long)_row(state)*nactions;
 
-	return (double)n/(double)maxn;
+	for(int a=0; a<nactions; a++)
+	{
+		nused += (long long)!used[first + a];
+		used[first + a] = 1;
+	}
+}
+
+double RL_MultiTable::usage() const
+{
+	return (double)nused/((double)nstates*(double)nactions);
 }
 
 int RL_MultiTable::_lines(const char * const filename)
@@ -71,63 +365,174 @@ int RL_MultiTable::_lines(const char * const filename)
 	return c;
 }
 
-void RL_MultiTable::save(string name)
+void RL_MultiTable::wait()
+{
+	if(writer==NULL) return;
+
+	writer->thread.join();
+	delete writer;
+	writer = NULL;
+}
+
+void RL_MultiTable::save(string name, bool bBackground)
 {
 	printf("save %s\n", name.c_str());
 
+	// one save at a time on the same table
+	wait();
+
+	Snapshot * snapshot = new Snapshot;
+	snapshot->name = name;
+	snapshot->dim = dim;
+	snapshot->index.reserve(nused);
+	snapshot->value.reserve(nused);
+
+	// used entries in lexicographic order of their indices, ie by state and then by action
+	vector< pair<long long, int> > rows;
+	if(bDense)
+		for(long long state=0; state<nstates; state++)
+			rows.push_back(pair<long long, int>(state, (int)state));
+	else
+	{
+		for(int i=0; i<(int)keys.size(); i++)
+			if(keys[i]>=0)
+				rows.push_back(pair<long long, int>(keys[i], key2row[i]));
+
+		sort(rows.begin(), rows.end());
+	}
+
+	for(vector< pair<long long, int> >::const_iterator it = rows.begin(); it!=rows.end(); it++)
+		for(int a=0; a<nactions; a++)
+		{
+			const long long e = (long long)it->second*nactions + a;
+			if(!used[e]) continue;
+
+			snapshot->index.push_back(it->first*nactions + a);
+			snapshot->value.push_back(values[e]);
+		}
+
+	// Check consistency
+	if((long long)snapshot->index.size()!=nused)
+	{
+		printf("RL_MultiTable::save: collected %lld entries but %lld are marked as used. Aborting.\n", (long long)snapshot->index.size(), nused);
+		abort();
+	}
+
+	if(bBackground)
+		writer = new Writer(snapshot);
+	else
+	{
+		snapshot->write();
+		delete snapshot;
+	}
+}
+
+void RL_MultiTable::restart(string name)
+{
 	const int DIM = dim.size();
-	string nameBackup = name + "_backup";
-	ofstream out(nameBackup.c_str());
-	out.precision(20);
+	if(DIM==0){ printf("Policy dimension was not set!\n"); abort(); }
 
-	out << DIM << "  ";
-	for(int i=0; i<DIM; i++)
-		out << dim[i] << "  ";
+	// a pending save of this table might be writing the file
+	wait();
+
+	const int fd = open(name.c_str(), O_RDONLY);
+	if(fd<0)
+	{
+		_restartText(name);
+		return;
+	}
+
+	struct stat st;
+	const size_t headerBytes = sizeof(policyMagic) + sizeof(int);
+	if(fstat(fd, &st)!=0 || (size_t)st.st_size<headerBytes)
+	{
+		close(fd);
+		_restartText(name);
+		return;
+	}
+
+	const size_t bytes = st.st_size;
+	void * const map = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map==MAP_FAILED){ printf("Could not map %s: %s\n", name.c_str(), strerror(errno)); abort(); }
 
-	out << endl;
+	const char * p = (const char *)map;
 
-	unsigned int counter = 0;
-	for(map< vector<int>, double >::iterator it = data.begin(); it!=data.end(); it++)
+	// files written by the older versions are text, their last valid copy is name_backup
+	if(memcmp(p, policyMagic, sizeof(policyMagic))!=0)
 	{
-		for(int i=0; i<DIM; i++)
-			out << (*it).first[i] << "  ";
+		munmap(map, bytes);
+		_restartText(name);
+		return;
+	}
+	p += sizeof(policyMagic);
+
+	printf("%s\n", name.c_str());
 
-		out << scientific << (*it).second << endl;
-		out.flush();
-		counter++;
+	int dimSignature = 0;
+	memcpy(&dimSignature, p, sizeof(int));
+	p += sizeof(int);
+	const size_t padding = _padding(headerBytes + DIM*sizeof(int));
+	if(DIM!=dimSignature || bytes < headerBytes + DIM*sizeof(int) + padding + sizeof(long long) + sizeof(unsigned long long))
+	{
+		printf("Saved policy and current policy do not match in dimensionality!\n");
+		abort();
 	}
-	out.flush();
-	out.close();
 
-	const int ndata = data.size();
-	const int nlinesBackup = _lines(nameBackup.c_str())-1;
+	for(int i=0; i<DIM; i++, p+=sizeof(int))
+	{
+		int d = 0;
+		memcpy(&d, p, sizeof(int));
+		if(d!=dim[i]){ printf("Saved policy and current policy do not match in dimensionality!\n"); abort(); }
+	}
+	p += padding;
+
+	long long count = 0;
+	unsigned long long checksum = 0;
+	memcpy(&count, p, sizeof(long long));
+	p += sizeof(long long);
+	memcpy(&checksum, p, sizeof(unsigned long long));
+	p += sizeof(unsigned long long);
+
+	// validate count before using it in any size computation
+	const size_t offset = p - (const char *)map;
+	const size_t entryBytes = sizeof(long long) + sizeof(double);
+	if(count<0 || (unsigned long long)count>(bytes - offset)/entryBytes || offset + count*entryBytes != bytes)
+	{
+		printf("Policy %s is truncated (%lld entries announced, %lu payload bytes)!\n", name.c_str(), count, (unsigned long)(bytes - offset));
+		abort();
+	}
+
+	const long long * const index = (const long long *)p;
+	const double * const value = (const double *)(p + count*sizeof(long long));
 
-	// Prepare copying command
-	std::string command = "cp ";
-	std::string nameOriginal = name;
-	command = command + nameBackup + " " + nameOriginal;
+	if(checksum!=_checksum(value, count*sizeof(double), _checksum(index, count*sizeof(long long))))
+	{
+		printf("Policy %s is corrupted (checksum mismatch)!\n", name.c_str());
+		abort();
+	}
 
-	// Submit the command to the system
-	FILE *ptr = popen(command.c_str(), "r");
-	//if( ptr != NULL){ std::cout << command << std::endl; std::cout << "successful policy backup!" << std::endl; }
-	//else{ std::cout << command << std::endl; std::cout << "policy backup failed" << std::endl; }
-	pclose( ptr );
+	const long long nentries = nstates*nactions;
+	for(long long k=0; k<count; k++)
+	{
+		if(index[k]<0 || index[k]>=nentries){ printf("Policy %s has an entry out of bounds!\n", name.c_str()); abort(); }
+		_entry(index[k]/nactions, index[k]%nactions) = value[k];
+	}
 
-	const int nlines = _lines(name.c_str())-1;
+	munmap(map, bytes);
 
 	// Check consistency
-	printf("counter=%d, ndata=%d, nlines=%d, nlinesBackup=%d\n", counter, ndata, nlines, nlinesBackup);
-	if(ndata!=nlines || nlines!=counter || counter!=ndata || nlinesBackup!=nlines)
+	printf("counter=%lld, ndata=%lld\n", count, nused);
+	if(nused!=count)
 	{
-		printf("Something went fucking wrong!\n");
+		printf("Policy %s lists %lld entries but %lld are marked as used after the restart (duplicate indices?). Aborting.\n", name.c_str(), count, nused);
 		abort();
 	}
 }
 
-void RL_MultiTable::restart(string name)
+void RL_MultiTable::_restartText(string name)
 {
 	const int DIM = dim.size();
-	if(DIM==0){ printf("Policy dimension was not set!\n"); abort(); }
 
 	string nameBackup = name + "_backup";
 
@@ -163,7 +568,7 @@ void RL_MultiTable::restart(string name)
 
 				double dummy = 0.0;
 				in >> dummy;
-				data[key] = dummy;
+				(*this)(key) = dummy;
 				counter++;
 
 				for(int i=0; i<DIM; i++)
@@ -173,17 +578,17 @@ void RL_MultiTable::restart(string name)
 			}
 
 			// Check consistency
-			const int ndata = data.size();
+			const int ndata = nused;
 			printf("counter=%d, ndata=%d, nlinesBackup=%d\n", counter, ndata, nlinesBackup);
 			if(ndata!=nlinesBackup || nlinesBackup!=counter || counter!=ndata)
 			{
-				printf("Something went fucking wrong!\n");
+				printf("Policy %s has %d lines but %d entries were read and %d are marked as used. Aborting.\n", nameBackup.c_str(), nlinesBackup, (int)counter, ndata);
 				abort();
 			}
 		}
 		else
 		{
-			printf("WTF couldnt open file (ok keep going mofo)!\n");
+			printf("Could not open %s, starting from an empty policy\n", nameBackup.c_str());
 		}
 
 		in.close();
@@ -3,6 +3,18 @@
  *
  *  Created on: May 26, 2011
  *      Author: mgazzola
+ *
+ *  The entries are addressed by a flat mixed-radix index computed from dim, the last
+ *  dimension (the action) running fastest: the values of all the actions of a state
+ *  form a contiguous row. The rows are stored in a dense array when the whole table
+ *  fits in maxDenseEntries, otherwise in an open-addressing hash keyed by the state.
+ *  Every entry ever accessed is marked as used (usage(), save()).
+ *
+ *  save() writes the used entries in a binary file: a header (magic, dims, number of
+ *  entries, checksum of the payload) followed by the flat indices and the values.
+ *  The file is written to name.tmp, synced and renamed, and the directory is synced:
+ *  name is always a complete policy. The entries are copied in a snapshot first, the writing can then happen
+ *  in a background thread while the table keeps learning.
  */
 
 #ifndef RL_MULTITABLE_H_
@@ -11,6 +23,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <assert.h>
 
 using namespace std;
 
@@ -19,24 +32,82 @@ namespace RL
 
 class RL_MultiTable
 {
+	static const long long maxDenseEntries = 1 << 22;
+
 	vector<int> dim;
-	map< vector<int>, double > data;
+	long long nstates;
+	int nactions;
+	bool bDense;
+
+	// rows of nactions values and flags, the dense table is indexed by the state
+	vector<double> values;
+	vector<unsigned char> used;
+	long long nused;
 
-	bool _check_bounds(vector<int> idx) const;
+	// open addressing with linear probing, state -> row (-1 is empty)
+	vector<long long> keys;
+	vector<int> key2row;
+	int nrows;
+
+	// the pending background save, owns its thread
+	struct Snapshot;
+	struct Writer;
+	Writer * writer;
+
+	bool _check_bounds(const vector<int> & idx) const;
 	int _lines(const char * const filename);
+	void _restartText(string name);
+
+	void _setup();
+	long long _state(const vector<int> & idx) const;
+	int _row(const long long state);
+	void _rehash(const int nslots);
+	void _decode(const long long state, const int action, vector<int> & idx) const;
+
+	double & _entry(const long long state, const int action)
+	{
+		const long long e = (long long)_row(state)*nactions + action;
+
+		nused += (long long)!used[e];
+		used[e] = 1;
+
+		return values[e];
+	}
 
 public:
 	// Costructor-Destructor
-	RL_MultiTable(){}
+	RL_MultiTable(): nstates(0), nactions(0), bDense(true), nused(0), nrows(0), writer(NULL) {}
 	RL_MultiTable(vector<int> dim);
+	RL_MultiTable(const RL_MultiTable & t);
+	RL_MultiTable & operator=(const RL_MultiTable & t);
 	~RL_MultiTable();
 
 	// Methods
-	inline void setdim(vector<int> _dim){ data.clear(); dim.clear(); dim = _dim; }
+	inline void setdim(vector<int> _dim){ dim.clear(); dim = _dim; _setup(); }
 	double & operator()(const vector<int> & idx);
 	double read(const vector<int> & idx);
+
+	// values of all the actions of a state (idx without the last dimension), NULL if the state was never accessed (all its values are 0).
+	// A lookup: no entry is marked as used. Valid until the next new state is accessed
+	const double * actions(const vector<int> & state) const;
+
+	// flat index of an entry and of a state, the flat index of an entry is state*nactions+action
+	long long index(const vector<int> & idx) const { return _state(idx)*nactions + idx[dim.size()-1]; }
+	long long state(const vector<int> & s) const { assert(s.size()==dim.size()-1); return _state(s); }
+	int actionCount() const { return nactions; }
+
+	// read-only lookup, NULL if the state was never accessed (all its values are 0): safe to call concurrently as long as no entry is accessed meanwhile
+	const double * find(const long long state) const;
+
+	// same as operator() with a flat index
+	double & entry(const long long index) { assert(index>=0 && index<nstates*nactions); return _entry(index/nactions, index%nactions); }
+
+	// marks all the actions of a state as used, as reading them with entry() would
+	void touch(const long long state);
+
 	double usage() const;
-	void save(string name = "savedQ");
+	void save(string name = "savedQ", bool bBackground = false);
+	void wait();
 	void restart(string name = "savedQ");
 };
 
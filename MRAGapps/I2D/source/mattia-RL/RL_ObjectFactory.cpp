@@ -54,7 +54,7 @@ int RL_ObjectFactory::_lines(string filename)
 	return c;
 }
 
-void RL_ObjectFactory::create(MRAG::ArgumentParser & parser, map< string, vector<RL_Agent *> >& shapesMap, RL_TabularPolicy ** policy)
+void RL_ObjectFactory::create(MRAG::ArgumentParser & parser, map< string, vector<RL_Agent *> >& shapesMap, RL_TabularPolicy ** policy, const unsigned long seed)
 {
 	shapesMap.clear();
 
@@ -78,17 +78,19 @@ void RL_ObjectFactory::create(MRAG::ArgumentParser & parser, map< string, vector
 		abort();
 	}
 
-	srand ( time(NULL) );
-	//printf("seed %d!\n", rand());
+	// one stream per call: environments created within the same second must not be identical
+	RNG seeds( (seed!=0) ? seed : (unsigned long)time(NULL) );
+	//printf("seed %d!\n", seeds.rand_int31());
 	//exit(0);
 
-	RNG rng( rand() );
+	RNG rng( seeds.rand_int31() );
 
 	// Count number of shapes
 	const int N = _lines(factoryFile);
 
-	if(SHARED)
-		(*policy) = new RL_QLearning(LR,GAMMA,GREEDYEPS,rand(),learnDump);
+	// environments sharing the policy are created with the same policy pointer
+	if(SHARED && (*policy)==NULL)
+		(*policy) = new RL_QLearning(LR,GAMMA,GREEDYEPS,seeds.rand_int31(),learnDump);
 
 	// Open factory file and retrieve information
 	FILE * ppFile;
@@ -131,7 +133,7 @@ void RL_ObjectFactory::create(MRAG::ArgumentParser & parser, map< string, vector
 			fscanf(ppFile," ym=%f",&variable);
 			const Real ym = YCM + variable*charLength;
 
-			RL_SmartyCircle * object = new RL_SmartyCircle(parser, xm, ym, d, counterID, policy, rand());
+			RL_SmartyCircle * object = new RL_SmartyCircle(parser, xm, ym, d, counterID, policy, seeds.rand_int31());
 
 			map< string, vector<RL_Agent *> >::iterator it = shapesMap.find(name);
 
@@ -160,7 +162,7 @@ void RL_ObjectFactory::create(MRAG::ArgumentParser & parser, map< string, vector
 			fscanf(ppFile," diry=%f",&variable);
 			dir[1] = variable;
 
-			RL_SmartyInline * object = new RL_SmartyInline(parser, xm, ym, d, dir, counterID, policy, rand());
+			RL_SmartyInline * object = new RL_SmartyInline(parser, xm, ym, d, dir, counterID, policy, seeds.rand_int31());
 
 			map< string, vector<RL_Agent *> >::iterator it = shapesMap.find(name);
 
@@ -189,7 +191,7 @@ void RL_ObjectFactory::create(MRAG::ArgumentParser & parser, map< string, vector
 			fscanf(ppFile," diry=%f",&variable);
 			dir[1] = variable;
 
-			RL_SmartyLattice * object = new RL_SmartyLattice(parser, xm, ym, d, dir, counterID, policy, rand());
+			RL_SmartyLattice * object = new RL_SmartyLattice(parser, xm, ym, d, dir, counterID, policy, seeds.rand_int31());
 
 			map< string, vector<RL_Agent *> >::iterator it = shapesMap.find(name);
 
@@ -226,7 +228,7 @@ void RL_ObjectFactory::create(MRAG::ArgumentParser & parser, map< string, vector
 					const Real xm = XCM + ix*charLength;
 					const Real ym = YCM + iy*charLength;
 
-					RL_SmartyLattice * object = new RL_SmartyLattice(parser, xm, ym, d, dir, counterID, policy, rand());
+					RL_SmartyLattice * object = new RL_SmartyLattice(parser, xm, ym, d, dir, counterID, policy, seeds.rand_int31());
 
 					map< string, vector<RL_Agent *> >::iterator it = shapesMap.find(name);
 
@@ -254,7 +256,7 @@ void RL_ObjectFactory::create(MRAG::ArgumentParser & parser, map< string, vector
 			const Real T = variable;
 			assert(T>=0.01);
 
-			RL_SmartyDodger * object = new RL_SmartyDodger(parser, xm, ym, d, T, counterID, policy, rand());
+			RL_SmartyDodger * object = new RL_SmartyDodger(parser, xm, ym, d, T, counterID, policy, seeds.rand_int31());
 
 			map< string, vector<RL_Agent *> >::iterator it = shapesMap.find(name);
 
@@ -288,7 +290,7 @@ void RL_ObjectFactory::create(MRAG::ArgumentParser & parser, map< string, vector
 				const Real xx = radius*cos(angle);
 				const Real yy = radius*sin(angle);
 
-				RL_SmartyDodger * object = new RL_SmartyDodger(parser, xx+0.5, yy+0.5, d, T, counterID, policy, rand());
+				RL_SmartyDodger * object = new RL_SmartyDodger(parser, xx+0.5, yy+0.5, d, T, counterID, policy, seeds.rand_int31());
 
 				map< string, vector<RL_Agent *> >::iterator it = shapesMap.find(name);
 
@@ -454,7 +456,7 @@ void RL_ObjectFactory::create(MRAG::ArgumentParser & parser, map< string, vector
 				const Real xx = radius*cos(angle);
 				const Real yy = radius*sin(angle);
 
-				RL_Food * object = new RL_Food(parser, xx+0.5, yy+0.5, d, counterID, rand());
+				RL_Food * object = new RL_Food(parser, xx+0.5, yy+0.5, d, counterID, seeds.rand_int31());
 
 				map< string, vector<RL_Agent *> >::iterator it = shapesMap.find(name);
 
@@ -495,7 +497,7 @@ void RL_ObjectFactory::create(MRAG::ArgumentParser & parser, map< string, vector
 			fscanf(ppFile," NN=%d",&variableInt);
 			const int NN = variableInt;
 
-			RL_SmartyGlutton * object = new RL_SmartyGlutton(parser, xm, ym, d, T, nactions, cutoffGluttons, cutoffFood, steer, noise, selfavoid, NN, counterID, policy, rand());
+			RL_SmartyGlutton * object = new RL_SmartyGlutton(parser, xm, ym, d, T, nactions, cutoffGluttons, cutoffFood, steer, noise, selfavoid, NN, counterID, policy, seeds.rand_int31());
 
 			map< string, vector<RL_Agent *> >::iterator it = shapesMap.find(name);
 
@@ -552,7 +554,7 @@ void RL_ObjectFactory::create(MRAG::ArgumentParser & parser, map< string, vector
 						const Real xx = ix*spacing + spacing/2.0 + rng.uniform(0.0,spacing/2.0);
 						const Real yy = iy*spacing + spacing/2.0 + rng.uniform(0.0,spacing/2.0);
 
-						RL_SmartyGlutton * object = new RL_SmartyGlutton(parser, xx, yy, d, T, nactions, cutoffGluttons, cutoffFood, steer, noise, selfavoid, NN, counterID, policy, rand());
+						RL_SmartyGlutton * object = new RL_SmartyGlutton(parser, xx, yy, d, T, nactions, cutoffGluttons, cutoffFood, steer, noise, selfavoid, NN, counterID, policy, seeds.rand_int31());
 
 						map< string, vector<RL_Agent *> >::iterator it = shapesMap.find(name);
 
@@ -27,7 +27,8 @@ public:
 	RL_ObjectFactory(const Real charLength, const Real XCM, const Real YCM);
 	~RL_ObjectFactory();
 
-	void create(MRAG::ArgumentParser & parser, map< string, vector<RL_Agent *> >& shapesMap, RL_TabularPolicy ** policy = NULL);
+	// seed 0 seeds the objects from the clock
+	void create(MRAG::ArgumentParser & parser, map< string, vector<RL_Agent *> >& shapesMap, RL_TabularPolicy ** policy = NULL, const unsigned long seed = 0);
 };
 
 } /* namespace RL */
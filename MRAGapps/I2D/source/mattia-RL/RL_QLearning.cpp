@@ -8,12 +8,73 @@
 #include <iostream>
 #include <assert.h>
 #include <fstream>
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
 #include "RL_QLearning.h"
 
 namespace RL
 {
 
-RL_QLearning::RL_QLearning(double LR, double gamma, double epsilon, int seed, int freq): rng(seed), LR(LR), gamma(gamma), epsilon(epsilon), plays(0), freq(freq), totalIntegralReward(0.0)
+const int RL_QLearning::grain;
+
+// temporal differences of the chunks of samples, against the table as it was before the batch: read-only lookups
+struct TBB_increments
+{
+	const RL_MultiTable & Q;
+	const vector<double> & rewards;
+	const vector< vector<int> > & stateActionStarts;
+	const vector< vector<int> > & stateEnds;
+	const double LR, gamma;
+	tbb::enumerable_thread_specific<RL_QLearning::Increments> & increments;
+
+	TBB_increments(const RL_MultiTable & Q, const vector<double> & rewards, const vector< vector<int> > & stateActionStarts, const vector< vector<int> > & stateEnds,
+				   const double LR, const double gamma, tbb::enumerable_thread_specific<RL_QLearning::Increments> & increments):
+	Q(Q), rewards(rewards), stateActionStarts(stateActionStarts), stateEnds(stateEnds), LR(LR), gamma(gamma), increments(increments)
+	{
+	}
+
+	void operator() ( const tbb::blocked_range<int> &r ) const
+	{
+		RL_QLearning::Increments & inc = increments.local();
+
+		const int nsamples = rewards.size();
+		const int nactions = Q.actionCount();
+
+		for (int k=r.begin(); k!=r.end(); ++k)
+		{
+			const int s = k*RL_QLearning::grain;
+			const int e = min(s + RL_QLearning::grain, nsamples);
+
+			for(int i=s; i<e; i++)
+			{
+				const long long flatStart = Q.index(stateActionStarts[i]);
+				const long long flatEnd = Q.state(stateEnds[i]);
+
+				// states never visited have all their values equal to zero
+				const double * const qs = Q.find(flatStart/nactions);
+				const double Qsa = (qs!=NULL) ? qs[flatStart%nactions] : 0.0;
+
+				const double * const qe = Q.find(flatEnd);
+				double QsaMax = (qe!=NULL) ? qe[0] : 0.0;
+				if(qe!=NULL)
+					for(int a=0; a<nactions; a++)
+						QsaMax = max(QsaMax, qe[a]);
+
+				const double delta = rewards[i] + gamma*QsaMax - Qsa;
+				assert(delta==delta);
+
+				inc.flatStarts.push_back(flatStart);
+				inc.flatEnds.push_back(flatEnd);
+				inc.values.push_back(LR * delta);
+			}
+
+			inc.chunks.push_back(k);
+			inc.offsets.push_back(inc.values.size());
+		}
+	}
+};
+
+RL_QLearning::RL_QLearning(double LR, double gamma, double epsilon, int seed, int freq): rng(seed), LR(LR), gamma(gamma), epsilon(epsilon), plays(0), freq(freq), totalIntegralReward(0.0), bDeterministic(true)
 {
 	assert( LR>=0.0 && LR<=1.0);
 	assert( gamma>=0.0 && gamma<=1.0 );
@@ -35,38 +96,24 @@ int RL_QLearning::_epsilonGreedySelection(const vector<int> & state)
 {
 	const int DIM = dim.size();
 	assert( (int)state.size() == (DIM-1) );
-	vector<int> idx(state);
-	idx.push_back(0.0);
 
-	double maxQ = Q.read(idx);
+	// the entries read are marked as used: action 0, and all the actions of the state when greedy
+	const int nactions = dim[DIM-1];
+	const long long first = Q.state(state)*nactions;
+
+	double maxQ = Q.entry(first);
 	int maxQIndex = 0;
 
 	if( rng.uniform(0.0,1.0) < epsilon )
-		maxQIndex = floor( rng.uniform( 0.0, (double)dim[DIM-1] ) );
+		maxQIndex = floor( rng.uniform( 0.0, (double)nactions ) );
 	else
 	{
-		//vector< double > qs;
-		//vector< int > qsIdx;
-
-		for(int k=0; k < dim[DIM-1]; k++)
+		for(int k=0; k < nactions; k++)
 		{
-			idx[DIM-1] = k;
-			const double qread = Q.read(idx);
-			//qs.push_back(qread);
+			const double qread = Q.entry(first + k);
 			maxQIndex = (qread>maxQ)?k:maxQIndex;
 			maxQ = max(maxQ, qread);
 		}
-
-		//for(int k=0; k < dim[DIM-1]; k++)
-		//{
-		//	idx[DIM-1] = k;
-		//	if(qs[k]==maxQ)
-		//		qsIdx.push_back(k);
-		//}
-
-
-		//printf("shit=%d\n",(int)floor(rng.uniform(0.0,(double)qsIdx.size())));
-		//return qsIdx[(int)floor(rng.uniform(0.0,(double)qsIdx.size()))];
 	}
 
 	return maxQIndex;
@@ -87,16 +134,14 @@ double RL_QLearning::_getMaxValue(const vector<int> & state)
 {
 	const int DIM = dim.size();
 	assert( (int)state.size() == (DIM-1) );
-	vector<int> idx(state);
-	idx.push_back(0.0);
 
-	double maxQ = Q.read(idx);
+	const int nactions = dim[DIM-1];
+	const long long first = Q.state(state)*nactions;
 
-	for(int k=0; k < dim[DIM-1]; k++)
-	{
-		idx[DIM-1] = k;
-		maxQ = max(maxQ, Q.read(idx));
-	}
+	double maxQ = Q.entry(first);
+
+	for(int k=0; k < nactions; k++)
+		maxQ = max(maxQ, Q.entry(first + k));
 
 	return maxQ;
 }
@@ -132,6 +177,16 @@ bool RL_QLearning::_jumpedToDifferentState(const vector<int> & stateActionStart,
 	return same;
 }
 
+void RL_QLearning::_apply(const Increments & inc, const int s, const int e)
+{
+	for(int j=s; j<e; j++)
+	{
+		// all the actions of the end state were read by the max
+		Q.touch(inc.flatEnds[j]);
+		Q.entry(inc.flatStarts[j]) += inc.values[j];
+	}
+}
+
 void RL_QLearning::update(string name)
 {
 	const unsigned int rsize = rewards.size();
@@ -141,23 +196,47 @@ void RL_QLearning::update(string name)
 	if( rsize==0 )
 		return;
 
-	// Calculate delta state action value for update
-	vector<double> deltaStateActionValues(rsize,0);
 	for(unsigned int i=0; i<rsize; ++i)
 	{
-		const double reward = rewards[i];
 		assert(rewards[i]==rewards[i]);
-		const double Qsa = _getValue( stateActionStarts[i] );
-		const double QsaMax = _getMaxValue( stateEnds[i] );
-		deltaStateActionValues[i] = reward + gamma*QsaMax - Qsa;
-		assert(deltaStateActionValues[i]==deltaStateActionValues[i]);
+		totalIntegralReward += rewards[i];
+	}
+
+	// Calculate the increments of the state action values PARALLEL, into the buffers of the threads
+	for(tbb::enumerable_thread_specific<Increments>::iterator it = increments.begin(); it!=increments.end(); ++it)
+		it->clear();
+
+	const int nchunks = (rsize + grain - 1)/grain;
+	TBB_increments tbb_increments(Q, rewards, stateActionStarts, stateEnds, LR, gamma, increments);
 
-		totalIntegralReward += reward;
+	// Update state action values SERIAL from the buffers: accessing new states is not thread-safe
+	if(bDeterministic)
+	{
+		// one chunk per task, the increments are applied chunk after chunk: the result is the one of the serial update
+		tbb::parallel_for(tbb::blocked_range<int>(0, nchunks, 1), tbb_increments, tbb::simple_partitioner());
+
+		vector< pair<const Increments *, int> > order(nchunks, pair<const Increments *, int>((const Increments *)NULL, 0));
+		for(tbb::enumerable_thread_specific<Increments>::const_iterator it = increments.begin(); it!=increments.end(); ++it)
+			for(int c=0; c<(int)it->chunks.size(); c++)
+				order[it->chunks[c]] = pair<const Increments *, int>(&*it, c);
+
+		for(int k=0; k<nchunks; k++)
+		{
+			assert(order[k].first!=NULL);
+			const Increments & inc = *order[k].first;
+			const int c = order[k].second;
+
+			_apply(inc, inc.offsets[c], inc.offsets[c+1]);
+		}
 	}
+	else
+	{
+		// the buffers are applied in the order of the threads, sums of increments on the same entry depend on the scheduling
+		tbb::parallel_for(tbb::blocked_range<int>(0, nchunks), tbb_increments, tbb::auto_partitioner());
 
-	// Update state action values
-	for(unsigned int i=0; i<rsize; i++)
-		Q(stateActionStarts[i]) += LR * deltaStateActionValues[i];
+		for(tbb::enumerable_thread_specific<Increments>::const_iterator it = increments.begin(); it!=increments.end(); ++it)
+			_apply(*it, 0, it->values.size());
+	}
 
 	// Dump statistics
 	histPlays.push_back(plays);
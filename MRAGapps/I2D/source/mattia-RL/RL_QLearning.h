@@ -11,6 +11,8 @@
 #include <vector>
 #include <string>
 
+#include "tbb/enumerable_thread_specific.h"
+
 #include "rng.h"
 
 #include "MRAGcore/MRAGProfiler.h"
@@ -36,6 +38,36 @@ protected:
 	vector<double> histRewards;
 	vector<double> histUsage;
 
+public:
+	// increments of the samples handled by one thread, chunk after chunk: chunk k holds the samples [k*grain, (k+1)*grain)
+	struct Increments
+	{
+		vector<int> chunks;
+		vector<int> offsets;
+		vector<long long> flatStarts;
+		vector<long long> flatEnds;
+		vector<double> values;
+
+		Increments(): offsets(1, 0) {}
+
+		void clear()
+		{
+			chunks.clear();
+			offsets.assign(1, 0);
+			flatStarts.clear();
+			flatEnds.clear();
+			values.clear();
+		}
+	};
+
+	static const int grain = 64;
+
+protected:
+	bool bDeterministic;
+	tbb::enumerable_thread_specific<Increments> increments;
+
+	void _apply(const Increments & inc, const int s, const int e);
+
 	RNG rng;
 	MRAG::Profiler profiler;
 
@@ -53,6 +85,9 @@ public:
 	void setStateActionStart( const vector<int> & idx );
 	void setStateEnd( const vector<int> & idx );
 	void update(string name = "learning");
+
+	// deterministic: the increments are applied in the order of the samples, as a serial update would (default)
+	void setDeterministic(const bool b) { bDeterministic = b; }
 };
 
 }
@@ -32,13 +32,14 @@ public:
 	virtual void setStateEnd( const vector<int> & idx ) = 0;
 	virtual void update(string name = "learning") = 0;
 
-	void save(string name = "savedQ")
+	// with bBackground the files are written by a background thread from a snapshot of the tables
+	void save(string name = "savedQ", bool bBackground = false)
 	{
 		assert(name!=string());
-		Q.save(name);
+		Q.save(name, bBackground);
 
 		string usage(name+"_usage");
-		Qusage.save(usage);
+		Qusage.save(usage, bBackground);
 
 	};
 
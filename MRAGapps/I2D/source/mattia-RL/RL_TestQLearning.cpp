@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <set>
+#include <vector>
+
+#include "RL_TestQLearning.h"
+#include "RL_QLearning.h"
+
+namespace RL
+{
+
+// gives access to the table and to the serial update, as RL_QLearning::update did before it was parallel
+class RL_QLearningCheck : public RL_QLearning
+{
+public:
+	RL_QLearningCheck(const vector<int> & dim, const int nbatches): RL_QLearning(0.1, 0.8, 0.0, 0, nbatches+1)
+	{
+		setdim(dim);
+	}
+
+	const RL_MultiTable & table() const { return Q; }
+
+	void updateSerial()
+	{
+		const unsigned int rsize = rewards.size();
+
+		vector<double> deltaStateActionValues(rsize,0);
+		for(unsigned int i=0; i<rsize; ++i)
+		{
+			const double Qsa = _getValue( stateActionStarts[i] );
+			const double QsaMax = _getMaxValue( stateEnds[i] );
+			deltaStateActionValues[i] = rewards[i] + gamma*QsaMax - Qsa;
+		}
+
+		for(unsigned int i=0; i<rsize; i++)
+			Q(stateActionStarts[i]) += LR * deltaStateActionValues[i];
+
+		rewards.clear();
+		stateActionStarts.clear();
+		stateEnds.clear();
+	}
+};
+
+RL_TestQLearning::RL_TestQLearning(const int argc, const char ** argv): parser(argc, argv), rng(parser("-seed").asInt(1))
+{
+	NSAMPLES = max(1, parser("-nsamples").asInt(10000));
+	NBATCHES = max(1, parser("-nbatches").asInt(20));
+	parser.save_options();
+}
+
+bool RL_TestQLearning::_check(const vector<int> & dim, const bool bDeterministic)
+{
+	const int DIM = dim.size();
+
+	RL_QLearningCheck serial(dim, NBATCHES);
+	RL_QLearningCheck parallel(dim, NBATCHES);
+	parallel.setDeterministic(bDeterministic);
+
+	// few states per batch: many samples update the same entries and read the entries updated by the others
+	const int nhot = 1 + NSAMPLES/50;
+	set<long long> visited;
+	int nmismatches = 0;
+
+	for(int b=0; b<NBATCHES; b++)
+	{
+		vector< vector<int> > hot(nhot, vector<int>(DIM-1));
+		for(int h=0; h<nhot; h++)
+			for(int d=0; d<DIM-1; d++)
+				hot[h][d] = rng.rand_int31() % dim[d];
+
+		for(int i=0; i<NSAMPLES; i++)
+		{
+			vector<int> start(hot[rng.rand_int31() % nhot]);
+			start.push_back(rng.rand_int31() % dim[DIM-1]);
+			const vector<int> & end = hot[rng.rand_int31() % nhot];
+			const double reward = rng.uniform(-1.0, 1.0);
+
+			serial.setStateActionStart(start);
+			serial.setStateEnd(end);
+			serial.setReward(reward);
+
+			parallel.setStateActionStart(start);
+			parallel.setStateEnd(end);
+			parallel.setReward(reward);
+		}
+
+		for(int h=0; h<nhot; h++)
+			visited.insert(serial.table().state(hot[h]));
+
+		serial.updateSerial();
+		parallel.update("qlearning_check");
+
+		const RL_MultiTable & Qs = serial.table();
+		const RL_MultiTable & Qp = parallel.table();
+		const int nactions = Qs.actionCount();
+
+		if(Qs.usage()!=Qp.usage())
+		{
+			printf("batch %d: usage %e (serial) vs %e (parallel)\n", b, Qs.usage(), Qp.usage());
+			nmismatches++;
+		}
+
+		for(set<long long>::const_iterator it=visited.begin(); it!=visited.end(); ++it)
+		{
+			const double * const qs = Qs.find(*it);
+			const double * const qp = Qp.find(*it);
+
+			if(qs==NULL || qp==NULL)
+			{
+				printf("batch %d: state %lld is missing\n", b, *it);
+				nmismatches++;
+				continue;
+			}
+
+			for(int a=0; a<nactions; a++)
+			{
+				const double tol = bDeterministic ? 0.0 : 1e-12*max(1.0, fabs(qs[a]));
+
+				if(fabs(qs[a]-qp[a])>tol && nmismatches++<10)
+					printf("batch %d: Q(%lld,%d) = %.17e (serial) vs %.17e (parallel)\n", b, *it, a, qs[a], qp[a]);
+			}
+		}
+	}
+
+	return nmismatches==0;
+}
+
+void RL_TestQLearning::run()
+{
+	// a table stored dense and one stored in the hash
+	vector<int> dense(3);
+	dense[0] = 32; dense[1] = 32; dense[2] = 5;
+
+	vector<int> hashed(3);
+	hashed[0] = 1<<16; hashed[1] = 1<<16; hashed[2] = 5;
+
+	bool bSuccess = true;
+	for(int d=0; d<2; d++)
+	{
+		const vector<int> & dim = d==0 ? dense : hashed;
+
+		for(int m=0; m<2; m++)
+		{
+			const bool bDeterministic = m==0;
+			const bool bPassed = _check(dim, bDeterministic);
+
+			printf("RL_TestQLearning: %s table, %s update: %s\n", d==0 ? "dense" : "hashed", bDeterministic ? "deterministic" : "non-deterministic", bPassed ? "passed" : "FAILED");
+			bSuccess &= bPassed;
+		}
+	}
+
+	if(!bSuccess)
+	{
+		printf("RL_TestQLearning: the parallel update does not match the serial one. Aborting.\n");
+		abort();
+	}
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "RL_Environment.h"
+#include "MRAGio/MRAG_IO_ArgumentParser.h"
+#include "IF2D_Test.h"
+#include "rng.h"
+
+namespace RL
+{
+
+// Checks the parallel update of RL_QLearning against the serial one, on random batches
+// of samples with many samples per entry, for a dense and a hashed table.
+class RL_TestQLearning: public IF2D_Test
+{
+protected:
+	int NSAMPLES, NBATCHES;
+
+	MRAG::ArgumentParser parser;
+	RNG rng;
+
+	bool _check(const vector<int> & dim, const bool bDeterministic);
+
+public:
+
+	RL_TestQLearning(const int argc, const char ** argv);
+	~RL_TestQLearning() {}
+
+	void run();
+	void paint(){};
+};
+
+}
@@ -4,6 +4,8 @@
 #include <time.h>
 #include <iostream>
 #include <vector>
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
 
 #include "rng.h"
 #include "RL_TestTabular.h"
@@ -24,7 +26,28 @@
 namespace RL
 {
 
-RL_TestTabular::RL_TestTabular(const int argc, const char ** argv):	parser(argc, argv), policy(NULL)
+// the environments evolve and collect their rewards independently, only choosing and learning touch the shared policy
+struct TBB_update_envs
+{
+	double t,dt;
+	vector<RL_AgentVector *> & envs;
+	vector<string> & names;
+
+	TBB_update_envs(double dt, double t, vector<RL_AgentVector *> & envs, vector<string> & names): dt(dt),t(t),envs(envs),names(names)
+	{
+	}
+
+	void operator() ( const tbb::blocked_range<size_t> &r ) const
+	{
+		for (size_t i=r.begin(); i!=r.end();++i)
+		{
+			envs[i]->update(dt,t,NULL,names[i]);
+			envs[i]->reward(t);
+		}
+	}
+};
+
+RL_TestTabular::RL_TestTabular(const int argc, const char ** argv):	parser(argc, argv), policy(NULL), rng((unsigned long)time(NULL))
 {
 	printf("//////////////////////////////////////////////////////////////////////\n");
 	printf("////////////            REINFORCEMENT LEARNING         ///////////////\n");
@@ -35,8 +58,23 @@ RL_TestTabular::RL_TestTabular(const int argc, const char ** argv):	parser(argc,
 	XPOS = parser("-xpos").asDouble();
 	YPOS = parser("-ypos").asDouble();
 	CHARLENGTH = parser("-D").asDouble();
+	parser.unset_strict_mode();
+	NENVS = max(1, parser("-nenvs").asInt(1));
 	parser.save_options();
 
+	if(NENVS>1 && !parser("-shared").asBool())
+	{
+		printf("Several environments (-nenvs %d) need a shared policy (-shared 1)!\n", NENVS);
+		abort();
+	}
+
+	for(int i=0; i<NENVS; i++)
+	{
+		char buf[100];
+		sprintf(buf, "commondump_%04d", i);
+		dumpNames.push_back((NENVS==1) ? string() : string(buf));
+	}
+
 	assert( SAVEFREQ >= 0.0 );
 	assert( XPOS>=0.0 && XPOS<=1.0 );
 	assert( YPOS>=0.0 && YPOS<=1.0 );
@@ -53,27 +91,31 @@ void RL_TestTabular::_refresh()
 
 void RL_TestTabular::_prepareAgents()
 {
-	assert(agent==NULL);
+	assert(envs.empty());
 
-	map< string, vector<RL_Agent *> > shapesMap;
+	// every environment gets its own stream of initial conditions and agent seeds
 	RL_ObjectFactory factory(CHARLENGTH, XPOS, YPOS);
-	factory.create(parser,shapesMap,&policy);
-	agent = new RL_AgentVector(parser,shapesMap);
+	for(int i=0; i<NENVS; i++)
+	{
+		map< string, vector<RL_Agent *> > shapesMap;
+		factory.create(parser,shapesMap,&policy,1+rng.rand_int31());
+		envs.push_back(new RL_AgentVector(parser,shapesMap));
+	}
 
-	assert(agent!=NULL);
+	// the policy is shared, the first environment restarts it for all
+	envs[0]->restartPolicy();
 
-	agent->restartPolicy();
+	RL_QLearning * const qlearning = dynamic_cast<RL_QLearning *>(policy);
+	if(qlearning!=NULL)
+		qlearning->setDeterministic(parser("-deterministic").asBool(true));
 }
 
 void RL_TestTabular::_dispose()
 {
-	if(agent!=NULL)
-	{
-		delete agent;
-		agent = NULL;
-	}
+	for(vector<RL_AgentVector *>::iterator it=envs.begin(); it!=envs.end(); ++it)
+		delete (*it);
 
-	assert(agent==NULL);
+	envs.clear();
 
 	if(policy!=NULL)
 	{
@@ -86,7 +128,7 @@ void RL_TestTabular::_dispose()
 
 void RL_TestTabular::_save()
 {
-	agent->savePolicy();
+	envs[0]->savePolicy();
 	printf("Policies saved successfully!\n");
 }
 
@@ -101,7 +143,7 @@ void RL_TestTabular::_paint()
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	glPushAttrib(GL_ENABLE_BIT);
-	agent->paint();
+	envs[0]->paint();
 	glPopAttrib();
 
 	glutSwapBuffers();
@@ -159,10 +201,10 @@ void RL_TestTabular::run()
 	FotoCamera foto;
 #endif
 
-	// Retrieve number of gluttons
-	RL_AgentVector * b = static_cast<RL_AgentVector*>(agent);
+	// Retrieve number of gluttons, in all the environments
+	RL_AgentVector * b = envs[0];
 	map< string, vector<RL_Agent *> >::iterator itmap = b->data.find("RL_SmartyGlutton");
-	const long unsigned int ngluttons = (itmap!=b->data.end())?itmap->second.size():0;
+	const long unsigned int ngluttons = (itmap!=b->data.end())?NENVS*itmap->second.size():0;
 	const long unsigned int totNumPolicyEval = 1e15;
 	const long unsigned int nplays = (ngluttons==0)?totNumPolicyEval:((int)ceil((Real)totNumPolicyEval/(Real)ngluttons));
 
@@ -172,24 +214,32 @@ void RL_TestTabular::run()
 	long unsigned int step_id = 0;
 	while(true)
 	{
-		// Choose an action
+		// Choose an action, environment after environment since the policy is shared
 		profiler.push_start("CHOOSE");
-		const bool valid = agent->choose(t);
-		profiler.pop_stop();
-		if(!valid){ printf("NON VALID: REFRESH!\n"); agent->savePolicy(); _refresh(); continue; }
-
-		// Update agents
-		profiler.push_start("UPDATE");
-		agent->update(dt,t);
+		bool valid = true;
+		for(vector<RL_AgentVector *>::iterator it=envs.begin(); it!=envs.end(); ++it)
+			valid &= (*it)->choose(t);
 		profiler.pop_stop();
+		if(!valid){ printf("NON VALID: REFRESH!\n"); envs[0]->savePolicy(); _refresh(); continue; }
 
-		// Compute rewards
-		profiler.push_start("REWARD");
-		agent->reward(t);
+		// Update agents and compute rewards, all the environments concurrently
+		profiler.push_start("UPDATE-REWARD");
+		TBB_update_envs tbb_update_envs(dt,t,envs,dumpNames);
+		tbb::parallel_for(tbb::blocked_range<size_t>(0,envs.size(),1), tbb_update_envs, tbb::auto_partitioner());
 		profiler.pop_stop();
 
+		// Learn: the shared policy holds the samples started by all the environments, they all hand
+		// their rewards and end states before the first update consumes the whole batch
 		profiler.push_start("LEARN");
-		agent->learn(t);
+		if(NENVS==1)
+			envs[0]->learn(t);
+		else
+		{
+			for(vector<RL_AgentVector *>::iterator it=envs.begin(); it!=envs.end(); ++it)
+				(*it)->collect(t);
+			for(vector<RL_AgentVector *>::iterator it=envs.begin(); it!=envs.end(); ++it)
+				(*it)->learnCollected(t);
+		}
 		profiler.pop_stop();
 
 		if(step_id % SAVEFREQ == 0)
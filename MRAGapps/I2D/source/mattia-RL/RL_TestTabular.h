@@ -7,6 +7,8 @@
 #include "FieldViewer.h"
 #include "RL_TabularPolicy.h"
 #include "RL_Agent.h"
+#include "RL_AgentVector.h"
+#include "rng.h"
 
 namespace RL
 {
@@ -17,12 +19,17 @@ protected:
 	Real CHARLENGTH, XPOS, YPOS;
 	bool RESTART;
 	int SAVEFREQ;
+	int NENVS;
 
 	MRAG::ArgumentParser parser;
 	RL_TabularPolicy * policy;
-	RL_Agent * agent;
 	MRAG::Profiler profiler;
 
+	// independent instances of the environment, all learning the same (shared) policy
+	vector<RL_AgentVector *> envs;
+	vector<string> dumpNames;
+	RNG rng;
+
 	void _save();
 	void _dispose();
 	void _refresh();
@@ -1,5 +1,6 @@
 #include "RL_Environment.h"
 #include "RL_TestTabular.h"
+#include "RL_TestQLearning.h"
 
 #ifdef _RL_VIZ
 #ifdef __APPLE__
@@ -71,6 +72,8 @@ int main (int argc, const char ** argv)
 
 	if( parser("-study").asString() == "RL" )
 		test = new RL_TestTabular(argc, argv);
+	else if( parser("-study").asString() == "QLearning" )
+		test = new RL_TestQLearning(argc, argv);
 	else
 	{
 		printf("Study case not defined!\n");
@@ -58,6 +58,12 @@ public:
 	virtual void getVortices(vector <Vortex> &vortices){};
 	virtual void getNominalGammas(vector <Real> & nominalGammas){};
 	virtual void getTargets(vector <pair <Real,Real> > &targets, map < pair <Real,Real>, PF_Agent*> *targetsAgent = NULL){};
+	// appends the targets and, for each of them, the agent which receives its velocity
+	virtual void getTargets(vector <pair <Real,Real> > &targets, vector <PF_Agent*> &owners)
+	{
+		getTargets(targets);
+		owners.resize(targets.size(), this);
+	};
 	virtual void getForwardVelocities(vector <Real> &forwardVelocities){};
 	virtual void getTargetPoints(vector<pair<Real, Real> > &targetPoints){};
 
@@ -9,6 +9,7 @@
 
 #include <complex>
 #include <math.h>
+#include <assert.h>
 #include "tbb/parallel_for.h"
 #include "tbb/blocked_range.h"
 #include "PF_AgentVector.h"
@@ -321,25 +322,38 @@ void PF_AgentVector::learn(const Real time, map < string, vector <PF_Agent*> > *
 	}
 	else
 	{
-		// Set reward SERIAL
-		for( vector<PF_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
-			(*it)->setReward(time);
+		collect(time);
+		learnCollected(time);
+	}
+}
 
-		// Map end state PARALLEL
-		TBB_map_test tbb_map_test(time,agents,&agentCollection);
-		tbb::parallel_for(tbb::blocked_range<size_t>(0,agents.size()), tbb_map_test, tbb::auto_partitioner());
+void PF_AgentVector::collect(const Real time)
+{
+	assert(shared);
 
-		// Stop test SERIAL
-		for( vector<PF_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
-			(*it)->stopTest(time,&agentCollection);
+	// Set reward SERIAL
+	for( vector<PF_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
+		(*it)->setReward(time);
 
-		// Learn SERIAL
-		unsigned int counter = 0;
-		for( vector<PF_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
-		{
-			(*it)->learn(time,&agentCollection,name_learning[counter]);
-			counter++;
-		}
+	// Map end state PARALLEL
+	TBB_map_test tbb_map_test(time,agents,&agentCollection);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0,agents.size()), tbb_map_test, tbb::auto_partitioner());
+
+	// Stop test SERIAL
+	for( vector<PF_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
+		(*it)->stopTest(time,&agentCollection);
+}
+
+void PF_AgentVector::learnCollected(const Real time)
+{
+	assert(shared);
+
+	// Learn SERIAL, in the agents order
+	unsigned int counter = 0;
+	for( vector<PF_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
+	{
+		(*it)->learn(time,&agentCollection,name_learning[counter]);
+		counter++;
 	}
 }
 
@@ -477,6 +491,15 @@ void PF_AgentVector::getTargets(vector <pair <Real,Real> > &targets, map < pair
 	}
 }
 
+void PF_AgentVector::getTargets(vector <pair <Real,Real> > &targets, vector <PF_Agent*> &owners)
+{
+	targets.clear();
+	owners.clear();
+
+	for( vector<PF_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
+		(*it)->getTargets(targets, owners);
+}
+
 void PF_AgentVector::getForwardVelocities(vector <Real> &forwardVelocities)
 {
 	forwardVelocities.clear();
@@ -499,6 +522,13 @@ void PF_AgentVector::getErrorValues(vector<Real> &errors)
 		(*it)->getErrorValues(errors);
 }
 
+void PF_AgentVector::getAveraged(vector<bool> &averaged)
+{
+	averaged.clear();
+	for (vector<PF_Agent *>::iterator it = agents.begin(); it != agents.end(); ++it)
+		averaged.push_back((*it)->isAveraged);
+}
+
 void PF_AgentVector::getTargetPoints(vector<pair<Real, Real> > &targetPoints)
 {
 	for( vector<PF_Agent *>::iterator it = agents.begin(); it!=agents.end(); ++it)
@@ -6,6 +6,8 @@
  *  Copyright 2012 __MyCompanyName__. All rights reserved.
  *
  */
+#pragma once
+
 #include <vector>
 #include "PF_Agent.h"
 
@@ -30,6 +32,7 @@ public:
 	void getVortices(vector <Vortex> &vortices);
 	void getNominalGammas(vector <Real> & nominalGammas);
 	void getTargets(vector <pair <Real,Real> > &targets, map < pair <Real,Real>, PF_Agent*> *targetsAgent = NULL);
+	void getTargets(vector <pair <Real,Real> > &targets, vector <PF_Agent*> &owners);
 	void getForwardVelocities(vector <Real> &forwardVelocities);
 	void getTargetPoints(vector<pair<Real, Real> > &targetPoints);
 
@@ -37,12 +40,19 @@ public:
 
 	void getFitnessValues(vector<Real> &fitnesses);
 	void getErrorValues(vector<Real> &errors);
+	void getAveraged(vector<bool> &averaged);
 
 	bool choose(const Real time, map < string, vector <PF_Agent*> > *collection = NULL);
 	void reward(const Real time, map < string, vector <PF_Agent*> > *collection = NULL);
 	void fitness();
 	void error();
 	void learn(const Real time, map < string, vector <PF_Agent*> > *collection = NULL, string filename = string());
+
+	// The two halves of learn() with a shared policy: collect() hands the rewards and end states
+	// of the agents to the policy, learnCollected() updates it with all the samples handed so far.
+	// Several vectors sharing a policy collect first, then learn (see PF_Solver::run).
+	void collect(const Real time);
+	void learnCollected(const Real time);
 	void savePolicy(string name = string());
 	void restartPolicy(string name = string());
 	void resetToInitialCondition();
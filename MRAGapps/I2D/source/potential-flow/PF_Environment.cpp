@@ -0,0 +1,566 @@
+/*
+ *  PF_Environment.cpp
+ *  DipoleCode
+ *
+ *  One school simulated by PF_Solver, split out of the solver so that
+ *  several of them can learn the same policy side by side.
+ *
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include "PF_Environment.h"
+#include "PF_ObjectFactory.h"
+
+using namespace PF;
+
+PF_Environment::PF_Environment(MRAG::ArgumentParser & parser, const Real charLength, const Real xpos, const Real ypos, RL::RL_TabularPolicy ** policy, const unsigned long seed, const string suffix, const bool sharesPolicy) :
+		parser(parser), policy(policy), seeds(seed), suffix(suffix), sharesPolicy(sharesPolicy), CHARLENGTH(charLength), XPOS(xpos), YPOS(ypos), collection(NULL), vortexVelocity(NULL), unitVelocity(0.0)
+{
+	parser.set_strict_mode();
+
+	ISCONTROLLED = parser("-isControlled").asBool();
+	SMOOTH = parser("-smooth").asBool();
+	LEARNINGTIME = parser("-learningTime").asDouble();
+	FITNESSTIME = parser("-fitnessTime").asDouble();
+	FITNESSBUFFER = parser("-fitnessBuffer").asDouble();
+	NAVG = parser("-navg").asInt();
+	NLEARNINGLEVELS = parser("-nLearningLevels").asInt();
+	LR = parser("-lr").asDouble();
+	GREEDYEPS = parser("-greedyEps").asDouble();
+
+	parser.unset_strict_mode();
+	FITSELECT = parser("-fitselection").asInt();
+	if (FITSELECT == 0) FITSELECT = 1;
+
+	// the velocity evaluator keeps its particles between calls, one per environment
+	const Real vortexTheta = parser("-vortexTheta").asDouble(0.5);
+	const int vortexDirectMax = parser("-vortexDirectMax").asInt(512);
+	vortexVelocity = new PF_VortexVelocity(vortexTheta, vortexDirectMax);
+
+	// Initialize counters
+	nTimesLearned = 0;
+	nTimesAveraged = 0;
+	nTeribleRefreshes = 0;
+	nCompletedAveraging = 0;
+	nAveragingScrewUps = 0;
+	timeAtLastValidRefresh = 0.0;
+	timeAtLastNonValidRefresh = 0.0;
+
+	// Initialize values
+	currentFitness = 0;
+	crashPenalty = 0;
+	penaltyForBeingTooClose = 0.0;
+	isUsingSoftReset = true;
+	isFinished = false;
+	solverState = learning;
+
+	prepareAgents();
+
+	avgFitness = vector<double>(collection->numberOfAgents(), 0.0);
+	currentIndividualFitness = vector<double>(collection->numberOfAgents(), 0.0);
+}
+
+PF_Environment::~PF_Environment()
+{
+	dispose();
+
+	delete vortexVelocity;
+}
+
+/**
+ * Prepare agents from the factory file, with the next seed of this environment.
+ */
+void PF_Environment::prepareAgents()
+{
+	assert(collection==NULL);
+
+	individualFitnessesInWindow.clear();
+	timeInWindow.clear();
+	timeStepsInWindow.clear();
+
+	map<string, vector<PF_Agent*> > shapesMap;
+	PF_ObjectFactory factory(CHARLENGTH, XPOS, YPOS);
+	factory.create(parser, shapesMap, LR, GREEDYEPS, policy, 1 + seeds.rand_int31());
+
+	collection = new PF_AgentVector(parser, LR, GREEDYEPS, SMOOTH, ISCONTROLLED, shapesMap);
+	assert(collection!=NULL);
+
+	unitVelocity = factory.getUnitVelocity();
+}
+
+/**
+ * Delete the agents, the last agent holding the shared policy deletes it.
+ */
+void PF_Environment::dispose()
+{
+	if (collection != NULL)
+	{
+		delete collection;
+		collection = NULL;
+	}
+	assert(collection==NULL);
+}
+
+void PF_Environment::_softRefresh()
+{
+	individualFitnessesInWindow.clear();
+	timeInWindow.clear();
+	timeStepsInWindow.clear();
+
+	collection->resetToInitialCondition();
+}
+
+/**
+ * Output files of environments running side by side get the environment number before the extension.
+ */
+string PF_Environment::_name(const char * base) const
+{
+	const string name(base);
+	const size_t dot = name.find('.');
+
+	if (dot == string::npos) return name + suffix;
+	return name.substr(0, dot) + suffix + name.substr(dot);
+}
+
+/**
+ * Compute the velocity of all agents.
+ */
+void PF_Environment::computeVelocity()
+{
+	vector<complex<Real> > velocities;
+	vector<pair<Real, Real> > targets;
+	vector<PF_Agent*> targetsAgent;
+	vector<Vortex> vortices;
+
+	collection->getVortices(vortices);
+	collection->getTargets(targets, targetsAgent);
+
+	/// beware, these are conjugate velocities
+	vortexVelocity->compute(vortices, targets, velocities);
+
+	for (int n = 0; n < (int) targets.size(); n++)
+		targetsAgent[n]->setVelocity(velocities[n]);
+}
+
+/**
+ * Set the time step based on minimum separation.
+ *
+ * @return
+ */
+double PF_Environment::setTimeStep()
+{
+	// Create positions-agents map
+	vector<pair<Real, Real> > position;
+	map<pair<Real, Real>, PF_Agent*> positionAgent;
+	collection->storePosition(position, &positionAgent);
+
+	//	const Real dtMax(1e-3);
+	const Real dtMax = 0.005 / unitVelocity;
+	const Real dtMin = 5e-4 / unitVelocity ;
+	const Real DMIN = CHARLENGTH / 2.0 / (2 * sqrt(2 * M_PI));
+	const Real DMAX = 2.0 * CHARLENGTH / (2 * sqrt(2 * M_PI));
+
+	vector<pair<Real, Real> > storeIndex;
+	pair<Real, Real> coord;
+
+	int size = position.size();
+	Real minDist = numeric_limits<Real>::max();
+	for (int n = 0; n < size - 1; n++)
+	{
+		Real x1 = position[n].first;
+		Real y1 = position[n].second;
+		for (int s = n + 1; s < size; s++)
+		{
+			Real x2 = position[s].first;
+			Real y2 = position[s].second;
+			Real dist = sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2));
+			if (dist < minDist)
+			{
+				storeIndex.clear();
+				minDist = dist;
+				coord.first = x1;
+				coord.second = y1;
+				storeIndex.push_back(coord);
+				coord.first = x2;
+				coord.second = y2;
+				storeIndex.push_back(coord);
+			}
+		}
+	}
+
+	double dt = max(dtMin, min(dtMax, max((Real) 0, minDist - DMIN) * (dtMax - dtMin) / (DMAX - DMIN)));
+
+	if ((Real) dt == dtMin)
+		for (vector<pair<Real, Real> >::iterator it = storeIndex.begin(); it != storeIndex.end(); ++it)
+		{
+			PF_Agent *agent = positionAgent[*it];
+			agent->reachedDtMin();
+		}
+
+	dt = dtMax;
+	return (dt);
+}
+
+/**
+ * Save the agents data and the last time where we are able restart time.
+ *
+ * @param time
+ */
+void PF_Environment::save(double time)
+{
+	collection->saveData(time);
+
+	// Save time as well
+	ofstream out(_name("RestartTime.txt").c_str(), ios::out | ios::trunc);
+	out.precision(10);
+	out << time << " ";
+	out << nTimesLearned;
+	out.close();
+}
+
+/**
+ * Save all resets (different from restarts).
+ * @param time
+ */
+void PF_Environment::saveResetTime(double time)
+{
+	FILE* fid;
+	fid = fopen(_name("resets.txt").c_str(), "a");
+	fprintf(fid, "%e\n", time);
+	fclose(fid);
+}
+
+/**
+ * Fitness reported for this environment once it is done averaging.
+ */
+Real PF_Environment::finalFitness() const
+{
+	return currentFitness + (double)(NAVG - nCompletedAveraging) + penaltyForBeingTooClose;
+}
+
+bool PF_Environment::checkStatus(double time)
+{
+	if (isFinished) return false;
+
+	// LEARNING STATE
+	if (nTimesLearned < NLEARNINGLEVELS)
+	{
+		solverState = learning;
+
+		if (time - timeAtLastValidRefresh > LEARNINGTIME)
+		{
+			nTimesLearned++;
+			saveResetTime(time);
+			timeAtLastValidRefresh = time;
+
+			if ((nTimesLearned == NLEARNINGLEVELS))
+			{
+				LR = 0.0;
+				GREEDYEPS = 0.0;
+			}
+			else
+			{
+				LR /= 2.0;
+				GREEDYEPS /= 2.0;
+			}
+
+			printf("** Finished learning stage %d/%d. New values for LR = %e, GREEDYEPS = %e, LEARNINGTIME = %0.2f.\n", nTimesLearned, NLEARNINGLEVELS, LR, GREEDYEPS, LEARNINGTIME);
+
+			return true; // hard refresh, the policy is recreated with the new schedule
+		}
+	}
+
+	// AVERAGING STATE
+	else if (nTimesAveraged < NAVG && ISCONTROLLED)
+	{
+		LR = 0.0;
+		GREEDYEPS = 0.0;
+		solverState = averaging;
+
+		if (time - timeAtLastValidRefresh > FITNESSTIME * FITNESSBUFFER) // finished with one averaging run, save fitness
+		{
+			computeTimeAveragedFitness(time);
+
+			currentFitness = (nCompletedAveraging * currentFitness + timeAveragedSchoolFitness) / (nCompletedAveraging + 1); // running average
+			crashPenalty = nAveragingScrewUps;
+
+			// Write fitness (overwrite, one number)
+			FILE* fid;
+			fid = fopen(_name("fitness").c_str(), "w");
+			fprintf(fid, "%e \n", currentFitness + (double)crashPenalty + penaltyForBeingTooClose);
+			fclose(fid);
+
+			// Calculate fitness using another way and print history to a file
+			Real sum = 0.0;
+			currentFitnesses.push_back(timeAveragedSchoolFitness);
+			const int nAveragesSoFar = currentFitnesses.size();
+			for (int i = 0; i < nAveragesSoFar; ++i)
+			{
+				sum += currentFitnesses[i];
+			}
+			const Real thisAverage = sum / nAveragesSoFar;
+
+			Real sigma = 0;
+			Real sigmasum = 0;
+			for (int i = 0; i < nAveragesSoFar; ++i)
+			{
+				sigmasum += (currentFitnesses[i] - thisAverage) * (currentFitnesses[i] - thisAverage);
+			}
+			sigma = sqrt(sigmasum / nAveragesSoFar);
+
+			// Write fitness history
+			fid = fopen(_name("fitnessStatsHistory").c_str(), "a");
+			fprintf(fid, "%d %e %e\n", nAveragesSoFar, thisAverage, sigma);
+			fclose(fid);
+
+			// Calculate individual fitness and write to a single file
+			const int n = avgFitness.size();
+			vector<pair<Real, Real> > coordinates;
+			collection->getCoordinates(coordinates);
+
+			fid = fopen(_name("individualFitnesses").c_str(), "w");
+			for (int i = 0; i < n; ++i)
+			{
+				currentIndividualFitness[i] = (nCompletedAveraging * currentIndividualFitness[i] + avgFitness[i]) / (nCompletedAveraging + 1); // running average
+				fprintf(fid, "%e %e %e\n", coordinates[i].first, coordinates[i].second, currentIndividualFitness[i]);
+			}
+			fclose(fid);
+
+			// Calculate individual fitness statistics
+			fid = fopen(_name("individualFitnessStatsHistory").c_str(), "a");
+			currentIndividualFitnesses.push_back(avgFitness);
+			fprintf(fid, "** Average %d\n", nAveragesSoFar);
+			for (int j = 0; j < n; j++)
+			{
+				Real sum = 0.0;
+				for (int i = 0; i < nAveragesSoFar; ++i)
+				{
+					const vector<double> &fitnessForThisSet = currentIndividualFitnesses[i];
+					sum += fitnessForThisSet[j];
+				}
+
+				Real thisAverage = sum / nAveragesSoFar;
+				Real sigma = 0;
+				Real sigmasum = 0;
+				for (int i = 0; i < nAveragesSoFar; ++i)
+				{
+					sigmasum += (currentFitnesses[i] - thisAverage) * (currentFitnesses[i] - thisAverage);
+				}
+				sigma = sqrt(sigmasum / nAveragesSoFar);
+				fprintf(fid, "%e %e %e %e\n", coordinates[j].first, coordinates[j].second, thisAverage, sigma);
+			}
+			fclose(fid);
+
+			saveResetTime(time);
+			timeAtLastValidRefresh = time;
+
+			nTimesAveraged++;
+			nCompletedAveraging++;
+
+			printf("** Finished averaging completely %d times (out of %d, NAVG = %d).\n", nCompletedAveraging, nTimesAveraged, NAVG);
+			printf("** Screwed up %d times so far (out of %d, NAVG = %d) \n", nAveragingScrewUps, nTimesAveraged, NAVG);
+			printf("** LR = %e. FITNESSTIME = %0.2f, FITNESSBUFFER = %0.2f.\n", LR, FITNESSTIME, FITNESSBUFFER);
+			printf("** currentFitness = %e, crashPenalty = %e, penaltyForBeingTooClose = %e.\n", currentFitness, (double)crashPenalty, penaltyForBeingTooClose);
+			printf("** currentFitnessCheck = %e.\n", thisAverage);
+			printf("** USING FITNESS %d!!! \n", FITSELECT);
+
+			// hard resets here, unless other environments are still learning from the same policy
+			if (!sharesPolicy) return true;
+			_softRefresh();
+		}
+	}
+
+	// EXIT STATES
+	else if (!ISCONTROLLED) abort();
+
+	else if (nTimesAveraged >= NAVG)
+	{
+		printf("** Environment%s reached expected sim time %e\n", suffix.c_str(), time);
+		// Write fitness (overwrite, one number)
+		crashPenalty = NAVG - nCompletedAveraging;
+		FILE* fid;
+		fid = fopen(_name("fitness").c_str(), "w");
+		fprintf(fid, "%e \n", currentFitness + (double)crashPenalty + penaltyForBeingTooClose);
+		fclose(fid);
+		isFinished = true;
+	}
+
+	return false;
+}
+
+bool PF_Environment::checkStatusPostAction(double time, double dt, bool valid)
+{
+	if (ISCONTROLLED)
+	{
+		if (!valid || dt <= 1e-4) // || time step is too small -> probably collision
+		{
+			if (solverState == averaging && !isFinished)
+			{
+				nTimesAveraged++;
+				nAveragingScrewUps++;
+				saveResetTime(time);
+				timeAtLastValidRefresh = time;
+				printf("** WARNING: Screwed up %d times so far (out of %d, NAVG = %d) \n", nAveragingScrewUps, nTimesAveraged, NAVG);
+			}
+
+			printf("** NON VALID: Refresh at t = %e using %s.\n", time, isUsingSoftReset ? "soft resets" : "hard resets");
+
+			// CHECK IF CRASHING TOO MUCH
+			if (solverState == learning)
+			{
+				const int nMaxTerribleRefresh = 500;
+				const double minTimeBetweenRefresh = 10.0/unitVelocity;
+
+				if (time - timeAtLastNonValidRefresh < minTimeBetweenRefresh)
+				{
+					nTeribleRefreshes++;
+					printf("** That is %d terrible refreshes with minTimeBetweenRefresh = %0.4f\n", nTeribleRefreshes, minTimeBetweenRefresh);
+				}
+
+				if (nTeribleRefreshes == nMaxTerribleRefresh)
+				{
+					printf("** Reached nMaxTerribleRefresh = %d. Agents are probably close given the decision making time.\n", nMaxTerribleRefresh);
+					FILE* fid;
+					fid = fopen("fitness", "w");
+					fprintf(fid, "%e \n", 1e8 - time); // CAN'T LEARN AT ALL -> ABORT (subtract time to rank better, if the simulation goes longer = better)
+					fclose(fid);
+					abort();
+				}
+			}
+
+			timeAtLastNonValidRefresh = time;
+
+			if (isUsingSoftReset || sharesPolicy) // to reduce dumping to files
+			{
+				_softRefresh();
+			}
+			else
+			{
+				saveResetTime(time);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void PF_Environment::computeTooClosePenalty()
+{
+	const Real distanceFactor = 1.0;
+	const Real minDist = distanceFactor * CHARLENGTH;
+	const Real penalizationFactor = 0.0;
+	Real penalty = 0.0;
+
+	vector<pair<Real, Real> > points;
+	collection->getCoordinates(points);
+
+	const int n = points.size();
+	for (int i = 0; i < n; i++)
+	{
+		const Real xi = points[i].first;
+		const Real yi = points[i].second;
+
+		for (int j = i + 1; j < n; j++) // only count the upper corner
+		{
+			const Real xj = points[j].first;
+			const Real yj = points[j].second;
+			const Real dist = (xi - xj) * (xi - xj) + (yi - yj) * (yi - yj);
+
+			if (dist < minDist * minDist)
+				penalty += penalizationFactor * CHARLENGTH * CHARLENGTH / dist;
+		}
+	}
+
+	penaltyForBeingTooClose = penalty;
+	printf("** Penalty for being too close = %e.\n", penaltyForBeingTooClose);
+}
+
+/**
+ *
+ * @param time
+ * @param dt
+ */
+void PF_Environment::computeFitness(double time, double dt)
+{
+	collection->fitness();
+
+	if (solverState == averaging) // Start saving fitnesses in deque if averaging
+	{
+		// Get all fitnesses
+		vector<Real> allFitnesses;
+		collection->getFitnessValues(allFitnesses);
+
+		// Add to deques
+		individualFitnessesInWindow.push_back(allFitnesses);
+		timeInWindow.push_back(time);
+		timeStepsInWindow.push_back(dt);
+
+		// Check if front of deque is outside window, if yes, pop off
+		while (time - timeInWindow.front() > FITNESSTIME)
+		{
+			individualFitnessesInWindow.pop_front();
+			timeInWindow.pop_front();
+			timeStepsInWindow.pop_front();
+		}
+	}
+}
+
+void PF_Environment::computeTimeAveragedFitness(double time)
+{
+	// Count the number of guys that you want to average
+	const double actualWindow = timeInWindow.back() - timeInWindow.front();
+	const int n = collection->numberOfAgents();
+
+	for (int i = 0; i < (int)individualFitnessesInWindow.size(); i++)
+	{
+		const vector<Real> fitnessHere = individualFitnessesInWindow[i];
+
+		for (int j = 0; j < n; j++)
+		{
+			avgFitness[j] += fitnessHere[j]*timeStepsInWindow[i];
+		}
+	}
+
+	vector<bool> averaged;
+	collection->getAveraged(averaged);
+
+	int nInAverage = n;
+	Real avgSchoolFitness = 0.0;
+	for (int i = 0; i < n; i++)
+	{
+		avgFitness[i] /= actualWindow;
+
+		if (averaged[i] == true)
+		{
+			avgSchoolFitness += avgFitness[i];
+		}
+		else
+		{
+			nInAverage--;
+		}
+	}
+	avgSchoolFitness /= nInAverage;
+	timeAveragedSchoolFitness = avgSchoolFitness;
+}
+
+void PF_Environment::computeError(double time)
+{
+	vector<Real> errors;
+	collection->error();
+	collection->getErrorValues(errors);
+
+	// Compute average
+	schoolError = accumulate(errors.begin(), errors.end(), 0.0);
+	schoolError /= collection->numberOfAgents();
+
+	FILE *fid;
+	fid = fopen(_name("error.txt").c_str(), "a");
+	fprintf(fid, "%e %e \n", time, schoolError);
+	fclose(fid);
+}
@@ -0,0 +1,102 @@
+/*
+ *  PF_Environment.h
+ *  DipoleCode
+ *
+ *  One school simulated by PF_Solver: the agents, their refresh state,
+ *  fitness windows and learning schedule. Several environments can run
+ *  side by side, all learning the same (shared) policy.
+ *
+ */
+#pragma once
+
+#include <deque>
+#include <string>
+#include "RL_Environment.h"
+#include "RL_TabularPolicy.h"
+#include "rng.h"
+#include "PF_Agent.h"
+#include "PF_AgentVector.h"
+#include "PF_VortexVelocity.h"
+
+namespace PF
+{
+
+class PF_Environment
+{
+public:
+	enum
+	{
+		learning, averaging
+	} solverState;
+
+	PF_AgentVector * collection;
+	PF_VortexVelocity * vortexVelocity;
+	Real unitVelocity;
+	Real LR;
+	Real GREEDYEPS;
+	int nTimesLearned;
+	bool isFinished;
+
+	PF_Environment(MRAG::ArgumentParser & parser, const Real charLength, const Real xpos, const Real ypos, RL::RL_TabularPolicy ** policy, const unsigned long seed, const string suffix, const bool sharesPolicy);
+	~PF_Environment();
+
+	void prepareAgents();
+	void dispose();
+
+	double setTimeStep();
+	void computeVelocity();
+	void computeFitness(double time, double dt);
+	void computeTimeAveragedFitness(double time);
+	void computeError(double time);
+	void computeTooClosePenalty();
+	void save(double time);
+	void saveResetTime(double time);
+	Real finalFitness() const;
+
+	// both return true when this environment must be hard refreshed, the shared policy is then saved and recreated
+	bool checkStatus(double time);
+	bool checkStatusPostAction(double time, double dt, bool valid);
+
+private:
+	MRAG::ArgumentParser & parser;
+	RL::RL_TabularPolicy ** policy;
+	RNG seeds;
+	const string suffix;
+	const bool sharesPolicy;
+
+	Real CHARLENGTH, XPOS, YPOS;
+	bool ISCONTROLLED; /// if any of the agents are controlled by learning
+	bool SMOOTH;
+	Real LEARNINGTIME; /// amount of time given to all agents to initially learn a 'good' policy
+	Real FITNESSTIME; /// amount of time given to average fitness function over
+	Real FITNESSBUFFER; /// take (FINTESSBUFFER - 1)% longer to get rid of transient after a refresh
+	int NAVG; /// number of final FITNESSTIME runs to average over
+	int NLEARNINGLEVELS;
+	int FITSELECT;
+
+	bool isUsingSoftReset;
+	int nTimesAveraged;
+	int nCompletedAveraging;
+	int nTeribleRefreshes;
+	int nAveragingScrewUps;
+	int crashPenalty; // a measure of robustness of the formation + policy
+	double timeAtLastValidRefresh;
+	double timeAtLastNonValidRefresh;
+	Real timeAveragedSchoolFitness;
+	Real currentFitness;
+	Real schoolError;
+	Real penaltyForBeingTooClose;
+	deque<vector<Real> > individualFitnessesInWindow;
+	deque<double> timeInWindow;
+	deque<double> timeStepsInWindow;
+
+	vector<Real> currentFitnesses;
+	vector<vector<double> > currentIndividualFitnesses;
+	vector<double> avgFitness;
+	vector<double> currentIndividualFitness;
+
+	void _softRefresh();
+	string _name(const char * base) const;
+};
+
+} /*namespace PF*/
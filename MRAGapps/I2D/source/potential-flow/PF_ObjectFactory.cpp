@@ -71,7 +71,7 @@ Real PF_ObjectFactory::getUnitVelocity()
 	return unitVelocity;
 }
 
-void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<PF_Agent *> >& shapesMap, const Real lr, const Real greedyEps, RL::RL_TabularPolicy ** policy)
+void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<PF_Agent *> >& shapesMap, const Real lr, const Real greedyEps, RL::RL_TabularPolicy ** policy, const unsigned long seed)
 {
 	shapesMap.clear();
 
@@ -92,15 +92,14 @@ void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<
 	assert(GAMMA>=0.0 && GAMMA<=1.0);
 	assert((GREEDYEPS>=0.0 && GREEDYEPS<=1.0));
 
-	srand(time(NULL));
-//	srand ( 100 );
-
-	RNG rng(rand());
+	// one stream per call: environments created within the same second must not be identical
+	RNG seeds((seed != 0) ? seed : (unsigned long) time(NULL));
 
 	// Count number of shapes
 	const int N = _lines(factoryFile);
 
-	if (SHARED) if (LR >= 0.0 && LR <= 1.0 && GAMMA >= 0.0 && GAMMA <= 1.0 && GREEDYEPS >= 0.0 && GREEDYEPS <= 1.0) (*policy) = new RL::RL_QLearning((double) LR, (double) GAMMA, (double) GREEDYEPS, rand(), learnDump);
+	// environments sharing the policy are created with the same policy pointer
+	if (SHARED && (*policy) == NULL) if (LR >= 0.0 && LR <= 1.0 && GAMMA >= 0.0 && GAMMA <= 1.0 && GREEDYEPS >= 0.0 && GREEDYEPS <= 1.0) (*policy) = new RL::RL_QLearning((double) LR, (double) GAMMA, (double) GREEDYEPS, seeds.rand_int31(), learnDump);
 
 	// Open factory file and retrieve information
 	FILE * ppFile;
@@ -214,7 +213,7 @@ void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<
 			fscanf(ppFile, " T=%f", &variable);
 			const Real T = variable;
 
-			PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, rand());
+			PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, seeds.rand_int31());
 
 			map<string, vector<PF_Agent*> >::iterator it = shapesMap.find(name);
 
@@ -255,7 +254,7 @@ void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<
 			fscanf(ppFile, " T=%f", &variable);
 			const Real T = variable;
 
-			PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, rand());
+			PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, seeds.rand_int31());
 
 			map<string, vector<PF_Agent*> >::iterator it = shapesMap.find(name);
 
@@ -297,7 +296,7 @@ void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<
 			fscanf(ppFile, " T=%f", &variable);
 			const Real T = variable;
 
-			PF_DipoleEight * object = new PF_DipoleEight(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, T, counterID, policy, rand());
+			PF_DipoleEight * object = new PF_DipoleEight(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, T, counterID, policy, seeds.rand_int31());
 
 			map<string, vector<PF_Agent*> >::iterator it = shapesMap.find(name);
 
@@ -398,7 +397,7 @@ void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<
 				const complex<Real> location(xm, ym);
 				const Real dir[2] = { 0, 1 };
 
-				PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, rand());
+				PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, seeds.rand_int31());
 
 				if (isInterior[i] == false)
 					object->isAveraged = false;
@@ -505,7 +504,7 @@ void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<
 				const complex<Real> location(xm, ym);
 				const Real dir[2] = { 0, 1 };
 
-				PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, rand());
+				PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, seeds.rand_int31());
 
 				if (isInterior[i] == false) object->isAveraged = false;
 
@@ -612,7 +611,7 @@ void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<
 				const complex<Real> location(xm, ym);
 				const Real dir[2] = { 0, 1 };
 
-				PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, rand());
+				PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, seeds.rand_int31());
 
 				if (isInterior[i] == false) object->isAveraged = false;
 
@@ -715,7 +714,7 @@ void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<
 				const complex<Real> location(xm, ym);
 				const Real dir[2] = { 0, 1 };
 
-				PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, rand());
+				PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, seeds.rand_int31());
 
 				if (isInterior[i] == false) object->isAveraged = false;
 
@@ -843,7 +842,7 @@ void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<
 				const complex<Real> location(xm, ym);
 				const Real dir[2] = { 0, 1 };
 
-				PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, rand());
+				PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, seeds.rand_int31());
 
 				map<string, vector<PF_Agent *> >::iterator it = shapesMap.find(name);
 				if (it == shapesMap.end())
@@ -892,7 +891,7 @@ void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<
 					const complex<Real> location(xm, ym);
 					const Real dir[2] = { 0, 1 };
 
-					PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, rand());
+					PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, seeds.rand_int31());
 
 					map<string, vector<PF_Agent *> >::iterator it = shapesMap.find(name);
 					if (it == shapesMap.end())
@@ -940,7 +939,7 @@ void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<
 					const complex<Real> location(xm, ym);
 					const Real dir[2] = { 0, 1 };
 
-					PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, rand());
+					PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, seeds.rand_int31());
 
 					map<string, vector<PF_Agent *> >::iterator it = shapesMap.find(name);
 
@@ -1073,7 +1072,7 @@ void PF_ObjectFactory::create(MRAG::ArgumentParser & parser, map<string, vector<
 			{
 				const complex<Real> location = locations[j];
 
-				PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, rand());
+				PF_DipoleInline * object = new PF_DipoleInline(parser, d, v, radius, acc, location, dir, lr, greedyEps, SMOOTH, ISCONTROLLED, FITSELECT, T, counterID, policy, seeds.rand_int31());
 
 				map<string, vector<PF_Agent *> >::iterator it = shapesMap.find(name);
 
@@ -22,7 +22,7 @@ public:
 	PF_ObjectFactory(const Real charLength, const Real XCM, const Real YCM);
 	~PF_ObjectFactory(){};
 
-	void create(MRAG::ArgumentParser & parser, map< string, vector<PF_Agent*> >& shapesMap, const Real lr, const Real gamma, RL::RL_TabularPolicy ** policy = NULL);
+	void create(MRAG::ArgumentParser & parser, map< string, vector<PF_Agent*> >& shapesMap, const Real lr, const Real gamma, RL::RL_TabularPolicy ** policy = NULL, const unsigned long seed = 0);
 	Real getUnitVelocity();
 
 private:
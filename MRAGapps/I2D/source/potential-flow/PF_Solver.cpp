@@ -12,9 +12,10 @@
 #include <limits>
 #include <numeric>
 #include <algorithm>
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
 #include "RL_QLearning.h"
-#include "PF_AgentVector.h"
-#include "PF_ObjectFactory.h"
+#include "PF_Environment.h"
 #include "PF_Solver.h"
 //#include "PF_Tracer.h"
 
@@ -29,8 +30,36 @@
 
 using namespace PF;
 
+//opening angle of the default arguments of the mani-fmm2d evaluator: the potential flow does not
+//link I2D_FMMTypes.o, PF_VortexVelocity always passes its own theta
+double _THETA = 0.5;
+
+// the environments evolve and collect their rewards independently, only choosing and learning touch the shared policy
+struct TBB_update_envs
+{
+	double t,dt;
+	bool isControlled;
+	vector<PF_Environment *> & envs;
+
+	TBB_update_envs(double dt, double t, bool isControlled, vector<PF_Environment *> & envs): dt(dt),t(t),isControlled(isControlled),envs(envs)
+	{
+	}
+
+	void operator() ( const tbb::blocked_range<size_t> &r ) const
+	{
+		for (size_t i=r.begin(); i!=r.end();++i)
+		{
+			PF_Environment * env = envs[i];
+			env->computeVelocity();
+			env->collection->update(dt, t);
+			env->collection->updatePostVelocityUpdate(dt, t);
+			if (isControlled) env->collection->reward(t);
+		}
+	}
+};
+
 PF_Solver::PF_Solver(int argc, const char ** argv) :
-		parser(argc, argv), policy(NULL), collection(NULL), unitVelocity(0.0), ISLABFRAME(true), FITSELECT(1)
+		parser(argc, argv), policy(NULL), tracers(NULL), ISLABFRAME(true), stepOfLastPolicySave(-1), rng((unsigned long)time(NULL))
 {
 	// Parse input
 	parser.set_strict_mode();
@@ -41,25 +70,22 @@ PF_Solver::PF_Solver(int argc, const char ** argv) :
 	YPOS = parser("-ypos").asDouble();
 	CHARLENGTH = parser("-D").asDouble();
 	ISCONTROLLED = parser("-isControlled").asBool();
-	SMOOTH = parser("-smooth").asBool();
-	LEARNINGTIME = parser("-learningTime").asDouble();
 	FITNESSTIME = parser("-fitnessTime").asDouble();
 	FITNESSSAVEFREQ = parser("-fitnessSaveFreq").asInt();
 	FITNESSBUFFER = parser("-fitnessBuffer").asDouble();
-	NAVG = parser("-navg").asInt();
-	NLEARNINGLEVELS = parser("-nLearningLevels").asInt();
 	INDIVIDUALFITNESS = parser("-individualFitness").asBool();
-	LR = parser("-lr").asDouble();
-	GREEDYEPS = parser("-greedyEps").asDouble();
 
 	parser.unset_strict_mode();
-	FITSELECT = parser("-fitselection").asInt();
-	if (FITSELECT == 0) FITSELECT = 1;
 	ISLABFRAME = parser("-islabframe").asBool();
 	ISUSINGTRACERS = 0;
 	ISUSINGTRACERS = parser("-isUsingTracers").asBool();
+	NENVS = max(1, parser("-nenvs").asInt(1));
 
-	parser.save_options();
+	if (NENVS > 1 && !parser("-shared").asBool())
+	{
+		printf("** ABORTING: several environments (-nenvs %d) need a shared policy (-shared 1)!\n", NENVS);
+		abort();
+	}
 
 	// Write fitness (overwrite, one number)
 	FILE* fid;
@@ -67,55 +93,29 @@ PF_Solver::PF_Solver(int argc, const char ** argv) :
 	fprintf(fid, "%e \n", 1e10); // PARAMETERS OKAY -> BUILD INITIAL SCHOOL
 	fclose(fid);
 
-	// Decrease learning time at each level by half
-	totalLearningTime = 0.0;
-	for (int i = 0; i < NLEARNINGLEVELS; i++)
-		totalLearningTime += LEARNINGTIME/(pow(2.0,(double) i));
-
-	// Initialize counters
-	nTimesLearned = 0;
-	nTimesAveraged = 0;
-	nTeribleRefreshes = 0;
-	nCompletedAveraging = 0;
-	nAveragingScrewUps = 0;
-
-	// Initialize values
-	currentFitness = 0;
-	crashPenalty = 0;
-	penaltyForBeingTooClose = 0.0;
-	needsRefreshing = false;
-	isUsingSoftReset = true;
-
-	_prepareAgents();
+	// every environment gets its own stream of agent seeds, the first one creates the shared policy
+	for (int i = 0; i < NENVS; i++)
+	{
+		char suffix[100];
+		sprintf(suffix, "_%04d", i);
+		envs.push_back(new PF_Environment(parser, CHARLENGTH, XPOS, YPOS, &policy, 1 + rng.rand_int31(), (NENVS == 1) ? string() : string(suffix), NENVS > 1));
+	}
+
+	parser.save_options();
+
+	envs[0]->collection->restartPolicy();
 	//if (ISUSINGTRACERS) _prepareTracers();
 	_checkSettings();
-
-	avgFitness = vector<double>(collection->numberOfAgents(), 0.0);
-	currentIndividualFitness = vector<double>(collection->numberOfAgents(), 0.0);
 }
 
 PF_Solver::~PF_Solver()
 {
 	_dispose();
-}
 
-/**
- * Prepare agents from the factory file.
- */
-void PF_Solver::_prepareAgents()
-{
-	assert(collection==NULL);
-
-	map<string, vector<PF_Agent*> > shapesMap;
-	PF_ObjectFactory factory(CHARLENGTH, XPOS, YPOS);
-	factory.create(parser, shapesMap, LR, GREEDYEPS, &policy);
+	for (vector<PF_Environment *>::iterator it = envs.begin(); it != envs.end(); ++it)
+		delete (*it);
 
-	collection = new PF_AgentVector(parser, LR, GREEDYEPS, SMOOTH, ISCONTROLLED, shapesMap);
-
-	assert(collection!=NULL);
-	collection->restartPolicy();
-
-	unitVelocity = factory.getUnitVelocity();
+	envs.clear();
 }
 
 /*
@@ -158,40 +158,52 @@ void PF_Solver::_prepareTracers()
 */
 
 /**
- * Refresh when you reach an invalid situation.
+ * Hard refresh of the environments that asked for it, the others keep running.
+ * The policy is recreated from the saved one, with the schedule of the refreshed environments.
+ *
+ * @param needsRefreshing
  */
-void PF_Solver::_refresh()
+void PF_Solver::_refresh(const vector<bool> & needsRefreshing)
 {
-	individualFitnessesInWindow.clear();
-	schoolFitnessInWindow.clear();
-	timeInWindow.clear();
-	timeStepsInWindow.clear();
+	// the agents delete the policy they hold, it must not go away with the first refreshed environment
+	if (policy != NULL)
+	{
+		delete policy;
+		policy = NULL;
+	}
 
-	_dispose();
-	_prepareAgents();
+	PF_Environment * first = NULL;
+	for (int i = 0; i < NENVS; i++)
+		if (needsRefreshing[i])
+		{
+			envs[i]->dispose();
+			envs[i]->prepareAgents();
+			if (first == NULL) first = envs[i];
+		}
+
+	// the policy is shared, the first refreshed environment restarts it for all
+	assert(first != NULL);
+	first->collection->restartPolicy();
 }
 
-void PF_Solver::_softRefresh()
+/**
+ * Save the policy, unless it was already saved during this step.
+ *
+ * @param step_id
+ */
+void PF_Solver::_savePolicy(const long int step_id)
 {
-	individualFitnessesInWindow.clear();
-	schoolFitnessInWindow.clear();
-	timeInWindow.clear();
-	timeStepsInWindow.clear();
+	if (step_id == stepOfLastPolicySave) return;
 
-	collection->resetToInitialCondition();
-
-	//printf("REFRESH\n");
-	//exit(0);
+	printf("** Saving policy!\n");
+	envs[0]->collection->savePolicy();
+	stepOfLastPolicySave = step_id;
 }
 
 void PF_Solver::_dispose()
 {
-	if (collection != NULL)
-	{
-		delete collection;
-		collection = NULL;
-	}
-	assert(collection==NULL);
+	for (vector<PF_Environment *>::iterator it = envs.begin(); it != envs.end(); ++it)
+		(*it)->dispose();
 
 	if (policy != NULL)
 	{
@@ -203,168 +215,70 @@ void PF_Solver::_dispose()
 }
 
 /**
- * Compute the velocity of all agents.
- */
-void PF_Solver::_computeVelocity()
-{
-	vector<complex<Real> > velocities;
-	vector<pair<Real, Real> > targets;
-	map<pair<Real, Real>, PF_Agent*> targetsAgent;
-	vector<Vortex> vortices;
-
-	collection->getVortices(vortices);
-	collection->getTargets(targets, &targetsAgent);
-
-	for (int n = 0; n < (int) targets.size(); n++)
-	{
-		complex<Real> velocity(0, 0);
-		Real xn = targets[n].first;
-		Real yn = targets[n].second;
-		for (int j = 0; j < (int) vortices.size(); j++)
-		{
-			Real xj = vortices[j].x;
-			Real yj = vortices[j].y;
-			Real gammaj = vortices[j].gamma;
-			Real X = xn - xj;
-			Real Y = yn - yj;
-			velocity += (j == n) ? (Real) (0) : -gammaj * (Y + I * X) / (Real) (2 * M_PI * (X * X + Y * Y));
-		}
-		velocities.push_back(velocity); /// beware, these are conjugate velocities
-	}
-
-	vector<complex<Real> >::iterator itVel = velocities.begin();
-	for (vector<pair<Real, Real> >::iterator itTarg = targets.begin(); itTarg != targets.end(); ++itTarg, ++itVel)
-	{
-		PF_Agent *agent = targetsAgent[*itTarg];
-		agent->setVelocity(*itVel);
-	}
-}
-
-/**
- * Compute the velocity of all tracers.
+ * Compute the velocity of all tracers, in the flow of the first environment.
  */
 void PF_Solver::_computeVelocityTracers()
 {
 	const Real exagerateFactor = 10.0;
 	vector<complex<Real> > velocities;
 	vector<pair<Real, Real> > tracerPoints;
-	map<pair<Real, Real>, PF_Agent*> targetsTracer;
+	vector<PF_Agent*> targetsTracer;
 	vector<Vortex> vortices;
 
-	collection->getVortices(vortices);
-	tracers->getTargets(tracerPoints, &targetsTracer); /// @todo change this
+	envs[0]->collection->getVortices(vortices);
+	tracers->getTargets(tracerPoints, targetsTracer);
 
-	for (int n = 0; n < (int) tracerPoints.size(); n++)
-	{
-		complex<Real> velocity(0, 0);
-		Real xn = tracerPoints[n].first;
-		Real yn = tracerPoints[n].second;
-		for (int j = 0; j < (int) vortices.size(); j++)
-		{
-			Real xj = vortices[j].x;
-			Real yj = vortices[j].y;
-			Real gammaj = vortices[j].gamma;
-			Real X = xn - xj;
-			Real Y = yn - yj;
-			velocity += - exagerateFactor * gammaj * (Y + I * X) / (Real) (2 * M_PI * (X * X + Y * Y));
-		}
-		velocities.push_back(velocity); /// beware, these are conjugate velocities
-	}
+	/// beware, these are conjugate velocities
+	envs[0]->vortexVelocity->compute(vortices, tracerPoints, velocities, exagerateFactor);
 
-	vector<complex<Real> >::iterator itVel = velocities.begin();
-	for (vector<pair<Real, Real> >::iterator itTarg = tracerPoints.begin(); itTarg != tracerPoints.end(); ++itTarg, ++itVel)
-	{
-		PF_Agent *agent = targetsTracer[*itTarg];
-		agent->setVelocity(*itVel);
-	}
+	for (int n = 0; n < (int) tracerPoints.size(); n++)
+		targetsTracer[n]->setVelocity(velocities[n]);
 }
 
 /**
- * Set the time step based on minimum separation.
+ * All the environments advance with the same time step, the smallest one.
  *
  * @return
  */
 double PF_Solver::_setTimeStep()
 {
-	// Create positions-agents map
-	vector<pair<Real, Real> > position;
-	map<pair<Real, Real>, PF_Agent*> positionAgent;
-	collection->storePosition(position, &positionAgent);
-
-	//	const Real dtMax(1e-3);
-	const Real dtMax = 0.005 / unitVelocity;
-	const Real dtMin = 5e-4 / unitVelocity ;
-	const Real DMIN = CHARLENGTH / 2.0 / (2 * sqrt(2 * M_PI));
-	const Real DMAX = 2.0 * CHARLENGTH / (2 * sqrt(2 * M_PI));
-
-	vector<pair<Real, Real> > storeIndex;
-	pair<Real, Real> coord;
-
-	int size = position.size();
-	Real minDist = numeric_limits<Real>::max();
-	for (int n = 0; n < size - 1; n++)
-	{
-		Real x1 = position[n].first;
-		Real y1 = position[n].second;
-		for (int s = n + 1; s < size; s++)
-		{
-			Real x2 = position[s].first;
-			Real y2 = position[s].second;
-			Real dist = sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2));
-			if (dist < minDist)
-			{
-				storeIndex.clear();
-				minDist = dist;
-				coord.first = x1;
-				coord.second = y1;
-				storeIndex.push_back(coord);
-				coord.first = x2;
-				coord.second = y2;
-				storeIndex.push_back(coord);
-			}
-		}
-	}
-
-	double dt = max(dtMin, min(dtMax, max((Real) 0, minDist - DMIN) * (dtMax - dtMin) / (DMAX - DMIN)));
-
-	if ((Real) dt == dtMin)
-		for (vector<pair<Real, Real> >::iterator it = storeIndex.begin(); it != storeIndex.end(); ++it)
-		{
-			PF_Agent *agent = positionAgent[*it];
-			agent->reachedDtMin();
-		}
+	double dt = numeric_limits<double>::max();
+	for (vector<PF_Environment *>::iterator it = envs.begin(); it != envs.end(); ++it)
+		dt = min(dt, (*it)->setTimeStep());
 
-	dt = dtMax;
 	return (dt);
 }
 
 /**
- * Save the policies and the last time where we are able restart time.
+ * Save the agents data and the restart time, of the first environment.
  *
  * @param time
  */
 void PF_Solver::_save(double time)
 {
-	collection->saveData(time);
-
-	// Save time as well
-	ofstream out("RestartTime.txt", ios::out | ios::trunc);
-	out.precision(10);
-	out << time << " ";
-	out << nTimesLearned;
-	out.close();
+	envs[0]->save(time);
 }
 
 /**
- * Save all resets (different from restarts).
+ * Every environment is done averaging: write the fitness of the run and stop.
+ *
  * @param time
  */
-void PF_Solver::_saveResetTime(double time)
+void PF_Solver::_exit(double time)
 {
+	printf("** EXITING: reached expected sim time %e\n", time);
+
+	// Write fitness (overwrite, one number), averaged over the environments
+	Real fitness = 0.0;
+	for (vector<PF_Environment *>::iterator it = envs.begin(); it != envs.end(); ++it)
+		fitness += (*it)->finalFitness();
+	fitness /= NENVS;
+
 	FILE* fid;
-	fid = fopen("resets.txt", "a");
-	fprintf(fid, "%e\n", time);
+	fid = fopen("fitness", "w");
+	fprintf(fid, "%e \n", fitness);
 	fclose(fid);
+	abort();
 }
 
 #ifdef _RL_VIZ
@@ -476,12 +390,12 @@ void PF_Solver::_paint(const double time)
 	if (ISLABFRAME)
 	{
 //		_paintBox(edgeLength, bottomLeftCorner, lineColor);
-		collection->paint();
+		envs[0]->collection->paint();
 		if (ISUSINGTRACERS) tracers->paint();
 	}
 	else
 	{
-		collection->paint(1.0/edgeLength, centerOfSchool);
+		envs[0]->collection->paint(1.0/edgeLength, centerOfSchool);
 		if (ISUSINGTRACERS) tracers->paint(1.0/edgeLength, centerOfSchool);
 	}
 
@@ -535,213 +449,6 @@ void PF::PF_Solver::_paintText(float x, float y, const char* text, float r, floa
 #endif
 
 
-void PF::PF_Solver::_checkStatus(double time, double & timeAtLastValidRefresh)
-{
-	// LEARNING STATE
-	if (nTimesLearned < NLEARNINGLEVELS)
-	{
-		if (time - timeAtLastValidRefresh > LEARNINGTIME)
-		{
-			nTimesLearned++;
-			printf("** Saving policy!\n");
-			collection->savePolicy();
-			_saveResetTime(time);
-			timeAtLastValidRefresh = time;
-
-			if ((nTimesLearned == NLEARNINGLEVELS))
-			{
-				LR = 0.0;
-				GREEDYEPS = 0.0;
-			}
-			else
-			{
-				LR /= 2.0;
-				GREEDYEPS /= 2.0;
-			}
-
-//			LEARNINGTIME /= 2.0;
-
-			_refresh(); // hard refresh
-
-			printf("** Finished learning stage %d/%d. New values for LR = %e, GREEDYEPS = %e, LEARNINGTIME = %0.2f.\n", nTimesLearned, NLEARNINGLEVELS, LR, GREEDYEPS, LEARNINGTIME);
-
-			needsRefreshing = true;
-		}
-		solverState = learning;
-	}
-
-	// AVERAGING STATE
-	else if (nTimesAveraged < NAVG && ISCONTROLLED)
-	{
-		LR = 0.0;
-		GREEDYEPS = 0.0;
-
-		if (time - timeAtLastValidRefresh > FITNESSTIME * FITNESSBUFFER) // finished with one averaging run, save fitness
-		{
-			_computeTimeAveragedFitness(time);
-
-			currentFitness = (nCompletedAveraging * currentFitness + timeAveragedSchoolFitness) / (nCompletedAveraging + 1); // running average
-			crashPenalty = nAveragingScrewUps;
-
-			// Write fitness (overwrite, one number)
-			FILE* fid;
-			fid = fopen("fitness", "w");
-			fprintf(fid, "%e \n", currentFitness + (double)crashPenalty + penaltyForBeingTooClose);
-			fclose(fid);
-
-			// Calculate fitness using another way and print history to a file
-			Real sum = 0.0;
-			currentFitnesses.push_back(timeAveragedSchoolFitness);
-			const int nAveragesSoFar = currentFitnesses.size();
-			for (int i = 0; i < nAveragesSoFar; ++i)
-			{
-				sum += currentFitnesses[i];
-			}
-			const Real thisAverage = sum / nAveragesSoFar;
-
-			Real sigma = 0;
-			Real sigmasum = 0;
-			for (int i = 0; i < nAveragesSoFar; ++i)
-			{
-				sigmasum += (currentFitnesses[i] - thisAverage) * (currentFitnesses[i] - thisAverage);
-			}
-			sigma = sqrt(sigmasum / nAveragesSoFar);
-
-			// Write fitness history
-			fid = fopen("fitnessStatsHistory", "a");
-			fprintf(fid, "%d %e %e\n", nAveragesSoFar, thisAverage, sigma);
-			fclose(fid);
-
-			// Calculate individual fitness and write to a single file
-			const int n = avgFitness.size();
-			vector<pair<Real, Real> > coordinates;
-			collection->getCoordinates(coordinates);
-
-			fid = fopen("individualFitnesses", "w");
-			for (int i = 0; i < n; ++i)
-			{
-				currentIndividualFitness[i] = (nCompletedAveraging * currentIndividualFitness[i] + avgFitness[i]) / (nCompletedAveraging + 1); // running average
-				fprintf(fid, "%e %e %e\n", coordinates[i].first, coordinates[i].second, currentIndividualFitness[i]);
-			}
-			fclose(fid);
-
-			// Calculate individual fitness statistics
-			fid = fopen("individualFitnessStatsHistory", "a");
-			currentIndividualFitnesses.push_back(avgFitness);
-			fprintf(fid, "** Average %d\n", nAveragesSoFar);
-			for (int j = 0; j < n; j++)
-			{
-				Real sum = 0.0;
-				for (int i = 0; i < nAveragesSoFar; ++i)
-				{
-					const vector<double> &fitnessForThisSet = currentIndividualFitnesses[i];
-					sum += fitnessForThisSet[j];
-				}
-
-				Real thisAverage = sum / nAveragesSoFar;
-				Real sigma = 0;
-				Real sigmasum = 0;
-				for (int i = 0; i < nAveragesSoFar; ++i)
-				{
-					sigmasum += (currentFitnesses[i] - thisAverage) * (currentFitnesses[i] - thisAverage);
-				}
-				sigma = sqrt(sigmasum / nAveragesSoFar);
-				fprintf(fid, "%e %e %e %e\n", coordinates[j].first, coordinates[j].second, thisAverage, sigma);
-			}
-			fclose(fid);
-
-			_saveResetTime(time);
-			timeAtLastValidRefresh = time;
-			_refresh(); // hard resets here
-
-			needsRefreshing = true;
-			nTimesAveraged++;
-			nCompletedAveraging++;
-
-			printf("** Finished averaging completely %d times (out of %d, NAVG = %d).\n", nCompletedAveraging, nTimesAveraged, NAVG);
-			printf("** Screwed up %d times so far (out of %d, NAVG = %d) \n", nAveragingScrewUps, nTimesAveraged, NAVG);
-			printf("** LR = %e. FITNESSTIME = %0.2f, FITNESSBUFFER = %0.2f.\n", LR, FITNESSTIME, FITNESSBUFFER);
-			printf("** currentFitness = %e, crashPenalty = %e, penaltyForBeingTooClose = %e.\n", currentFitness, (double)crashPenalty, penaltyForBeingTooClose);
-			printf("** currentFitnessCheck = %e.\n", thisAverage);
-			printf("** USING FITNESS %d!!! \n", FITSELECT);
-		}
-
-		solverState = averaging;
-	}
-
-	// EXIT STATES
-	else if (!ISCONTROLLED) abort();
-
-	else if (nTimesAveraged == NAVG)
-	{
-		printf("** EXITING: reached expected sim time %e\n", time);
-		// Write fitness (overwrite, one number)
-		crashPenalty = NAVG - nCompletedAveraging;
-		FILE* fid;
-		fid = fopen("fitness", "w");
-		fprintf(fid, "%e \n", currentFitness + (double)crashPenalty + penaltyForBeingTooClose);
-		fclose(fid);
-		abort();
-	}
-}
-
-void PF::PF_Solver::_checkStatusPostAction(double time, double dt, bool valid, double & timeAtLastValidRefresh, double & timeAtLastNonValidRefresh)
-{
-	if (ISCONTROLLED)
-	{
-		if (!valid || dt <= 1e-4) // || time step is too small -> probably collision
-		{
-			if (solverState == averaging)
-			{
-				nTimesAveraged++;
-				nAveragingScrewUps++;
-				_saveResetTime(time);
-				timeAtLastValidRefresh = time;
-				printf("** WARNING: Screwed up %d times so far (out of %d, NAVG = %d) \n", nAveragingScrewUps, nTimesAveraged, NAVG);
-			}
-
-			printf("** NON VALID: Refresh at t = %e using %s.\n", time, isUsingSoftReset ? "soft resets" : "hard resets");
-
-			// CHECK IF CRASHING TOO MUCH
-			if (solverState == learning)
-			{
-				const int nMaxTerribleRefresh = 500;
-				const double minTimeBetweenRefresh = 10.0/unitVelocity;
-
-				if (time - timeAtLastNonValidRefresh < minTimeBetweenRefresh)
-				{
-					nTeribleRefreshes++;
-					printf("** That is %d terrible refreshes with minTimeBetweenRefresh = %0.4f\n", nTeribleRefreshes, minTimeBetweenRefresh);
-				}
-
-				if (nTeribleRefreshes == nMaxTerribleRefresh)
-				{
-					printf("** Reached nMaxTerribleRefresh = %d. Agents are probably close given the decision making time.\n", nMaxTerribleRefresh);
-					FILE* fid;
-					fid = fopen("fitness", "w");
-					fprintf(fid, "%e \n", 1e8 - time); // CAN'T LEARN AT ALL -> ABORT (subtract time to rank better, if the simulation goes longer = better)
-					fclose(fid);
-					abort();
-				}
-			}
-
-			if (isUsingSoftReset) // to reduce dumping to files
-			{
-				_softRefresh();
-			}
-			else
-			{
-				printf("** Saving policy!\n");
-				collection->savePolicy();
-				_saveResetTime(time);
-				_refresh();
-			}
-
-			timeAtLastNonValidRefresh = time;
-		}
-	}
-}
-
 void PF::PF_Solver::_checkSettings()
 {
 	assert(SAVEFREQ >= 0.0);
@@ -749,6 +456,7 @@ void PF::PF_Solver::_checkSettings()
 	assert(YPOS >= 0.0 && YPOS <= 1.0);
 	assert(CHARLENGTH >= 0.0 && CHARLENGTH <= 1.0);
 
+	const Real unitVelocity = envs[0]->unitVelocity;
 	const double timeToReachOtherSide = 1.0 / (unitVelocity * CHARLENGTH);
 	if (FITNESSTIME * FITNESSBUFFER > timeToReachOtherSide)
 	{
@@ -759,165 +467,13 @@ void PF::PF_Solver::_checkSettings()
 	}
 }
 
-Real PF_Solver::_computeTooClosePenalty()
-{
-	const Real distanceFactor = 1.0;
-	const Real minDist = distanceFactor * CHARLENGTH;
-	const Real penalizationFactor = 0.0;
-	Real penalty = 0.0;
-
-	vector<pair<Real, Real> > points;
-	collection->getCoordinates(points);
-
-	const int n = points.size();
-	for (int i = 0; i < n; i++)
-	{
-		const Real xi = points[i].first;
-		const Real yi = points[i].second;
-
-		for (int j = i + 1; j < n; j++) // only count the upper corner
-		{
-			const Real xj = points[j].first;
-			const Real yj = points[j].second;
-			const Real dist = (xi - xj) * (xi - xj) + (yi - yj) * (yi - yj);
-
-			if (dist < minDist * minDist)
-				penalty += penalizationFactor * CHARLENGTH * CHARLENGTH / dist;
-		}
-	}
-	return (penalty);
-}
-
-/**
- *
- * @param time
- * @param dt
- */
-void PF::PF_Solver::_computeFitness(double time, double dt)
-{
-	collection->fitness();
-
-	if (solverState == averaging) // Start saving fitnesses in deque if averaging
-	{
-		// Get all fitnesses
-		vector<Real> allFitnesses;
-		collection->getFitnessValues(allFitnesses);
-
-		// Add to deques
-		individualFitnessesInWindow.push_back(allFitnesses);
-		timeInWindow.push_back(time);
-		timeStepsInWindow.push_back(dt);
-
-		// Check if front of deque is outside window, if yes, pop off
-		while (time - timeInWindow.front() > FITNESSTIME)
-		{
-			individualFitnessesInWindow.pop_front();
-			timeInWindow.pop_front();
-			timeStepsInWindow.pop_front();
-		}
-	}
-}
-
-
-void PF::PF_Solver::_computeTimeAveragedFitness(double time)
-{
-	// Count the number of guys that you want to average
-	const double actualWindow = timeInWindow.back() - timeInWindow.front();
-	const int n = collection->numberOfAgents();
-
-//	vector<double> avgFitness(n, 0.0);
-
-	for (int i = 0; i < (int)individualFitnessesInWindow.size(); i++)
-	{
-		const vector<Real> fitnessHere = individualFitnessesInWindow[i];
-
-		for (int j = 0; j < n; j++)
-		{
-			avgFitness[j] += fitnessHere[j]*timeStepsInWindow[i];
-		}
-	}
-
-	int nInAverage = n;
-	Real avgSchoolFitness = 0.0;
-	for (int i = 0; i < n; i++)
-	{
-		avgFitness[i] /= actualWindow;
-
-		if (collection[i].isAveraged == true)
-		{
-			avgSchoolFitness += avgFitness[i];
-		}
-		else
-		{
-			nInAverage--;
-		}
-	}
-	avgSchoolFitness /= nInAverage;
-	timeAveragedSchoolFitness = avgSchoolFitness;
-
-//	// Write fitness history
-//	FILE* fid;
-//	fid = fopen("schoolFitnesshistory", "a");
-//	fprintf(fid, "%e \n", avgSchoolFitness);
-//	fclose(fid);
-//
-//	vector<pair<Real, Real> > coordinates;
-//	collection->getCoordinates(coordinates);
-//
-//	// Write individual fitnesses
-//	fid = fopen("individualFitnessesHistory", "a");
-//	for (int i = 0; i < n; i++)
-//		fprintf(fid, "%e %e %e\n", coordinates[i].first, coordinates[i].second, avgFitness[i]);
-//	fclose(fid);
-
-	/** COMMENT ME OUT! **/
-//	fid = fopen("blah.txt", "a");
-//	fprintf(fid, "%e ", time);
-//	for (int i = 0; i < n; i++)
-//		fprintf(fid, "%e ", avgFitness[i]);
-//	fprintf(fid, "\n");
-//	fclose(fid);
-//
-//	fid = fopen("actions.txt", "a");
-//	fprintf(fid, "%e ", time);
-//	const vector<Real> printMe = individualFitnessesInWindow.back();
-//	for (int i = 0; i < n; i++)
-//		fprintf(fid, "%e ", printMe[i]);
-//	fprintf(fid, "\n");
-//	fclose(fid);
-//
-//	fid = fopen("avgFitness.txt", "a");
-//	fprintf(fid, "%e ", time);
-//	fprintf(fid, "%e \n", avgSchoolFitness);
-//	fclose(fid);
-	/** COMMENT ME OUT! **/
-}
-
-
-void PF::PF_Solver::_computeError(double time)
-{
-	vector<Real> errors;
-	collection->error();
-	collection->getErrorValues(errors);
-
-	// Compute average
-	schoolError = accumulate(errors.begin(), errors.end(), 0.0);
-	schoolError /= collection->numberOfAgents();
-
-	FILE *fid;
-	fid = fopen("error.txt", "a");
-	fprintf(fid, "%e %e \n", time, schoolError);
-	fclose(fid);
-}
-
-
 void PF::PF_Solver::_getTargetSchoolInfo(Real x[2], Real & edgeLength)
 {
 	const Real windowScale = 1.5; // todo
 
 	vector<pair<Real, Real> > targetPoints;
 
-	collection->getTargetPoints(targetPoints);
+	envs[0]->collection->getTargetPoints(targetPoints);
 	vector<Real> xT;
 	vector<Real> yT;
 
@@ -962,21 +518,31 @@ void PF_Solver::run()
 #endif
 
 	double time = 0.0;
-	double timeAtLastValidRefresh = 0.0;
-	double timeAtLastNonValidRefresh = 0.0;
 	long unsigned int step_id = 0;
 
-	penaltyForBeingTooClose = _computeTooClosePenalty();
-	printf("** Penalty for being too close = %e.\n", penaltyForBeingTooClose);
+	for (vector<PF_Environment *>::iterator it = envs.begin(); it != envs.end(); ++it)
+		(*it)->computeTooClosePenalty();
 
 	_save(time);
 
 	while (true)
 	{
-		_checkStatus(time, timeAtLastValidRefresh);
+		// Status of every environment, only the ones that finished a learning stage are refreshed with the new schedule
+		vector<bool> needsRefreshing(NENVS, false);
+		bool isRefreshing = false;
+		bool isFinished = true;
+		for (int i = 0; i < NENVS; i++)
+		{
+			needsRefreshing[i] = envs[i]->checkStatus(time);
+			isRefreshing = isRefreshing || needsRefreshing[i];
+			isFinished = isFinished && envs[i]->isFinished;
+		}
+
+		if (isFinished) _exit(time);
 
-		if (needsRefreshing) {
-			needsRefreshing = false;
+		if (isRefreshing) {
+			_savePolicy(step_id);
+			_refresh(needsRefreshing); // hard refresh
 			continue;
 		}
 
@@ -984,41 +550,55 @@ void PF_Solver::run()
 		const double dt = _setTimeStep();
 		profiler.pop_stop();
 
-		profiler.push_start("CHOOSE");
-		const bool valid = collection->choose(time);
-		profiler.pop_stop();
+		// Choose an action, environment after environment since the policy is shared
+		for (int i = 0; i < NENVS; i++)
+		{
+			profiler.push_start("CHOOSE");
+			const bool valid = envs[i]->collection->choose(time);
+			profiler.pop_stop();
 
-		profiler.push_start("CHECK");
-		_checkStatusPostAction(time, dt, valid, timeAtLastValidRefresh, timeAtLastNonValidRefresh);
-		profiler.pop_stop();
+			profiler.push_start("CHECK");
+			// environments sharing the policy only soft refresh here, no sample is left pending in a recreated policy
+			needsRefreshing[i] = envs[i]->checkStatusPostAction(time, dt, valid);
+			isRefreshing = isRefreshing || needsRefreshing[i];
+			profiler.pop_stop();
+		}
+
+		if (isRefreshing) {
+			_savePolicy(step_id);
+			_refresh(needsRefreshing); // hard refresh
+			continue;
+		}
 
-		profiler.push_start("VEL");
-		_computeVelocity();
+		// Velocities, update and rewards, all the environments concurrently
+		profiler.push_start("UPDATE");
+		TBB_update_envs tbb_update_envs(dt, time, ISCONTROLLED, envs);
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, envs.size(), 1), tbb_update_envs, tbb::auto_partitioner());
 #ifdef _RL_VIZ
 		if (ISUSINGTRACERS) _computeVelocityTracers();
 #endif
 		profiler.pop_stop();
 
-		profiler.push_start("UPDATE");
-		collection->update(dt, time);
-		collection->updatePostVelocityUpdate(dt, time);
-		profiler.pop_stop();
-
+		// Learn: the shared policy holds the samples started by all the environments, they all hand
+		// their rewards and end states before the first update consumes the whole batch
 		if (ISCONTROLLED)
 		{
-			profiler.push_start("REWARD");
-			collection->reward(time);
-			profiler.pop_stop();
-
 			profiler.push_start("LEARN");
-			collection->learn(time);
+			if (NENVS == 1)
+				envs[0]->collection->learn(time);
+			else
+			{
+				for (vector<PF_Environment *>::iterator it = envs.begin(); it != envs.end(); ++it)
+					(*it)->collection->collect(time);
+				for (vector<PF_Environment *>::iterator it = envs.begin(); it != envs.end(); ++it)
+					(*it)->collection->learnCollected(time);
+			}
 			profiler.pop_stop();
 		}
 
 		if (step_id % SAVEFREQ == 0)
 		{
-			printf("** Saving policy!\n");
-			collection->savePolicy();
+			_savePolicy(step_id);
 			_save(time);
 			profiler.printSummary();
 		}
@@ -1027,15 +607,21 @@ void PF_Solver::run()
 		step_id++;
 
 		profiler.push_start("FITNESS");
-		_computeFitness(time, dt);
+		for (vector<PF_Environment *>::iterator it = envs.begin(); it != envs.end(); ++it)
+			(*it)->computeFitness(time, dt);
 		profiler.pop_stop();
 
 		// Average only when needed
-		if (step_id % FITNESSSAVEFREQ == 0 && solverState == averaging)
+		if (step_id % FITNESSSAVEFREQ == 0)
 		{
-			_save(time);
-			_computeError(time);
-			_computeTimeAveragedFitness(time);
+			if (envs[0]->solverState == PF_Environment::averaging) _save(time);
+
+			for (vector<PF_Environment *>::iterator it = envs.begin(); it != envs.end(); ++it)
+				if ((*it)->solverState == PF_Environment::averaging)
+				{
+					(*it)->computeError(time);
+					(*it)->computeTimeAveragedFitness(time);
+				}
 		}
 
 #ifdef _RL_VIZ
@@ -1052,4 +638,3 @@ void PF_Solver::run()
 #endif
 	}
 }
-
@@ -0,0 +1,234 @@
+/*
+ *  PF_VortexVelocity.h
+ *  DipoleCode
+ *
+ *	Velocity induced by the point vortices of the agents at a set of target
+ *	points. Few vortices are summed directly, in parallel over the targets;
+ *	larger sets are sorted in the mani-fmm2d quadtree and every target walks
+ *	the tree, using the multipole expansion of the well separated boxes
+ *	(Barnes-Hut criterion theta) and the direct kernel for the others.
+ *	A target lying on a vortex does not feel that vortex.
+ *
+ *	The velocities are returned conjugated (u - i v), as used by the agents.
+ *
+ */
+#pragma once
+
+#ifndef _FMMSILENT
+#define _FMMSILENT
+#endif
+
+#include <string.h>
+#include <complex>
+#include <vector>
+#include "tbb/parallel_for.h"
+#include "tbb/blocked_range.h"
+
+//referred to by the default arguments of the evaluator, defined in PF_Solver.cpp
+extern double _THETA;
+
+#include "mani-fmm2d/VortexExpansions.h"
+#include "mani-fmm2d/hcfmm_box.h"
+#include "mani-fmm2d/hcfmm_boxBuilder_serial.h"
+#include "mani-fmm2d/hcfmm_evaluator_serial.h"
+#include "PF_Agent.h"
+
+namespace PF
+{
+
+struct PF_VelocityRHS
+{
+	static const int dim = 2;
+	Real x[2];
+
+	PF_VelocityRHS()
+	{
+		x[0] = x[1] = 0.0;
+	}
+
+	PF_VelocityRHS& operator+=(const PF_VelocityRHS& r)
+	{
+		x[0] += r.x[0];
+		x[1] += r.x[1];
+		return *this;
+	}
+};
+
+struct PF_VortexParticle
+{
+	typedef PF_VelocityRHS RHSType;
+	typedef Real BaseType;
+
+	static const int dim = 2;
+	static const int pdim = 1;
+
+	Real x[2];
+	Real w[1];
+};
+
+struct PF_VelocityTarget
+{
+	typedef PF_VelocityRHS RHSType;
+	typedef Real BaseType;
+
+	Real x[2];
+	RHSType RHS;
+
+	RHSType computeRHS(const PF_VortexParticle * p) const
+	{
+		RHSType r;
+
+		const Real X = x[0] - p->x[0];
+		const Real Y = x[1] - p->x[1];
+		const Real r2 = X*X + Y*Y;
+
+		if (r2 > 0)
+		{
+			const Real factor = p->w[0]/(Real)(2*M_PI*r2);
+			r.x[0] = -factor*Y;
+			r.x[1] = +factor*X;
+		}
+
+		return r;
+	}
+};
+
+class PF_VortexVelocity
+{
+	typedef _VortexExpansions<PF_VortexParticle, _ORDER_> tExpansions;
+	typedef HCFMM::Box<tExpansions, _FMM_MAX_LEVEL_> tBox;
+	typedef HCFMM::boxBuilder_serial<tExpansions, _FMM_MAX_LEVEL_> tBoxBuilder;
+	typedef HCFMM::Evaluator_serial<tExpansions, PF_VelocityTarget, _FMM_MAX_LEVEL_> tEvaluator;
+
+	const Real theta;
+	const int maxDirect;
+
+	vector<Real> vx, vy, vgamma;
+	vector<PF_VortexParticle> particles;
+
+	struct DirectSum
+	{
+		const Real * const vx, * const vy, * const vgamma;
+		const int nvortices;
+		const vector<pair<Real, Real> >& targets;
+		vector<complex<Real> >& velocities;
+
+		DirectSum(const Real * vx, const Real * vy, const Real * vgamma, const int nvortices, const vector<pair<Real, Real> >& targets, vector<complex<Real> >& velocities):
+		vx(vx), vy(vy), vgamma(vgamma), nvortices(nvortices), targets(targets), velocities(velocities) {}
+
+		DirectSum(const DirectSum& c): vx(c.vx), vy(c.vy), vgamma(c.vgamma), nvortices(c.nvortices), targets(c.targets), velocities(c.velocities) {}
+
+		void operator()(const tbb::blocked_range<int>& range) const
+		{
+			for(int n=range.begin(); n<range.end(); n++)
+			{
+				const Real xn = targets[n].first;
+				const Real yn = targets[n].second;
+
+				Real u = 0, v = 0;
+
+				//flat arrays and no branch but the select: the loop is vectorized
+				for(int j=0; j<nvortices; j++)
+				{
+					const Real X = xn - vx[j];
+					const Real Y = yn - vy[j];
+					const Real r2 = X*X + Y*Y;
+					const Real factor = (r2 > 0) ? vgamma[j]/r2 : (Real)0;
+
+					u -= factor*Y;
+					v += factor*X;
+				}
+
+				velocities[n] = complex<Real>(u, -v)/(Real)(2*M_PI);
+			}
+		}
+	};
+
+	struct TreeSum
+	{
+		const tEvaluator& evaluator;
+		tBox * const root;
+		const Real theta;
+		const vector<pair<Real, Real> >& targets;
+		vector<complex<Real> >& velocities;
+
+		TreeSum(const tEvaluator& evaluator, tBox * root, const Real theta, const vector<pair<Real, Real> >& targets, vector<complex<Real> >& velocities):
+		evaluator(evaluator), root(root), theta(theta), targets(targets), velocities(velocities) {}
+
+		TreeSum(const TreeSum& c): evaluator(c.evaluator), root(c.root), theta(c.theta), targets(c.targets), velocities(c.velocities) {}
+
+		void operator()(const tbb::blocked_range<int>& range) const
+		{
+			for(int n=range.begin(); n<range.end(); n++)
+			{
+				PF_VelocityTarget target;
+				target.x[0] = targets[n].first;
+				target.x[1] = targets[n].second;
+
+				const PF_VelocityRHS u = evaluator.traverseRecursive(&target, root, theta);
+
+				velocities[n] = complex<Real>(u.x[0], -u.x[1]);
+			}
+		}
+	};
+
+public:
+
+	//theta: opening angle of the boxes, maxDirect: number of vortices up to which the sum is direct
+	PF_VortexVelocity(const Real theta = 0.5, const int maxDirect = 512): theta(theta), maxDirect(maxDirect) {}
+
+	//the circulations are multiplied by gammaFactor
+	void compute(const vector<Vortex>& vortices, const vector<pair<Real, Real> >& targets, vector<complex<Real> >& velocities, const Real gammaFactor = 1)
+	{
+		const int nvortices = vortices.size();
+		const int ntargets = targets.size();
+
+		velocities.resize(ntargets);
+
+		if (ntargets == 0) return;
+
+		if (nvortices <= maxDirect)
+		{
+			vx.resize(nvortices);
+			vy.resize(nvortices);
+			vgamma.resize(nvortices);
+
+			for(int j=0; j<nvortices; j++)
+			{
+				vx[j] = vortices[j].x;
+				vy[j] = vortices[j].y;
+				vgamma[j] = gammaFactor*vortices[j].gamma;
+			}
+
+			DirectSum direct(nvortices ? &vx.front() : NULL, nvortices ? &vy.front() : NULL, nvortices ? &vgamma.front() : NULL, nvortices, targets, velocities);
+			tbb::parallel_for(tbb::blocked_range<int>(0, ntargets), direct, tbb::auto_partitioner());
+
+			return;
+		}
+
+		//the builder reorders the particles
+		particles.resize(nvortices);
+
+		for(int j=0; j<nvortices; j++)
+		{
+			particles[j].x[0] = vortices[j].x;
+			particles[j].x[1] = vortices[j].y;
+			particles[j].w[0] = gammaFactor*vortices[j].gamma;
+		}
+
+		tBox * root = new tBox;
+		tBoxBuilder::buildBoxes(&particles.front(), nvortices, root);
+		tBoxBuilder::generateExpansions(root);
+
+		{
+			const tEvaluator evaluator(root);
+
+			TreeSum tree(evaluator, root, theta, targets, velocities);
+			tbb::parallel_for(tbb::blocked_range<int>(0, ntargets), tree, tbb::auto_partitioner());
+		}
+
+		delete root;
+	}
+};
+
+} /*namespace PF*/